@@ -0,0 +1,124 @@
+/*
+ * Cloud View
+ *
+ * Lightweight view of a subset of a point cloud: a shared pointer to the cloud plus an
+ * (optional) shared list of indices. Copying a view does not copy any point, so filters,
+ * clustering and rasterization can be chained without materializing the subclouds.
+ *
+ * A view without indices represents the whole cloud.
+ *
+ */
+
+#ifndef CLOUD_VIEW_HPP
+#define CLOUD_VIEW_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+template<typename PointT>
+class CloudView
+{
+    public:
+        typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+        CloudView() {}
+        CloudView(const PointCloudConstPtr& cloud, const pcl::IndicesConstPtr& indices = pcl::IndicesConstPtr())
+            : cloud(cloud), indices(indices) {}
+        CloudView(const PointCloudConstPtr& cloud, const pcl::PointIndices& point_indices)
+            : cloud(cloud), indices(new std::vector<int>(point_indices.indices)) {}
+
+        const PointCloudConstPtr& getCloud() const { return cloud; }
+        const pcl::IndicesConstPtr& getIndices() const { return indices; }
+        bool hasIndices() const { return bool(indices); }
+
+        std::size_t size() const
+        {
+            if (!cloud) return 0;
+            return indices ? indices->size() : cloud->points.size();
+        }
+        bool empty() const { return size() == 0; }
+
+        //-- Index in the underlying cloud of the i-th point of the view
+        int index(std::size_t i) const { return indices ? (*indices)[i] : (int)i; }
+        const PointT& operator[](std::size_t i) const { return cloud->points[index(i)]; }
+
+        //-- Indices in the underlying cloud of all the points of the view
+        pcl::IndicesConstPtr getIndicesOrAll() const
+        {
+            if (indices)
+                return indices;
+
+            pcl::IndicesPtr all(new std::vector<int>(size()));
+            for (std::size_t i = 0; i < all->size(); i++)
+                (*all)[i] = i;
+            return all;
+        }
+
+        //-- Axis-aligned bounding box of the (finite) points of the view
+        bool getMinMax3D(PointT& min_point, PointT& max_point) const
+        {
+            float max_value = std::numeric_limits<float>::max();
+            Eigen::Vector3f min_bb(max_value, max_value, max_value), max_bb(-max_value, -max_value, -max_value);
+            bool found = false;
+            for (std::size_t i = 0; i < size(); i++)
+            {
+                const PointT& point = (*this)[i];
+                if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+                    continue;
+
+                min_bb = min_bb.cwiseMin(point.getVector3fMap());
+                max_bb = max_bb.cwiseMax(point.getVector3fMap());
+                found = true;
+            }
+
+            min_point.x = min_bb[0]; min_point.y = min_bb[1]; min_point.z = min_bb[2];
+            max_point.x = max_bb[0]; max_point.y = max_bb[1]; max_point.z = max_bb[2];
+            return found;
+        }
+
+        //-- Subview with the points inside the given box (limits included)
+        CloudView cropBox(const Eigen::Vector3f& min_bb, const Eigen::Vector3f& max_bb) const
+        {
+            pcl::IndicesPtr inside(new std::vector<int>);
+            for (std::size_t i = 0; i < size(); i++)
+            {
+                const PointT& point = (*this)[i];
+                if (point.x >= min_bb[0] && point.y >= min_bb[1] && point.z >= min_bb[2] &&
+                    point.x <= max_bb[0] && point.y <= max_bb[1] && point.z <= max_bb[2])
+                    inside->push_back(index(i));
+            }
+            return CloudView(cloud, inside);
+        }
+
+        //-- Copy the points of the view into a new cloud (only when a real cloud is needed,
+        //-- e.g. to save it to a file)
+        void copyTo(pcl::PointCloud<PointT>& output) const
+        {
+            if (!indices)
+            {
+                output = *cloud;
+                return;
+            }
+
+            output.points.resize(indices->size());
+            for (std::size_t i = 0; i < indices->size(); i++)
+                output.points[i] = cloud->points[(*indices)[i]];
+            output.header = cloud->header;
+            output.width = indices->size();
+            output.height = 1;
+            output.is_dense = cloud->is_dense;
+            output.sensor_origin_ = cloud->sensor_origin_;
+            output.sensor_orientation_ = cloud->sensor_orientation_;
+        }
+
+    private:
+        PointCloudConstPtr cloud;
+        pcl::IndicesConstPtr indices;
+};
+
+#endif // CLOUD_VIEW_HPP
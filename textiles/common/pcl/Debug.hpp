@@ -26,6 +26,9 @@ class Debug
         template<typename PointT>
         bool plotPointCloud(typename pcl::PointCloud<PointT>::Ptr& point_cloud,
                             const DebugColor& color, int point_size = 1);
+        template<typename PointT>
+        bool plotPointCloud(const typename pcl::PointCloud<PointT>::ConstPtr& point_cloud,
+                            const DebugColor& color, int point_size = 1);
 
         template<typename PointT, typename PointNT>
         bool plotNormals(typename pcl::PointCloud<PointT>::Ptr& cloud,
@@ -89,6 +92,13 @@ bool Debug::plotNormals(typename pcl::PointCloud<PointT>::Ptr& cloud,
 template<typename PointT>
 bool Debug::plotPointCloud(typename pcl::PointCloud<PointT>::Ptr& point_cloud,
                     const Debug::DebugColor& color, int point_size)
+{
+    return plotPointCloud<PointT>(typename pcl::PointCloud<PointT>::ConstPtr(point_cloud), color, point_size);
+}
+
+template<typename PointT>
+bool Debug::plotPointCloud(const typename pcl::PointCloud<PointT>::ConstPtr& point_cloud,
+                    const Debug::DebugColor& color, int point_size)
 {
     if (current_viewer == nullptr)
         if (!init_viewer())
@@ -0,0 +1 @@
+#include "NeighborhoodCache.hpp"
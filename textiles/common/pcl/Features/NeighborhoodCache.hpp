@@ -0,0 +1,189 @@
+/*
+ * Neighborhood Cache
+ *
+ * Search method that runs a single radius search per point, at the largest radius that will
+ * be needed, and keeps the neighbors sorted by distance in a compact CSR layout (one offset per
+ * point plus flat arrays of indices and squared distances). Queries for a point of the input
+ * cloud with a smaller radius are served as a prefix of its row, so the normals, RSD and WiLD
+ * of the same cloud share the adjacency instead of querying the kd-tree again each time.
+ *
+ * It is a pcl::search::Search, so it can be given to any PCL feature with setSearchMethod().
+ * PCL features query by index when the search surface is the input cloud, which is what makes
+ * them hit the cache. Queries by point, for other clouds or beyond the cached radius go to the
+ * underlying search (by default a SpatialHashSearch with cells of the largest radius).
+ *
+ * Memory grows with the number of neighbors at the largest radius: set it no larger than needed.
+ *
+ */
+
+#ifndef NEIGHBORHOOD_CACHE_HPP
+#define NEIGHBORHOOD_CACHE_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/search.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "SpatialHashSearch.hpp"
+
+template<typename PointT>
+class NeighborhoodCache : public pcl::search::Search<PointT>
+{
+    typedef pcl::search::Search<PointT> BaseClass;
+    typedef typename BaseClass::PointCloudConstPtr PointCloudConstPtr;
+    typedef typename BaseClass::IndicesConstPtr IndicesConstPtr;
+    typedef typename pcl::search::Search<PointT>::Ptr SearchPtr;
+
+    public:
+        typedef boost::shared_ptr<NeighborhoodCache<PointT> > Ptr;
+
+        using BaseClass::radiusSearch;
+        using BaseClass::nearestKSearch;
+
+        NeighborhoodCache() : BaseClass("NeighborhoodCache", true) {
+            //-- Set default values
+            max_radius = 0.03;
+            default_search.reset(new SpatialHashSearch<PointT>);
+            search = default_search;
+        }
+
+        //-- Largest radius that will be queried (set it before the input cloud)
+        void setMaxRadius(double max_radius) { this->max_radius = max_radius; }
+        double getMaxRadius() const { return max_radius; }
+        //-- Search used to fill the cache and for the queries it cannot serve
+        void setSearchMethod(const SearchPtr& search) { this->search = search; default_search.reset(); }
+
+        //-- Fills the cache for the given points (all the points of the cloud by default)
+        virtual void setInputCloud(const PointCloudConstPtr& cloud, const IndicesConstPtr& indices = IndicesConstPtr())
+        {
+            this->input_ = cloud;
+            this->indices_ = indices;
+            if (default_search)
+                default_search->setCellSize(max_radius);
+            search->setInputCloud(cloud, indices);
+            build();
+        }
+
+        //-- Queries by index: served from the cache when possible
+        virtual int radiusSearch(const pcl::PointCloud<PointT>& cloud, int index, double radius, std::vector<int>& k_indices,
+                                 std::vector<float>& k_sqr_distances, unsigned int max_nn = 0) const
+        {
+            const int* neighbors;
+            const float* sqr_distances;
+            int n = (&cloud == this->input_.get()) ? getNeighbors(index, radius, neighbors, sqr_distances) : -1;
+            if (n < 0)
+                return search->radiusSearch(cloud.points[index], radius, k_indices, k_sqr_distances, max_nn);
+
+            if (max_nn > 0 && n > (int)max_nn)
+                n = max_nn;
+            k_indices.assign(neighbors, neighbors + n);
+            k_sqr_distances.assign(sqr_distances, sqr_distances + n);
+            return n;
+        }
+
+        //-- Queries by point always go to the underlying search
+        virtual int radiusSearch(const PointT& point, double radius, std::vector<int>& k_indices,
+                                 std::vector<float>& k_sqr_distances, unsigned int max_nn = 0) const
+        {
+            return search->radiusSearch(point, radius, k_indices, k_sqr_distances, max_nn);
+        }
+
+        virtual int nearestKSearch(const PointT& point, int k, std::vector<int>& k_indices, std::vector<float>& k_sqr_distances) const
+        {
+            return search->nearestKSearch(point, k, k_indices, k_sqr_distances);
+        }
+
+        //-- Neighbors of a point of the input cloud within the radius, without copying them. Returns
+        //-- their number, or -1 if the point or radius are not cached (a radius given in float
+        //-- or double precision is the same radius)
+        int getNeighbors(int index, double radius, const int*& neighbors, const float*& sqr_distances) const
+        {
+            if (index < 0 || index >= (int)rows.size() || rows[index] < 0 || radius > max_radius * (1 + 1e-6))
+                return -1;
+
+            int row = rows[index];
+            const float* begin = row_sqr_distances.data() + offsets[row];
+            const float* end = row_sqr_distances.data() + offsets[row+1];
+            neighbors = row_indices.data() + offsets[row];
+            sqr_distances = begin;
+            if (radius >= max_radius)
+                return end - begin;
+            return std::upper_bound(begin, end, (float)(radius * radius)) - begin;
+        }
+
+        //-- Total number of cached neighbors
+        std::size_t size() const { return row_indices.size(); }
+
+    private:
+        void build()
+        {
+            int n = this->indices_ ? this->indices_->size() : this->input_->points.size();
+            rows.assign(this->input_->points.size(), -1);
+            offsets.assign(1, 0);
+            offsets.reserve(n + 1);
+            row_indices.clear();
+            row_sqr_distances.clear();
+
+            //-- Rows are searched in parallel by blocks and appended in order
+            const int block_size = 4096;
+            std::vector<std::vector<int> > block_indices(block_size);
+            std::vector<std::vector<float> > block_sqr_distances(block_size);
+            for (int block_start = 0; block_start < n; block_start += block_size)
+            {
+                int block_end = std::min(n, block_start + block_size);
+
+                #pragma omp parallel for schedule(dynamic, 64)
+                for (int k = block_start; k < block_end; k++)
+                {
+                    const PointT& point = this->input_->points[this->indices_ ? (*this->indices_)[k] : k];
+                    std::vector<int>& neighbors = block_indices[k - block_start];
+                    std::vector<float>& sqr_distances = block_sqr_distances[k - block_start];
+                    neighbors.clear();
+                    sqr_distances.clear();
+
+                    if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+                        continue;
+                    search->radiusSearch(point, max_radius, neighbors, sqr_distances);
+                    sortByDistance(neighbors, sqr_distances);
+                }
+
+                for (int k = block_start; k < block_end; k++)
+                {
+                    const std::vector<int>& neighbors = block_indices[k - block_start];
+                    const std::vector<float>& sqr_distances = block_sqr_distances[k - block_start];
+                    rows[this->indices_ ? (*this->indices_)[k] : k] = k;
+                    row_indices.insert(row_indices.end(), neighbors.begin(), neighbors.end());
+                    row_sqr_distances.insert(row_sqr_distances.end(), sqr_distances.begin(), sqr_distances.end());
+                    offsets.push_back(row_indices.size());
+                }
+            }
+        }
+
+        static void sortByDistance(std::vector<int>& neighbors, std::vector<float>& sqr_distances)
+        {
+            std::vector<std::pair<float, int> > pairs(neighbors.size());
+            for (std::size_t i = 0; i < neighbors.size(); i++)
+                pairs[i] = std::make_pair(sqr_distances[i], neighbors[i]);
+            std::sort(pairs.begin(), pairs.end());
+            for (std::size_t i = 0; i < pairs.size(); i++)
+            {
+                sqr_distances[i] = pairs[i].first;
+                neighbors[i] = pairs[i].second;
+            }
+        }
+
+        SearchPtr search;
+        typename SpatialHashSearch<PointT>::Ptr default_search;
+        double max_radius;
+
+        //-- CSR adjacency: neighbors of the point of row r in [offsets[r], offsets[r+1])
+        std::vector<int> rows;                  //-- Row of each point of the cloud (-1 if not cached)
+        std::vector<std::size_t> offsets;
+        std::vector<int> row_indices;
+        std::vector<float> row_sqr_distances;
+};
+
+#endif // NEIGHBORHOOD_CACHE_HPP
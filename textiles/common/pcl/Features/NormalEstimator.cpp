@@ -0,0 +1 @@
+#include "NormalEstimator.hpp"
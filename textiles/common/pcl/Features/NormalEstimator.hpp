@@ -0,0 +1,114 @@
+/*
+ * Normal Estimator
+ *
+ * Computes the normals of a cloud with the fastest method available for it:
+ *  - Organized clouds (height > 1, e.g. 640x480 frames from the grabber or OpenNI2) use
+ *    integral images, which take constant time per point and need no search tree.
+ *  - Unorganized clouds use pcl::NormalEstimationOMP with a radius or k nearest neighbors.
+ *
+ * Normals are flipped towards the viewpoint in both cases.
+ *
+ */
+
+#ifndef NORMAL_ESTIMATOR_HPP
+#define NORMAL_ESTIMATOR_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/features/integral_image_normal.h>
+#include <pcl/search/kdtree.h>
+
+#include <iostream>
+
+#include "SpatialHashSearch.hpp"
+
+template<typename PointT>
+class NormalEstimator
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::search::Search<PointT>::Ptr SearchPtr;
+
+    public:
+        NormalEstimator() {
+            //-- Set default values
+            radius = 0.03;
+            k = 0;
+            view_point = Eigen::Vector3f::Zero();
+            use_organized = true;
+            max_depth_change_factor = 0.02;
+            smoothing_size = 10.0;
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+
+        //-- Unorganized clouds: neighbors within a radius, or the k nearest ones if k > 0
+        void setRadiusSearch(float radius) { this->radius = radius; this->k = 0; }
+        void setKSearch(int k) { this->k = k; }
+        //-- Search method for unorganized clouds (if not set, a spatial hash grid is created for
+        //-- radius searches and a kd-tree for k nearest neighbors)
+        void setSearchMethod(const SearchPtr& search) { this->search = search; }
+
+        void setViewPoint(float x, float y, float z) { view_point = Eigen::Vector3f(x, y, z); }
+
+        //-- Organized clouds: use integral images (default), depth change (relative to the depth)
+        //-- that breaks the smoothing area, and size of the smoothing area in pixels
+        void setUseOrganized(bool use_organized) { this->use_organized = use_organized; }
+        void setMaxDepthChangeFactor(float max_depth_change_factor) { this->max_depth_change_factor = max_depth_change_factor; }
+        void setNormalSmoothingSize(float smoothing_size) { this->smoothing_size = smoothing_size; }
+
+        //-- Whether the last computation used integral images
+        bool isOrganized() const { return use_organized && input_cloud && input_cloud->isOrganized(); }
+
+        bool compute(pcl::PointCloud<pcl::Normal>& normals)
+        {
+            if (!input_cloud)
+            {
+                std::cerr << "Error: input cloud not set" << std::endl;
+                return false;
+            }
+
+            if (isOrganized())
+            {
+                pcl::IntegralImageNormalEstimation<PointT, pcl::Normal> normal_estimation;
+                normal_estimation.setNormalEstimationMethod(pcl::IntegralImageNormalEstimation<PointT, pcl::Normal>::AVERAGE_3D_GRADIENT);
+                normal_estimation.setMaxDepthChangeFactor(max_depth_change_factor);
+                normal_estimation.setNormalSmoothingSize(smoothing_size);
+                normal_estimation.setViewPoint(view_point[0], view_point[1], view_point[2]);
+                normal_estimation.setInputCloud(input_cloud);
+                normal_estimation.compute(normals);
+            }
+            else
+            {
+                if (!search && k > 0)
+                    search.reset(new pcl::search::KdTree<PointT>);
+                else if (!search)
+                    search.reset(new SpatialHashSearch<PointT>(radius));
+
+                pcl::NormalEstimationOMP<PointT, pcl::Normal> normal_estimation;
+                normal_estimation.setInputCloud(input_cloud);
+                normal_estimation.setSearchMethod(search);
+                if (k > 0)
+                    normal_estimation.setKSearch(k);
+                else
+                    normal_estimation.setRadiusSearch(radius);
+                normal_estimation.setViewPoint(view_point[0], view_point[1], view_point[2]);
+                normal_estimation.compute(normals);
+            }
+            return true;
+        }
+
+    private:
+        PointCloudConstPtr input_cloud;
+        SearchPtr search;
+
+        float radius;
+        int k;
+        Eigen::Vector3f view_point;
+
+        bool use_organized;
+        float max_depth_change_factor;
+        float smoothing_size;
+};
+
+#endif // NORMAL_ESTIMATOR_HPP
@@ -0,0 +1 @@
+#include "OrganizedNeighborhood.hpp"
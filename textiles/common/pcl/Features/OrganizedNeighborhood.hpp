@@ -0,0 +1,145 @@
+/*
+ * Organized Neighborhood
+ *
+ * Radius search in organized clouds without a search tree: the neighbors of a point are
+ * looked for in a window of pixels around it, and only those within the radius are kept.
+ * The window is chosen from the radius and the distance between adjacent pixels (a small
+ * percentile of it, so that the window covers the radius for almost every point).
+ *
+ * The search can be restricted to a subset of the points (e.g. the garment), in which case
+ * only those points are returned as neighbors.
+ *
+ */
+
+#ifndef ORGANIZED_NEIGHBORHOOD_HPP
+#define ORGANIZED_NEIGHBORHOOD_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+
+template<typename PointT>
+class OrganizedNeighborhood
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        OrganizedNeighborhood() {
+            //-- Set default values
+            radius = 0.03;
+            window_size = 0;
+            max_window_size = 25;
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        //-- Points that can be neighbors (optional, all the valid points by default)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+        void setRadius(float radius) { this->radius = radius; }
+        //-- Half size of the window in pixels (0 to compute it from the radius)
+        void setWindowSize(int window_size) { this->window_size = window_size; }
+        void setMaxWindowSize(int max_window_size) { this->max_window_size = max_window_size; }
+
+        int getWindowSize() const { return used_window_size; }
+
+        //-- Has to be called after setting the parameters and before searching
+        bool initialize()
+        {
+            if (!input_cloud || !input_cloud->isOrganized())
+            {
+                std::cerr << "Error: input cloud is not organized" << std::endl;
+                return false;
+            }
+
+            const std::vector<PointT, Eigen::aligned_allocator<PointT> >& points = input_cloud->points;
+            mask.assign(points.size(), 0);
+            if (input_indices)
+            {
+                for (std::size_t i = 0; i < input_indices->size(); i++)
+                    if (isValid(points[(*input_indices)[i]]))
+                        mask[(*input_indices)[i]] = 1;
+            }
+            else
+            {
+                for (std::size_t i = 0; i < points.size(); i++)
+                    mask[i] = isValid(points[i]);
+            }
+
+            used_window_size = window_size > 0 ? window_size : estimateWindowSize();
+            return true;
+        }
+
+        //-- Neighbors of a point of the input cloud (the point itself included if it is in the subset)
+        int radiusSearch(int index, std::vector<int>& neighbors, std::vector<float>& squared_distances) const
+        {
+            neighbors.clear();
+            squared_distances.clear();
+
+            const PointT& point = input_cloud->points[index];
+            if (!isValid(point))
+                return 0;
+
+            int width = input_cloud->width, height = input_cloud->height;
+            int u = index % width, v = index / width;
+            int min_u = std::max(0, u - used_window_size), max_u = std::min(width-1, u + used_window_size);
+            int min_v = std::max(0, v - used_window_size), max_v = std::min(height-1, v + used_window_size);
+            float squared_radius = radius * radius;
+
+            for (int j = min_v; j <= max_v; j++)
+                for (int i = min_u; i <= max_u; i++)
+                {
+                    int neighbor = j * width + i;
+                    if (!mask[neighbor])
+                        continue;
+
+                    float squared_distance = (input_cloud->points[neighbor].getVector3fMap() - point.getVector3fMap()).squaredNorm();
+                    if (squared_distance <= squared_radius)
+                    {
+                        neighbors.push_back(neighbor);
+                        squared_distances.push_back(squared_distance);
+                    }
+                }
+            return neighbors.size();
+        }
+
+    private:
+        int estimateWindowSize() const
+        {
+            //-- Distance between horizontally adjacent points of the subset
+            std::vector<float> spacings;
+            int width = input_cloud->width;
+            for (std::size_t i = 0; i + 1 < mask.size(); i++)
+                if (mask[i] && mask[i+1] && (int)((i+1) % width) != 0)
+                    spacings.push_back((input_cloud->points[i+1].getVector3fMap() - input_cloud->points[i].getVector3fMap()).norm());
+
+            if (spacings.empty())
+                return 1;
+
+            std::vector<float>::iterator percentile = spacings.begin() + spacings.size() / 10;
+            std::nth_element(spacings.begin(), percentile, spacings.end());
+            if (*percentile <= 0)
+                return max_window_size;
+            return std::max(1, std::min(max_window_size, (int)std::ceil(radius / *percentile)));
+        }
+
+        static bool isValid(const PointT& point)
+        {
+            return std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z);
+        }
+
+        PointCloudConstPtr input_cloud;
+        pcl::IndicesConstPtr input_indices;
+
+        float radius;
+        int window_size;
+        int max_window_size;
+
+        std::vector<uint8_t> mask;
+        int used_window_size;
+};
+
+#endif // ORGANIZED_NEIGHBORHOOD_HPP
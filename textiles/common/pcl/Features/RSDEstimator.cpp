@@ -0,0 +1 @@
+#include "RSDEstimator.hpp"
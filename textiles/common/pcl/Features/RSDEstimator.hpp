@@ -0,0 +1,295 @@
+/*
+ * RSD Estimator
+ *
+ * Radius-based Surface Descriptor: minimum and maximum radius of the surface around each point,
+ * with the same method as pcl::RSDEstimation (Marton et al.):
+ *  - Neighbors are binned by distance, and the minimum and maximum angle between normals is
+ *    kept for each distance bin (the bins live in per-thread buffers of fixed size).
+ *  - Each radius is the least squares fit of distance = radius * angle over the bins, which
+ *    has a closed form, with the same correction of the systematic error as PCL.
+ *
+ * Unlike PCL, neighbors can be subsampled to a maximum number (approximate mode: the fit only
+ * needs a few samples per bin), the neighborhoods of a NeighborhoodCache are read in place, and
+ * the radii are returned as plain arrays, rasterized into images or saved as a binary file.
+ *
+ */
+
+#ifndef RSD_ESTIMATOR_HPP
+#define RSD_ESTIMATOR_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "NeighborhoodCache.hpp"
+#include "SpatialHashSearch.hpp"
+
+template<typename PointT, typename NormalT = pcl::Normal>
+class RSDEstimator
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::PointCloud<NormalT>::ConstPtr NormalCloudConstPtr;
+    typedef typename pcl::search::Search<PointT>::Ptr SearchPtr;
+
+    public:
+        RSDEstimator() {
+            //-- Set default values
+            radius = 0.03;
+            plane_radius = 0.2;
+            n_subdivisions = 5;
+            max_neighbors = 0;
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        void setInputNormals(const NormalCloudConstPtr& input_normals) { this->input_normals = input_normals; }
+        //-- Compute the descriptors only for these points (neighbors are still searched in the whole cloud)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+        //-- Search method (a spatial hash grid is created if not set). If it already has the input cloud,
+        //-- e.g. the one used for the normals, it is not rebuilt
+        void setSearchMethod(const SearchPtr& search) { this->search = search; }
+
+        void setRadiusSearch(float radius) { this->radius = radius; }
+        //-- Radius given to surfaces with larger radius (considered planes)
+        void setPlaneRadius(float plane_radius) { this->plane_radius = plane_radius; }
+        //-- Number of distance bins
+        void setNumberOfSubdivisions(int n_subdivisions) { this->n_subdivisions = n_subdivisions; }
+        //-- Approximate mode: use at most this many neighbors, evenly spread (0: all of them)
+        void setMaxNeighbors(int max_neighbors) { this->max_neighbors = max_neighbors; }
+
+        //-- Minimum and maximum radius of each point of the input cloud, or of each index
+        bool compute(std::vector<float>& r_min, std::vector<float>& r_max)
+        {
+            if (!input_cloud || !input_normals || input_normals->points.size() != input_cloud->points.size())
+            {
+                std::cerr << "Error: input cloud and normals not set or of different size" << std::endl;
+                return false;
+            }
+
+            if (radius <= 0 || n_subdivisions <= 0)
+            {
+                std::cerr << "Error: radius and number of subdivisions must be positive" << std::endl;
+                return false;
+            }
+
+            if (!search)
+                search.reset(new SpatialHashSearch<PointT>(radius));
+            if (search->getInputCloud() != input_cloud || search->getIndices())
+                search->setInputCloud(input_cloud);
+            const NeighborhoodCache<PointT>* cache = dynamic_cast<const NeighborhoodCache<PointT>*>(search.get());
+
+            int n = input_indices ? input_indices->size() : input_cloud->points.size();
+            r_min.resize(n);
+            r_max.resize(n);
+
+            #pragma omp parallel
+            {
+                std::vector<int> neighbors;
+                std::vector<float> squared_distances;
+                std::vector<double> min_angle(n_subdivisions), max_angle(n_subdivisions);
+
+                #pragma omp for schedule(dynamic, 256)
+                for (int i = 0; i < n; i++)
+                {
+                    int index = input_indices ? (*input_indices)[i] : i;
+
+                    const int* neighbor = NULL;
+                    const float* squared_distance = NULL;
+                    int n_neighbors = cache ? cache->getNeighbors(index, radius, neighbor, squared_distance) : -1;
+                    if (n_neighbors < 0)
+                    {
+                        n_neighbors = search->radiusSearch(*input_cloud, index, radius, neighbors, squared_distances);
+                        neighbor = neighbors.data();
+                        squared_distance = squared_distances.data();
+                    }
+
+                    computeRadii(index, neighbor, squared_distance, n_neighbors, min_angle, max_angle, r_min[i], r_max[i]);
+                }
+            }
+            return true;
+        }
+
+        //-- Same output as pcl::RSDEstimation
+        bool compute(pcl::PointCloud<pcl::PrincipalRadiiRSD>& descriptors)
+        {
+            std::vector<float> r_min, r_max;
+            if (!compute(r_min, r_max))
+                return false;
+
+            descriptors.points.resize(r_min.size());
+            descriptors.width = r_min.size();
+            descriptors.height = 1;
+            for (int i = 0; i < r_min.size(); i++)
+            {
+                descriptors.points[i].r_min = r_min[i];
+                descriptors.points[i].r_max = r_max[i];
+            }
+            return true;
+        }
+
+        //-- Curvature maps: mean radii of the points in each pixel of an XY grid over the points
+        //-- (top left corner at the minimum x and maximum y, as the image creators). Empty pixels are 0
+        bool computeImages(float resolution, Eigen::MatrixXf& r_min_image, Eigen::MatrixXf& r_max_image)
+        {
+            std::vector<float> r_min, r_max;
+            return resolution > 0 && compute(r_min, r_max) && computeImages(resolution, r_min, r_max, r_min_image, r_max_image);
+        }
+
+        //-- Same, from the radii already computed for the current input
+        bool computeImages(float resolution, const std::vector<float>& r_min, const std::vector<float>& r_max,
+                           Eigen::MatrixXf& r_min_image, Eigen::MatrixXf& r_max_image) const
+        {
+            int n_points = input_indices ? input_indices->size() : (input_cloud ? input_cloud->points.size() : 0);
+            if (resolution <= 0 || r_min.size() != n_points || r_max.size() != n_points)
+            {
+                std::cerr << "Error: radii do not match the input cloud, or resolution is not positive" << std::endl;
+                return false;
+            }
+
+            float max_value = std::numeric_limits<float>::max();
+            Eigen::Vector2f min_point(max_value, max_value), max_point(-max_value, -max_value);
+            for (int i = 0; i < r_min.size(); i++)
+            {
+                const PointT& point = input_cloud->points[input_indices ? (*input_indices)[i] : i];
+                if (!std::isfinite(point.x) || !std::isfinite(point.y))
+                    continue;
+                min_point = min_point.cwiseMin(Eigen::Vector2f(point.x, point.y));
+                max_point = max_point.cwiseMax(Eigen::Vector2f(point.x, point.y));
+            }
+
+            int width = std::max(1, (int)std::ceil((max_point[0] - min_point[0]) / resolution));
+            int height = std::max(1, (int)std::ceil((max_point[1] - min_point[1]) / resolution));
+            r_min_image = Eigen::MatrixXf::Zero(height, width);
+            r_max_image = Eigen::MatrixXf::Zero(height, width);
+            Eigen::MatrixXi count = Eigen::MatrixXi::Zero(height, width);
+
+            for (int i = 0; i < r_min.size(); i++)
+            {
+                const PointT& point = input_cloud->points[input_indices ? (*input_indices)[i] : i];
+                if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(r_min[i]))
+                    continue;
+
+                int col = std::min<int>((point.x - min_point[0]) / resolution, width-1);
+                int row = std::min<int>((max_point[1] - point.y) / resolution, height-1);
+                int n_current_bin = ++count(row, col);
+                r_min_image(row, col) += (r_min[i] - r_min_image(row, col)) / n_current_bin;
+                r_max_image(row, col) += (r_max[i] - r_max_image(row, col)) / n_current_bin;
+            }
+            return true;
+        }
+
+        //-- Saves x y z r_min r_max of each point: as text, or as float32 records if the filename
+        //-- ends in .bin (numpy.fromfile(filename, numpy.float32).reshape(-1, 5))
+        static bool save(const std::string& filename, const pcl::PointCloud<PointT>& cloud,
+                         const std::vector<float>& r_min, const std::vector<float>& r_max)
+        {
+            bool binary = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".bin") == 0;
+            std::ofstream file(filename.c_str(), binary ? std::ios::binary : std::ios::out);
+            if (!file.is_open())
+            {
+                std::cerr << "Error: could not open " << filename << std::endl;
+                return false;
+            }
+
+            for (int i = 0; i < r_min.size(); i++)
+            {
+                const PointT& point = cloud.points[i];
+                if (binary)
+                {
+                    float record[5] = {point.x, point.y, point.z, r_min[i], r_max[i]};
+                    file.write((const char*)record, sizeof(record));
+                }
+                else
+                    file << point.x << " " << point.y << " " << point.z << " " << r_min[i] << " " << r_max[i] << "\n";
+            }
+            return file.good();
+        }
+
+    private:
+        void computeRadii(int index, const int* neighbor, const float* squared_distance, int n_neighbors,
+                          std::vector<double>& min_angle, std::vector<double>& max_angle, float& r_min, float& r_max) const
+        {
+            //-- As in PCL, points without a valid normal get no radii
+            const NormalT& normal = input_normals->points[index];
+            if (n_neighbors < 2 || !isFinite(normal))
+            {
+                r_min = r_max = 0;
+                return;
+            }
+
+            //-- Minimum and maximum angle between normals (disregarding orientation) by distance
+            min_angle[0] = max_angle[0] = 0;
+            for (int d = 1; d < n_subdivisions; d++)
+            {
+                min_angle[d] = DBL_MAX;
+                max_angle[d] = -DBL_MAX;
+            }
+
+            int step = (max_neighbors > 0 && n_neighbors > max_neighbors) ? (n_neighbors + max_neighbors - 1) / max_neighbors : 1;
+            for (int j = 0; j < n_neighbors; j += step)
+            {
+                if (neighbor[j] == index)
+                    continue;
+
+                const NormalT& neighbor_normal = input_normals->points[neighbor[j]];
+                if (!isFinite(neighbor_normal))
+                    continue;
+
+                double cosine = std::abs(normal.normal_x * neighbor_normal.normal_x + normal.normal_y * neighbor_normal.normal_y
+                                         + normal.normal_z * neighbor_normal.normal_z);
+                double angle = std::acos(std::min(1.0, cosine));
+
+                double distance = std::sqrt(squared_distance[j]);
+                if (distance > radius)
+                    continue;
+
+                int d = std::min(n_subdivisions - 1, (int)(n_subdivisions * distance / radius));
+                min_angle[d] = std::min(min_angle[d], angle);
+                max_angle[d] = std::max(max_angle[d], angle);
+            }
+
+            //-- Least squares fit of distance = radius * angle, for the minimum and maximum angles
+            double min_squared = 0, min_distance = 0, max_squared = 0, max_distance = 0;
+            for (int d = 0; d < n_subdivisions; d++)
+            {
+                if (max_angle[d] < 0)
+                    continue;
+
+                double distance = (d + 0.5) * radius / n_subdivisions;
+                min_squared += min_angle[d] * min_angle[d];
+                min_distance += min_angle[d] * distance;
+                max_squared += max_angle[d] * max_angle[d];
+                max_distance += max_angle[d] * distance;
+            }
+
+            //-- Same correction of the systematic error as PCL (for 5 subdivisions)
+            float min_radius = 1.1f * (min_squared == 0 ? plane_radius : std::min(min_distance / min_squared, (double)plane_radius));
+            float max_radius = 0.9f * (max_squared == 0 ? plane_radius : std::min(max_distance / max_squared, (double)plane_radius));
+            r_min = std::min(min_radius, max_radius);
+            r_max = std::max(min_radius, max_radius);
+        }
+
+        static bool isFinite(const NormalT& normal)
+        {
+            return std::isfinite(normal.normal_x) && std::isfinite(normal.normal_y) && std::isfinite(normal.normal_z);
+        }
+
+        PointCloudConstPtr input_cloud;
+        NormalCloudConstPtr input_normals;
+        pcl::IndicesConstPtr input_indices;
+        SearchPtr search;
+
+        float radius;
+        float plane_radius;
+        int n_subdivisions;
+        int max_neighbors;
+};
+
+#endif // RSD_ESTIMATOR_HPP
@@ -0,0 +1 @@
+#include "SpatialHashSearch.hpp"
@@ -0,0 +1,320 @@
+/*
+ * Spatial Hash Search
+ *
+ * Fixed-radius neighbor search on a uniform grid, as an alternative to the kd-tree for the
+ * dense, roughly 2.5D surfaces of garments. Points are hashed into cubic cells (of the size
+ * of the usual query radius), grouped by cell in parallel with the VoxelGridDownsampler, and
+ * their coordinates are copied in cell order, so a query reads a few contiguous runs of
+ * memory instead of walking a tree:
+ *  - A radius search visits only the cells that intersect the bounding box of the sphere
+ *    (27 cells when the radius is not larger than the cell size).
+ *  - A k nearest neighbors search visits rings of cells of growing size until the k-th
+ *    neighbor is closer than any cell not visited yet.
+ *
+ * It is a pcl::search::Search, so it can be given to any PCL feature with setSearchMethod().
+ * Batched queries for points of the input cloud are processed in parallel in cell order, and
+ * consecutive queries of the same cell share the lookup of the neighbor cells.
+ *
+ */
+
+#ifndef SPATIAL_HASH_SEARCH_HPP
+#define SPATIAL_HASH_SEARCH_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/search/search.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "VoxelKey.hpp"
+#include "VoxelGridDownsampler.hpp"
+
+template<typename PointT>
+class SpatialHashSearch : public pcl::search::Search<PointT>
+{
+    typedef pcl::search::Search<PointT> BaseClass;
+    typedef typename BaseClass::PointCloudConstPtr PointCloudConstPtr;
+    typedef typename BaseClass::IndicesConstPtr IndicesConstPtr;
+    typedef std::unordered_map<VoxelKey, int, VoxelKeyHash> CellMap;
+
+    public:
+        typedef boost::shared_ptr<SpatialHashSearch<PointT> > Ptr;
+
+        using BaseClass::radiusSearch;
+        using BaseClass::nearestKSearch;
+
+        SpatialHashSearch(float cell_size = 0.03, bool sorted = false) : BaseClass("SpatialHashSearch", sorted) {
+            //-- Set default values
+            this->cell_size = cell_size;
+        }
+
+        //-- Side of the cells: best set to the radius of the queries (set it before the input cloud)
+        void setCellSize(float cell_size) { this->cell_size = cell_size; }
+        float getCellSize() const { return cell_size; }
+
+        virtual void setInputCloud(const PointCloudConstPtr& cloud, const IndicesConstPtr& indices = IndicesConstPtr())
+        {
+            this->input_ = cloud;
+            this->indices_ = indices;
+            build();
+        }
+
+        virtual int radiusSearch(const PointT& point, double radius, std::vector<int>& k_indices,
+                                 std::vector<float>& k_sqr_distances, unsigned int max_nn = 0) const
+        {
+            k_indices.clear();
+            k_sqr_distances.clear();
+            if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z) || cells.empty())
+                return 0;
+
+            std::vector<int> neighbor_cells;
+            getNeighborCells(computeKey(point), radius, neighbor_cells);
+            return searchCells(point, radius, neighbor_cells, k_indices, k_sqr_distances, max_nn);
+        }
+
+        //-- Batched queries: parallel, and in cell order for points of the input cloud
+        virtual void radiusSearch(const pcl::PointCloud<PointT>& cloud, const std::vector<int>& indices, double radius,
+                                  std::vector<std::vector<int> >& k_indices, std::vector<std::vector<float> >& k_sqr_distances,
+                                  unsigned int max_nn = 0) const
+        {
+            int n = indices.empty() ? cloud.points.size() : indices.size();
+            k_indices.resize(n);
+            k_sqr_distances.resize(n);
+
+            //-- Queries sorted by cell (those of other clouds keep their order)
+            std::vector<std::pair<int, int> > order(n);
+            bool own_cloud = (&cloud == this->input_.get());
+            for (int i = 0; i < n; i++)
+                order[i] = std::make_pair(own_cloud ? point_cells[indices.empty() ? i : indices[i]] : 0, i);
+            if (own_cloud)
+                std::sort(order.begin(), order.end());
+
+            #pragma omp parallel
+            {
+                std::vector<int> neighbor_cells;
+                VoxelKey last_key;
+                bool has_last_key = false;
+
+                #pragma omp for schedule(dynamic, 256)
+                for (int j = 0; j < n; j++)
+                {
+                    int i = order[j].second;
+                    const PointT& point = cloud.points[indices.empty() ? i : indices[i]];
+                    k_indices[i].clear();
+                    k_sqr_distances[i].clear();
+                    if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z) || cells.empty())
+                        continue;
+
+                    VoxelKey key = computeKey(point);
+                    if (!has_last_key || key != last_key)
+                    {
+                        getNeighborCells(key, radius, neighbor_cells);
+                        last_key = key;
+                        has_last_key = true;
+                    }
+                    searchCells(point, radius, neighbor_cells, k_indices[i], k_sqr_distances[i], max_nn);
+                }
+            }
+        }
+
+        virtual int nearestKSearch(const PointT& point, int k, std::vector<int>& k_indices, std::vector<float>& k_sqr_distances) const
+        {
+            k_indices.clear();
+            k_sqr_distances.clear();
+            if (k <= 0 || !std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z) || cells.empty())
+                return 0;
+
+            //-- Candidates sorted by distance, from rings of cells of growing size. After visiting ring
+            //-- s, all the points left are at least s cells away
+            VoxelKey center = computeKey(point);
+            int max_ring = std::max(std::max(std::max(center.x - min_key.x, max_key.x - center.x),
+                                             std::max(center.y - min_key.y, max_key.y - center.y)),
+                                    std::max(center.z - min_key.z, max_key.z - center.z));
+            std::vector<std::pair<float, int> > candidates;
+            for (int ring = 0; ring <= max_ring; ring++)
+            {
+                for (int dx = -ring; dx <= ring; dx++)
+                    for (int dy = -ring; dy <= ring; dy++)
+                        for (int dz = -ring; dz <= ring; dz++)
+                        {
+                            if (std::max(std::max(std::abs(dx), std::abs(dy)), std::abs(dz)) != ring)
+                                continue;
+
+                            typename CellMap::const_iterator cell = cell_map.find(VoxelKey(center.x + dx, center.y + dy, center.z + dz));
+                            if (cell == cell_map.end())
+                                continue;
+
+                            for (int i = cell_offsets[cell->second]; i < cell_offsets[cell->second+1]; i++)
+                                candidates.push_back(std::make_pair(squaredDistance(point, i), cell_points[i]));
+                        }
+
+                float reached = ring * cell_size;
+                if ((int)candidates.size() >= k)
+                {
+                    std::nth_element(candidates.begin(), candidates.begin() + (k-1), candidates.end());
+                    if (candidates[k-1].first <= reached * reached)
+                        break;
+                }
+            }
+
+            int n = std::min<int>(k, candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end());
+            k_indices.resize(n);
+            k_sqr_distances.resize(n);
+            for (int i = 0; i < n; i++)
+            {
+                k_sqr_distances[i] = candidates[i].first;
+                k_indices[i] = candidates[i].second;
+            }
+            return n;
+        }
+
+    private:
+        void build()
+        {
+            cells.clear();
+            cell_map.clear();
+            cell_offsets.clear();
+            cell_points.clear();
+            sorted_points.clear();
+            point_cells.assign(this->input_->points.size(), -1);
+            if (cell_size <= 0)
+            {
+                std::cerr << "Error: invalid cell size" << std::endl;
+                return;
+            }
+
+            //-- Group the points by cell
+            VoxelGridDownsampler<PointT> voxel_grid;
+            pcl::PointCloud<PointT> cell_representatives;
+            voxel_grid.setInputCloud(this->input_);
+            if (this->indices_)
+                voxel_grid.setIndices(this->indices_);
+            voxel_grid.setLeafSize(cell_size);
+            voxel_grid.setReductionMode(VoxelGridDownsampler<PointT>::FIRST_POINT);
+            voxel_grid.setSaveVoxelMap(true);
+            voxel_grid.filter(cell_representatives);
+            voxel_grid.getVoxelMap(cell_offsets, cell_points);
+            int n_cells = cell_representatives.points.size();
+
+            //-- Cell lookup by coordinates, and grid extent for the k nearest neighbors search
+            cells.resize(n_cells);
+            cell_map.reserve(n_cells);
+            int max_value = std::numeric_limits<int>::max();
+            min_key = VoxelKey(max_value, max_value, max_value);
+            max_key = VoxelKey(-max_value, -max_value, -max_value);
+            for (int c = 0; c < n_cells; c++)
+            {
+                cells[c] = computeKey(cell_representatives.points[c]);
+                cell_map[cells[c]] = c;
+                min_key = VoxelKey(std::min(min_key.x, cells[c].x), std::min(min_key.y, cells[c].y), std::min(min_key.z, cells[c].z));
+                max_key = VoxelKey(std::max(max_key.x, cells[c].x), std::max(max_key.y, cells[c].y), std::max(max_key.z, cells[c].z));
+            }
+
+            //-- Coordinates in cell order, so each cell is scanned contiguously
+            sorted_points.resize(cell_points.size());
+            #pragma omp parallel for schedule(dynamic, 256)
+            for (int c = 0; c < n_cells; c++)
+                for (int i = cell_offsets[c]; i < cell_offsets[c+1]; i++)
+                {
+                    sorted_points[i] = this->input_->points[cell_points[i]].getVector3fMap();
+                    point_cells[cell_points[i]] = c;
+                }
+        }
+
+        VoxelKey computeKey(const PointT& point) const
+        {
+            float inverse_cell_size = 1.0f / cell_size;
+            return computeVoxelKey(point.x, point.y, point.z, inverse_cell_size, inverse_cell_size, inverse_cell_size);
+        }
+
+        //-- Cells that intersect the bounding box of the sphere around a point of the given cell
+        void getNeighborCells(const VoxelKey& key, double radius, std::vector<int>& neighbor_cells) const
+        {
+            neighbor_cells.clear();
+            int range = std::max(1, (int)std::ceil(radius / cell_size));
+            for (int dx = -range; dx <= range; dx++)
+                for (int dy = -range; dy <= range; dy++)
+                    for (int dz = -range; dz <= range; dz++)
+                    {
+                        //-- Minimum distance between the cells has to be within the radius
+                        float gap_x = std::max(std::abs(dx)-1, 0) * cell_size;
+                        float gap_y = std::max(std::abs(dy)-1, 0) * cell_size;
+                        float gap_z = std::max(std::abs(dz)-1, 0) * cell_size;
+                        if (gap_x*gap_x + gap_y*gap_y + gap_z*gap_z > radius*radius)
+                            continue;
+
+                        typename CellMap::const_iterator cell = cell_map.find(VoxelKey(key.x + dx, key.y + dy, key.z + dz));
+                        if (cell != cell_map.end())
+                            neighbor_cells.push_back(cell->second);
+                    }
+        }
+
+        int searchCells(const PointT& point, double radius, const std::vector<int>& neighbor_cells, std::vector<int>& k_indices,
+                        std::vector<float>& k_sqr_distances, unsigned int max_nn) const
+        {
+            k_indices.clear();
+            k_sqr_distances.clear();
+            float squared_radius = radius * radius;
+            bool truncate = max_nn > 0 && !this->sorted_results_;
+            for (std::size_t c = 0; c < neighbor_cells.size(); c++)
+                for (int i = cell_offsets[neighbor_cells[c]]; i < cell_offsets[neighbor_cells[c]+1]; i++)
+                {
+                    float squared_distance = squaredDistance(point, i);
+                    if (squared_distance > squared_radius)
+                        continue;
+
+                    k_indices.push_back(cell_points[i]);
+                    k_sqr_distances.push_back(squared_distance);
+                    if (truncate && k_indices.size() == max_nn)
+                        return k_indices.size();
+                }
+
+            //-- Sorted results: the max_nn closest ones
+            if (this->sorted_results_)
+            {
+                std::vector<std::pair<float, int> > pairs(k_indices.size());
+                for (std::size_t i = 0; i < pairs.size(); i++)
+                    pairs[i] = std::make_pair(k_sqr_distances[i], k_indices[i]);
+                std::sort(pairs.begin(), pairs.end());
+                if (max_nn > 0 && pairs.size() > max_nn)
+                    pairs.resize(max_nn);
+
+                k_indices.resize(pairs.size());
+                k_sqr_distances.resize(pairs.size());
+                for (std::size_t i = 0; i < pairs.size(); i++)
+                {
+                    k_sqr_distances[i] = pairs[i].first;
+                    k_indices[i] = pairs[i].second;
+                }
+            }
+            return k_indices.size();
+        }
+
+        float squaredDistance(const PointT& point, int i) const
+        {
+            float dx = sorted_points[i][0] - point.x;
+            float dy = sorted_points[i][1] - point.y;
+            float dz = sorted_points[i][2] - point.z;
+            return dx*dx + dy*dy + dz*dz;
+        }
+
+        float cell_size;
+
+        //-- Points of cell c: cell_points[cell_offsets[c]] ... cell_points[cell_offsets[c+1]-1] (indices
+        //-- of the input cloud), with their coordinates in sorted_points
+        std::vector<VoxelKey> cells;
+        CellMap cell_map;
+        std::vector<int> cell_offsets;
+        std::vector<int> cell_points;
+        std::vector<Eigen::Vector3f> sorted_points;
+        std::vector<int> point_cells;           //-- Cell of each point of the cloud (-1 if not in the grid)
+        VoxelKey min_key, max_key;
+};
+
+#endif // SPATIAL_HASH_SEARCH_HPP
@@ -0,0 +1 @@
+#include "WiLDEstimator.hpp"
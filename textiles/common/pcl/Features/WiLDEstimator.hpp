@@ -0,0 +1,193 @@
+/*
+ * WiLD Estimator
+ *
+ * WiLD descriptor: mean dot product of the normal of each point with the normals of its
+ * neighbors within a radius. Since the dot product is linear, it is computed as the dot
+ * product of the normal with the sum of the neighbor normals.
+ *
+ *  - Normals are copied to one array per component, so the sums over the neighbors vectorize.
+ *  - Points are processed in Morton (Z-order) order, so consecutive queries of a thread hit
+ *    the same branches of the search tree and the same normals.
+ *  - Neighbor buffers are allocated once per thread.
+ *  - Organized clouds are searched in a window of pixels instead of a kd-tree.
+ *  - With a NeighborhoodCache as search method, the cached rows are read in place.
+ *  - Invalid normals (NaN, or zero) are zeroed and not counted as neighbors, and points with
+ *    an invalid normal get no descriptor.
+ *
+ * wrinkleDetection started the sum at -Eigen::Infinity, which is the integer constant -1,
+ * so 1/n was added to every descriptor. setLegacyOffset(true) keeps that behavior.
+ *
+ */
+
+#ifndef WILD_ESTIMATOR_HPP
+#define WILD_ESTIMATOR_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "MortonReordering.hpp"
+#include "NeighborhoodCache.hpp"
+#include "SpatialHashSearch.hpp"
+#include "OrganizedNeighborhood.hpp"
+
+template<typename PointT, typename NormalT = pcl::Normal>
+class WiLDEstimator
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::PointCloud<NormalT>::ConstPtr NormalCloudConstPtr;
+    typedef typename pcl::search::Search<PointT>::Ptr SearchPtr;
+
+    public:
+        WiLDEstimator() {
+            //-- Set default values
+            radius = 0.03;
+            use_organized = true;
+            legacy_offset = false;
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        void setInputNormals(const NormalCloudConstPtr& input_normals) { this->input_normals = input_normals; }
+        //-- Only these points are used, both to compute descriptors and as neighbors (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+
+        void setRadius(float radius) { this->radius = radius; }
+        //-- Search method for unorganized clouds. If it already has the input cloud (and indices),
+        //-- e.g. the tree used for the normals, it is not rebuilt
+        void setSearchMethod(const SearchPtr& search) { this->search = search; }
+        //-- Search organized clouds in image space (default)
+        void setUseOrganized(bool use_organized) { this->use_organized = use_organized; }
+        void setLegacyOffset(bool legacy_offset) { this->legacy_offset = legacy_offset; }
+
+        //-- One descriptor per point of the input cloud, or per index if indices were given.
+        //-- Points without valid neighbors or normal get NaN (or 1 with the legacy offset)
+        bool compute(std::vector<double>& wild)
+        {
+            if (!input_cloud || !input_normals || input_normals->points.size() != input_cloud->points.size())
+            {
+                std::cerr << "Error: input cloud and normals not set or of different size" << std::endl;
+                return false;
+            }
+
+            int n = input_indices ? input_indices->size() : input_cloud->points.size();
+            wild.resize(n);
+            copyNormals();
+
+            bool organized = use_organized && input_cloud->isOrganized();
+            OrganizedNeighborhood<PointT> neighborhood;
+            if (organized)
+            {
+                neighborhood.setInputCloud(input_cloud);
+                neighborhood.setIndices(input_indices);
+                neighborhood.setRadius(radius);
+                if (!neighborhood.initialize())
+                    return false;
+            }
+            else
+            {
+                if (!search)
+                    search.reset(new SpatialHashSearch<PointT>(radius));
+                if (search->getInputCloud() != input_cloud || search->getIndices() != input_indices)
+                    search->setInputCloud(input_cloud, input_indices);
+            }
+
+            //-- Points (positions in the indices, if any) along a Z-order curve
+            MortonReordering<PointT> morton_reordering;
+            morton_reordering.setInputCloud(input_cloud);
+            morton_reordering.setIndices(input_indices);
+            morton_reordering.compute();
+            const std::vector<int>& order = morton_reordering.getPermutation();
+            const NeighborhoodCache<PointT>* cache = organized ? NULL : dynamic_cast<const NeighborhoodCache<PointT>*>(search.get());
+
+            const float* nx = &normal_x[0];
+            const float* ny = &normal_y[0];
+            const float* nz = &normal_z[0];
+            const float* valid = &normal_valid[0];
+            double empty_value = legacy_offset ? 1 : std::numeric_limits<double>::quiet_NaN();
+
+            #pragma omp parallel
+            {
+                std::vector<int> neighbors;
+                std::vector<float> squared_distances;
+
+                #pragma omp for schedule(dynamic, 256)
+                for (int k = 0; k < n; k++)
+                {
+                    int i = order[k];
+                    int index = input_indices ? (*input_indices)[i] : i;
+
+                    const int* neighbor = NULL;
+                    const float* squared_distance;
+                    int n_neighbors = cache ? cache->getNeighbors(index, radius, neighbor, squared_distance) : -1;
+                    if (n_neighbors < 0)
+                    {
+                        n_neighbors = organized ? neighborhood.radiusSearch(index, neighbors, squared_distances)
+                                                : search->radiusSearch(*input_cloud, index, radius, neighbors, squared_distances);
+                        neighbor = neighbors.data();
+                    }
+
+                    if (n_neighbors <= 0 || !valid[index])
+                    {
+                        wild[i] = empty_value;
+                        continue;
+                    }
+
+                    //-- Sum of the neighbor normals (invalid ones are zero) and number of valid ones
+                    float sum_x = 0, sum_y = 0, sum_z = 0, n_valid = 0;
+                    #pragma omp simd reduction(+:sum_x,sum_y,sum_z,n_valid)
+                    for (int j = 0; j < n_neighbors; j++)
+                    {
+                        sum_x += nx[neighbor[j]];
+                        sum_y += ny[neighbor[j]];
+                        sum_z += nz[neighbor[j]];
+                        n_valid += valid[neighbor[j]];
+                    }
+
+                    double dot = (double)nx[index]*sum_x + (double)ny[index]*sum_y + (double)nz[index]*sum_z;
+                    wild[i] = ((legacy_offset ? 1 : 0) + dot) / n_valid;
+                }
+            }
+            return true;
+        }
+
+    private:
+        void copyNormals()
+        {
+            std::size_t n = input_normals->points.size();
+            normal_x.resize(n);
+            normal_y.resize(n);
+            normal_z.resize(n);
+            normal_valid.resize(n);
+
+            #pragma omp parallel for schedule(static)
+            for (long i = 0; i < (long)n; i++)
+            {
+                const NormalT& normal = input_normals->points[i];
+                bool is_valid = std::isfinite(normal.normal_x) && std::isfinite(normal.normal_y) && std::isfinite(normal.normal_z)
+                        && (normal.normal_x != 0 || normal.normal_y != 0 || normal.normal_z != 0);
+                normal_x[i] = is_valid ? normal.normal_x : 0;
+                normal_y[i] = is_valid ? normal.normal_y : 0;
+                normal_z[i] = is_valid ? normal.normal_z : 0;
+                normal_valid[i] = is_valid ? 1 : 0;
+            }
+        }
+
+        PointCloudConstPtr input_cloud;
+        NormalCloudConstPtr input_normals;
+        pcl::IndicesConstPtr input_indices;
+        SearchPtr search;
+
+        float radius;
+        bool use_organized;
+        bool legacy_offset;
+
+        std::vector<float> normal_x, normal_y, normal_z;
+        std::vector<float> normal_valid;
+};
+
+#endif // WILD_ESTIMATOR_HPP
@@ -0,0 +1 @@
+#include "MortonReordering.hpp"
@@ -0,0 +1,251 @@
+/*
+ * Morton Reordering
+ *
+ * Sorts the points of a cloud along a Z-order (Morton) curve, so points that are close in
+ * space are also close in memory. Clouds from kinfu or pcl::transformPointCloud keep their
+ * points in arbitrary order, and the parallel loops over points (normals, WiLD, RSD,
+ * rasterization) then jump around the cloud for every neighborhood.
+ *
+ *  - Codes have 10 bits per axis over the bounding box of the points.
+ *  - Codes are sorted with a parallel LSD radix sort (stable, 8 bits per pass, passes where all
+ *    the codes share the same digit are skipped).
+ *  - Points with non-finite coordinates go to the end, in their original order.
+ *
+ * The permutation is kept, so attribute arrays (normals, descriptors, indices...) can be
+ * reordered the same way and results can be restored to the original order.
+ *
+ */
+
+#ifndef MORTON_REORDERING_HPP
+#define MORTON_REORDERING_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+template<typename PointT>
+class MortonReordering
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        MortonReordering() {}
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        //-- Reorder only a subset of the input cloud (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+
+        //-- Position (in the input cloud, or in the indices if given) of each point in Morton order
+        const std::vector<int>& getPermutation() const { return permutation; }
+
+        bool compute()
+        {
+            permutation.clear();
+            if (!input_cloud)
+            {
+                std::cerr << "Error: input cloud not set" << std::endl;
+                return false;
+            }
+
+            std::vector<uint32_t> codes;
+            computeCodes(codes);
+            sortCodes(codes);
+            return true;
+        }
+
+        //-- Points (of the indices, if given) in Morton order. The output is unorganized
+        bool filter(pcl::PointCloud<PointT>& output)
+        {
+            if (!compute())
+                return false;
+
+            typename pcl::PointCloud<PointT>::VectorType output_points(permutation.size());
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < (int)permutation.size(); k++)
+                output_points[k] = input_cloud->points[index(permutation[k])];
+
+            output.header = input_cloud->header;
+            output.sensor_origin_ = input_cloud->sensor_origin_;
+            output.sensor_orientation_ = input_cloud->sensor_orientation_;
+            output.points.swap(output_points);
+            output.width = permutation.size();
+            output.height = 1;
+            output.is_dense = input_cloud->is_dense;
+            return true;
+        }
+
+        //-- Reorders an array with one element per point (or per index): output[k] = input[permutation[k]]
+        template<typename T>
+        void apply(const std::vector<T>& input, std::vector<T>& output) const
+        {
+            std::vector<T> reordered(permutation.size());
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < (int)permutation.size(); k++)
+                reordered[k] = input[permutation[k]];
+            output.swap(reordered);
+        }
+
+        template<typename T>
+        void apply(const pcl::PointCloud<T>& input, pcl::PointCloud<T>& output) const
+        {
+            typename pcl::PointCloud<T>::VectorType reordered(permutation.size());
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < (int)permutation.size(); k++)
+                reordered[k] = input.points[permutation[k]];
+
+            output.header = input.header;
+            output.points.swap(reordered);
+            output.width = permutation.size();
+            output.height = 1;
+            output.is_dense = input.is_dense;
+        }
+
+        //-- Back to the original order: output[permutation[k]] = input[k]
+        template<typename T>
+        void restore(const std::vector<T>& input, std::vector<T>& output) const
+        {
+            std::vector<T> restored(permutation.size());
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < (int)permutation.size(); k++)
+                restored[permutation[k]] = input[k];
+            output.swap(restored);
+        }
+
+    private:
+        int index(int i) const { return input_indices ? (*input_indices)[i] : i; }
+
+        bool isFinite(const PointT& point) const
+        {
+            return std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z);
+        }
+
+        void computeCodes(std::vector<uint32_t>& codes) const
+        {
+            int n = input_indices ? input_indices->size() : input_cloud->points.size();
+
+            Eigen::Vector3f min_point = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+            Eigen::Vector3f max_point = -min_point;
+            for (int i = 0; i < n; i++)
+            {
+                const PointT& point = input_cloud->points[index(i)];
+                if (!isFinite(point))
+                    continue;
+                min_point = min_point.cwiseMin(point.getVector3fMap());
+                max_point = max_point.cwiseMax(point.getVector3fMap());
+            }
+
+            //-- 10 bits per axis over the bounding box, non-finite points after all the others
+            Eigen::Vector3f scale = (max_point - min_point).cwiseMax(Eigen::Vector3f::Constant(1e-6f)).cwiseInverse() * 1023.0f;
+            codes.resize(n);
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < n; i++)
+            {
+                const PointT& point = input_cloud->points[index(i)];
+                if (!isFinite(point))
+                {
+                    codes[i] = std::numeric_limits<uint32_t>::max();
+                    continue;
+                }
+
+                Eigen::Vector3f cell = (point.getVector3fMap() - min_point).cwiseProduct(scale);
+                codes[i] = spreadBits(cell[0]) | (spreadBits(cell[1]) << 1) | (spreadBits(cell[2]) << 2);
+            }
+        }
+
+        //-- Parallel LSD radix sort of the codes, carrying the original positions
+        void sortCodes(std::vector<uint32_t>& codes)
+        {
+            int n = codes.size();
+            permutation.resize(n);
+            for (int i = 0; i < n; i++)
+                permutation[i] = i;
+
+            int n_threads = 1;
+#ifdef _OPENMP
+            n_threads = std::max(1, std::min(omp_get_max_threads(), n / 4096));
+#endif
+            const int n_buckets = 256;
+            std::vector<uint32_t> sorted_codes(n);
+            std::vector<int> sorted_permutation(n);
+            std::vector<int> offsets(n_threads * n_buckets);
+
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                //-- Histogram of each thread over its own (contiguous) chunk
+                std::fill(offsets.begin(), offsets.end(), 0);
+                #pragma omp parallel for schedule(static, 1) num_threads(n_threads)
+                for (int t = 0; t < n_threads; t++)
+                {
+                    int begin = (long)n * t / n_threads, end = (long)n * (t+1) / n_threads;
+                    int* histogram = &offsets[t * n_buckets];
+                    for (int i = begin; i < end; i++)
+                        histogram[(codes[i] >> shift) & 0xFF]++;
+                }
+
+                //-- Nothing to do if all the codes have the same digit
+                bool single_bucket = false;
+                for (int b = 0; b < n_buckets && !single_bucket; b++)
+                {
+                    int bucket_size = 0;
+                    for (int t = 0; t < n_threads; t++)
+                        bucket_size += offsets[t * n_buckets + b];
+                    single_bucket = (bucket_size == n);
+                }
+                if (single_bucket)
+                    continue;
+
+                //-- Start of each (bucket, thread) in the output, buckets first so the sort is stable
+                int start = 0;
+                for (int b = 0; b < n_buckets; b++)
+                    for (int t = 0; t < n_threads; t++)
+                    {
+                        int count = offsets[t * n_buckets + b];
+                        offsets[t * n_buckets + b] = start;
+                        start += count;
+                    }
+
+                #pragma omp parallel for schedule(static, 1) num_threads(n_threads)
+                for (int t = 0; t < n_threads; t++)
+                {
+                    int begin = (long)n * t / n_threads, end = (long)n * (t+1) / n_threads;
+                    int* next = &offsets[t * n_buckets];
+                    for (int i = begin; i < end; i++)
+                    {
+                        int position = next[(codes[i] >> shift) & 0xFF]++;
+                        sorted_codes[position] = codes[i];
+                        sorted_permutation[position] = permutation[i];
+                    }
+                }
+                codes.swap(sorted_codes);
+                permutation.swap(sorted_permutation);
+            }
+        }
+
+        //-- Inserts two zero bits between each of the 10 lower bits
+        static uint32_t spreadBits(float value)
+        {
+            uint32_t x = std::min(1023u, (uint32_t)std::max(0.0f, value));
+            x = (x | (x << 16)) & 0x030000FF;
+            x = (x | (x << 8)) & 0x0300F00F;
+            x = (x | (x << 4)) & 0x030C30C3;
+            x = (x | (x << 2)) & 0x09249249;
+            return x;
+        }
+
+        PointCloudConstPtr input_cloud;
+        pcl::IndicesConstPtr input_indices;
+
+        std::vector<int> permutation;
+};
+
+#endif // MORTON_REORDERING_HPP
@@ -0,0 +1 @@
+#include "VoxelGridDownsampler.hpp"
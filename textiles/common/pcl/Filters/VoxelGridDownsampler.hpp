@@ -0,0 +1,406 @@
+/*
+ * Voxel Grid Downsampler
+ *
+ * Replacement for pcl::VoxelGrid that groups the points with a spatial hash instead
+ * of sorting them, so that it works for any extent of the input cloud. Voxels are
+ * partitioned by hash between threads (the points are bucketed by partition first, so
+ * each thread only walks its own points), and the output voxels keep the order of the
+ * first point that falls in each of them, so the result does not depend on the
+ * number of threads.
+ *
+ * Each voxel is reduced to a single point with one of these modes:
+ *  - CENTROID: average of the float fields and of each color channel of the points in the
+ *    voxel (as pcl::VoxelGrid), other fields are taken from the first point
+ *  - FIRST_POINT: first point of the voxel
+ *  - CLOSEST_TO_CENTROID: point of the voxel closest to its centroid
+ *  - MAX_Z: highest point of the voxel (useful for heightmaps)
+ *
+ * Optionally, the points that fell in each output voxel can be kept to recover
+ * full-resolution indices without searching the input cloud again.
+ *
+ */
+
+#ifndef VOXEL_GRID_DOWNSAMPLER_HPP
+#define VOXEL_GRID_DOWNSAMPLER_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/common/io.h>
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "VoxelKey.hpp"
+
+template<typename PointT>
+class VoxelGridDownsampler
+{
+    //-- Typedefs for clarity's sake
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef std::unordered_map<VoxelKey, int, VoxelKeyHash> VoxelMap;
+
+    public:
+        enum ReductionMode { CENTROID, FIRST_POINT, CLOSEST_TO_CENTROID, MAX_Z };
+
+        VoxelGridDownsampler() {
+            //-- Set default values
+            setLeafSize(0.01f);
+            reduction_mode = CENTROID;
+            min_points_per_voxel = 1;
+            save_voxel_map = false;
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        //-- Downsample only a subset of the input cloud (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+
+        void setLeafSize(float leaf_size) { setLeafSize(leaf_size, leaf_size, leaf_size); }
+        void setLeafSize(float leaf_x, float leaf_y, float leaf_z) {
+            leaf_size = Eigen::Vector3f(leaf_x, leaf_y, leaf_z);
+        }
+        void setReductionMode(ReductionMode reduction_mode) { this->reduction_mode = reduction_mode; }
+        //-- Voxels with fewer points than this are discarded
+        void setMinPointsPerVoxel(int min_points_per_voxel) { this->min_points_per_voxel = min_points_per_voxel; }
+        //-- Keep the points that fell in each output voxel (see getVoxelPoints())
+        void setSaveVoxelMap(bool save_voxel_map) { this->save_voxel_map = save_voxel_map; }
+
+        //-- Index (in the input cloud) of the point chosen for each output voxel. For CENTROID
+        //-- mode it is the first point of the voxel, since the output point is synthetic
+        const std::vector<int>& getRepresentativeIndices() const { return representative_indices; }
+
+        //-- Indices (in the input cloud) of the points that fell in the given output voxel
+        void getVoxelPoints(int voxel, std::vector<int>& points) const
+        {
+            points.clear();
+            if (voxel < 0 || voxel + 1 >= (int)voxel_offsets.size())
+                return;
+            points.assign(voxel_points.begin() + voxel_offsets[voxel], voxel_points.begin() + voxel_offsets[voxel+1]);
+        }
+
+        //-- Whole voxel map: the points of voxel i are points[offsets[i]] ... points[offsets[i+1]-1]
+        void getVoxelMap(std::vector<int>& offsets, std::vector<int>& points) const
+        {
+            offsets = voxel_offsets;
+            points = voxel_points;
+        }
+
+        bool filter(pcl::PointCloud<PointT>& output)
+        {
+            representative_indices.clear();
+            voxel_offsets.clear();
+            voxel_points.clear();
+
+            if (!input_cloud)
+            {
+                std::cerr << "Error: input cloud not set" << std::endl;
+                return false;
+            }
+
+            if (leaf_size.minCoeff() <= 0)
+            {
+                std::cerr << "Error: invalid leaf size" << std::endl;
+                return false;
+            }
+
+            //-- Points to process
+            std::vector<int> indices;
+            if (input_indices)
+                indices = *input_indices;
+            else
+            {
+                indices.resize(input_cloud->points.size());
+                for (int i = 0; i < (int)indices.size(); i++)
+                    indices[i] = i;
+            }
+            int n_points = indices.size();
+
+            //-- Fields averaged by CENTROID mode
+            if (reduction_mode == CENTROID)
+                findCentroidFields();
+
+            //-- Compute the voxel of each point and the partition that owns it
+            int n_partitions = 1;
+#ifdef _OPENMP
+            n_partitions = omp_get_max_threads();
+#endif
+            Eigen::Vector3f inverse_leaf_size = leaf_size.cwiseInverse();
+            std::vector<VoxelKey> keys(n_points);
+            std::vector<int> owner(n_points);
+            #pragma omp parallel for
+            for (int k = 0; k < n_points; k++)
+            {
+                const PointT& point = input_cloud->points[indices[k]];
+                if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+                {
+                    owner[k] = -1;
+                    continue;
+                }
+
+                keys[k] = computeVoxelKey(point.x, point.y, point.z,
+                                          inverse_leaf_size[0], inverse_leaf_size[1], inverse_leaf_size[2]);
+                owner[k] = VoxelKeyHash()(keys[k]) % n_partitions;
+            }
+
+            //-- Bucket the points by partition (stable counting sort over chunks of points), so
+            //-- each partition only walks its own points
+            std::vector<int> bucket_offsets(n_partitions * n_partitions + 1, 0);
+            #pragma omp parallel for schedule(static, 1)
+            for (int t = 0; t < n_partitions; t++)
+            {
+                int begin = (long)n_points * t / n_partitions, end = (long)n_points * (t+1) / n_partitions;
+                for (int k = begin; k < end; k++)
+                    if (owner[k] >= 0)
+                        bucket_offsets[owner[k] * n_partitions + t + 1]++;
+            }
+            for (int b = 0; b < n_partitions * n_partitions; b++)
+                bucket_offsets[b+1] += bucket_offsets[b];
+
+            std::vector<int> partition_points(bucket_offsets.back());
+            #pragma omp parallel for schedule(static, 1)
+            for (int t = 0; t < n_partitions; t++)
+            {
+                int begin = (long)n_points * t / n_partitions, end = (long)n_points * (t+1) / n_partitions;
+                std::vector<int> next(n_partitions);
+                for (int p = 0; p < n_partitions; p++)
+                    next[p] = bucket_offsets[p * n_partitions + t];
+                for (int k = begin; k < end; k++)
+                    if (owner[k] >= 0)
+                        partition_points[next[owner[k]]++] = k;
+            }
+
+            //-- Each partition inserts only the voxels it owns in its own hash map, so no
+            //-- locking is needed. The first point of each voxel is flagged for the numbering
+            std::vector<int> local_voxel(n_points, -1);
+            std::vector<char> first_point(n_points, 0);
+            std::vector<std::vector<int> > voxel_first(n_partitions), voxel_counts(n_partitions);
+            #pragma omp parallel for schedule(static, 1)
+            for (int p = 0; p < n_partitions; p++)
+            {
+                VoxelMap voxel_map;
+                for (int b = bucket_offsets[p * n_partitions]; b < bucket_offsets[(p+1) * n_partitions]; b++)
+                {
+                    int k = partition_points[b];
+                    std::pair<typename VoxelMap::iterator, bool> result = voxel_map.insert(std::make_pair(keys[k], (int)voxel_first[p].size()));
+                    if (result.second)
+                    {
+                        voxel_first[p].push_back(k);
+                        voxel_counts[p].push_back(0);
+                        first_point[k] = 1;
+                    }
+                    local_voxel[k] = result.first->second;
+                    voxel_counts[p][local_voxel[k]]++;
+                }
+            }
+
+            //-- Voxels are numbered in order of their first point: number of first points before
+            //-- it (parallel prefix sum over chunks of points)
+            std::vector<int> first_rank(n_points);
+            std::vector<int> chunk_offsets(n_partitions + 1, 0);
+            #pragma omp parallel for schedule(static, 1)
+            for (int t = 0; t < n_partitions; t++)
+            {
+                int begin = (long)n_points * t / n_partitions, end = (long)n_points * (t+1) / n_partitions;
+                for (int k = begin; k < end; k++)
+                    chunk_offsets[t+1] += first_point[k];
+            }
+            for (int t = 0; t < n_partitions; t++)
+                chunk_offsets[t+1] += chunk_offsets[t];
+            int n_voxels = chunk_offsets.back();
+
+            #pragma omp parallel for schedule(static, 1)
+            for (int t = 0; t < n_partitions; t++)
+            {
+                int begin = (long)n_points * t / n_partitions, end = (long)n_points * (t+1) / n_partitions;
+                int rank = chunk_offsets[t];
+                for (int k = begin; k < end; k++)
+                {
+                    first_rank[k] = rank;
+                    rank += first_point[k];
+                }
+            }
+
+            std::vector<std::vector<int> > global_voxel(n_partitions);
+            std::vector<int> voxel_sizes(n_voxels);
+            #pragma omp parallel for schedule(static, 1)
+            for (int p = 0; p < n_partitions; p++)
+            {
+                global_voxel[p].resize(voxel_first[p].size());
+                for (int v = 0; v < (int)voxel_first[p].size(); v++)
+                {
+                    global_voxel[p][v] = first_rank[voxel_first[p][v]];
+                    voxel_sizes[global_voxel[p][v]] = voxel_counts[p][v];
+                }
+            }
+
+            //-- Drop small voxels and build the voxel -> points map (CSR layout). Each partition
+            //-- fills the voxels it owns, walking its points in order
+            std::vector<int> output_voxel(n_voxels, -1);
+            std::vector<int> offsets(1, 0);
+            for (int v = 0; v < n_voxels; v++)
+                if (voxel_sizes[v] >= min_points_per_voxel)
+                {
+                    output_voxel[v] = offsets.size() - 1;
+                    offsets.push_back(offsets.back() + voxel_sizes[v]);
+                }
+            int n_output_voxels = offsets.size() - 1;
+
+            std::vector<int> points(offsets.back());
+            std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+            #pragma omp parallel for schedule(static, 1)
+            for (int p = 0; p < n_partitions; p++)
+                for (int b = bucket_offsets[p * n_partitions]; b < bucket_offsets[(p+1) * n_partitions]; b++)
+                {
+                    int k = partition_points[b];
+                    int voxel = output_voxel[global_voxel[p][local_voxel[k]]];
+                    if (voxel >= 0)
+                        points[fill[voxel]++] = indices[k];
+                }
+
+            //-- Reduce each voxel to a single point
+            typename pcl::PointCloud<PointT>::VectorType output_points(n_output_voxels);
+            representative_indices.resize(n_output_voxels);
+            #pragma omp parallel for schedule(dynamic, 256)
+            for (int v = 0; v < n_output_voxels; v++)
+                representative_indices[v] = reduceVoxel(points, offsets[v], offsets[v+1], output_points[v]);
+
+            if (save_voxel_map)
+            {
+                voxel_offsets.swap(offsets);
+                voxel_points.swap(points);
+            }
+
+            output.header = input_cloud->header;
+            output.sensor_origin_ = input_cloud->sensor_origin_;
+            output.sensor_orientation_ = input_cloud->sensor_orientation_;
+            output.points.swap(output_points);
+            output.width = n_output_voxels;
+            output.height = 1;
+            output.is_dense = true;
+            return true;
+        }
+
+    private:
+        //-- Returns the index of the representative point of the voxel
+        int reduceVoxel(const std::vector<int>& points, int begin, int end, PointT& output_point) const
+        {
+            switch (reduction_mode)
+            {
+                case FIRST_POINT:
+                    output_point = input_cloud->points[points[begin]];
+                    return points[begin];
+
+                case MAX_Z:
+                {
+                    int highest = points[begin];
+                    for (int i = begin + 1; i < end; i++)
+                        if (input_cloud->points[points[i]].z > input_cloud->points[highest].z)
+                            highest = points[i];
+                    output_point = input_cloud->points[highest];
+                    return highest;
+                }
+
+                case CLOSEST_TO_CENTROID:
+                {
+                    Eigen::Vector3f centroid = Eigen::Vector3f::Zero();
+                    for (int i = begin; i < end; i++)
+                        centroid += input_cloud->points[points[i]].getVector3fMap();
+                    centroid /= (float)(end - begin);
+
+                    int closest = points[begin];
+                    float min_distance = std::numeric_limits<float>::max();
+                    for (int i = begin; i < end; i++)
+                    {
+                        float distance = (input_cloud->points[points[i]].getVector3fMap() - centroid).squaredNorm();
+                        if (distance < min_distance)
+                        {
+                            min_distance = distance;
+                            closest = points[i];
+                        }
+                    }
+                    output_point = input_cloud->points[closest];
+                    return closest;
+                }
+
+                case CENTROID:
+                default:
+                {
+                    //-- Mean of each float value and of each byte of the packed color, the
+                    //-- rest of the fields come from the first point
+                    output_point = input_cloud->points[points[begin]];
+                    uint8_t* output_data = reinterpret_cast<uint8_t*>(&output_point);
+                    for (int f = 0; f < (int)float_offsets.size(); f++)
+                    {
+                        double sum = 0;
+                        for (int i = begin; i < end; i++)
+                            sum += *reinterpret_cast<const float*>(pointData(points[i]) + float_offsets[f]);
+                        *reinterpret_cast<float*>(output_data + float_offsets[f]) = sum / (end - begin);
+                    }
+
+                    if (color_offset >= 0)
+                    {
+                        long channel_sums[4] = {0, 0, 0, 0};
+                        for (int i = begin; i < end; i++)
+                        {
+                            uint32_t color = *reinterpret_cast<const uint32_t*>(pointData(points[i]) + color_offset);
+                            for (int c = 0; c < 4; c++)
+                                channel_sums[c] += (color >> (8 * c)) & 0xFF;
+                        }
+
+                        uint32_t color = 0;
+                        for (int c = 0; c < 4; c++)
+                            color |= (uint32_t)(channel_sums[c] / (end - begin)) << (8 * c);
+                        *reinterpret_cast<uint32_t*>(output_data + color_offset) = color;
+                    }
+                    return points[begin];
+                }
+            }
+        }
+
+        //-- Offsets of the float values and of the packed color (rgb or rgba) of PointT
+        void findCentroidFields()
+        {
+            std::vector<pcl::PCLPointField> fields;
+            pcl::getFields<PointT>(fields);
+
+            float_offsets.clear();
+            color_offset = -1;
+            for (int f = 0; f < (int)fields.size(); f++)
+            {
+                if (fields[f].name == "rgb" || fields[f].name == "rgba")
+                    color_offset = fields[f].offset;
+                else if (fields[f].datatype == pcl::PCLPointField::FLOAT32)
+                    for (int c = 0; c < (int)fields[f].count; c++)
+                        float_offsets.push_back(fields[f].offset + c * sizeof(float));
+            }
+        }
+
+        const uint8_t* pointData(int index) const
+        {
+            return reinterpret_cast<const uint8_t*>(&input_cloud->points[index]);
+        }
+
+        PointCloudConstPtr input_cloud;
+        pcl::IndicesConstPtr input_indices;
+
+        Eigen::Vector3f leaf_size;
+        ReductionMode reduction_mode;
+        int min_points_per_voxel;
+        bool save_voxel_map;
+
+        std::vector<int> float_offsets;
+        int color_offset;
+
+        std::vector<int> representative_indices;
+        std::vector<int> voxel_offsets;
+        std::vector<int> voxel_points;
+};
+
+#endif // VOXEL_GRID_DOWNSAMPLER_HPP
@@ -0,0 +1,46 @@
+/*
+ * Voxel Key
+ *
+ * Integer coordinates of a voxel and the hash used to store voxels in hash maps.
+ * Each axis is stored separately, so there is no need to know the extent of the
+ * cloud beforehand (pcl::VoxelGrid packs the three axes in a single integer and
+ * overflows when the cloud is large compared to the leaf size).
+ *
+ */
+
+#ifndef VOXEL_KEY_HPP
+#define VOXEL_KEY_HPP
+
+#include <cmath>
+#include <cstddef>
+
+struct VoxelKey
+{
+    int x, y, z;
+
+    VoxelKey() : x(0), y(0), z(0) {}
+    VoxelKey(int x, int y, int z) : x(x), y(y), z(z) {}
+
+    bool operator==(const VoxelKey& other) const { return x == other.x && y == other.y && z == other.z; }
+    bool operator!=(const VoxelKey& other) const { return !(*this == other); }
+};
+
+struct VoxelKeyHash
+{
+    std::size_t operator()(const VoxelKey& key) const
+    {
+        //-- Spatial hash from Teschner et al. "Optimized Spatial Hashing for Collision Detection..."
+        return ((std::size_t)(unsigned int)key.x * 73856093u) ^
+               ((std::size_t)(unsigned int)key.y * 19349663u) ^
+               ((std::size_t)(unsigned int)key.z * 83492791u);
+    }
+};
+
+inline VoxelKey computeVoxelKey(float x, float y, float z, float inverse_leaf_x, float inverse_leaf_y, float inverse_leaf_z)
+{
+    return VoxelKey((int)std::floor(x * inverse_leaf_x),
+                    (int)std::floor(y * inverse_leaf_y),
+                    (int)std::floor(z * inverse_leaf_z));
+}
+
+#endif // VOXEL_KEY_HPP
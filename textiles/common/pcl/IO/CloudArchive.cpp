@@ -0,0 +1,580 @@
+#include "CloudArchive.hpp"
+#include "VoxelKey.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    const char archive_magic[8] = { 'T', 'X', 'A', 'R', 'C', 'H', 'V', '1' };
+    const uint32_t max_quantized_coordinate = (1u << 21) - 1;
+
+    //-- Interleave the bits of the three (21 bit) coordinates
+    uint64_t splitBits(uint32_t value)
+    {
+        uint64_t x = value & 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffffULL;
+        x = (x | x << 16) & 0x1f0000ff0000ffULL;
+        x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+        x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+        x = (x | x << 2)  & 0x1249249249249249ULL;
+        return x;
+    }
+
+    uint32_t compactBits(uint64_t x)
+    {
+        x &= 0x1249249249249249ULL;
+        x = (x ^ (x >> 2))  & 0x10c30c30c30c30c3ULL;
+        x = (x ^ (x >> 4))  & 0x100f00f00f00f00fULL;
+        x = (x ^ (x >> 8))  & 0x1f0000ff0000ffULL;
+        x = (x ^ (x >> 16)) & 0x1f00000000ffffULL;
+        x = (x ^ (x >> 32)) & 0x1fffff;
+        return (uint32_t)x;
+    }
+
+    uint64_t encodeMorton(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return splitBits(x) | (splitBits(y) << 1) | (splitBits(z) << 2);
+    }
+
+    template<typename T>
+    void writeValue(std::ostream& stream, const T& value)
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool readValue(std::istream& stream, T& value)
+    {
+        return bool(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    struct PointCode {
+        uint64_t code;
+        uint32_t color;
+        bool operator<(const PointCode& other) const { return code < other.code; }
+    };
+}
+
+CloudArchive::CloudArchive()
+{
+    //-- Set default values
+    quantization_step = 0.0005;
+    chunk_size = 0.25;
+    levels = 3;
+    coarsest_leaf_size = 0.02;
+    compression_level = 6;
+
+    has_color = false;
+    total_points = 0;
+}
+
+bool CloudArchive::setCompressionLevel(int compression_level)
+{
+    if (compression_level < Z_NO_COMPRESSION || compression_level > Z_BEST_COMPRESSION)
+    {
+        std::cerr << "Error: compression level must be between " << Z_NO_COMPRESSION << " and "
+                  << Z_BEST_COMPRESSION << std::endl;
+        return false;
+    }
+
+    this->compression_level = compression_level;
+    return true;
+}
+
+bool CloudArchive::write(const std::string& filename, const pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+    std::vector<Eigen::Vector3f> points;
+    points.reserve(cloud.points.size());
+    for (std::size_t i = 0; i < cloud.points.size(); i++)
+        if (std::isfinite(cloud.points[i].x) && std::isfinite(cloud.points[i].y) && std::isfinite(cloud.points[i].z))
+            points.push_back(Eigen::Vector3f(cloud.points[i].x, cloud.points[i].y, cloud.points[i].z));
+
+    return writePoints(filename, points, NULL);
+}
+
+bool CloudArchive::write(const std::string& filename, const pcl::PointCloud<pcl::PointXYZRGB>& cloud)
+{
+    std::vector<Eigen::Vector3f> points;
+    std::vector<uint32_t> colors;
+    points.reserve(cloud.points.size());
+    colors.reserve(cloud.points.size());
+    for (std::size_t i = 0; i < cloud.points.size(); i++)
+        if (std::isfinite(cloud.points[i].x) && std::isfinite(cloud.points[i].y) && std::isfinite(cloud.points[i].z))
+        {
+            const pcl::PointXYZRGB& point = cloud.points[i];
+            points.push_back(Eigen::Vector3f(point.x, point.y, point.z));
+            colors.push_back(((uint32_t)point.r << 16) | ((uint32_t)point.g << 8) | (uint32_t)point.b);
+        }
+
+    return writePoints(filename, points, &colors);
+}
+
+bool CloudArchive::writePoints(const std::string& filename, const std::vector<Eigen::Vector3f>& points,
+                               const std::vector<uint32_t>* colors)
+{
+    if (quantization_step <= 0 || chunk_size <= 0 || levels < 1 || coarsest_leaf_size <= 0)
+    {
+        std::cerr << "Error: invalid archive parameters" << std::endl;
+        return false;
+    }
+
+    if (chunk_size / quantization_step >= max_quantized_coordinate)
+    {
+        std::cerr << "Error: chunk size too large for the quantization step" << std::endl;
+        return false;
+    }
+
+    has_color = colors != NULL;
+    total_points = points.size();
+    min_bb = Eigen::Vector3f::Zero();
+    max_bb = Eigen::Vector3f::Zero();
+    if (!points.empty())
+    {
+        min_bb = max_bb = points[0];
+        for (std::size_t i = 1; i < points.size(); i++)
+        {
+            min_bb = min_bb.cwiseMin(points[i]);
+            max_bb = max_bb.cwiseMax(points[i]);
+        }
+    }
+    origin = min_bb;
+
+    //-- Split the points in chunks
+    chunks.clear();
+    std::vector<std::vector<int> > chunk_points;
+    std::unordered_map<VoxelKey, int, VoxelKeyHash> chunk_map;
+    float inverse_chunk_size = 1.0f / chunk_size;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        Eigen::Vector3f relative = points[i] - origin;
+        VoxelKey key = computeVoxelKey(relative[0], relative[1], relative[2], inverse_chunk_size, inverse_chunk_size, inverse_chunk_size);
+        std::pair<std::unordered_map<VoxelKey, int, VoxelKeyHash>::iterator, bool> inserted = chunk_map.insert(std::make_pair(key, (int)chunks.size()));
+        if (inserted.second)
+        {
+            Chunk chunk;
+            chunk.x = key.x; chunk.y = key.y; chunk.z = key.z;
+            chunks.push_back(chunk);
+            chunk_points.push_back(std::vector<int>());
+        }
+        chunk_points[inserted.first->second].push_back(i);
+    }
+
+    //-- Encode each chunk (in parallel)
+    std::vector<std::vector<std::vector<uint8_t> > > data(chunks.size(), std::vector<std::vector<uint8_t> >(levels));
+    std::vector<char> encoded(chunks.size(), 1);
+    #pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < (int)chunks.size(); c++)
+    {
+        const std::vector<int>& indices = chunk_points[c];
+        Eigen::Vector3f chunk_origin = origin + Eigen::Vector3f(chunks[c].x, chunks[c].y, chunks[c].z) * chunk_size;
+
+        //-- Quantize the points to the chunk origin
+        std::vector<VoxelKey> quantized(indices.size());
+        for (std::size_t i = 0; i < indices.size(); i++)
+        {
+            Eigen::Vector3f q = (points[indices[i]] - chunk_origin) / quantization_step;
+            quantized[i] = VoxelKey(std::min((int)max_quantized_coordinate, std::max(0, (int)std::floor(q[0] + 0.5f))),
+                                    std::min((int)max_quantized_coordinate, std::max(0, (int)std::floor(q[1] + 0.5f))),
+                                    std::min((int)max_quantized_coordinate, std::max(0, (int)std::floor(q[2] + 0.5f))));
+        }
+
+        //-- Assign levels: each level adds the points that fall in voxels (of half the size of the
+        //-- previous level) still empty
+        std::vector<int> point_level(indices.size(), levels-1);
+        for (int l = 0; l < levels-1; l++)
+        {
+            float inverse_leaf = quantization_step / (coarsest_leaf_size / (1 << l));
+            std::unordered_set<VoxelKey, VoxelKeyHash> occupied;
+            for (int pass = 0; pass < 2; pass++)
+                for (std::size_t i = 0; i < indices.size(); i++)
+                {
+                    //-- First the voxels of the previous levels, then the new ones
+                    bool assigned = point_level[i] < l;
+                    if ((pass == 0) != assigned)
+                        continue;
+
+                    VoxelKey key = computeVoxelKey(quantized[i].x, quantized[i].y, quantized[i].z, inverse_leaf, inverse_leaf, inverse_leaf);
+                    if (occupied.insert(key).second && !assigned)
+                        point_level[i] = l;
+                }
+        }
+
+        chunks[c].levels.resize(levels);
+        for (int l = 0; l < levels; l++)
+        {
+            std::vector<PointCode> level_points;
+            for (std::size_t i = 0; i < indices.size(); i++)
+                if (point_level[i] == l)
+                {
+                    PointCode point;
+                    point.code = encodeMorton(quantized[i].x, quantized[i].y, quantized[i].z);
+                    point.color = colors ? (*colors)[indices[i]] : 0;
+                    level_points.push_back(point);
+                }
+            std::sort(level_points.begin(), level_points.end());
+
+            std::vector<uint64_t> codes(level_points.size());
+            std::vector<uint32_t> level_colors(colors ? level_points.size() : 0);
+            for (std::size_t i = 0; i < level_points.size(); i++)
+            {
+                codes[i] = level_points[i].code;
+                if (colors)
+                    level_colors[i] = level_points[i].color;
+            }
+
+            if (!encodeLevel(codes, colors ? &level_colors : NULL, data[c][l], chunks[c].levels[l].uncompressed_size))
+                encoded[c] = 0;
+            chunks[c].levels[l].compressed_size = data[c][l].size();
+            chunks[c].levels[l].points = level_points.size();
+        }
+    }
+
+    if (std::find(encoded.begin(), encoded.end(), 0) != encoded.end())
+    {
+        std::cerr << "Error: could not compress the chunks of " << filename << std::endl;
+        return false;
+    }
+
+    //-- Header, chunk index and data
+    uint64_t offset = sizeof(archive_magic) + 4 * sizeof(uint32_t) + 12 * sizeof(float) + sizeof(uint64_t)
+                      + chunks.size() * (3 * sizeof(int32_t) + levels * (sizeof(uint64_t) + 3 * sizeof(uint32_t)));
+    for (std::size_t c = 0; c < chunks.size(); c++)
+        for (int l = 0; l < levels; l++)
+        {
+            chunks[c].levels[l].offset = offset;
+            offset += chunks[c].levels[l].compressed_size;
+        }
+
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: could not open " << filename << std::endl;
+        return false;
+    }
+
+    file.write(archive_magic, sizeof(archive_magic));
+    writeValue(file, (uint32_t)(has_color ? 1 : 0));
+    writeValue(file, (uint32_t)levels);
+    writeValue(file, quantization_step);
+    writeValue(file, chunk_size);
+    writeValue(file, coarsest_leaf_size);
+    for (int i = 0; i < 3; i++) writeValue(file, origin[i]);
+    for (int i = 0; i < 3; i++) writeValue(file, min_bb[i]);
+    for (int i = 0; i < 3; i++) writeValue(file, max_bb[i]);
+    writeValue(file, total_points);
+    writeValue(file, (uint32_t)chunks.size());
+    writeValue(file, (uint32_t)0);  //-- Reserved
+
+    for (std::size_t c = 0; c < chunks.size(); c++)
+    {
+        writeValue(file, chunks[c].x);
+        writeValue(file, chunks[c].y);
+        writeValue(file, chunks[c].z);
+        for (int l = 0; l < levels; l++)
+        {
+            writeValue(file, chunks[c].levels[l].offset);
+            writeValue(file, chunks[c].levels[l].compressed_size);
+            writeValue(file, chunks[c].levels[l].uncompressed_size);
+            writeValue(file, chunks[c].levels[l].points);
+        }
+    }
+
+    for (std::size_t c = 0; c < chunks.size(); c++)
+        for (int l = 0; l < levels; l++)
+            if (!data[c][l].empty())
+                file.write(reinterpret_cast<const char*>(&data[c][l][0]), data[c][l].size());
+
+    this->filename = filename;
+    return file.good();
+}
+
+bool CloudArchive::encodeLevel(const std::vector<uint64_t>& codes, const std::vector<uint32_t>* colors,
+                               std::vector<uint8_t>& compressed, uint32_t& uncompressed_size) const
+{
+    //-- Sorted codes are stored as varint deltas, colors as planar r, g, b
+    std::vector<uint8_t> raw;
+    raw.reserve(codes.size() * (colors ? 5 : 2));
+    uint64_t previous = 0;
+    for (std::size_t i = 0; i < codes.size(); i++)
+    {
+        uint64_t delta = codes[i] - previous;
+        previous = codes[i];
+        while (delta >= 0x80)
+        {
+            raw.push_back((uint8_t)(delta | 0x80));
+            delta >>= 7;
+        }
+        raw.push_back((uint8_t)delta);
+    }
+
+    if (colors)
+        for (int shift = 16; shift >= 0; shift -= 8)
+            for (std::size_t i = 0; i < colors->size(); i++)
+                raw.push_back((uint8_t)((*colors)[i] >> shift));
+
+    uncompressed_size = raw.size();
+    compressed.clear();
+    if (raw.empty())
+        return true;
+
+    uLongf compressed_size = compressBound(raw.size());
+    compressed.resize(compressed_size);
+    if (compress2(&compressed[0], &compressed_size, &raw[0], raw.size(), compression_level) != Z_OK)
+    {
+        compressed.clear();
+        return false;
+    }
+    compressed.resize(compressed_size);
+    return true;
+}
+
+bool CloudArchive::open(const std::string& filename)
+{
+    chunks.clear();
+    total_points = 0;
+
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: could not open " << filename << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(archive_magic)];
+    uint32_t flags, n_levels, n_chunks, reserved;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, archive_magic, sizeof(magic)) != 0)
+    {
+        std::cerr << "Error: " << filename << " is not a cloud archive" << std::endl;
+        return false;
+    }
+
+    bool ok = readValue(file, flags) && readValue(file, n_levels) && readValue(file, quantization_step) &&
+              readValue(file, chunk_size) && readValue(file, coarsest_leaf_size);
+    for (int i = 0; i < 3; i++) ok = ok && readValue(file, origin[i]);
+    for (int i = 0; i < 3; i++) ok = ok && readValue(file, min_bb[i]);
+    for (int i = 0; i < 3; i++) ok = ok && readValue(file, max_bb[i]);
+    ok = ok && readValue(file, total_points) && readValue(file, n_chunks) && readValue(file, reserved);
+    if (!ok || n_levels < 1)
+    {
+        std::cerr << "Error: corrupted archive header in " << filename << std::endl;
+        return false;
+    }
+
+    has_color = flags & 1;
+    levels = n_levels;
+    chunks.resize(n_chunks);
+    for (std::size_t c = 0; c < chunks.size() && ok; c++)
+    {
+        ok = readValue(file, chunks[c].x) && readValue(file, chunks[c].y) && readValue(file, chunks[c].z);
+        chunks[c].levels.resize(levels);
+        for (int l = 0; l < levels && ok; l++)
+            ok = readValue(file, chunks[c].levels[l].offset) && readValue(file, chunks[c].levels[l].compressed_size) &&
+                 readValue(file, chunks[c].levels[l].uncompressed_size) && readValue(file, chunks[c].levels[l].points);
+    }
+
+    if (!ok)
+    {
+        std::cerr << "Error: corrupted chunk index in " << filename << std::endl;
+        chunks.clear();
+        return false;
+    }
+
+    this->filename = filename;
+    return true;
+}
+
+uint64_t CloudArchive::getPointCount(int level) const
+{
+    if (level < 0 || level >= levels)
+        return total_points;
+
+    uint64_t count = 0;
+    for (std::size_t c = 0; c < chunks.size(); c++)
+        for (int l = 0; l <= level; l++)
+            count += chunks[c].levels[l].points;
+    return count;
+}
+
+bool CloudArchive::read(pcl::PointCloud<pcl::PointXYZ>& cloud, int level)
+{
+    float max_value = std::numeric_limits<float>::max();
+    return readRegion(Eigen::Vector3f::Constant(-max_value), Eigen::Vector3f::Constant(max_value), cloud, level);
+}
+
+bool CloudArchive::read(pcl::PointCloud<pcl::PointXYZRGB>& cloud, int level)
+{
+    float max_value = std::numeric_limits<float>::max();
+    return readRegion(Eigen::Vector3f::Constant(-max_value), Eigen::Vector3f::Constant(max_value), cloud, level);
+}
+
+bool CloudArchive::readRegion(const Eigen::Vector3f& min_bb, const Eigen::Vector3f& max_bb,
+                              pcl::PointCloud<pcl::PointXYZ>& cloud, int level)
+{
+    std::vector<Eigen::Vector3f> points;
+    std::vector<uint32_t> colors;
+    if (!readPoints(min_bb, max_bb, level, points, colors))
+        return false;
+
+    cloud.points.resize(points.size());
+    for (std::size_t i = 0; i < points.size(); i++)
+        cloud.points[i].getVector3fMap() = points[i];
+    cloud.width = points.size();
+    cloud.height = 1;
+    cloud.is_dense = true;
+    return true;
+}
+
+bool CloudArchive::readRegion(const Eigen::Vector3f& min_bb, const Eigen::Vector3f& max_bb,
+                              pcl::PointCloud<pcl::PointXYZRGB>& cloud, int level)
+{
+    std::vector<Eigen::Vector3f> points;
+    std::vector<uint32_t> colors;
+    if (!readPoints(min_bb, max_bb, level, points, colors))
+        return false;
+
+    cloud.points.resize(points.size());
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        pcl::PointXYZRGB& point = cloud.points[i];
+        point.getVector3fMap() = points[i];
+        uint32_t color = has_color ? colors[i] : 0;
+        point.r = color >> 16; point.g = color >> 8; point.b = color;
+    }
+    cloud.width = points.size();
+    cloud.height = 1;
+    cloud.is_dense = true;
+    return true;
+}
+
+bool CloudArchive::readPoints(const Eigen::Vector3f& min_bb, const Eigen::Vector3f& max_bb, int level,
+                              std::vector<Eigen::Vector3f>& points, std::vector<uint32_t>& colors)
+{
+    points.clear();
+    colors.clear();
+    if (filename.empty())
+    {
+        std::cerr << "Error: no archive open" << std::endl;
+        return false;
+    }
+
+    if (level < 0 || level >= levels)
+        level = levels-1;
+
+    //-- Only the chunks that intersect the region are read
+    std::vector<int> selected;
+    for (std::size_t c = 0; c < chunks.size(); c++)
+    {
+        Eigen::Vector3f chunk_min = origin + Eigen::Vector3f(chunks[c].x, chunks[c].y, chunks[c].z) * chunk_size;
+        Eigen::Vector3f chunk_max = chunk_min + Eigen::Vector3f::Constant(chunk_size + quantization_step);
+        if ((chunk_max.array() >= min_bb.array()).all() && (chunk_min.array() <= max_bb.array()).all())
+            selected.push_back(c);
+    }
+
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: could not open " << filename << std::endl;
+        return false;
+    }
+
+    int blocks_per_chunk = level + 1;
+    std::vector<std::vector<uint8_t> > compressed(selected.size() * blocks_per_chunk);
+    for (std::size_t s = 0; s < selected.size(); s++)
+        for (int l = 0; l <= level; l++)
+        {
+            const LevelEntry& entry = chunks[selected[s]].levels[l];
+            std::vector<uint8_t>& block = compressed[s * blocks_per_chunk + l];
+            block.resize(entry.compressed_size);
+            if (block.empty())
+                continue;
+            file.seekg(entry.offset);
+            if (!file.read(reinterpret_cast<char*>(&block[0]), block.size()))
+            {
+                std::cerr << "Error: truncated archive " << filename << std::endl;
+                return false;
+            }
+        }
+
+    //-- Decompress the blocks in parallel
+    std::vector<std::vector<Eigen::Vector3f> > block_points(compressed.size());
+    std::vector<std::vector<uint32_t> > block_colors(compressed.size());
+    bool ok = true;
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < (int)compressed.size(); b++)
+    {
+        const Chunk& chunk = chunks[selected[b / blocks_per_chunk]];
+        Eigen::Vector3f chunk_origin = origin + Eigen::Vector3f(chunk.x, chunk.y, chunk.z) * chunk_size;
+        if (!decodeLevel(compressed[b], chunk.levels[b % blocks_per_chunk], chunk_origin, block_points[b], block_colors[b]))
+        {
+            #pragma omp critical
+            ok = false;
+        }
+    }
+
+    if (!ok)
+    {
+        std::cerr << "Error: corrupted data in " << filename << std::endl;
+        return false;
+    }
+
+    for (std::size_t b = 0; b < block_points.size(); b++)
+        for (std::size_t i = 0; i < block_points[b].size(); i++)
+            if ((block_points[b][i].array() >= min_bb.array()).all() && (block_points[b][i].array() <= max_bb.array()).all())
+            {
+                points.push_back(block_points[b][i]);
+                if (has_color)
+                    colors.push_back(block_colors[b][i]);
+            }
+    return true;
+}
+
+bool CloudArchive::decodeLevel(const std::vector<uint8_t>& compressed, const LevelEntry& entry, const Eigen::Vector3f& chunk_origin,
+                               std::vector<Eigen::Vector3f>& points, std::vector<uint32_t>& colors) const
+{
+    if (entry.points == 0)
+        return true;
+
+    std::vector<uint8_t> raw(entry.uncompressed_size);
+    uLongf raw_size = raw.size();
+    if (raw.empty() || compressed.empty() ||
+            uncompress(&raw[0], &raw_size, &compressed[0], compressed.size()) != Z_OK || raw_size != raw.size())
+        return false;
+
+    points.resize(entry.points);
+    std::size_t position = 0;
+    uint64_t code = 0;
+    for (std::size_t i = 0; i < points.size(); i++)
+    {
+        uint64_t delta = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (position >= raw.size() || shift > 63)
+                return false;
+            uint8_t byte = raw[position++];
+            delta |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        code += delta;
+        points[i] = chunk_origin + Eigen::Vector3f(compactBits(code), compactBits(code >> 1), compactBits(code >> 2)) * quantization_step;
+    }
+
+    if (has_color)
+    {
+        if (raw.size() - position != 3 * points.size())
+            return false;
+
+        colors.assign(points.size(), 0);
+        for (int channel = 0; channel < 3; channel++)
+            for (std::size_t i = 0; i < points.size(); i++)
+                colors[i] |= (uint32_t)raw[position++] << (16 - 8 * channel);
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+ * Cloud Archive
+ *
+ * Compressed storage for point clouds (.tca files) with random access to spatial regions and
+ * levels of detail:
+ *  - The cloud is split in cubic chunks, indexed at the start of the file. Reading a region
+ *    only decompresses the chunks that intersect it.
+ *  - The points of each chunk are split in levels: level 0 keeps one point per voxel of the
+ *    coarsest leaf size, each following level halves the leaf size, and the last one has all
+ *    the remaining points. Reading level L only decompresses levels 0..L.
+ *  - Each level is quantized to the chunk origin, sorted by Morton code, stored as varint
+ *    deltas of the codes (plus planar r, g, b when there is color) and compressed with zlib.
+ *
+ * Coordinates are rounded to the quantization step and the original order of the points
+ * is not preserved. Invalid (NaN) points are dropped.
+ *
+ */
+
+#ifndef CLOUD_ARCHIVE_HPP
+#define CLOUD_ARCHIVE_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CloudArchive
+{
+    public:
+        CloudArchive();
+
+        //-- Writing parameters
+        void setQuantizationStep(float quantization_step) { this->quantization_step = quantization_step; }
+        void setChunkSize(float chunk_size) { this->chunk_size = chunk_size; }
+        void setLevels(int levels) { this->levels = levels; }
+        void setCoarsestLeafSize(float coarsest_leaf_size) { this->coarsest_leaf_size = coarsest_leaf_size; }
+        //-- zlib level, from 0 (no compression) to 9
+        bool setCompressionLevel(int compression_level);
+
+        bool write(const std::string& filename, const pcl::PointCloud<pcl::PointXYZ>& cloud);
+        bool write(const std::string& filename, const pcl::PointCloud<pcl::PointXYZRGB>& cloud);
+
+        //-- Reading (only the header and the chunk index are read when opening)
+        bool open(const std::string& filename);
+        bool hasColor() const { return has_color; }
+        int getLevels() const { return levels; }
+        std::size_t getChunkCount() const { return chunks.size(); }
+        uint64_t getPointCount() const { return total_points; }
+        uint64_t getPointCount(int level) const;
+        void getBoundingBox(Eigen::Vector3f& min_bb, Eigen::Vector3f& max_bb) const { min_bb = this->min_bb; max_bb = this->max_bb; }
+        float getQuantizationStep() const { return quantization_step; }
+        float getChunkSize() const { return chunk_size; }
+
+        //-- Points up to the given level of detail (-1 for all of them)
+        bool read(pcl::PointCloud<pcl::PointXYZ>& cloud, int level = -1);
+        bool read(pcl::PointCloud<pcl::PointXYZRGB>& cloud, int level = -1);
+
+        //-- Points inside a box (limits included), up to the given level of detail
+        bool readRegion(const Eigen::Vector3f& min_bb, const Eigen::Vector3f& max_bb,
+                        pcl::PointCloud<pcl::PointXYZ>& cloud, int level = -1);
+        bool readRegion(const Eigen::Vector3f& min_bb, const Eigen::Vector3f& max_bb,
+                        pcl::PointCloud<pcl::PointXYZRGB>& cloud, int level = -1);
+
+    private:
+        struct LevelEntry {
+            uint64_t offset;
+            uint32_t compressed_size;
+            uint32_t uncompressed_size;
+            uint32_t points;
+        };
+
+        struct Chunk {
+            int32_t x, y, z;
+            std::vector<LevelEntry> levels;
+        };
+
+        bool writePoints(const std::string& filename, const std::vector<Eigen::Vector3f>& points,
+                         const std::vector<uint32_t>* colors);
+        bool readPoints(const Eigen::Vector3f& min_bb, const Eigen::Vector3f& max_bb, int level,
+                        std::vector<Eigen::Vector3f>& points, std::vector<uint32_t>& colors);
+
+        bool encodeLevel(const std::vector<uint64_t>& codes, const std::vector<uint32_t>* colors,
+                         std::vector<uint8_t>& compressed, uint32_t& uncompressed_size) const;
+        bool decodeLevel(const std::vector<uint8_t>& compressed, const LevelEntry& entry, const Eigen::Vector3f& chunk_origin,
+                         std::vector<Eigen::Vector3f>& points, std::vector<uint32_t>& colors) const;
+
+        //-- Writing parameters (and values read from the header)
+        float quantization_step;
+        float chunk_size;
+        int levels;
+        float coarsest_leaf_size;
+        int compression_level;
+
+        //-- Open archive
+        std::string filename;
+        bool has_color;
+        uint64_t total_points;
+        Eigen::Vector3f origin;
+        Eigen::Vector3f min_bb, max_bb;
+        std::vector<Chunk> chunks;
+};
+
+#endif // CLOUD_ARCHIVE_HPP
@@ -0,0 +1,137 @@
+#include "CloudLoader.hpp"
+#include "FastPLYReader.hpp"
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/console/parse.h>
+
+CloudLoader::CloudLoader()
+{
+    filename = "";
+    sensor_origin = Eigen::Vector4f::Zero();
+    sensor_orientation = Eigen::Quaternionf::Identity();
+}
+
+bool CloudLoader::load(const std::string& filename, bool load_faces)
+{
+    this->filename = filename;
+    raw_cloud.reset();
+    pcd_reader.reset();
+    polygons.clear();
+    sensor_origin = Eigen::Vector4f::Zero();
+    sensor_orientation = Eigen::Quaternionf::Identity();
+
+    pcl::PCLPointCloud2::Ptr cloud(new pcl::PCLPointCloud2);
+    int result;
+    if (isPLY(filename))
+    {
+        //-- Large binary meshes are decoded in parallel (other layouts are read by PCL)
+        FastPLYReader ply_reader;
+        result = ply_reader.open(filename) && ply_reader.read(*cloud, load_faces ? &polygons : NULL) ? 0 : -1;
+    }
+    else if (isPCD(filename))
+    {
+        //-- Binary files are kept mapped, and read from the map when a cloud is requested
+        boost::shared_ptr<MMapPCDReader> reader(new MMapPCDReader);
+        if (!reader->open(filename))
+            result = -1;
+        else if (reader->getDataType() == MMapPCDReader::ASCII)
+            result = pcl::io::loadPCDFile(filename, *cloud, sensor_origin, sensor_orientation);
+        else
+        {
+            pcd_reader = reader;
+            sensor_origin = reader->getSensorOrigin();
+            sensor_orientation = reader->getSensorOrientation();
+            return true;
+        }
+    }
+    else
+    {
+        std::cerr << "Error: unknown point cloud format " << filename << std::endl;
+        return false;
+    }
+
+    if (result < 0)
+    {
+        std::cerr << "Error loading point cloud " << filename << std::endl;
+        return false;
+    }
+
+    raw_cloud = cloud;
+    return true;
+}
+
+pcl::PCLPointCloud2::ConstPtr CloudLoader::getRawCloud() const
+{
+    if (!raw_cloud && pcd_reader)
+    {
+        pcl::PCLPointCloud2::Ptr cloud(new pcl::PCLPointCloud2);
+        if (!pcd_reader->read(*cloud))
+        {
+            std::cerr << "Error loading point cloud " << filename << std::endl;
+            return pcl::PCLPointCloud2::ConstPtr();
+        }
+        raw_cloud = cloud;
+    }
+    return raw_cloud;
+}
+
+bool CloudLoader::hasField(const std::string& field_name) const
+{
+    if (pcd_reader)
+    {
+        const std::vector<pcl::PCLPointField>& fields = pcd_reader->getFields();
+        for (std::size_t i = 0; i < fields.size(); i++)
+            if (fields[i].name == field_name)
+                return true;
+        return false;
+    }
+
+    if (!raw_cloud)
+        return false;
+
+    for (std::size_t i = 0; i < raw_cloud->fields.size(); i++)
+        if (raw_cloud->fields[i].name == field_name)
+            return true;
+    return false;
+}
+
+std::size_t CloudLoader::size() const
+{
+    if (pcd_reader)
+        return pcd_reader->size();
+
+    if (!raw_cloud)
+        return 0;
+    return (std::size_t)raw_cloud->width * raw_cloud->height;
+}
+
+static bool hasExtension(const std::string& filename, const std::string& extension)
+{
+    return filename.size() >= extension.size() &&
+           filename.compare(filename.size()-extension.size(), extension.size(), extension) == 0;
+}
+
+bool CloudLoader::isPLY(const std::string& filename)
+{
+    return hasExtension(filename, ".ply");
+}
+
+bool CloudLoader::isPCD(const std::string& filename)
+{
+    return hasExtension(filename, ".pcd");
+}
+
+std::string CloudLoader::parseFilenameArgument(int argc, char** argv)
+{
+    std::vector<int> filenames = pcl::console::parse_file_extension_argument(argc, argv, ".ply");
+
+    if (filenames.size() != 1)
+    {
+        filenames = pcl::console::parse_file_extension_argument(argc, argv, ".pcd");
+
+        if (filenames.size() != 1)
+            return "";
+    }
+
+    return argv[filenames[0]];
+}
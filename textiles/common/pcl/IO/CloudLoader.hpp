@@ -0,0 +1,101 @@
+/*
+ * Cloud Loader
+ *
+ * Reads a .pcd or .ply file once, keeping all of its fields (PCLPointCloud2), and hands out
+ * typed clouds (PointXYZ, PointXYZRGB, PointXYZRGBNormal...) built from the parsed data.
+ * Programs that need the same file with and without color no longer parse it twice.
+ *
+ * Binary .pcd files are read with MMapPCDReader and .ply files with FastPLYReader. Binary
+ * .pcd files stay mapped while the loader is alive: typed clouds are read straight from the
+ * map (a single copy if the file has the layout of the point type), and the PCLPointCloud2
+ * is only built if it is requested.
+ *
+ * It also finds the (single) .ply or .pcd file among the program arguments, which every
+ * program used to do by itself.
+ *
+ */
+
+#ifndef CLOUD_LOADER_HPP
+#define CLOUD_LOADER_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PCLPointCloud2.h>
+#include <pcl/Vertices.h>
+#include <pcl/conversions.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "MMapPCDReader.hpp"
+
+class CloudLoader
+{
+    public:
+        CloudLoader();
+
+        //-- Parse the file (format selected by extension). The faces of .ply meshes are only
+        //-- read if requested
+        bool load(const std::string& filename, bool load_faces = false);
+        bool isLoaded() const { return raw_cloud || pcd_reader; }
+        const std::string& getFilename() const { return filename; }
+
+        //-- Fields available in the file
+        bool hasField(const std::string& field_name) const;
+        bool hasColor() const { return hasField("rgb") || hasField("rgba"); }
+        bool hasNormals() const { return hasField("normal_x") && hasField("normal_y") && hasField("normal_z"); }
+        std::size_t size() const;
+
+        //-- Parsed data, with all the fields of the file
+        pcl::PCLPointCloud2::ConstPtr getRawCloud() const;
+        const std::vector<pcl::Vertices>& getPolygons() const { return polygons; }
+
+        //-- Typed cloud (fields missing in the file are left with their default values)
+        template<typename PointT>
+        bool getCloud(pcl::PointCloud<PointT>& cloud) const
+        {
+            if (pcd_reader)
+                return pcd_reader->read(cloud);
+
+            if (!raw_cloud)
+            {
+                std::cerr << "Error: no point cloud loaded" << std::endl;
+                return false;
+            }
+
+            pcl::fromPCLPointCloud2(*raw_cloud, cloud);
+            cloud.sensor_origin_ = sensor_origin;
+            cloud.sensor_orientation_ = sensor_orientation;
+            return true;
+        }
+
+        template<typename PointT>
+        typename pcl::PointCloud<PointT>::Ptr getCloud() const
+        {
+            typename pcl::PointCloud<PointT>::Ptr cloud(new pcl::PointCloud<PointT>);
+            if (!getCloud(*cloud))
+                return typename pcl::PointCloud<PointT>::Ptr();
+            return cloud;
+        }
+
+        static bool isPLY(const std::string& filename);
+        static bool isPCD(const std::string& filename);
+
+        //-- The only .ply (or, if there is none, .pcd) file in the arguments ("" if there is
+        //-- not exactly one)
+        static std::string parseFilenameArgument(int argc, char** argv);
+
+    private:
+        std::string filename;
+        mutable pcl::PCLPointCloud2::Ptr raw_cloud;
+        //-- Open reader of binary .pcd files (their raw cloud is built on demand)
+        boost::shared_ptr<MMapPCDReader> pcd_reader;
+        std::vector<pcl::Vertices> polygons;
+        Eigen::Vector4f sensor_origin;
+        Eigen::Quaternionf sensor_orientation;
+};
+
+#endif // CLOUD_LOADER_HPP
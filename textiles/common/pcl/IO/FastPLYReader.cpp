@@ -0,0 +1,430 @@
+#include "FastPLYReader.hpp"
+
+#include <pcl/PolygonMesh.h>
+#include <pcl/io/ply_io.h>
+
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FastPLYReader::FastPLYReader()
+{
+    file_descriptor = -1;
+    mapped_data = NULL;
+    mapped_size = 0;
+    close();
+}
+
+FastPLYReader::~FastPLYReader()
+{
+    close();
+}
+
+bool FastPLYReader::open(const std::string& filename)
+{
+    close();
+    this->filename = filename;
+
+    file_descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (file_descriptor < 0)
+    {
+        std::cerr << "Error: could not open " << filename << std::endl;
+        return false;
+    }
+
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || file_status.st_size == 0)
+    {
+        std::cerr << "Error: could not read " << filename << std::endl;
+        close();
+        return false;
+    }
+
+    mapped_size = file_status.st_size;
+    void* data = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "Error: could not map " << filename << std::endl;
+        mapped_size = 0;
+        close();
+        return false;
+    }
+    mapped_data = static_cast<uint8_t*>(data);
+
+    if (!parseHeader())
+    {
+        std::cerr << "Error: invalid PLY header in " << filename << std::endl;
+        close();
+        return false;
+    }
+
+    //-- Only the header has to be valid for the PCL fallback
+    if (supported)
+        supported = findElementOffsets();
+    return true;
+}
+
+void FastPLYReader::close()
+{
+    if (mapped_data)
+        munmap(mapped_data, mapped_size);
+    if (file_descriptor >= 0)
+        ::close(file_descriptor);
+
+    file_descriptor = -1;
+    mapped_data = NULL;
+    mapped_size = 0;
+    data_offset = 0;
+    supported = false;
+    elements.clear();
+    vertex_element = -1;
+    face_element = -1;
+}
+
+bool FastPLYReader::parseHeader()
+{
+    //-- Supported only on little endian machines
+    const uint16_t endianness_test = 1;
+    bool little_endian_host = *reinterpret_cast<const uint8_t*>(&endianness_test) == 1;
+
+    std::size_t position = 0;
+    bool first_line = true;
+    while (position < mapped_size)
+    {
+        const uint8_t* line_end = static_cast<const uint8_t*>(memchr(mapped_data + position, '\n', mapped_size - position));
+        if (!line_end)
+            return false;
+        std::size_t next_position = line_end - mapped_data + 1;
+        std::istringstream line(std::string(reinterpret_cast<const char*>(mapped_data + position), next_position - position));
+        position = next_position;
+
+        std::string keyword;
+        line >> keyword;
+        if (first_line)
+        {
+            if (keyword != "ply")
+                return false;
+            first_line = false;
+        }
+        else if (keyword == "format")
+        {
+            std::string format;
+            line >> format;
+            supported = format == "binary_little_endian" && little_endian_host;
+        }
+        else if (keyword == "element")
+        {
+            Element element;
+            line >> element.name >> element.count;
+            element.offset = 0;
+            element.record_size = 0;
+            elements.push_back(element);
+        }
+        else if (keyword == "property")
+        {
+            if (elements.empty())
+                return false;
+
+            Property property;
+            std::string type;
+            line >> type;
+            property.is_list = type == "list";
+            if (property.is_list)
+            {
+                std::string count_type, item_type;
+                line >> count_type >> item_type;
+                if (!parseType(count_type, property.count_datatype, property.count_size) ||
+                        !parseType(item_type, property.datatype, property.type_size))
+                    return false;
+            }
+            else if (!parseType(type, property.datatype, property.type_size))
+                return false;
+            line >> property.name;
+
+            Element& element = elements.back();
+            element.properties.push_back(property);
+            if (property.is_list || element.record_size < 0)
+                element.record_size = -1;
+            else
+                element.record_size += property.type_size;
+        }
+        else if (keyword == "end_header")
+        {
+            data_offset = position;
+            break;
+        }
+    }
+
+    if (data_offset == 0)
+        return false;
+
+    for (std::size_t i = 0; i < elements.size(); i++)
+    {
+        if (elements[i].name == "vertex") vertex_element = i;
+        if (elements[i].name == "face") face_element = i;
+    }
+
+    //-- Vertices have to be fixed size records to be decoded in parallel
+    if (vertex_element < 0 || elements[vertex_element].record_size <= 0)
+        supported = false;
+    return true;
+}
+
+bool FastPLYReader::findElementOffsets()
+{
+    std::size_t position = data_offset;
+    for (std::size_t i = 0; i < elements.size(); i++)
+    {
+        Element& element = elements[i];
+        element.offset = position;
+
+        //-- Elements after the ones used do not need to be walked through
+        if ((int)i > vertex_element && (int)i > face_element)
+            break;
+
+        if (element.record_size >= 0)
+            position += element.count * element.record_size;
+        else
+            for (std::size_t j = 0; j < element.count && position <= mapped_size; j++)
+                position = skipRecord(element, position);
+
+        if (position > mapped_size)
+        {
+            std::cerr << "Error: truncated PLY file " << filename << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t FastPLYReader::skipRecord(const Element& element, std::size_t position) const
+{
+    for (std::size_t k = 0; k < element.properties.size(); k++)
+    {
+        const Property& property = element.properties[k];
+        if (!property.is_list)
+        {
+            position += property.type_size;
+            continue;
+        }
+
+        if (position + property.count_size > mapped_size)
+            return mapped_size + 1;
+        std::size_t count = readValue(mapped_data + position, property.count_datatype);
+        position += property.count_size + count * property.type_size;
+    }
+    return position;
+}
+
+bool FastPLYReader::read(pcl::PCLPointCloud2& cloud, std::vector<pcl::Vertices>* polygons)
+{
+    if (!isOpen())
+    {
+        std::cerr << "Error: no PLY file open" << std::endl;
+        return false;
+    }
+
+    if (!supported)
+        return readWithPCL(cloud, polygons);
+
+    //-- Output fields (PCL names), and where each one comes from
+    const Element& vertices = elements[vertex_element];
+    std::vector<int> source_offsets, source_sizes;
+    std::vector<int> color_offsets(4, -1);  //-- red, green, blue, alpha
+    int color_field = -1;
+
+    cloud.fields.clear();
+    uint32_t point_step = 0;
+    int property_offset = 0;
+    for (std::size_t k = 0; k < vertices.properties.size(); k++)
+    {
+        const Property& property = vertices.properties[k];
+        int offset = property_offset;
+        property_offset += property.type_size;
+
+        //-- Colors are packed in a single field
+        const char* color_names[] = { "red", "green", "blue", "alpha" };
+        bool is_color = false;
+        for (int c = 0; c < 4; c++)
+            if ((property.name == color_names[c] || property.name == std::string("diffuse_") + color_names[c]) &&
+                    property.datatype == pcl::PCLPointField::UINT8)
+            {
+                color_offsets[c] = offset;
+                is_color = true;
+            }
+
+        if (is_color)
+        {
+            if (color_field >= 0)
+                continue;
+            pcl::PCLPointField field;
+            field.name = "rgb";
+            field.datatype = pcl::PCLPointField::FLOAT32;
+            field.count = 1;
+            field.offset = point_step;
+            color_field = cloud.fields.size();
+            cloud.fields.push_back(field);
+            source_offsets.push_back(-1);
+            source_sizes.push_back(4);
+            point_step += 4;
+            continue;
+        }
+
+        pcl::PCLPointField field;
+        field.name = property.name;
+        if (property.name == "nx") field.name = "normal_x";
+        if (property.name == "ny") field.name = "normal_y";
+        if (property.name == "nz") field.name = "normal_z";
+        field.datatype = property.datatype;
+        field.count = 1;
+        field.offset = point_step;
+        cloud.fields.push_back(field);
+        source_offsets.push_back(offset);
+        source_sizes.push_back(property.type_size);
+        point_step += property.type_size;
+    }
+
+    if (color_field >= 0 && color_offsets[3] >= 0)
+    {
+        cloud.fields[color_field].name = "rgba";
+        cloud.fields[color_field].datatype = pcl::PCLPointField::UINT32;
+    }
+
+    std::size_t n_vertices = vertices.count;
+    cloud.width = n_vertices;
+    cloud.height = 1;
+    cloud.point_step = point_step;
+    cloud.row_step = point_step * n_vertices;
+    cloud.is_bigendian = false;
+    cloud.is_dense = true;
+    cloud.data.resize(n_vertices * point_step);
+
+    //-- Vertex records have a fixed size, so each thread decodes its own chunk of them
+    const uint8_t* vertex_data = mapped_data + vertices.offset;
+    int record_size = vertices.record_size;
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < (int64_t)n_vertices; i++)
+    {
+        const uint8_t* record = vertex_data + i * record_size;
+        uint8_t* point = &cloud.data[i * point_step];
+        for (std::size_t j = 0; j < cloud.fields.size(); j++)
+        {
+            if ((int)j != color_field)
+            {
+                std::memcpy(point + cloud.fields[j].offset, record + source_offsets[j], source_sizes[j]);
+                continue;
+            }
+
+            uint8_t bgra[4] = { 0, 0, 0, 255 };
+            for (int c = 0; c < 4; c++)
+                if (color_offsets[c] >= 0)
+                    bgra[c < 3 ? 2 - c : 3] = record[color_offsets[c]];
+            std::memcpy(point + cloud.fields[j].offset, bgra, 4);
+        }
+    }
+
+    if (polygons)
+        return readFaces(*polygons);
+    return true;
+}
+
+bool FastPLYReader::readFaces(std::vector<pcl::Vertices>& polygons) const
+{
+    polygons.clear();
+    if (face_element < 0)
+        return true;
+
+    const Element& faces = elements[face_element];
+    int indices_property = -1;
+    for (std::size_t k = 0; k < faces.properties.size(); k++)
+        if (faces.properties[k].is_list && (faces.properties[k].name == "vertex_indices" || faces.properties[k].name == "vertex_index"))
+            indices_property = k;
+    if (indices_property < 0)
+    {
+        std::cerr << "Error: faces without vertex indices in " << filename << std::endl;
+        return false;
+    }
+
+    //-- Serial pass to find where the indices of each face are
+    std::vector<std::size_t> list_offsets(faces.count);
+    std::size_t position = faces.offset;
+    for (std::size_t i = 0; i < faces.count; i++)
+    {
+        std::size_t record_start = position;
+        for (int k = 0; k < indices_property; k++)
+        {
+            const Property& property = faces.properties[k];
+            if (!property.is_list)
+                position += property.type_size;
+            else
+                position += property.count_size + (std::size_t)readValue(mapped_data + position, property.count_datatype) * property.type_size;
+        }
+        list_offsets[i] = position;
+        position = skipRecord(faces, record_start);
+        if (position > mapped_size)
+        {
+            std::cerr << "Error: truncated PLY file " << filename << std::endl;
+            return false;
+        }
+    }
+
+    //-- Decode the indices in parallel
+    const Property& indices = faces.properties[indices_property];
+    polygons.resize(faces.count);
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < (int64_t)faces.count; i++)
+    {
+        const uint8_t* list = mapped_data + list_offsets[i];
+        std::size_t count = readValue(list, indices.count_datatype);
+        polygons[i].vertices.resize(count);
+        for (std::size_t j = 0; j < count; j++)
+            polygons[i].vertices[j] = readValue(list + indices.count_size + j * indices.type_size, indices.datatype);
+    }
+    return true;
+}
+
+bool FastPLYReader::readWithPCL(pcl::PCLPointCloud2& cloud, std::vector<pcl::Vertices>* polygons) const
+{
+    if (!polygons)
+        return pcl::io::loadPLYFile(filename, cloud) >= 0;
+
+    pcl::PolygonMesh mesh;
+    if (pcl::io::loadPLYFile(filename, mesh) < 0)
+        return false;
+    cloud = mesh.cloud;
+    polygons->swap(mesh.polygons);
+    return true;
+}
+
+bool FastPLYReader::parseType(const std::string& type_name, uint8_t& datatype, int& type_size)
+{
+    if (type_name == "char" || type_name == "int8") { datatype = pcl::PCLPointField::INT8; type_size = 1; }
+    else if (type_name == "uchar" || type_name == "uint8") { datatype = pcl::PCLPointField::UINT8; type_size = 1; }
+    else if (type_name == "short" || type_name == "int16") { datatype = pcl::PCLPointField::INT16; type_size = 2; }
+    else if (type_name == "ushort" || type_name == "uint16") { datatype = pcl::PCLPointField::UINT16; type_size = 2; }
+    else if (type_name == "int" || type_name == "int32") { datatype = pcl::PCLPointField::INT32; type_size = 4; }
+    else if (type_name == "uint" || type_name == "uint32") { datatype = pcl::PCLPointField::UINT32; type_size = 4; }
+    else if (type_name == "float" || type_name == "float32") { datatype = pcl::PCLPointField::FLOAT32; type_size = 4; }
+    else if (type_name == "double" || type_name == "float64") { datatype = pcl::PCLPointField::FLOAT64; type_size = 8; }
+    else return false;
+    return true;
+}
+
+double FastPLYReader::readValue(const uint8_t* data, uint8_t datatype)
+{
+    switch (datatype)
+    {
+        case pcl::PCLPointField::INT8: { int8_t value; std::memcpy(&value, data, 1); return value; }
+        case pcl::PCLPointField::UINT8: return *data;
+        case pcl::PCLPointField::INT16: { int16_t value; std::memcpy(&value, data, 2); return value; }
+        case pcl::PCLPointField::UINT16: { uint16_t value; std::memcpy(&value, data, 2); return value; }
+        case pcl::PCLPointField::INT32: { int32_t value; std::memcpy(&value, data, 4); return value; }
+        case pcl::PCLPointField::UINT32: { uint32_t value; std::memcpy(&value, data, 4); return value; }
+        case pcl::PCLPointField::FLOAT32: { float value; std::memcpy(&value, data, 4); return value; }
+        default: { double value; std::memcpy(&value, data, 8); return value; }
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * Fast PLY Reader
+ *
+ * Reader for the large binary little-endian .ply meshes exported by kinfu. The file is
+ * memory mapped and the vertex block (fixed size records) is split in chunks that are
+ * decoded in parallel into a PCLPointCloud2, with the same field names PCL uses (nx -> normal_x,
+ * red/green/blue[/alpha] -> rgb[a]...). Faces are only read if requested: their offsets are
+ * found with a quick serial pass over the list sizes and then they are decoded in parallel.
+ *
+ * Any other layout (ascii, big endian, lists in the vertices...) is read with the PCL reader.
+ *
+ */
+
+#ifndef FAST_PLY_READER_HPP
+#define FAST_PLY_READER_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PCLPointCloud2.h>
+#include <pcl/Vertices.h>
+#include <pcl/conversions.h>
+
+#include <iostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class FastPLYReader
+{
+    public:
+        FastPLYReader();
+        ~FastPLYReader();
+
+        //-- Map the file and parse its header
+        bool open(const std::string& filename);
+        void close();
+        bool isOpen() const { return mapped_data != NULL; }
+
+        //-- Whether the file can be decoded by this reader (otherwise PCL is used)
+        bool isSupported() const { return supported; }
+        std::size_t getVertexCount() const { return vertex_element >= 0 ? elements[vertex_element].count : 0; }
+        std::size_t getFaceCount() const { return face_element >= 0 ? elements[face_element].count : 0; }
+
+        //-- Vertices (and faces, if polygons is not NULL)
+        bool read(pcl::PCLPointCloud2& cloud, std::vector<pcl::Vertices>* polygons = NULL);
+
+        template<typename PointT>
+        bool read(pcl::PointCloud<PointT>& cloud, std::vector<pcl::Vertices>* polygons = NULL)
+        {
+            pcl::PCLPointCloud2 raw_cloud;
+            if (!read(raw_cloud, polygons))
+                return false;
+
+            pcl::fromPCLPointCloud2(raw_cloud, cloud);
+            return true;
+        }
+
+    private:
+        struct Property {
+            std::string name;
+            int type_size;
+            uint8_t datatype;
+            bool is_list;
+            int count_size;
+            uint8_t count_datatype;
+        };
+
+        struct Element {
+            std::string name;
+            std::size_t count;
+            std::vector<Property> properties;
+            std::size_t offset;     //-- Start of the element data in the file
+            int record_size;        //-- Bytes per item (-1 if it contains lists)
+        };
+
+        bool parseHeader();
+        bool findElementOffsets();
+        std::size_t skipRecord(const Element& element, std::size_t position) const;
+        bool readFaces(std::vector<pcl::Vertices>& polygons) const;
+        bool readWithPCL(pcl::PCLPointCloud2& cloud, std::vector<pcl::Vertices>* polygons) const;
+
+        static bool parseType(const std::string& type_name, uint8_t& datatype, int& type_size);
+        static double readValue(const uint8_t* data, uint8_t datatype);
+
+        //-- Not copyable (it owns the memory map)
+        FastPLYReader(const FastPLYReader&);
+        FastPLYReader& operator=(const FastPLYReader&);
+
+        std::string filename;
+        int file_descriptor;
+        uint8_t* mapped_data;
+        std::size_t mapped_size;
+        std::size_t data_offset;
+
+        bool supported;
+        std::vector<Element> elements;
+        int vertex_element;
+        int face_element;
+};
+
+#endif // FAST_PLY_READER_HPP
@@ -0,0 +1,325 @@
+#include "MMapPCDReader.hpp"
+
+#include <pcl/io/lzf.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MMapPCDReader::MMapPCDReader()
+{
+    file_descriptor = -1;
+    mapped_data = NULL;
+    mapped_size = 0;
+    close();
+}
+
+MMapPCDReader::~MMapPCDReader()
+{
+    close();
+}
+
+bool MMapPCDReader::open(const std::string& filename)
+{
+    close();
+    this->filename = filename;
+
+    file_descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (file_descriptor < 0)
+    {
+        std::cerr << "Error: could not open " << filename << std::endl;
+        return false;
+    }
+
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0 || file_status.st_size == 0)
+    {
+        std::cerr << "Error: could not read " << filename << std::endl;
+        close();
+        return false;
+    }
+
+    mapped_size = file_status.st_size;
+    void* data = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "Error: could not map " << filename << std::endl;
+        mapped_size = 0;
+        close();
+        return false;
+    }
+    mapped_data = static_cast<uint8_t*>(data);
+    madvise(mapped_data, mapped_size, MADV_SEQUENTIAL);
+
+    if (!parseHeader())
+    {
+        std::cerr << "Error: invalid PCD header in " << filename << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MMapPCDReader::close()
+{
+    if (mapped_data)
+        munmap(mapped_data, mapped_size);
+    if (file_descriptor >= 0)
+        ::close(file_descriptor);
+
+    file_descriptor = -1;
+    mapped_data = NULL;
+    mapped_size = 0;
+    data_offset = 0;
+    data_type = ASCII;
+    fields.clear();
+    width = height = point_step = 0;
+    sensor_origin = Eigen::Vector4f::Zero();
+    sensor_orientation = Eigen::Quaternionf::Identity();
+    decompressed_data.clear();
+    decompressed_offsets.clear();
+}
+
+bool MMapPCDReader::parseHeader()
+{
+    std::vector<std::string> names;
+    std::vector<int> sizes, counts;
+    std::vector<char> types;
+    std::size_t n_points = 0;
+
+    std::size_t position = 0;
+    while (position < mapped_size)
+    {
+        //-- Next line of the header
+        const uint8_t* line_end = static_cast<const uint8_t*>(memchr(mapped_data + position, '\n', mapped_size - position));
+        std::size_t next_position = line_end ? line_end - mapped_data + 1 : mapped_size;
+        std::istringstream line(std::string(reinterpret_cast<const char*>(mapped_data + position), next_position - position));
+        position = next_position;
+
+        std::string keyword;
+        if (!(line >> keyword) || keyword[0] == '#')
+            continue;
+
+        if (keyword == "FIELDS" || keyword == "COLUMNS")
+        {
+            std::string name;
+            while (line >> name) names.push_back(name);
+        }
+        else if (keyword == "SIZE")
+        {
+            int size;
+            while (line >> size) sizes.push_back(size);
+        }
+        else if (keyword == "TYPE")
+        {
+            char type;
+            while (line >> type) types.push_back(type);
+        }
+        else if (keyword == "COUNT")
+        {
+            int count;
+            while (line >> count) counts.push_back(count);
+        }
+        else if (keyword == "WIDTH")
+            line >> width;
+        else if (keyword == "HEIGHT")
+            line >> height;
+        else if (keyword == "POINTS")
+            line >> n_points;
+        else if (keyword == "VIEWPOINT")
+        {
+            float tx, ty, tz, qw, qx, qy, qz;
+            if (line >> tx >> ty >> tz >> qw >> qx >> qy >> qz)
+            {
+                sensor_origin = Eigen::Vector4f(tx, ty, tz, 0);
+                sensor_orientation = Eigen::Quaternionf(qw, qx, qy, qz);
+            }
+        }
+        else if (keyword == "DATA")
+        {
+            std::string type;
+            line >> type;
+            if (type == "ascii") data_type = ASCII;
+            else if (type == "binary") data_type = BINARY;
+            else if (type == "binary_compressed") data_type = BINARY_COMPRESSED;
+            else return false;
+
+            data_offset = position;
+            break;
+        }
+    }
+
+    if (counts.empty())
+        counts.assign(names.size(), 1);
+    if (names.empty() || sizes.size() != names.size() || types.size() != names.size() || counts.size() != names.size())
+        return false;
+    if (height == 0)
+        height = 1;
+    if (width == 0 || (std::size_t)width * height != n_points)
+    {
+        width = n_points;
+        height = 1;
+    }
+
+    //-- Fields are packed in binary files
+    point_step = 0;
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        pcl::PCLPointField field;
+        field.name = names[i];
+        field.offset = point_step;
+        field.count = counts[i];
+        switch (types[i])
+        {
+            case 'I': field.datatype = sizes[i] == 1 ? pcl::PCLPointField::INT8 : sizes[i] == 2 ? pcl::PCLPointField::INT16 : pcl::PCLPointField::INT32; break;
+            case 'U': field.datatype = sizes[i] == 1 ? pcl::PCLPointField::UINT8 : sizes[i] == 2 ? pcl::PCLPointField::UINT16 : pcl::PCLPointField::UINT32; break;
+            case 'F': field.datatype = sizes[i] == 8 ? pcl::PCLPointField::FLOAT64 : pcl::PCLPointField::FLOAT32; break;
+            default: return false;
+        }
+        if ((int)getFieldSize(field) != sizes[i] * counts[i])
+            return false;
+
+        fields.push_back(field);
+        point_step += getFieldSize(field);
+    }
+
+    if (data_type == BINARY && data_offset + size() * point_step > mapped_size)
+        return false;
+    return data_offset > 0;
+}
+
+bool MMapPCDReader::decompress()
+{
+    if (!decompressed_data.empty() || size() == 0)
+        return true;
+
+    if (data_offset + 2 * sizeof(uint32_t) > mapped_size)
+        return false;
+
+    uint32_t compressed_size, uncompressed_size;
+    std::memcpy(&compressed_size, mapped_data + data_offset, sizeof(uint32_t));
+    std::memcpy(&uncompressed_size, mapped_data + data_offset + sizeof(uint32_t), sizeof(uint32_t));
+    if (uncompressed_size != size() * point_step || data_offset + 2 * sizeof(uint32_t) + compressed_size > mapped_size)
+    {
+        std::cerr << "Error: corrupted compressed data in " << filename << std::endl;
+        return false;
+    }
+
+    decompressed_data.resize(uncompressed_size);
+    unsigned int result = pcl::lzfDecompress(mapped_data + data_offset + 2 * sizeof(uint32_t), compressed_size,
+                                             &decompressed_data[0], uncompressed_size);
+    if (result != uncompressed_size)
+    {
+        std::cerr << "Error: could not decompress " << filename << std::endl;
+        decompressed_data.clear();
+        return false;
+    }
+
+    //-- All the values of the first field go first, then all the values of the second...
+    decompressed_offsets.resize(fields.size());
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < fields.size(); i++)
+    {
+        decompressed_offsets[i] = offset;
+        offset += getFieldSize(fields[i]) * size();
+    }
+    return true;
+}
+
+const uint8_t* MMapPCDReader::getFieldData(const std::string& field_name, std::size_t& stride)
+{
+    int field = findField(field_name);
+    if (field < 0 || size() == 0)
+        return NULL;
+
+    if (data_type == BINARY)
+    {
+        stride = point_step;
+        return mapped_data + data_offset + fields[field].offset;
+    }
+
+    if (data_type == BINARY_COMPRESSED && decompress())
+    {
+        stride = getFieldSize(fields[field]);
+        return &decompressed_data[decompressed_offsets[field]];
+    }
+
+    return NULL;
+}
+
+bool MMapPCDReader::read(pcl::PCLPointCloud2& cloud)
+{
+    if (!isOpen())
+    {
+        std::cerr << "Error: no PCD file open" << std::endl;
+        return false;
+    }
+
+    if (data_type == ASCII)
+        return pcl::io::loadPCDFile(filename, cloud) >= 0;
+
+    cloud.fields = fields;
+    cloud.width = width;
+    cloud.height = height;
+    cloud.point_step = point_step;
+    cloud.row_step = point_step * width;
+    cloud.is_bigendian = false;
+    cloud.is_dense = false;
+    cloud.data.resize(size() * point_step);
+    if (cloud.data.empty())
+        return true;
+
+    if (data_type == BINARY)
+    {
+        std::memcpy(&cloud.data[0], mapped_data + data_offset, cloud.data.size());
+        return true;
+    }
+
+    //-- Interleave the fields of the points
+    if (!decompress())
+        return false;
+
+    for (std::size_t j = 0; j < fields.size(); j++)
+    {
+        std::size_t field_size = getFieldSize(fields[j]);
+        const uint8_t* source = &decompressed_data[decompressed_offsets[j]];
+        uint8_t* destination = &cloud.data[fields[j].offset];
+
+        #pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < (int64_t)size(); i++)
+            std::memcpy(destination + i * point_step, source + i * field_size, field_size);
+    }
+    return true;
+}
+
+int MMapPCDReader::findField(const std::string& field_name) const
+{
+    for (std::size_t i = 0; i < fields.size(); i++)
+        if (fields[i].name == field_name)
+            return i;
+    return -1;
+}
+
+std::size_t MMapPCDReader::getFieldSize(const pcl::PCLPointField& field)
+{
+    std::size_t count = field.count > 0 ? field.count : 1;
+    switch (field.datatype)
+    {
+        case pcl::PCLPointField::INT8: case pcl::PCLPointField::UINT8: return count;
+        case pcl::PCLPointField::INT16: case pcl::PCLPointField::UINT16: return 2 * count;
+        case pcl::PCLPointField::FLOAT64: return 8 * count;
+        default: return 4 * count;
+    }
+}
+
+char MMapPCDReader::getTypeCharacter(uint8_t datatype)
+{
+    switch (datatype)
+    {
+        case pcl::PCLPointField::INT8: case pcl::PCLPointField::INT16: case pcl::PCLPointField::INT32: return 'I';
+        case pcl::PCLPointField::UINT8: case pcl::PCLPointField::UINT16: case pcl::PCLPointField::UINT32: return 'U';
+        default: return 'F';
+    }
+}
@@ -0,0 +1,280 @@
+/*
+ * MMap PCD Reader
+ *
+ * Reads binary and binary_compressed .pcd files through a memory map of the file, instead
+ * of reading them into freshly allocated buffers:
+ *  - binary: the points are used in place. getFieldData() returns pointers into the map,
+ *    and getPoints<PointT>() returns the points themselves if the file has the same memory
+ *    layout as PointT (see writeMappable()). Both stay valid while the reader is open.
+ *  - binary_compressed: the data is decompressed once (LZF streams can only be decompressed
+ *    serially), and then its fields are scattered in parallel into the output cloud.
+ *
+ * ascii files are read with pcl::io::loadPCDFile.
+ *
+ */
+
+#ifndef MMAP_PCD_READER_HPP
+#define MMAP_PCD_READER_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PCLPointCloud2.h>
+#include <pcl/common/io.h>
+#include <pcl/io/pcd_io.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class MMapPCDReader
+{
+    public:
+        enum DataType { ASCII, BINARY, BINARY_COMPRESSED };
+
+        MMapPCDReader();
+        ~MMapPCDReader();
+
+        //-- Map the file and parse its header
+        bool open(const std::string& filename);
+        void close();
+        bool isOpen() const { return mapped_data != NULL; }
+
+        DataType getDataType() const { return data_type; }
+        const std::vector<pcl::PCLPointField>& getFields() const { return fields; }
+        uint32_t getWidth() const { return width; }
+        uint32_t getHeight() const { return height; }
+        std::size_t size() const { return (std::size_t)width * height; }
+        uint32_t getPointStep() const { return point_step; }
+        const Eigen::Vector4f& getSensorOrigin() const { return sensor_origin; }
+        const Eigen::Quaternionf& getSensorOrientation() const { return sensor_orientation; }
+
+        //-- Data of a field: the value of the i-th point starts at data + i*stride (NULL if
+        //-- the field does not exist or the file is ascii). Compressed data is decompressed
+        //-- the first time it is needed
+        const uint8_t* getFieldData(const std::string& field_name, std::size_t& stride);
+
+        //-- Points of the file in place, without any copy (NULL if the file is not binary or
+        //-- its layout does not match the one of PointT)
+        template<typename PointT>
+        const PointT* getPoints() const
+        {
+            if (data_type != BINARY || point_step != sizeof(PointT))
+                return NULL;
+
+            const uint8_t* points = mapped_data + data_offset;
+            if (reinterpret_cast<uintptr_t>(points) % 16 != 0)
+                return NULL;
+
+            std::vector<pcl::PCLPointField> point_fields;
+            pcl::getFields<PointT>(point_fields);
+            for (std::size_t i = 0; i < point_fields.size(); i++)
+            {
+                if (point_fields[i].name == "_")
+                    continue;
+
+                int field = findField(point_fields[i].name);
+                if (field < 0 || fields[field].offset != point_fields[i].offset ||
+                        getFieldSize(fields[field]) != getFieldSize(point_fields[i]))
+                    return NULL;
+            }
+
+            return reinterpret_cast<const PointT*>(points);
+        }
+
+        //-- Untyped cloud with all the fields of the file
+        bool read(pcl::PCLPointCloud2& cloud);
+
+        //-- Typed cloud (fields missing in the file are left with their default values)
+        template<typename PointT>
+        bool read(pcl::PointCloud<PointT>& cloud)
+        {
+            if (!isOpen())
+            {
+                std::cerr << "Error: no PCD file open" << std::endl;
+                return false;
+            }
+
+            if (data_type == ASCII)
+                return pcl::io::loadPCDFile(filename, cloud) >= 0;
+
+            cloud.points.resize(size());
+            cloud.width = width;
+            cloud.height = height;
+            cloud.sensor_origin_ = sensor_origin;
+            cloud.sensor_orientation_ = sensor_orientation;
+            if (cloud.points.empty())
+            {
+                cloud.is_dense = true;
+                return true;
+            }
+
+            //-- Same layout: a single copy of the whole block
+            const PointT* points = getPoints<PointT>();
+            if (points)
+            {
+                std::memcpy(&cloud.points[0], points, size() * sizeof(PointT));
+                cloud.is_dense = isDense(cloud);
+                return true;
+            }
+
+            //-- Otherwise, copy field by field
+            std::vector<FieldCopy> copies;
+            std::vector<pcl::PCLPointField> point_fields;
+            pcl::getFields<PointT>(point_fields);
+            for (std::size_t i = 0; i < point_fields.size(); i++)
+            {
+                if (point_fields[i].name == "_")
+                    continue;
+
+                FieldCopy copy;
+                int field = findField(point_fields[i].name);
+                //-- rgb and rgba are stored the same way
+                if (field < 0 && point_fields[i].name == "rgb") field = findField("rgba");
+                if (field < 0 && point_fields[i].name == "rgba") field = findField("rgb");
+                if (field < 0 || getFieldSize(fields[field]) != getFieldSize(point_fields[i]))
+                    continue;
+
+                copy.source = getFieldData(fields[field].name, copy.stride);
+                if (!copy.source)
+                    return false;
+                copy.offset = point_fields[i].offset;
+                copy.size = getFieldSize(point_fields[i]);
+                copies.push_back(copy);
+            }
+
+            uint8_t* output = reinterpret_cast<uint8_t*>(&cloud.points[0]);
+            #pragma omp parallel for schedule(static)
+            for (int64_t i = 0; i < (int64_t)size(); i++)
+                for (std::size_t j = 0; j < copies.size(); j++)
+                    std::memcpy(output + i * sizeof(PointT) + copies[j].offset, copies[j].source + i * copies[j].stride, copies[j].size);
+
+            cloud.is_dense = isDense(cloud);
+            return true;
+        }
+
+        //-- Write a binary .pcd with the memory layout of PointT (padding included), that can be
+        //-- read back without copies
+        template<typename PointT>
+        static bool writeMappable(const std::string& filename, const pcl::PointCloud<PointT>& cloud)
+        {
+            std::vector<pcl::PCLPointField> point_fields;
+            pcl::getFields<PointT>(point_fields);
+            std::sort(point_fields.begin(), point_fields.end(), CompareOffset());
+
+            //-- Padding bytes are stored as "_" fields
+            std::ostringstream names, sizes, types, counts;
+            uint32_t offset = 0;
+            for (std::size_t i = 0; i <= point_fields.size(); i++)
+            {
+                uint32_t next_offset = i < point_fields.size() ? point_fields[i].offset : sizeof(PointT);
+                if (next_offset > offset)
+                {
+                    names << " _"; sizes << " 1"; types << " U"; counts << " " << next_offset - offset;
+                }
+                if (i == point_fields.size())
+                    break;
+
+                names << " " << point_fields[i].name;
+                sizes << " " << getFieldSize(point_fields[i]) / point_fields[i].count;
+                types << " " << getTypeCharacter(point_fields[i].datatype);
+                counts << " " << point_fields[i].count;
+                offset = point_fields[i].offset + getFieldSize(point_fields[i]);
+            }
+
+            std::ostringstream header;
+            header << "VERSION 0.7\n"
+                   << "FIELDS" << names.str() << "\n"
+                   << "SIZE" << sizes.str() << "\n"
+                   << "TYPE" << types.str() << "\n"
+                   << "COUNT" << counts.str() << "\n"
+                   << "WIDTH " << cloud.width << "\n"
+                   << "HEIGHT " << cloud.height << "\n"
+                   << "VIEWPOINT " << cloud.sensor_origin_[0] << " " << cloud.sensor_origin_[1] << " " << cloud.sensor_origin_[2] << " "
+                   << cloud.sensor_orientation_.w() << " " << cloud.sensor_orientation_.x() << " "
+                   << cloud.sensor_orientation_.y() << " " << cloud.sensor_orientation_.z() << "\n"
+                   << "POINTS " << cloud.points.size() << "\n"
+                   << "DATA binary\n";
+
+            //-- A comment line pads the header so that the points start 16-byte aligned
+            std::string comment = "# .PCD v0.7 - Point Cloud Data file format";
+            std::size_t header_size = comment.size() + 1 + header.str().size();
+            comment.append((16 - header_size % 16) % 16, ' ');
+
+            std::ofstream file(filename.c_str(), std::ios::binary);
+            if (!file.is_open())
+            {
+                std::cerr << "Error: could not open " << filename << std::endl;
+                return false;
+            }
+
+            file << comment << "\n" << header.str();
+            if (!cloud.points.empty())
+                file.write(reinterpret_cast<const char*>(&cloud.points[0]), cloud.points.size() * sizeof(PointT));
+            return file.good();
+        }
+
+    private:
+        struct FieldCopy {
+            const uint8_t* source;
+            std::size_t stride;
+            std::size_t offset;
+            std::size_t size;
+        };
+
+        struct CompareOffset {
+            bool operator()(const pcl::PCLPointField& a, const pcl::PCLPointField& b) const { return a.offset < b.offset; }
+        };
+
+        bool parseHeader();
+        bool decompress();
+        int findField(const std::string& field_name) const;
+
+        static std::size_t getFieldSize(const pcl::PCLPointField& field);
+        static char getTypeCharacter(uint8_t datatype);
+
+        template<typename PointT>
+        static bool isDense(const pcl::PointCloud<PointT>& cloud)
+        {
+            std::vector<pcl::PCLPointField> point_fields;
+            pcl::getFields<PointT>(point_fields);
+            if (point_fields.empty() || point_fields[0].name != "x")
+                return true;
+
+            for (std::size_t i = 0; i < cloud.points.size(); i++)
+            {
+                const float* xyz = reinterpret_cast<const float*>(&cloud.points[i]);
+                if (!std::isfinite(xyz[0]) || !std::isfinite(xyz[1]) || !std::isfinite(xyz[2]))
+                    return false;
+            }
+            return true;
+        }
+
+        //-- Not copyable (it owns the memory map)
+        MMapPCDReader(const MMapPCDReader&);
+        MMapPCDReader& operator=(const MMapPCDReader&);
+
+        std::string filename;
+        int file_descriptor;
+        uint8_t* mapped_data;
+        std::size_t mapped_size;
+        std::size_t data_offset;
+
+        DataType data_type;
+        std::vector<pcl::PCLPointField> fields;
+        uint32_t width, height;
+        uint32_t point_step;
+        Eigen::Vector4f sensor_origin;
+        Eigen::Quaternionf sensor_orientation;
+
+        //-- Decompressed data, stored field after field
+        std::vector<uint8_t> decompressed_data;
+        std::vector<std::size_t> decompressed_offsets;
+};
+
+#endif // MMAP_PCD_READER_HPP
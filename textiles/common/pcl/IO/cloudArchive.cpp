@@ -0,0 +1,171 @@
+/*
+ * cloudArchive
+ * --------------------------------------
+ *
+ * Packs point clouds into compressed archives (.tca) and
+ * extracts regions / levels of detail from them
+ *
+ */
+
+#include <iostream>
+#include <limits>
+#include <pcl/console/parse.h>
+#include <pcl/point_types.h>
+
+#include "CloudLoader.hpp"
+#include "CloudArchive.hpp"
+#include "MMapPCDReader.hpp"
+
+void show_usage(char * program_name)
+{
+    std::cout << std::endl;
+    std::cout << "Usage: " << program_name << " cloud_filename.[pcd|ply] archive.tca" << std::endl;
+    std::cout << "       " << program_name << " archive.tca output.pcd" << std::endl;
+    std::cout << "       " << program_name << " archive.tca" << std::endl;
+    std::cout << "-h:  Show this help." << std::endl;
+    std::cout << "Packing:" << std::endl;
+    std::cout << "--step: Quantization step (default: 0.0005)" << std::endl;
+    std::cout << "--chunk-size: Side of the chunks (default: 0.25)" << std::endl;
+    std::cout << "--levels: Levels of detail (default: 3)" << std::endl;
+    std::cout << "--leaf-size: Leaf size of the coarsest level of detail (default: 0.02)" << std::endl;
+    std::cout << "Extracting (without output file, only the archive information is shown):" << std::endl;
+    std::cout << "--level: Level of detail to extract, starting from 0 (default: all points)" << std::endl;
+    std::cout << "--box: Extract only the points inside a box: min_x,min_y,min_z,max_x,max_y,max_z" << std::endl;
+}
+
+int main (int argc, char** argv)
+{
+    //-- Command-line arguments
+    float quantization_step = 0.0005;
+    float chunk_size = 0.25;
+    int levels = 3;
+    float leaf_size = 0.02;
+    int level = -1;
+    std::vector<double> box;
+
+    //-- Show usage
+    if (pcl::console::find_switch(argc, argv, "-h") || pcl::console::find_switch(argc, argv, "--help"))
+    {
+        show_usage(argv[0]);
+        return 0;
+    }
+
+    if (pcl::console::find_switch(argc, argv, "--step"))
+        pcl::console::parse_argument(argc, argv, "--step", quantization_step);
+    if (pcl::console::find_switch(argc, argv, "--chunk-size"))
+        pcl::console::parse_argument(argc, argv, "--chunk-size", chunk_size);
+    if (pcl::console::find_switch(argc, argv, "--levels"))
+        pcl::console::parse_argument(argc, argv, "--levels", levels);
+    if (pcl::console::find_switch(argc, argv, "--leaf-size"))
+        pcl::console::parse_argument(argc, argv, "--leaf-size", leaf_size);
+    if (pcl::console::find_switch(argc, argv, "--level"))
+        pcl::console::parse_argument(argc, argv, "--level", level);
+    if (pcl::console::find_switch(argc, argv, "--box"))
+    {
+        pcl::console::parse_x_arguments(argc, argv, "--box", box);
+        if (box.size() != 6)
+        {
+            std::cerr << "Box has to be specified as min_x,min_y,min_z,max_x,max_y,max_z" << std::endl;
+            show_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    std::vector<int> archive_filenames = pcl::console::parse_file_extension_argument(argc, argv, ".tca");
+    std::vector<int> pcd_filenames = pcl::console::parse_file_extension_argument(argc, argv, ".pcd");
+    std::vector<int> ply_filenames = pcl::console::parse_file_extension_argument(argc, argv, ".ply");
+    if (archive_filenames.size() != 1 || pcd_filenames.size() + ply_filenames.size() > 1)
+    {
+        show_usage(argv[0]);
+        return -1;
+    }
+    std::string archive_filename = argv[archive_filenames[0]];
+
+    //-- Pack a cloud (the input file comes before the archive)
+    int cloud_argument = !pcd_filenames.empty() ? pcd_filenames[0] : !ply_filenames.empty() ? ply_filenames[0] : -1;
+    if (cloud_argument >= 0 && cloud_argument < archive_filenames[0])
+    {
+        CloudLoader cloud_loader;
+        if (!cloud_loader.load(argv[cloud_argument]))
+        {
+            std::cout << "Error loading point cloud " << argv[cloud_argument] << std::endl << std::endl;
+            show_usage(argv[0]);
+            return -1;
+        }
+
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_color;
+        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+        if (cloud_loader.hasColor())
+            cloud_color = cloud_loader.getCloud<pcl::PointXYZRGB>();
+        else
+            cloud = cloud_loader.getCloud<pcl::PointXYZ>();
+        if (!cloud_color && !cloud)
+        {
+            std::cout << "Error reading point cloud " << argv[cloud_argument] << std::endl << std::endl;
+            show_usage(argv[0]);
+            return -1;
+        }
+
+        CloudArchive archive;
+        archive.setQuantizationStep(quantization_step);
+        archive.setChunkSize(chunk_size);
+        archive.setLevels(levels);
+        archive.setCoarsestLeafSize(leaf_size);
+        bool written = cloud_color ? archive.write(archive_filename, *cloud_color) : archive.write(archive_filename, *cloud);
+        if (!written)
+            return -2;
+
+        std::cout << "Archived " << archive.getPointCount() << " points in " << archive.getChunkCount() << " chunks" << std::endl;
+        return 0;
+    }
+
+    //-- Archive information
+    CloudArchive archive;
+    if (!archive.open(archive_filename))
+        return -1;
+
+    Eigen::Vector3f min_bb, max_bb;
+    archive.getBoundingBox(min_bb, max_bb);
+    std::cout << "Archive: " << archive_filename << std::endl
+              << "\tPoints: " << archive.getPointCount() << (archive.hasColor() ? " (with color)" : "") << std::endl
+              << "\tChunks: " << archive.getChunkCount() << " (size: " << archive.getChunkSize() << ")" << std::endl
+              << "\tQuantization step: " << archive.getQuantizationStep() << std::endl
+              << "\tBounding box: [" << min_bb.transpose() << "] - [" << max_bb.transpose() << "]" << std::endl;
+    for (int l = 0; l < archive.getLevels(); l++)
+        std::cout << "\tLevel " << l << ": " << archive.getPointCount(l) << " points" << std::endl;
+
+    if (cloud_argument < 0)
+        return 0;
+
+    if (!CloudLoader::isPCD(argv[cloud_argument]))
+    {
+        std::cerr << "Extracted points can only be saved as .pcd" << std::endl;
+        return -1;
+    }
+
+    //-- Extract points (saved with the layout of the point type, so they load without copies)
+    if (box.empty())
+    {
+        box.assign(3, -std::numeric_limits<float>::max());
+        box.resize(6, std::numeric_limits<float>::max());
+    }
+    Eigen::Vector3f box_min(box[0], box[1], box[2]), box_max(box[3], box[4], box[5]);
+
+    bool extracted;
+    if (archive.hasColor())
+    {
+        pcl::PointCloud<pcl::PointXYZRGB> cloud;
+        extracted = archive.readRegion(box_min, box_max, cloud, level) &&
+                    MMapPCDReader::writeMappable(argv[cloud_argument], cloud);
+        std::cout << "Extracted " << cloud.points.size() << " points" << std::endl;
+    }
+    else
+    {
+        pcl::PointCloud<pcl::PointXYZ> cloud;
+        extracted = archive.readRegion(box_min, box_max, cloud, level) &&
+                    MMapPCDReader::writeMappable(argv[cloud_argument], cloud);
+        std::cout << "Extracted " << cloud.points.size() << " points" << std::endl;
+    }
+
+    return extracted ? 0 : -2;
+}
@@ -0,0 +1,542 @@
+/*
+ * Cloud Stages
+ *
+ * Pipeline stages for the steps shared by most of the perception programs:
+ *  - LoadCloudStage: reads a .pcd/.ply file (no inputs)
+ *  - VoxelGridStage: downsamples a cloud (input: cloud)
+ *  - MortonReorderingStage: sorts a cloud along a Z-order curve, ahead of the stages that
+ *    process neighborhoods (input: cloud)
+ *  - PlaneRemovalStage: removes all the planes of a cloud, returning the indices of the
+ *    points that do not belong to any plane (input: cloud)
+ *  - EuclideanClusteringStage: clusters a cloud, sorted from largest to smallest
+ *    (inputs: cloud and, optionally, the indices to be clustered)
+ *  - OrientedBoundingBoxStage: oriented bounding box of a cloud (input: cloud)
+ *  - TransformStage: applies a rigid transform to a cloud, either a fixed one or the one that
+ *    takes it to the frame of a bounding box (inputs: cloud and, optionally, the box)
+ *  - HistogramImageStage: rasterizes a cloud into an image with the count of points of each
+ *    bin (input: cloud)
+ *
+ * Clouds are passed between stages as ConstPtr, since results are shared through the cache.
+ *
+ */
+
+#ifndef CLOUD_STAGES_HPP
+#define CLOUD_STAGES_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/segmentation/extract_clusters.h>
+#include <pcl/features/moment_of_inertia_estimation.h>
+#include <pcl/common/transforms.h>
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "PipelineStage.hpp"
+#include "CloudLoader.hpp"
+#include "VoxelGridDownsampler.hpp"
+#include "MortonReordering.hpp"
+#include "MultiPlaneSegmentation.hpp"
+#include "SpatialHashSearch.hpp"
+#include "HistogramImageCreator.hpp"
+
+//-- Common code to read and write clouds in the disk cache
+template<typename PointT>
+class CloudStage : public PipelineStage
+{
+    protected:
+        typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+        virtual bool saveResult(const boost::any& result, const std::string& filename) const
+        {
+            PointCloudConstPtr cloud = boost::any_cast<PointCloudConstPtr>(result);
+            if (pcl::io::savePCDFileBinary(filename + ".pcd.tmp", *cloud) < 0)
+            {
+                std::remove((filename + ".pcd.tmp").c_str());
+                return false;
+            }
+            return replaceFile(filename + ".pcd.tmp", filename + ".pcd");
+        }
+
+        virtual bool loadResult(const std::string& filename, boost::any& result) const
+        {
+            if (!std::ifstream((filename + ".pcd").c_str()).good())
+                return false;
+
+            typename pcl::PointCloud<PointT>::Ptr cloud(new pcl::PointCloud<PointT>);
+            if (pcl::io::loadPCDFile(filename + ".pcd", *cloud) < 0)
+                return false;
+            result = PointCloudConstPtr(cloud);
+            return true;
+        }
+};
+
+template<typename PointT>
+class LoadCloudStage : public CloudStage<PointT>
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        LoadCloudStage(const std::string& filename) : filename(filename) {}
+
+        virtual std::string getType() const { return "LoadCloud"; }
+        virtual std::string getParameters() const { return filename; }
+
+        //-- The cache is invalidated whenever the file changes (the nanoseconds of the modification
+        //-- time catch rewrites within the same second that keep the size)
+        virtual std::string getSourceKey() const
+        {
+            struct stat file_status;
+            if (stat(filename.c_str(), &file_status) != 0)
+                return "missing";
+
+            std::ostringstream key;
+            key << file_status.st_mtime << "." << std::setfill('0') << std::setw(9) << file_status.st_mtim.tv_nsec
+                << " " << file_status.st_size;
+            return key.str();
+        }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            CloudLoader cloud_loader;
+            if (!cloud_loader.load(filename))
+                return false;
+
+            PointCloudConstPtr cloud = cloud_loader.getCloud<PointT>();
+            if (!cloud)
+            {
+                std::cerr << "Error reading point cloud " << filename << std::endl;
+                return false;
+            }
+
+            output = cloud;
+            return true;
+        }
+
+        //-- The file is already on disk, there is no point in caching it
+        virtual bool saveResult(const boost::any& result, const std::string& filename) const { return false; }
+        virtual bool loadResult(const std::string& filename, boost::any& result) const { return false; }
+
+    private:
+        std::string filename;
+};
+
+template<typename PointT>
+class VoxelGridStage : public CloudStage<PointT>
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename VoxelGridDownsampler<PointT>::ReductionMode ReductionMode;
+
+    public:
+        VoxelGridStage(float leaf_size, ReductionMode reduction_mode = VoxelGridDownsampler<PointT>::CENTROID)
+            : leaf_size(leaf_size), reduction_mode(reduction_mode) {}
+
+        virtual std::string getType() const { return "VoxelGrid"; }
+        virtual std::string getParameters() const
+        {
+            std::ostringstream parameters;
+            parameters << std::setprecision(9) << leaf_size << " " << (int)reduction_mode;
+            return parameters.str();
+        }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            typename pcl::PointCloud<PointT>::Ptr cloud_filtered(new pcl::PointCloud<PointT>);
+            VoxelGridDownsampler<PointT> voxel_grid;
+            voxel_grid.setInputCloud(boost::any_cast<PointCloudConstPtr>(inputs[0]));
+            voxel_grid.setLeafSize(leaf_size);
+            voxel_grid.setReductionMode(reduction_mode);
+            if (!voxel_grid.filter(*cloud_filtered))
+                return false;
+
+            std::cout << "PointCloud after filtering has: " << cloud_filtered->points.size ()  << " data points." << std::endl;
+            output = PointCloudConstPtr(cloud_filtered);
+            return true;
+        }
+
+    private:
+        float leaf_size;
+        ReductionMode reduction_mode;
+};
+
+template<typename PointT>
+class MortonReorderingStage : public CloudStage<PointT>
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        virtual std::string getType() const { return "MortonReordering"; }
+        virtual std::string getParameters() const { return ""; }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            typename pcl::PointCloud<PointT>::Ptr cloud_reordered(new pcl::PointCloud<PointT>);
+            MortonReordering<PointT> morton_reordering;
+            morton_reordering.setInputCloud(boost::any_cast<PointCloudConstPtr>(inputs[0]));
+            if (!morton_reordering.filter(*cloud_reordered))
+                return false;
+
+            output = PointCloudConstPtr(cloud_reordered);
+            return true;
+        }
+};
+
+template<typename PointT>
+class PlaneRemovalStage : public PipelineStage
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        PlaneRemovalStage(float distance_threshold, float remaining_points_ratio = 0.3, int candidate_regions = 1)
+            : distance_threshold(distance_threshold), remaining_points_ratio(remaining_points_ratio),
+              candidate_regions(candidate_regions), input_size(0) {}
+
+        virtual std::string getType() const { return "PlaneRemoval"; }
+        virtual std::string getParameters() const
+        {
+            std::ostringstream parameters;
+            parameters << std::setprecision(9) << distance_threshold << " " << remaining_points_ratio << " " << candidate_regions;
+            return parameters.str();
+        }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            std::vector<pcl::ModelCoefficients> planes;
+            std::vector<pcl::PointIndices> planes_inliers;
+            MultiPlaneSegmentation<PointT> multi_plane_segmentation;
+            PointCloudConstPtr cloud = boost::any_cast<PointCloudConstPtr>(inputs[0]);
+            input_size = cloud->points.size();
+            multi_plane_segmentation.setInputCloud(cloud);
+            multi_plane_segmentation.setDistanceThreshold(distance_threshold);
+            multi_plane_segmentation.setRemainingPointsRatio(remaining_points_ratio);
+            multi_plane_segmentation.setCandidateRegions(candidate_regions);
+            if (!multi_plane_segmentation.segment(planes, planes_inliers))
+                std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
+
+            for (int i = 0; i < planes_inliers.size(); i++)
+                std::cout << "PointCloud representing the planar component: " << planes_inliers[i].indices.size() << " data points." << std::endl;
+
+            output = pcl::IndicesConstPtr(multi_plane_segmentation.getRemainingIndices());
+            return true;
+        }
+
+        virtual bool saveResult(const boost::any& result, const std::string& filename) const
+        {
+            return saveIndices(*boost::any_cast<pcl::IndicesConstPtr>(result), input_size, filename + ".txt");
+        }
+
+        virtual bool loadResult(const std::string& filename, boost::any& result) const
+        {
+            pcl::IndicesPtr indices(new std::vector<int>);
+            if (!loadIndices(filename + ".txt", *indices))
+                return false;
+            result = pcl::IndicesConstPtr(indices);
+            return true;
+        }
+
+    private:
+        float distance_threshold;
+        float remaining_points_ratio;
+        int candidate_regions;
+        //-- Size of the cloud the result indexes into, checked when the result is read back
+        int input_size;
+};
+
+template<typename PointT>
+class EuclideanClusteringStage : public PipelineStage
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        EuclideanClusteringStage(float cluster_tolerance, int min_size, int max_size)
+            : cluster_tolerance(cluster_tolerance), min_size(min_size), max_size(max_size), input_size(0) {}
+
+        virtual std::string getType() const { return "EuclideanClustering"; }
+        virtual std::string getParameters() const
+        {
+            std::ostringstream parameters;
+            parameters << std::setprecision(9) << cluster_tolerance << " " << min_size << " " << max_size;
+            return parameters.str();
+        }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            PointCloudConstPtr cloud = boost::any_cast<PointCloudConstPtr>(inputs[0]);
+            input_size = cloud->points.size();
+
+            //-- Hash grid with cells of the tolerance for the search method of the extraction
+            typename SpatialHashSearch<PointT>::Ptr tree(new SpatialHashSearch<PointT>(cluster_tolerance));
+            std::vector<pcl::PointIndices> cluster_indices;
+            pcl::EuclideanClusterExtraction<PointT> ec;
+            ec.setClusterTolerance(cluster_tolerance);
+            ec.setMinClusterSize(min_size);
+            ec.setMaxClusterSize(max_size);
+            ec.setSearchMethod(tree);
+            ec.setInputCloud(cloud);
+            if (inputs.size() > 1)
+                ec.setIndices(boost::any_cast<pcl::IndicesConstPtr>(inputs[1]));
+            ec.extract(cluster_indices);
+
+            output = cluster_indices;
+            return true;
+        }
+
+        virtual bool saveResult(const boost::any& result, const std::string& filename) const
+        {
+            return saveClusters(boost::any_cast<std::vector<pcl::PointIndices> >(result), input_size, filename + ".txt");
+        }
+
+        virtual bool loadResult(const std::string& filename, boost::any& result) const
+        {
+            std::vector<pcl::PointIndices> cluster_indices;
+            if (!loadClusters(filename + ".txt", cluster_indices))
+                return false;
+            result = cluster_indices;
+            return true;
+        }
+
+    private:
+        float cluster_tolerance;
+        int min_size;
+        int max_size;
+        int input_size;
+};
+
+//-- Result of OrientedBoundingBoxStage. The corners are given in the frame of the box
+struct OrientedBoundingBox
+{
+    Eigen::Vector3f min_point;
+    Eigen::Vector3f max_point;
+    Eigen::Vector3f position;
+    Eigen::Matrix3f rotation;
+
+    //-- Takes the points to the frame of the box (centered on it and aligned with its axes)
+    Eigen::Affine3f getBoxTransform() const
+    {
+        Eigen::Affine3f transform = Eigen::Affine3f::Identity();
+        transform.linear() = rotation.transpose();
+        transform.translation() = -(rotation.transpose() * position);
+        return transform;
+    }
+};
+
+template<typename PointT>
+class OrientedBoundingBoxStage : public PipelineStage
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        virtual std::string getType() const { return "OrientedBoundingBox"; }
+        virtual std::string getParameters() const { return ""; }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            PointCloudConstPtr cloud = boost::any_cast<PointCloudConstPtr>(inputs[0]);
+            if (cloud->points.empty())
+            {
+                std::cerr << "Error: no points to compute the bounding box" << std::endl;
+                return false;
+            }
+
+            pcl::MomentOfInertiaEstimation<PointT> feature_extractor;
+            PointT min_point_OBB, max_point_OBB, position_OBB;
+            OrientedBoundingBox box;
+            feature_extractor.setInputCloud(cloud);
+            feature_extractor.compute();
+            if (!feature_extractor.getOBB(min_point_OBB, max_point_OBB, position_OBB, box.rotation))
+                return false;
+
+            box.min_point = min_point_OBB.getVector3fMap();
+            box.max_point = max_point_OBB.getVector3fMap();
+            box.position = position_OBB.getVector3fMap();
+            output = box;
+            return true;
+        }
+
+        virtual bool saveResult(const boost::any& result, const std::string& filename) const
+        {
+            const OrientedBoundingBox& box = boost::any_cast<const OrientedBoundingBox&>(result);
+            std::ofstream file((filename + ".txt.tmp").c_str());
+            if (!file.is_open())
+                return false;
+
+            file << std::setprecision(9)
+                 << box.min_point.transpose() << std::endl
+                 << box.max_point.transpose() << std::endl
+                 << box.position.transpose() << std::endl
+                 << box.rotation << std::endl;
+            file.close();
+            if (file.fail())
+            {
+                std::remove((filename + ".txt.tmp").c_str());
+                return false;
+            }
+            return replaceFile(filename + ".txt.tmp", filename + ".txt");
+        }
+
+        virtual bool loadResult(const std::string& filename, boost::any& result) const
+        {
+            std::ifstream file((filename + ".txt").c_str());
+            if (!file.is_open())
+                return false;
+
+            OrientedBoundingBox box;
+            for (int i = 0; i < 3; i++) file >> box.min_point[i];
+            for (int i = 0; i < 3; i++) file >> box.max_point[i];
+            for (int i = 0; i < 3; i++) file >> box.position[i];
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 3; j++)
+                    file >> box.rotation(i, j);
+            if (file.fail())
+                return false;
+
+            result = box;
+            return true;
+        }
+};
+
+template<typename PointT>
+class TransformStage : public CloudStage<PointT>
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        //-- Without a fixed transform, the cloud is taken to the frame of the bounding box given
+        //-- as second input
+        TransformStage() : use_box(true) { transform.setIdentity(); }
+        TransformStage(const Eigen::Affine3f& transform) : use_box(false) { this->transform = transform.matrix(); }
+
+        virtual std::string getType() const { return "Transform"; }
+        virtual std::string getParameters() const
+        {
+            if (use_box)
+                return "box";
+
+            std::ostringstream parameters;
+            parameters << std::setprecision(9);
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 4; j++)
+                    parameters << (i + j > 0 ? " " : "") << transform(i, j);
+            return parameters.str();
+        }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            Eigen::Affine3f cloud_transform(transform);
+            if (use_box)
+            {
+                if (inputs.size() < 2)
+                {
+                    std::cerr << "Error: transform stage without bounding box input" << std::endl;
+                    return false;
+                }
+                cloud_transform = boost::any_cast<const OrientedBoundingBox&>(inputs[1]).getBoxTransform();
+            }
+
+            typename pcl::PointCloud<PointT>::Ptr transformed_cloud(new pcl::PointCloud<PointT>);
+            pcl::transformPointCloud(*boost::any_cast<PointCloudConstPtr>(inputs[0]), *transformed_cloud, cloud_transform);
+            output = PointCloudConstPtr(transformed_cloud);
+            return true;
+        }
+
+    private:
+        bool use_box;
+        //-- Unaligned, since stages are allocated with plain new
+        Eigen::Matrix<float, 4, 4, Eigen::DontAlign> transform;
+};
+
+template<typename PointT>
+class HistogramImageStage : public PipelineStage
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        HistogramImageStage(int resolution, bool upsampling = false)
+            : resolution(resolution), upsampling(upsampling) {}
+
+        virtual std::string getType() const { return "HistogramImage"; }
+        virtual std::string getParameters() const
+        {
+            std::ostringstream parameters;
+            parameters << resolution << " " << upsampling;
+            return parameters.str();
+        }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            HistogramImageCreator<PointT> histogram_image_creator;
+            histogram_image_creator.setInputPointCloud(boost::any_cast<PointCloudConstPtr>(inputs[0]));
+            histogram_image_creator.setResolution(resolution);
+            histogram_image_creator.setUpsampling(upsampling);
+            if (!histogram_image_creator.compute())
+                return false;
+
+            output = histogram_image_creator.getDepthImageAsMatrix();
+            return true;
+        }
+
+        //-- One row of the image per line, as the programs write it
+        virtual bool saveResult(const boost::any& result, const std::string& filename) const
+        {
+            std::ofstream file((filename + ".m.tmp").c_str());
+            if (!file.is_open())
+                return false;
+
+            file << boost::any_cast<const Eigen::MatrixXi&>(result) << std::endl;
+            file.close();
+            if (file.fail())
+            {
+                std::remove((filename + ".m.tmp").c_str());
+                return false;
+            }
+            return replaceFile(filename + ".m.tmp", filename + ".m");
+        }
+
+        virtual bool loadResult(const std::string& filename, boost::any& result) const
+        {
+            std::ifstream file((filename + ".m").c_str());
+            if (!file.is_open())
+                return false;
+
+            std::vector<int> values;
+            int rows = 0, cols = 0;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                std::istringstream line_stream(line);
+                int value, line_cols = 0;
+                while (line_stream >> value)
+                {
+                    values.push_back(value);
+                    line_cols++;
+                }
+                if (!line_stream.eof())
+                    return false;
+                if (line_cols == 0)
+                    continue;
+                if (rows > 0 && line_cols != cols)
+                    return false;
+                cols = line_cols;
+                rows++;
+            }
+            if (file.bad())
+                return false;
+
+            Eigen::MatrixXi image(rows, cols);
+            for (int row = 0; row < rows; row++)
+                for (int col = 0; col < cols; col++)
+                    image(row, col) = values[row * cols + col];
+            result = image;
+            return true;
+        }
+
+    private:
+        int resolution;
+        bool upsampling;
+};
+
+#endif // CLOUD_STAGES_HPP
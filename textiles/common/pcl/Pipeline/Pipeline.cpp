@@ -0,0 +1,118 @@
+#include "Pipeline.hpp"
+
+#include <cstdio>
+#include <stdint.h>
+
+Pipeline::Pipeline()
+{
+    cache_directory = "";
+    verbose = true;
+}
+
+bool Pipeline::addStage(const std::string& name, const PipelineStage::Ptr& stage, const std::vector<std::string>& inputs)
+{
+    if (!stage)
+    {
+        std::cerr << "Error: stage \"" << name << "\" is empty" << std::endl;
+        return false;
+    }
+
+    if (nodes.find(name) != nodes.end())
+    {
+        std::cerr << "Error: stage \"" << name << "\" already exists" << std::endl;
+        return false;
+    }
+
+    for (std::size_t i = 0; i < inputs.size(); i++)
+        if (nodes.find(inputs[i]) == nodes.end())
+        {
+            std::cerr << "Error: input \"" << inputs[i] << "\" of stage \"" << name << "\" does not exist" << std::endl;
+            return false;
+        }
+
+    Node node;
+    node.stage = stage;
+    node.inputs = inputs;
+    nodes[name] = node;
+    return true;
+}
+
+bool Pipeline::run(const std::string& name, boost::any& result)
+{
+    std::map<std::string, Node>::const_iterator node = nodes.find(name);
+    if (node == nodes.end())
+    {
+        std::cerr << "Error: stage \"" << name << "\" does not exist" << std::endl;
+        return false;
+    }
+
+    //-- Look for the result in the caches first
+    std::string key = getKey(name);
+    std::map<std::string, boost::any>::const_iterator cached = memory_cache.find(key);
+    if (cached != memory_cache.end())
+    {
+        result = cached->second;
+        return true;
+    }
+
+    std::string cache_filename = getCacheFilename(name, key);
+    if (!cache_filename.empty() && node->second.stage->loadResult(cache_filename, result))
+    {
+        if (verbose)
+            std::cout << "[Pipeline] " << name << ": loaded from cache" << std::endl;
+        memory_cache[key] = result;
+        return true;
+    }
+
+    //-- Compute inputs and run the stage
+    std::vector<boost::any> inputs(node->second.inputs.size());
+    for (std::size_t i = 0; i < inputs.size(); i++)
+        if (!run(node->second.inputs[i], inputs[i]))
+            return false;
+
+    if (verbose)
+        std::cout << "[Pipeline] " << name << ": running (" << node->second.stage->getType() << ")" << std::endl;
+
+    if (!node->second.stage->process(inputs, result))
+    {
+        std::cerr << "Error: stage \"" << name << "\" failed" << std::endl;
+        return false;
+    }
+
+    memory_cache[key] = result;
+    if (!cache_filename.empty())
+        node->second.stage->saveResult(result, cache_filename);
+    return true;
+}
+
+std::string Pipeline::getKey(const std::string& name)
+{
+    const Node& node = nodes[name];
+    std::string description = node.stage->getType() + "(" + node.stage->getParameters() + ")"
+                              + "[" + node.stage->getSourceKey() + "]";
+    for (std::size_t i = 0; i < node.inputs.size(); i++)
+        description += ":" + getKey(node.inputs[i]);
+    return hash(description);
+}
+
+std::string Pipeline::getCacheFilename(const std::string& name, const std::string& key) const
+{
+    if (cache_directory.empty())
+        return "";
+    return cache_directory + "/" + name + "-" + key;
+}
+
+std::string Pipeline::hash(const std::string& text)
+{
+    //-- 64-bit FNV-1a, so that keys are the same between runs and platforms
+    uint64_t hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < text.size(); i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+    return std::string(buffer);
+}
@@ -0,0 +1,78 @@
+/*
+ * Pipeline
+ *
+ * Directed acyclic graph of PipelineStages. Stages are added by name together with the
+ * names of the stages they take as inputs (which must have been added before, so the
+ * graph can never contain cycles), and results are computed on demand.
+ *
+ * Every result is identified by a key computed from the type and parameters of its stage
+ * and the keys of its inputs. Keys are computed before running anything, so when a result
+ * is already cached (in memory or in the cache directory) none of the stages upstream of it
+ * are run. E.g. changing only the cluster tolerance re-runs only the clustering stage.
+ *
+ */
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include "PipelineStage.hpp"
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+class Pipeline
+{
+    public:
+        Pipeline();
+
+        bool addStage(const std::string& name, const PipelineStage::Ptr& stage,
+                      const std::vector<std::string>& inputs = std::vector<std::string>());
+
+        //-- Directory where the results of the stages are stored between runs ("" to disable)
+        void setCacheDirectory(const std::string& cache_directory) { this->cache_directory = cache_directory; }
+        void setVerbose(bool verbose) { this->verbose = verbose; }
+
+        bool run(const std::string& name, boost::any& result);
+
+        template<typename T>
+        bool run(const std::string& name, T& result)
+        {
+            boost::any any_result;
+            if (!run(name, any_result))
+                return false;
+
+            try
+            {
+                result = boost::any_cast<T>(any_result);
+            }
+            catch (const boost::bad_any_cast&)
+            {
+                std::cerr << "Error: stage \"" << name << "\" has a different result type" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        //-- Key that identifies the result of a stage with its current parameters and inputs
+        std::string getKey(const std::string& name);
+
+        void clearMemoryCache() { memory_cache.clear(); }
+
+    private:
+        struct Node {
+            PipelineStage::Ptr stage;
+            std::vector<std::string> inputs;
+        };
+
+        std::string getCacheFilename(const std::string& name, const std::string& key) const;
+        static std::string hash(const std::string& text);
+
+        std::map<std::string, Node> nodes;
+        std::map<std::string, boost::any> memory_cache; //-- Results indexed by key
+        std::string cache_directory;
+        bool verbose;
+};
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,128 @@
+#include "PipelineStage.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool PipelineStage::replaceFile(const std::string& temporary_filename, const std::string& filename)
+{
+    //-- rename() replaces the destination atomically, so readers never see a partial file
+    if (std::rename(temporary_filename.c_str(), filename.c_str()) != 0)
+    {
+        std::remove(temporary_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool PipelineStage::saveIndices(const std::vector<int>& indices, int input_size, const std::string& filename)
+{
+    //-- Header with the size of the input cloud and the number of indices, then one index per line
+    std::string temporary_filename = filename + ".tmp";
+    std::ofstream file(temporary_filename.c_str());
+    if (!file.is_open())
+        return false;
+
+    file << input_size << " " << indices.size() << std::endl;
+    for (std::size_t i = 0; i < indices.size(); i++)
+        file << indices[i] << std::endl;
+    file.close();
+    if (file.fail())
+    {
+        std::remove(temporary_filename.c_str());
+        return false;
+    }
+    return replaceFile(temporary_filename, filename);
+}
+
+bool PipelineStage::loadIndices(const std::string& filename, std::vector<int>& indices)
+{
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+        return false;
+
+    int input_size;
+    std::size_t n_indices;
+    if (!(file >> input_size >> n_indices))
+        return false;
+
+    indices.clear();
+    indices.reserve(n_indices);
+    for (std::size_t i = 0; i < n_indices; i++)
+    {
+        int index;
+        if (!(file >> index) || index < 0 || index >= input_size)
+        {
+            std::cerr << "Error: missing or out of range index in cache file " << filename << std::endl;
+            return false;
+        }
+        indices.push_back(index);
+    }
+
+    //-- Anything after the last index means the file is not the one we wrote
+    file >> std::ws;
+    return file.eof();
+}
+
+bool PipelineStage::saveClusters(const std::vector<pcl::PointIndices>& clusters, int input_size, const std::string& filename)
+{
+    //-- Header with the size of the input cloud and the number of clusters, then one cluster
+    //-- per line (its size followed by its indices)
+    std::string temporary_filename = filename + ".tmp";
+    std::ofstream file(temporary_filename.c_str());
+    if (!file.is_open())
+        return false;
+
+    file << input_size << " " << clusters.size() << std::endl;
+    for (std::size_t i = 0; i < clusters.size(); i++)
+    {
+        file << clusters[i].indices.size();
+        for (std::size_t j = 0; j < clusters[i].indices.size(); j++)
+            file << " " << clusters[i].indices[j];
+        file << std::endl;
+    }
+    file.close();
+    if (file.fail())
+    {
+        std::remove(temporary_filename.c_str());
+        return false;
+    }
+    return replaceFile(temporary_filename, filename);
+}
+
+bool PipelineStage::loadClusters(const std::string& filename, std::vector<pcl::PointIndices>& clusters)
+{
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+        return false;
+
+    int input_size;
+    std::size_t n_clusters;
+    if (!(file >> input_size >> n_clusters))
+        return false;
+
+    clusters.clear();
+    clusters.resize(n_clusters);
+    for (std::size_t i = 0; i < n_clusters; i++)
+    {
+        std::size_t cluster_size;
+        if (!(file >> cluster_size))
+            return false;
+
+        clusters[i].indices.reserve(cluster_size);
+        for (std::size_t j = 0; j < cluster_size; j++)
+        {
+            int index;
+            if (!(file >> index) || index < 0 || index >= input_size)
+            {
+                std::cerr << "Error: missing or out of range index in cache file " << filename << std::endl;
+                return false;
+            }
+            clusters[i].indices.push_back(index);
+        }
+    }
+
+    file >> std::ws;
+    return file.eof();
+}
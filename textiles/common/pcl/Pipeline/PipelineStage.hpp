@@ -0,0 +1,60 @@
+/*
+ * Pipeline Stage
+ *
+ * Base class for the processing steps (load, downsample, plane removal, clustering...)
+ * that are assembled into a Pipeline. Each stage takes the results of its input stages
+ * and produces a single result, stored in a boost::any.
+ *
+ * The type and parameters of a stage are used by the Pipeline to build the cache key of
+ * its result, so two stages with the same parameters and inputs are never run twice.
+ * Stages that can write their result to disk implement saveResult() / loadResult(), so
+ * that intermediate results are kept between runs of the program.
+ *
+ */
+
+#ifndef PIPELINE_STAGE_HPP
+#define PIPELINE_STAGE_HPP
+
+#include <boost/any.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/PointIndices.h>
+
+#include <string>
+#include <vector>
+
+class PipelineStage
+{
+    public:
+        typedef boost::shared_ptr<PipelineStage> Ptr;
+
+        virtual ~PipelineStage() {}
+
+        //-- Name of the kind of stage and text representation of its parameters (used in the cache key)
+        virtual std::string getType() const = 0;
+        virtual std::string getParameters() const = 0;
+
+        //-- Identifies the external data read by the stage, e.g. a file and its modification time
+        //-- (only needed for stages without inputs)
+        virtual std::string getSourceKey() const { return ""; }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output) = 0;
+
+        //-- Disk cache (optional). The filename is given without extension
+        virtual bool saveResult(const boost::any& result, const std::string& filename) const { return false; }
+        virtual bool loadResult(const std::string& filename, boost::any& result) const { return false; }
+
+    protected:
+        //-- Moves a completely written temporary file to its final name, so that an interrupted
+        //-- run never leaves a truncated result in the cache
+        static bool replaceFile(const std::string& temporary_filename, const std::string& filename);
+
+        //-- Helpers for stages whose results are (lists of) indices into a cloud of input_size
+        //-- points. Loading fails if the file is truncated or any index is out of that range
+        static bool saveIndices(const std::vector<int>& indices, int input_size, const std::string& filename);
+        static bool loadIndices(const std::string& filename, std::vector<int>& indices);
+        static bool saveClusters(const std::vector<pcl::PointIndices>& clusters, int input_size, const std::string& filename);
+        static bool loadClusters(const std::string& filename, std::vector<pcl::PointIndices>& clusters);
+};
+
+#endif // PIPELINE_STAGE_HPP
@@ -0,0 +1,190 @@
+/*
+ * Color Segmentation
+ *
+ * Keeps the points whose saturation and value (HSV) are above a threshold, without building
+ * an HSV cloud: S and V are computed from the RGB values of each point in integer arithmetic
+ * (S > t  <=>  max-min > t*max, V > t  <=>  max > t*255) and the result is written to a mask.
+ *
+ * Thresholds can also be chosen automatically with Otsu's method. In that case the same pass
+ * that computes S and V (quantized to bytes) builds their histograms, and the mask is then
+ * computed from the bytes.
+ *
+ * S and V are in [0, 1], as in pcl::PointCloudXYZRGBtoXYZHSV.
+ *
+ */
+
+#ifndef COLOR_SEGMENTATION_HPP
+#define COLOR_SEGMENTATION_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+
+template<typename PointT>
+class ColorSegmentation
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        ColorSegmentation() {
+            //-- Set default values
+            saturation_threshold = 0.30;
+            value_threshold = 0.35;
+            automatic_thresholds = false;
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        //-- Segment only a subset of the input cloud (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+
+        void setSaturationThreshold(float saturation_threshold) { this->saturation_threshold = saturation_threshold; }
+        void setValueThreshold(float value_threshold) { this->value_threshold = value_threshold; }
+        //-- Compute both thresholds with Otsu's method instead of using the given ones
+        void setAutomaticThresholds(bool automatic_thresholds) { this->automatic_thresholds = automatic_thresholds; }
+
+        //-- Thresholds used in the last segmentation
+        float getSaturationThreshold() const { return saturation_threshold; }
+        float getValueThreshold() const { return value_threshold; }
+
+        //-- Mask with one value per point of the input cloud (1: point kept), and kept points
+        const std::vector<uint8_t>& getMask() const { return mask; }
+
+        bool segment(pcl::PointIndices& indices)
+        {
+            indices.indices.clear();
+            if (!input_cloud)
+            {
+                std::cerr << "Error: input cloud not set" << std::endl;
+                return false;
+            }
+
+            const std::vector<PointT, Eigen::aligned_allocator<PointT> >& points = input_cloud->points;
+            int n = input_indices ? input_indices->size() : points.size();
+            mask.assign(points.size(), 0);
+
+            if (automatic_thresholds)
+            {
+                //-- S and V as bytes, and their histograms
+                std::vector<uint8_t> saturation(n), value(n);
+                std::vector<int> saturation_histogram(256, 0), value_histogram(256, 0);
+                #pragma omp parallel
+                {
+                    std::vector<int> local_saturation_histogram(256, 0), local_value_histogram(256, 0);
+                    #pragma omp for schedule(static)
+                    for (int i = 0; i < n; i++)
+                    {
+                        const PointT& point = points[input_indices ? (*input_indices)[i] : i];
+                        int max = std::max(point.r, std::max(point.g, point.b));
+                        int min = std::min(point.r, std::min(point.g, point.b));
+                        saturation[i] = max > 0 ? (255 * (max - min) + max / 2) / max : 0;
+                        value[i] = max;
+                        if (isValid(point))
+                        {
+                            local_saturation_histogram[saturation[i]]++;
+                            local_value_histogram[value[i]]++;
+                        }
+                    }
+
+                    #pragma omp critical
+                    for (int b = 0; b < 256; b++)
+                    {
+                        saturation_histogram[b] += local_saturation_histogram[b];
+                        value_histogram[b] += local_value_histogram[b];
+                    }
+                }
+
+                int saturation_bin = computeOtsuThreshold(saturation_histogram);
+                int value_bin = computeOtsuThreshold(value_histogram);
+                saturation_threshold = saturation_bin / 255.0f;
+                value_threshold = value_bin / 255.0f;
+
+                #pragma omp parallel for schedule(static)
+                for (int i = 0; i < n; i++)
+                {
+                    int index = input_indices ? (*input_indices)[i] : i;
+                    mask[index] = (saturation[i] > saturation_bin) & (value[i] > value_bin) & isValid(points[index]);
+                }
+            }
+            else
+            {
+                //-- Thresholds scaled to the integer comparisons
+                float scaled_value_threshold = value_threshold * 255.0f;
+                #pragma omp parallel for schedule(static)
+                for (int i = 0; i < n; i++)
+                {
+                    int index = input_indices ? (*input_indices)[i] : i;
+                    const PointT& point = points[index];
+                    int max = std::max(point.r, std::max(point.g, point.b));
+                    int min = std::min(point.r, std::min(point.g, point.b));
+                    mask[index] = ((max - min) > saturation_threshold * max) & (max > scaled_value_threshold) & isValid(point);
+                }
+            }
+
+            //-- Indices in the same order as the input ones
+            indices.header = input_cloud->header;
+            indices.indices.reserve(n);
+            for (int i = 0; i < n; i++)
+            {
+                int index = input_indices ? (*input_indices)[i] : i;
+                if (mask[index])
+                    indices.indices.push_back(index);
+            }
+            return true;
+        }
+
+    private:
+        static bool isValid(const PointT& point)
+        {
+            return std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z);
+        }
+
+        //-- Bin that maximizes the between-class variance (values above it are the foreground)
+        static int computeOtsuThreshold(const std::vector<int>& histogram)
+        {
+            double total = 0, total_sum = 0;
+            for (int b = 0; b < (int)histogram.size(); b++)
+            {
+                total += histogram[b];
+                total_sum += (double)b * histogram[b];
+            }
+
+            double background = 0, background_sum = 0, best_variance = -1;
+            int threshold = 0;
+            for (int b = 0; b < (int)histogram.size(); b++)
+            {
+                background += histogram[b];
+                background_sum += (double)b * histogram[b];
+                double foreground = total - background;
+                if (background == 0)
+                    continue;
+                if (foreground == 0)
+                    break;
+
+                double mean_difference = background_sum / background - (total_sum - background_sum) / foreground;
+                double variance = background * foreground * mean_difference * mean_difference;
+                if (variance > best_variance)
+                {
+                    best_variance = variance;
+                    threshold = b;
+                }
+            }
+            return threshold;
+        }
+
+        PointCloudConstPtr input_cloud;
+        pcl::IndicesConstPtr input_indices;
+
+        float saturation_threshold;
+        float value_threshold;
+        bool automatic_thresholds;
+
+        std::vector<uint8_t> mask;
+};
+
+#endif // COLOR_SEGMENTATION_HPP
@@ -0,0 +1 @@
+#include "LargestClusterExtraction.hpp"
@@ -0,0 +1,278 @@
+/*
+ * Largest Cluster Extraction
+ *
+ * Euclidean clustering (same result as pcl::EuclideanClusterExtraction) without a kd-tree
+ * search per point. Points are hashed into voxels of side tolerance/sqrt(3), so all the
+ * points of a voxel are always connected. Then voxels are joined with a parallel union-find:
+ * two nearby voxels are merged when any pair of their points is closer than the tolerance,
+ * checking only the points of each voxel that lie close enough to the border of the other.
+ *
+ * Clusters are returned as indices of the input cloud, the largest one first.
+ *
+ */
+
+#ifndef LARGEST_CLUSTER_EXTRACTION_HPP
+#define LARGEST_CLUSTER_EXTRACTION_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "VoxelKey.hpp"
+#include "VoxelGridDownsampler.hpp"
+
+template<typename PointT>
+class LargestClusterExtraction
+{
+    //-- Typedefs for clarity's sake
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef std::unordered_map<VoxelKey, int, VoxelKeyHash> VoxelMap;
+
+    public:
+        LargestClusterExtraction() {
+            //-- Set default values
+            cluster_tolerance = 0.02;
+            min_cluster_size = 1;
+            max_cluster_size = std::numeric_limits<int>::max();
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        //-- Cluster only a subset of the input cloud (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+
+        void setClusterTolerance(float cluster_tolerance) { this->cluster_tolerance = cluster_tolerance; }
+        void setMinClusterSize(int min_cluster_size) { this->min_cluster_size = min_cluster_size; }
+        void setMaxClusterSize(int max_cluster_size) { this->max_cluster_size = max_cluster_size; }
+
+        //-- Largest cluster (false if there is no cluster with at least min_cluster_size points)
+        bool extractLargest(pcl::PointIndices& largest_cluster)
+        {
+            std::vector<pcl::PointIndices> clusters;
+            largest_cluster.indices.clear();
+            if (!computeClusters(clusters, true))
+                return false;
+
+            largest_cluster.indices.swap(clusters[0].indices);
+            return true;
+        }
+
+        //-- All clusters with a size within the limits, sorted from largest to smallest
+        void extract(std::vector<pcl::PointIndices>& clusters)
+        {
+            computeClusters(clusters, false);
+        }
+
+    private:
+        bool computeClusters(std::vector<pcl::PointIndices>& clusters, bool only_largest)
+        {
+            clusters.clear();
+            if (!input_cloud)
+            {
+                std::cerr << "Error: input cloud not set" << std::endl;
+                return false;
+            }
+
+            if (cluster_tolerance <= 0)
+            {
+                std::cerr << "Error: invalid cluster tolerance" << std::endl;
+                return false;
+            }
+
+            //-- Group points in voxels small enough to have all their points connected
+            float voxel_size = cluster_tolerance / std::sqrt(3.0f);
+            VoxelGridDownsampler<PointT> voxel_grid;
+            pcl::PointCloud<PointT> voxel_representatives;
+            voxel_grid.setInputCloud(input_cloud);
+            if (input_indices)
+                voxel_grid.setIndices(input_indices);
+            voxel_grid.setLeafSize(voxel_size);
+            voxel_grid.setReductionMode(VoxelGridDownsampler<PointT>::FIRST_POINT);
+            voxel_grid.setSaveVoxelMap(true);
+            voxel_grid.filter(voxel_representatives);
+            voxel_grid.getVoxelMap(voxel_offsets, voxel_points);
+            int n_voxels = voxel_representatives.points.size();
+
+            //-- Voxel lookup by coordinates
+            float inverse_voxel_size = 1.0f / voxel_size;
+            std::vector<VoxelKey> keys(n_voxels);
+            VoxelMap voxel_map;
+            voxel_map.reserve(n_voxels);
+            for (int v = 0; v < n_voxels; v++)
+            {
+                const PointT& point = voxel_representatives.points[v];
+                keys[v] = computeVoxelKey(point.x, point.y, point.z, inverse_voxel_size, inverse_voxel_size, inverse_voxel_size);
+                voxel_map[keys[v]] = v;
+            }
+
+            //-- Neighbor voxels that may contain points within the tolerance. Only half of them
+            //-- are needed, since each pair of voxels is checked once
+            std::vector<VoxelKey> offsets;
+            for (int dx = -2; dx <= 2; dx++)
+                for (int dy = -2; dy <= 2; dy++)
+                    for (int dz = -2; dz <= 2; dz++)
+                    {
+                        VoxelKey offset(dx, dy, dz);
+                        if (!isPositiveOffset(offset))
+                            continue;
+
+                        //-- Minimum distance between the voxels has to be under the tolerance
+                        float gap_x = std::max(std::abs(dx)-1, 0) * voxel_size;
+                        float gap_y = std::max(std::abs(dy)-1, 0) * voxel_size;
+                        float gap_z = std::max(std::abs(dz)-1, 0) * voxel_size;
+                        if (gap_x*gap_x + gap_y*gap_y + gap_z*gap_z < cluster_tolerance*cluster_tolerance)
+                            offsets.push_back(offset);
+                    }
+
+            //-- Join neighbor voxels (parallel union-find)
+            parent = std::vector<std::atomic<int> >(n_voxels);
+            for (int v = 0; v < n_voxels; v++)
+                parent[v].store(v);
+
+            #pragma omp parallel for schedule(dynamic, 64)
+            for (int v = 0; v < n_voxels; v++)
+                for (std::size_t i = 0; i < offsets.size(); i++)
+                {
+                    VoxelKey neighbor_key(keys[v].x + offsets[i].x, keys[v].y + offsets[i].y, keys[v].z + offsets[i].z);
+                    typename VoxelMap::const_iterator neighbor = voxel_map.find(neighbor_key);
+                    if (neighbor == voxel_map.end())
+                        continue;
+
+                    //-- Skip the (expensive) distance check if they are already joined
+                    if (find(v) == find(neighbor->second))
+                        continue;
+
+                    if (areConnected(v, neighbor->second, neighbor_key, voxel_size))
+                        unite(v, neighbor->second);
+                }
+
+            //-- Size of each component
+            std::vector<int> component_size(n_voxels, 0);
+            std::vector<int> root(n_voxels);
+            for (int v = 0; v < n_voxels; v++)
+            {
+                root[v] = find(v);
+                component_size[root[v]] += voxel_offsets[v+1] - voxel_offsets[v];
+            }
+
+            //-- Select the components to return
+            std::vector<int> selected;
+            for (int v = 0; v < n_voxels; v++)
+                if (root[v] == v && component_size[v] >= min_cluster_size && component_size[v] <= max_cluster_size)
+                    selected.push_back(v);
+            std::stable_sort(selected.begin(), selected.end(), CompareSize(component_size));
+            if (only_largest && selected.size() > 1)
+                selected.resize(1);
+
+            std::vector<int> cluster_of_root(n_voxels, -1);
+            clusters.resize(selected.size());
+            for (int i = 0; i < (int)selected.size(); i++)
+            {
+                cluster_of_root[selected[i]] = i;
+                clusters[i].header = input_cloud->header;
+                clusters[i].indices.reserve(component_size[selected[i]]);
+            }
+
+            for (int v = 0; v < n_voxels; v++)
+            {
+                int cluster = cluster_of_root[root[v]];
+                if (cluster >= 0)
+                    clusters[cluster].indices.insert(clusters[cluster].indices.end(),
+                                                     voxel_points.begin() + voxel_offsets[v],
+                                                     voxel_points.begin() + voxel_offsets[v+1]);
+            }
+
+            for (std::size_t i = 0; i < clusters.size(); i++)
+                std::sort(clusters[i].indices.begin(), clusters[i].indices.end());
+
+            return !clusters.empty();
+        }
+
+        //-- Whether any point of voxel a is within the tolerance of any point of voxel b
+        bool areConnected(int a, int b, const VoxelKey& key_b, float voxel_size) const
+        {
+            float squared_tolerance = cluster_tolerance * cluster_tolerance;
+            Eigen::Vector3f min_b(key_b.x * voxel_size, key_b.y * voxel_size, key_b.z * voxel_size);
+            Eigen::Vector3f max_b = min_b + Eigen::Vector3f::Constant(voxel_size);
+
+            for (int i = voxel_offsets[a]; i < voxel_offsets[a+1]; i++)
+            {
+                Eigen::Vector3f p = input_cloud->points[voxel_points[i]].getVector3fMap();
+
+                //-- Only the points close to the border of b can reach it
+                Eigen::Vector3f gap = (min_b - p).cwiseMax(p - max_b).cwiseMax(Eigen::Vector3f::Zero());
+                if (gap.squaredNorm() > squared_tolerance)
+                    continue;
+
+                for (int j = voxel_offsets[b]; j < voxel_offsets[b+1]; j++)
+                    if ((input_cloud->points[voxel_points[j]].getVector3fMap() - p).squaredNorm() <= squared_tolerance)
+                        return true;
+            }
+            return false;
+        }
+
+        static bool isPositiveOffset(const VoxelKey& offset)
+        {
+            if (offset.x != 0) return offset.x > 0;
+            if (offset.y != 0) return offset.y > 0;
+            return offset.z > 0;
+        }
+
+        int find(int v)
+        {
+            //-- Path halving
+            int p = parent[v].load();
+            while (p != v)
+            {
+                int grandparent = parent[p].load();
+                if (grandparent != p)
+                    parent[v].compare_exchange_weak(p, grandparent);
+                v = grandparent;
+                p = parent[v].load();
+            }
+            return v;
+        }
+
+        void unite(int a, int b)
+        {
+            while (true)
+            {
+                a = find(a);
+                b = find(b);
+                if (a == b)
+                    return;
+
+                //-- Always link the larger root to the smaller one
+                if (a < b) std::swap(a, b);
+                int expected = a;
+                if (parent[a].compare_exchange_strong(expected, b))
+                    return;
+            }
+        }
+
+        struct CompareSize {
+            CompareSize(const std::vector<int>& sizes) : sizes(sizes) {}
+            bool operator()(int a, int b) const { return sizes[a] > sizes[b]; }
+            const std::vector<int>& sizes;
+        };
+
+        PointCloudConstPtr input_cloud;
+        pcl::IndicesConstPtr input_indices;
+
+        float cluster_tolerance;
+        int min_cluster_size;
+        int max_cluster_size;
+
+        std::vector<int> voxel_offsets;
+        std::vector<int> voxel_points;
+        std::vector<std::atomic<int> > parent;
+};
+
+#endif // LARGEST_CLUSTER_EXTRACTION_HPP
@@ -0,0 +1 @@
+#include "MultiPlaneSegmentation.hpp"
@@ -0,0 +1,357 @@
+/*
+ * Multi Plane Segmentation
+ *
+ * Iteratively peels all the planes found in a point cloud. The input cloud is never
+ * copied: the points that have not been assigned to a plane yet are tracked with an
+ * "alive" mask that is compacted into a list of indices after every plane.
+ *
+ * Organized clouds (height > 1) are segmented by default with integral image normals and
+ * pcl::OrganizedMultiPlaneSegmentation, which finds all the planes in a single pass over the
+ * image. Planes are then taken from largest to smallest with the same stop criteria.
+ *
+ */
+
+#ifndef MULTI_PLANE_SEGMENTATION_HPP
+#define MULTI_PLANE_SEGMENTATION_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+//-- Plane fitting
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/sample_consensus/sac_model_plane.h>
+#include <pcl/sample_consensus/ransac.h>
+//-- Organized clouds
+#include <pcl/segmentation/organized_multi_plane_segmentation.h>
+#include <pcl/common/angles.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "NormalEstimator.hpp"
+
+template<typename PointT>
+class MultiPlaneSegmentation
+{
+    //-- Typedefs for clarity's sake
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::SampleConsensusModelPlane<PointT>::Ptr PlaneModelPtr;
+
+    public:
+        MultiPlaneSegmentation() {
+            //-- Set default values (same as the original peeling loops)
+            distance_threshold = 0.02;
+            remaining_points_ratio = 0.3;
+            max_planes = 0;
+            min_inliers = 3;
+            max_iterations = 50;
+            optimize_coefficients = true;
+            candidate_regions = 1;
+            use_organized = true;
+            angular_threshold = pcl::deg2rad(3.0);
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        //-- Restrict the search to a subset of the input cloud (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->input_indices = indices; }
+
+        void setDistanceThreshold(float distance_threshold) { this->distance_threshold = distance_threshold; }
+        //-- Stop when the points not assigned to any plane are fewer than this ratio of the input
+        void setRemainingPointsRatio(float ratio) { this->remaining_points_ratio = ratio; }
+        //-- Maximum number of planes to extract (0 means no limit)
+        void setMaxPlanes(int max_planes) { this->max_planes = max_planes; }
+        void setMinInliers(int min_inliers) { this->min_inliers = min_inliers; }
+        void setMaxIterations(int max_iterations) { this->max_iterations = max_iterations; }
+        void setOptimizeCoefficients(bool optimize) { this->optimize_coefficients = optimize; }
+        //-- Number of spatial regions in which candidate planes are searched concurrently
+        //-- (1 runs a single RANSAC over all the remaining points)
+        void setCandidateRegions(int candidate_regions) { this->candidate_regions = std::max(1, candidate_regions); }
+        //-- Segment organized clouds in image space (only without indices). The angular threshold
+        //-- is the maximum angle between the normals of a plane
+        void setUseOrganized(bool use_organized) { this->use_organized = use_organized; }
+        void setAngularThreshold(float angular_threshold) { this->angular_threshold = angular_threshold; }
+
+        //-- Indices (in the input cloud) of the points that do not belong to any plane
+        pcl::IndicesPtr getRemainingIndices() { return pcl::IndicesPtr(new std::vector<int>(remaining)); }
+
+        bool segment(std::vector<pcl::ModelCoefficients>& planes, std::vector<pcl::PointIndices>& planes_inliers)
+        {
+            planes.clear();
+            planes_inliers.clear();
+            remaining.clear();
+
+            if (!input_cloud)
+            {
+                std::cerr << "Error: input cloud not set" << std::endl;
+                return false;
+            }
+
+            if (use_organized && input_cloud->isOrganized() && !input_indices)
+                return segmentOrganized(planes, planes_inliers);
+
+            //-- Initially all (finite) points are alive
+            std::vector<char> alive(input_cloud->points.size(), 0);
+            if (input_indices)
+            {
+                remaining.reserve(input_indices->size());
+                for (std::size_t i = 0; i < input_indices->size(); i++)
+                    if (isFinitePoint(input_cloud->points[(*input_indices)[i]]))
+                        remaining.push_back((*input_indices)[i]);
+            }
+            else
+            {
+                remaining.reserve(input_cloud->points.size());
+                for (int i = 0; i < (int)input_cloud->points.size(); i++)
+                    if (isFinitePoint(input_cloud->points[i]))
+                        remaining.push_back(i);
+            }
+
+            for (std::size_t i = 0; i < remaining.size(); i++)
+                alive[remaining[i]] = 1;
+
+            std::size_t nr_points = remaining.size();
+            while (remaining.size() > remaining_points_ratio * nr_points && remaining.size() >= 3)
+            {
+                if (max_planes > 0 && (int)planes.size() >= max_planes)
+                    break;
+
+                //-- Segment the largest planar component from the remaining points
+                Eigen::VectorXf coefficients;
+                pcl::PointIndices inliers;
+                if (!findPlane(coefficients, inliers.indices) || (int)inliers.indices.size() < min_inliers)
+                    break;
+
+                //-- Kill the planar inliers and compact the list of alive points
+                for (std::size_t i = 0; i < inliers.indices.size(); i++)
+                    alive[inliers.indices[i]] = 0;
+
+                std::size_t n_alive = 0;
+                for (std::size_t i = 0; i < remaining.size(); i++)
+                    if (alive[remaining[i]])
+                        remaining[n_alive++] = remaining[i];
+                remaining.resize(n_alive);
+
+                //-- Save plane
+                pcl::ModelCoefficients plane;
+                plane.values.resize(4);
+                for (int i = 0; i < 4; i++)
+                    plane.values[i] = coefficients[i];
+                planes.push_back(plane);
+                planes_inliers.push_back(inliers);
+            }
+
+            return !planes.empty();
+        }
+
+    private:
+        bool segmentOrganized(std::vector<pcl::ModelCoefficients>& planes, std::vector<pcl::PointIndices>& planes_inliers)
+        {
+            std::vector<char> alive(input_cloud->points.size(), 0);
+            for (int i = 0; i < (int)input_cloud->points.size(); i++)
+                alive[i] = isFinitePoint(input_cloud->points[i]);
+            std::size_t nr_points = std::count(alive.begin(), alive.end(), 1);
+
+            //-- All the planar regions at once
+            pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
+            NormalEstimator<PointT> normal_estimator;
+            normal_estimator.setInputCloud(input_cloud);
+            normal_estimator.compute(*normals);
+
+            std::vector<pcl::ModelCoefficients> regions;
+            std::vector<pcl::PointIndices> regions_inliers;
+            pcl::OrganizedMultiPlaneSegmentation<PointT, pcl::Normal, pcl::Label> organized_segmentation;
+            organized_segmentation.setInputCloud(input_cloud);
+            organized_segmentation.setInputNormals(normals);
+            organized_segmentation.setDistanceThreshold(distance_threshold);
+            organized_segmentation.setAngularThreshold(angular_threshold);
+            //-- Region growing over the image finds many small patches, so at least 1% of the points
+            organized_segmentation.setMinInliers(std::max<int>(min_inliers, nr_points / 100));
+            organized_segmentation.segment(regions, regions_inliers);
+
+            //-- Same order and stop criteria as the peeling loop: largest planes first
+            std::vector<int> order(regions.size());
+            for (std::size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(), CompareInliers(regions_inliers));
+
+            std::size_t n_alive = nr_points;
+            for (std::size_t i = 0; i < order.size(); i++)
+            {
+                if (n_alive <= remaining_points_ratio * nr_points || n_alive < 3)
+                    break;
+                if (max_planes > 0 && (int)planes.size() >= max_planes)
+                    break;
+
+                const pcl::PointIndices& inliers = regions_inliers[order[i]];
+                for (std::size_t j = 0; j < inliers.indices.size(); j++)
+                    if (alive[inliers.indices[j]])
+                    {
+                        alive[inliers.indices[j]] = 0;
+                        n_alive--;
+                    }
+                planes.push_back(regions[order[i]]);
+                planes_inliers.push_back(inliers);
+            }
+
+            remaining.clear();
+            remaining.reserve(n_alive);
+            for (int i = 0; i < (int)alive.size(); i++)
+                if (alive[i])
+                    remaining.push_back(i);
+
+            return !planes.empty();
+        }
+
+        struct CompareInliers {
+            CompareInliers(const std::vector<pcl::PointIndices>& inliers) : inliers(inliers) {}
+            bool operator()(int a, int b) const { return inliers[a].indices.size() > inliers[b].indices.size(); }
+            const std::vector<pcl::PointIndices>& inliers;
+        };
+
+        bool findPlane(Eigen::VectorXf& coefficients, std::vector<int>& inliers)
+        {
+            if (candidate_regions > 1 && remaining.size() >= 3 * (std::size_t)candidate_regions)
+            {
+                //-- Split the remaining points in bands along their widest horizontal axis
+                std::vector<std::vector<int> > regions;
+                splitInRegions(regions);
+
+                //-- Look for a candidate plane in each region concurrently
+                std::vector<Eigen::VectorXf> candidates(regions.size());
+                std::vector<char> valid(regions.size(), 0);
+                #pragma omp parallel for schedule(dynamic)
+                for (int i = 0; i < (int)regions.size(); i++)
+                    valid[i] = fitPlaneRANSAC(regions[i], candidates[i]);
+
+                //-- Keep the candidate that explains more remaining points
+                int best_candidate = -1;
+                std::size_t best_count = 0;
+                for (int i = 0; i < (int)candidates.size(); i++)
+                {
+                    if (!valid[i])
+                        continue;
+
+                    std::size_t count = countInliers(candidates[i]);
+                    if (best_candidate < 0 || count > best_count)
+                    {
+                        best_candidate = i;
+                        best_count = count;
+                    }
+                }
+
+                if (best_candidate < 0)
+                    return false;
+                coefficients = candidates[best_candidate];
+            }
+            else
+            {
+                if (!fitPlaneRANSAC(remaining, coefficients))
+                    return false;
+            }
+
+            selectInliers(coefficients, inliers);
+
+            //-- Least-squares refinement with all the inliers of the winning plane
+            if (optimize_coefficients && inliers.size() >= 3)
+            {
+                Eigen::VectorXf optimized_coefficients;
+                pcl::SampleConsensusModelPlane<PointT> model(input_cloud, inliers);
+                model.optimizeModelCoefficients(inliers, coefficients, optimized_coefficients);
+                if (optimized_coefficients.size() == 4)
+                {
+                    coefficients = optimized_coefficients;
+                    selectInliers(coefficients, inliers);
+                }
+            }
+
+            return !inliers.empty();
+        }
+
+        bool fitPlaneRANSAC(const std::vector<int>& indices, Eigen::VectorXf& coefficients)
+        {
+            if (indices.size() < 3)
+                return false;
+
+            PlaneModelPtr model(new pcl::SampleConsensusModelPlane<PointT>(input_cloud, indices));
+            pcl::RandomSampleConsensus<PointT> ransac(model, distance_threshold);
+            ransac.setMaxIterations(max_iterations);
+            ransac.setProbability(0.99);
+            if (!ransac.computeModel())
+                return false;
+
+            ransac.getModelCoefficients(coefficients);
+            return coefficients.size() == 4;
+        }
+
+        void splitInRegions(std::vector<std::vector<int> >& regions)
+        {
+            float min_x = std::numeric_limits<float>::max(), max_x = -std::numeric_limits<float>::max();
+            float min_y = std::numeric_limits<float>::max(), max_y = -std::numeric_limits<float>::max();
+            for (std::size_t i = 0; i < remaining.size(); i++)
+            {
+                const PointT& point = input_cloud->points[remaining[i]];
+                min_x = std::min(min_x, point.x); max_x = std::max(max_x, point.x);
+                min_y = std::min(min_y, point.y); max_y = std::max(max_y, point.y);
+            }
+
+            bool split_x = (max_x - min_x) >= (max_y - min_y);
+            float min_value = split_x ? min_x : min_y;
+            float band_size = (split_x ? max_x - min_x : max_y - min_y) / candidate_regions;
+
+            regions.assign(candidate_regions, std::vector<int>());
+            for (std::size_t i = 0; i < remaining.size(); i++)
+            {
+                const PointT& point = input_cloud->points[remaining[i]];
+                int region = band_size > 0 ? (int)(((split_x ? point.x : point.y) - min_value) / band_size) : 0;
+                if (region >= candidate_regions) region = candidate_regions-1;
+                regions[region].push_back(remaining[i]);
+            }
+        }
+
+        std::size_t countInliers(const Eigen::VectorXf& coefficients) const
+        {
+            long count = 0;
+            #pragma omp parallel for reduction(+:count)
+            for (long i = 0; i < (long)remaining.size(); i++)
+                if (pointToPlaneDistance(input_cloud->points[remaining[i]], coefficients) <= distance_threshold)
+                    count++;
+            return count;
+        }
+
+        void selectInliers(const Eigen::VectorXf& coefficients, std::vector<int>& inliers) const
+        {
+            inliers.clear();
+            for (std::size_t i = 0; i < remaining.size(); i++)
+                if (pointToPlaneDistance(input_cloud->points[remaining[i]], coefficients) <= distance_threshold)
+                    inliers.push_back(remaining[i]);
+        }
+
+        static float pointToPlaneDistance(const PointT& point, const Eigen::VectorXf& coefficients)
+        {
+            return std::abs(coefficients[0]*point.x + coefficients[1]*point.y + coefficients[2]*point.z + coefficients[3]);
+        }
+
+        static bool isFinitePoint(const PointT& point)
+        {
+            return std::isfinite(point.x) && std::isfinite(point.y) && std::isfinite(point.z);
+        }
+
+        PointCloudConstPtr input_cloud;
+        pcl::IndicesConstPtr input_indices;
+        std::vector<int> remaining;
+
+        float distance_threshold;
+        float remaining_points_ratio;
+        int max_planes;
+        int min_inliers;
+        int max_iterations;
+        bool optimize_coefficients;
+        int candidate_regions;
+        bool use_organized;
+        float angular_threshold;
+};
+
+#endif // MULTI_PLANE_SEGMENTATION_HPP
@@ -0,0 +1,72 @@
+#include "PlaneModelCache.hpp"
+
+#include <fstream>
+#include <sstream>
+
+PlaneModelCache::PlaneModelCache()
+{
+    min_inlier_ratio = 0.8;
+}
+
+bool PlaneModelCache::load(const std::string &filename)
+{
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+        return false;
+
+    //-- One plane per line: rig a b c d inlier_ratio
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream line_stream(line);
+        std::string rig;
+        CachedPlane cached_plane;
+        cached_plane.coefficients.resize(4);
+        if (line_stream >> rig >> cached_plane.coefficients[0] >> cached_plane.coefficients[1]
+                        >> cached_plane.coefficients[2] >> cached_plane.coefficients[3]
+                        >> cached_plane.inlier_ratio)
+            planes[rig] = cached_plane;
+    }
+
+    return true;
+}
+
+bool PlaneModelCache::save(const std::string &filename) const
+{
+    std::ofstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Could not write plane cache to " << filename << std::endl;
+        return false;
+    }
+
+    file << "# rig a b c d inlier_ratio" << std::endl;
+    for (std::map<std::string, CachedPlane>::const_iterator it = planes.begin(); it != planes.end(); ++it)
+        file << it->first << " " << it->second.coefficients[0] << " " << it->second.coefficients[1] << " "
+             << it->second.coefficients[2] << " " << it->second.coefficients[3] << " "
+             << it->second.inlier_ratio << std::endl;
+    file.close();
+    return true;
+}
+
+bool PlaneModelCache::getPlane(const std::string &rig, pcl::ModelCoefficients &plane, float &inlier_ratio) const
+{
+    std::map<std::string, CachedPlane>::const_iterator it = planes.find(rig);
+    if (it == planes.end())
+        return false;
+
+    plane.values = it->second.coefficients;
+    inlier_ratio = it->second.inlier_ratio;
+    return true;
+}
+
+void PlaneModelCache::storePlane(const std::string &rig, const pcl::ModelCoefficients &plane, float inlier_ratio)
+{
+    CachedPlane cached_plane;
+    cached_plane.coefficients.assign(plane.values.begin(), plane.values.begin()+4);
+    cached_plane.inlier_ratio = inlier_ratio;
+    planes[rig] = cached_plane;
+}
@@ -0,0 +1,138 @@
+/*
+ * Plane Model Cache
+ *
+ * Stores the last plane found for each rig (ironing board, unfolding table...) in a
+ * text file, so that consecutive scans of the same rig do not need to re-discover it
+ * with RANSAC. The cached plane is checked against the new cloud by its inlier ratio
+ * and, if it still holds, it is refined with a cheap least-squares fit.
+ *
+ */
+
+#ifndef PLANE_MODEL_CACHE_HPP
+#define PLANE_MODEL_CACHE_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+#include <pcl/sample_consensus/sac_model_plane.h>
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+class PlaneModelCache
+{
+    public:
+        PlaneModelCache();
+
+        bool load(const std::string& filename);
+        bool save(const std::string& filename) const;
+
+        //-- Fraction of the cached inlier ratio that the new cloud has to keep to accept the plane
+        void setMinInlierRatio(float min_inlier_ratio) { this->min_inlier_ratio = min_inlier_ratio; }
+
+        bool getPlane(const std::string& rig, pcl::ModelCoefficients& plane, float& inlier_ratio) const;
+        void storePlane(const std::string& rig, const pcl::ModelCoefficients& plane, float inlier_ratio);
+
+        template<typename PointT>
+        bool refit(const std::string& rig, const typename pcl::PointCloud<PointT>::ConstPtr& cloud,
+                   float distance_threshold, pcl::ModelCoefficients& plane, pcl::PointIndices& inliers);
+
+        template<typename PointT>
+        static float computeInlierRatio(const pcl::PointCloud<PointT>& cloud, const pcl::ModelCoefficients& plane,
+                                        float distance_threshold);
+
+    private:
+        template<typename PointT>
+        static void selectInliers(const pcl::PointCloud<PointT>& cloud, const std::vector<float>& plane,
+                                  float distance_threshold, std::vector<int>& inliers, int& n_finite);
+
+        struct CachedPlane {
+            std::vector<float> coefficients;
+            float inlier_ratio;
+        };
+
+        std::map<std::string, CachedPlane> planes;
+        float min_inlier_ratio;
+};
+
+template<typename PointT>
+bool PlaneModelCache::refit(const std::string& rig, const typename pcl::PointCloud<PointT>::ConstPtr& cloud,
+                            float distance_threshold, pcl::ModelCoefficients& plane, pcl::PointIndices& inliers)
+{
+    pcl::ModelCoefficients cached_plane;
+    float cached_inlier_ratio;
+    if (!getPlane(rig, cached_plane, cached_inlier_ratio))
+        return false;
+
+    //-- Check that the cached plane still explains the new cloud
+    int n_finite = 0;
+    selectInliers(*cloud, cached_plane.values, distance_threshold, inliers.indices, n_finite);
+    float inlier_ratio = n_finite > 0 ? inliers.indices.size() / (float) n_finite : 0;
+    if (inliers.indices.size() < 3 || inlier_ratio < min_inlier_ratio * cached_inlier_ratio)
+    {
+        std::cout << "Cached plane for \"" << rig << "\" does not hold (inlier ratio: " << inlier_ratio
+                  << ", cached: " << cached_inlier_ratio << ")" << std::endl;
+        return false;
+    }
+
+    //-- Least-squares refit with the inliers of the cached plane
+    Eigen::VectorXf coefficients(4), refined_coefficients;
+    for (int i = 0; i < 4; i++)
+        coefficients[i] = cached_plane.values[i];
+
+    pcl::SampleConsensusModelPlane<PointT> model(cloud, inliers.indices);
+    model.optimizeModelCoefficients(inliers.indices, coefficients, refined_coefficients);
+    if (refined_coefficients.size() != 4)
+        return false;
+
+    //-- Keep the orientation of the cached normal
+    if (refined_coefficients.head(3).dot(coefficients.head(3)) < 0)
+        refined_coefficients = -refined_coefficients;
+
+    plane.values.resize(4);
+    for (int i = 0; i < 4; i++)
+        plane.values[i] = refined_coefficients[i];
+    selectInliers(*cloud, plane.values, distance_threshold, inliers.indices, n_finite);
+
+    std::cout << "Using cached plane for \"" << rig << "\" (inlier ratio: " << inlier_ratio << ")" << std::endl;
+    storePlane(rig, plane, n_finite > 0 ? inliers.indices.size() / (float) n_finite : 0);
+    return true;
+}
+
+template<typename PointT>
+float PlaneModelCache::computeInlierRatio(const pcl::PointCloud<PointT>& cloud, const pcl::ModelCoefficients& plane,
+                                          float distance_threshold)
+{
+    std::vector<int> inliers;
+    int n_finite = 0;
+    selectInliers(cloud, plane.values, distance_threshold, inliers, n_finite);
+    return n_finite > 0 ? inliers.size() / (float) n_finite : 0;
+}
+
+template<typename PointT>
+void PlaneModelCache::selectInliers(const pcl::PointCloud<PointT>& cloud, const std::vector<float>& plane,
+                                    float distance_threshold, std::vector<int>& inliers, int& n_finite)
+{
+    //-- Normalize the plane so that the residual is the point to plane distance
+    float norm = std::sqrt(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+    float a = plane[0]/norm, b = plane[1]/norm, c = plane[2]/norm, d = plane[3]/norm;
+
+    inliers.clear();
+    n_finite = 0;
+    for (int i = 0; i < (int)cloud.points.size(); i++)
+    {
+        const PointT& point = cloud.points[i];
+        if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+            continue;
+
+        n_finite++;
+        if (std::abs(a*point.x + b*point.y + c*point.z + d) <= distance_threshold)
+            inliers.push_back(i);
+    }
+}
+
+#endif // PLANE_MODEL_CACHE_HPP
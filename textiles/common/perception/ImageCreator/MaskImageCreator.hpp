@@ -3,10 +3,11 @@
 
 #include <pcl/point_cloud.h>
 #include <pcl/filters/filter.h>
-#include <pcl/features/moment_of_inertia_estimation.h>
-#include <pcl/filters/extract_indices.h>
 
 #include <cmath>
+#include <iostream>
+
+#include "CloudView.hpp"
 
 template<typename PointT>
 class MaskImageCreator
@@ -19,6 +20,9 @@ class MaskImageCreator
         }
 
         void setInputPointCloud(const PointCloudConstPtr& pc) { point_cloud = pc; }
+        //-- Rasterize only a subset of the input cloud (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->indices = indices; }
+        void setInputCloudView(const CloudView<PointT>& view) { point_cloud = view.getCloud(); indices = view.getIndices(); }
         void setAvgPointDist(const float& average_point_distance) { this->average_point_distance = average_point_distance; }
         void setBoundingBox(PointT min_point_bb, PointT max_point_bb)
         {
@@ -37,38 +41,22 @@ class MaskImageCreator
                 return false;
             }
 
+            //-- Select the points to rasterize (without copying them)
             float lowest_height_limit = 0;
-            typename pcl::PointCloud<PointT>::Ptr filtered_cloud(new pcl::PointCloud<PointT>);
+            CloudView<PointT> filtered_view(point_cloud, indices);
             if (!user_defined_bb)
             {
-                *filtered_cloud = *point_cloud;
-
                 //-- Find bounding box of input point_cloud
-                pcl::MomentOfInertiaEstimation<PointT> feature_extractor;
-                feature_extractor.setInputCloud(filtered_cloud);
-                feature_extractor.compute();
-                feature_extractor.getAABB(min_point_bb, max_point_bb);
+                filtered_view.getMinMax3D(min_point_bb, max_point_bb);
                 lowest_height_limit = min_point_bb.z;
             }
             else
             {
                 //-- User defined bounding box to use: filter the cloud with the bounding box
                 lowest_height_limit = min_point_bb.z;
-                pcl::octree::OctreePointCloudSearch<PointT> octree(average_point_distance/2.0f);
-                std::vector<int> points_within_bounding_box;
                 Eigen::Vector3f min_bb(min_point_bb.x, min_point_bb.y, lowest_height_limit);
                 Eigen::Vector3f max_bb(max_point_bb.x, max_point_bb.y, 1);
-                octree.setInputCloud(point_cloud->makeShared());
-                octree.addPointsFromInputCloud();
-                octree.boxSearch(min_bb, max_bb, points_within_bounding_box);
-
-                pcl::ExtractIndices<PointT> extract_indices;
-                pcl::PointIndices::Ptr indices(new pcl::PointIndices);
-                indices->indices= points_within_bounding_box;
-                extract_indices.setInputCloud(point_cloud);
-                extract_indices.setIndices(indices);
-                extract_indices.setNegative(false);
-                extract_indices.filter(*filtered_cloud);
+                filtered_view = filtered_view.cropBox(min_bb, max_bb);
             }
 
             //-- Calculate image resolution
@@ -86,13 +74,13 @@ class MaskImageCreator
 
             //-- Loop through those points to get RGBD data
             #pragma omp parallel for
-            for (int i = 0; i < filtered_cloud->points.size(); i++)
+            for (int i = 0; i < (int)filtered_view.size(); i++)
             {
-                if (isnan(filtered_cloud->points[i].x) || isnan(filtered_cloud->points[i].y ))
+                if (isnan(filtered_view[i].x) || isnan(filtered_view[i].y ))
                     continue;
 
-                int index_x = (filtered_cloud->points[i].x-min_point_bb.x) / average_point_distance;
-                int index_y = (max_point_bb.y - filtered_cloud->points[i].y) / average_point_distance;
+                int index_x = (filtered_view[i].x-min_point_bb.x) / average_point_distance;
+                int index_y = (max_point_bb.y - filtered_view[i].y) / average_point_distance;
 
                 if (index_x >= width) index_x = width-1;
                 if (index_y >= height) index_y = height-1;
@@ -112,6 +100,7 @@ class MaskImageCreator
 
     private:
         PointCloudConstPtr point_cloud;
+        pcl::IndicesConstPtr indices;
         float average_point_distance;
         //-- Bounding Box
         bool user_defined_bb;
@@ -0,0 +1 @@
+#include "WiLDImageCreator.hpp"
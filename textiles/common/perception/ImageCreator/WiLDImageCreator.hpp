@@ -0,0 +1,212 @@
+/*
+ * WiLD Image Creator
+ *
+ * WiLD computed in image space. The mean dot product of a normal with the normals of its
+ * neighbors is the dot product of the normal with the mean of the neighbor normals, and on
+ * a raster that mean is a box filter:
+ *  1. Normals are splatted into a 3-channel image of normal sums, plus a point count image
+ *  2. Summed-area tables of the four images are built
+ *  3. The WiLD of each pixel is the dot product of its mean normal with the sum of the normals
+ *     in a window around it, divided by the number of points in the window: O(1) per pixel
+ *
+ * The window is the square with the same area as the disc of the WiLD radius. The depth (highest
+ * z) and mask images come out of the same pass over the points.
+ *
+ */
+
+#ifndef __WiLDImageCreator_HPP__
+#define __WiLDImageCreator_HPP__
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "CloudView.hpp"
+
+template<typename PointT, typename NormalT = pcl::Normal>
+class WiLDImageCreator
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    typedef typename pcl::PointCloud<NormalT>::ConstPtr NormalCloudConstPtr;
+
+    public:
+        WiLDImageCreator() {
+            //-- Set default values
+            user_defined_bb = false;
+            average_point_distance = 0.005;
+            radius = 0.03;
+            window_radius = 0;
+        }
+
+        void setInputPointCloud(const PointCloudConstPtr& pc) { point_cloud = pc; }
+        //-- One normal per point of the input cloud
+        void setInputNormals(const NormalCloudConstPtr& normals) { this->normals = normals; }
+        //-- Rasterize only a subset of the input cloud (optional)
+        void setIndices(const pcl::IndicesConstPtr& indices) { this->indices = indices; }
+        void setInputCloudView(const CloudView<PointT>& view) { point_cloud = view.getCloud(); indices = view.getIndices(); }
+        void setAvgPointDist(const float& average_point_distance) { this->average_point_distance = average_point_distance; }
+        void setRadius(float radius) { this->radius = radius; }
+        void setBoundingBox(PointT min_point_bb, PointT max_point_bb)
+        {
+            this->min_point_bb = min_point_bb;
+            this->max_point_bb = max_point_bb;
+            this->user_defined_bb = true;
+        }
+
+        Eigen::MatrixXf getWiLDImageAsMatrix() { return wild_image; }
+        Eigen::MatrixXf getDepthImageAsMatrix() { return depth_image; }
+        Eigen::MatrixXd getMaskAsMatrix() { return mask; }
+        //-- Sum of the normals of the points in each pixel
+        Eigen::MatrixXf getNormalImageAsMatrix(const int& channel) { return normal_image[channel]; }
+        //-- Top left corner of the images
+        PointT getOrigin() const { PointT origin = min_point_bb; origin.y = max_point_bb.y; return origin; }
+        //-- Half size of the window, in pixels
+        int getWindowRadius() const { return window_radius; }
+
+        //-- Pixel of a point (false if it falls outside the images)
+        bool getPixel(const PointT& point, int& row, int& col) const
+        {
+            if (!std::isfinite(point.x) || !std::isfinite(point.y))
+                return false;
+
+            col = std::min<int>((point.x - min_point_bb.x) / average_point_distance, wild_image.cols()-1);
+            row = std::min<int>((max_point_bb.y - point.y) / average_point_distance, wild_image.rows()-1);
+            return col >= 0 && row >= 0;
+        }
+
+        bool compute()
+        {
+            if (average_point_distance <= 0)
+            {
+                std::cerr << "Error: average point distance not set" << std::endl;
+                return false;
+            }
+
+            if (!point_cloud || !normals || normals->points.size() != point_cloud->points.size())
+            {
+                std::cerr << "Error: input cloud and normals not set or of different size" << std::endl;
+                return false;
+            }
+
+            //-- Select the points to rasterize (without copying them)
+            CloudView<PointT> filtered_view(point_cloud, indices);
+            if (!user_defined_bb)
+            {
+                //-- Find bounding box of input point_cloud
+                filtered_view.getMinMax3D(min_point_bb, max_point_bb);
+            }
+            else
+            {
+                //-- User defined bounding box to use: filter the cloud with the bounding box
+                Eigen::Vector3f min_bb(min_point_bb.x, min_point_bb.y, min_point_bb.z);
+                Eigen::Vector3f max_bb(max_point_bb.x, max_point_bb.y, 1);
+                filtered_view = filtered_view.cropBox(min_bb, max_bb);
+            }
+
+            //-- Calculate image resolution
+            int width = std::ceil(std::abs(max_point_bb.x - min_point_bb.x) / average_point_distance);
+            int height = std::ceil(std::abs(max_point_bb.y - min_point_bb.y) / average_point_distance);
+            std::cout << "Creating 2D image with resolution: " << width << "x" << height << "px" << std::endl;
+
+            //-- Splat normals, depth and mask (a single pass, cheaper than locking every pixel)
+            depth_image = Eigen::MatrixXf::Zero(height, width);
+            wild_image = Eigen::MatrixXf::Zero(height, width);
+            mask = Eigen::MatrixXd::Zero(height, width);
+            Eigen::MatrixXf count = Eigen::MatrixXf::Zero(height, width);
+            for (int c = 0; c < 3; c++)
+                normal_image[c] = Eigen::MatrixXf::Zero(height, width);
+
+            for (int i = 0; i < (int)filtered_view.size(); i++)
+            {
+                const PointT& point = filtered_view[i];
+                const NormalT& normal = normals->points[filtered_view.index(i)];
+                int row, col;
+                //-- Invalid normals (NaN, or zeroed) are not splatted
+                if (!getPixel(point, row, col) || !std::isfinite(normal.normal_x)
+                        || (normal.normal_x == 0 && normal.normal_y == 0 && normal.normal_z == 0))
+                    continue;
+
+                if (point.z > depth_image(row, col))
+                    depth_image(row, col) = point.z;
+                mask(row, col) = 1;
+                count(row, col) += 1;
+                normal_image[CHANNEL_X](row, col) += normal.normal_x;
+                normal_image[CHANNEL_Y](row, col) += normal.normal_y;
+                normal_image[CHANNEL_Z](row, col) += normal.normal_z;
+            }
+
+            //-- Summed-area tables (double, so large windows do not lose precision)
+            Eigen::MatrixXd count_table, normal_table[3];
+            computeSummedAreaTable(count, count_table);
+            for (int c = 0; c < 3; c++)
+                computeSummedAreaTable(normal_image[c], normal_table[c]);
+
+            //-- WiLD of each pixel with points
+            window_radius = std::max(0, (int)std::floor(radius * std::sqrt(M_PI) / 2 / average_point_distance + 0.5f));
+
+            #pragma omp parallel for schedule(static)
+            for (int row = 0; row < height; row++)
+            {
+                int top = std::max(0, row - window_radius), bottom = std::min(height, row + window_radius + 1);
+                for (int col = 0; col < width; col++)
+                {
+                    if (count(row, col) == 0)
+                        continue;
+
+                    int left = std::max(0, col - window_radius), right = std::min(width, col + window_radius + 1);
+                    double n_neighbors = boxSum(count_table, top, left, bottom, right);
+                    double dot = 0;
+                    for (int c = 0; c < 3; c++)
+                        dot += normal_image[c](row, col) * boxSum(normal_table[c], top, left, bottom, right);
+                    wild_image(row, col) = dot / (count(row, col) * n_neighbors);
+                }
+            }
+            return true;
+        }
+
+    static const int CHANNEL_X = 0;
+    static const int CHANNEL_Y = 1;
+    static const int CHANNEL_Z = 2;
+
+    private:
+        //-- Table with one extra row and column of zeros: table(i, j) is the sum of image(0:i, 0:j)
+        static void computeSummedAreaTable(const Eigen::MatrixXf& image, Eigen::MatrixXd& table)
+        {
+            table = Eigen::MatrixXd::Zero(image.rows()+1, image.cols()+1);
+            for (int row = 0; row < image.rows(); row++)
+            {
+                double row_sum = 0;
+                for (int col = 0; col < image.cols(); col++)
+                {
+                    row_sum += image(row, col);
+                    table(row+1, col+1) = table(row, col+1) + row_sum;
+                }
+            }
+        }
+
+        //-- Sum of the pixels in rows [top, bottom) and columns [left, right)
+        static double boxSum(const Eigen::MatrixXd& table, int top, int left, int bottom, int right)
+        {
+            return table(bottom, right) - table(top, right) - table(bottom, left) + table(top, left);
+        }
+
+        PointCloudConstPtr point_cloud;
+        NormalCloudConstPtr normals;
+        pcl::IndicesConstPtr indices;
+        float average_point_distance;
+        float radius;
+        int window_radius;
+        //-- Bounding Box
+        bool user_defined_bb;
+        PointT min_point_bb, max_point_bb;
+        //-- Output images
+        Eigen::MatrixXf normal_image[3];
+        Eigen::MatrixXf depth_image;
+        Eigen::MatrixXf wild_image;
+        Eigen::MatrixXd mask;
+};
+
+#endif // __WiLDImageCreator_HPP__
@@ -9,11 +9,12 @@
 
 #include <pcl/point_cloud.h>
 #include <pcl/filters/filter.h>
-#include <pcl/features/moment_of_inertia_estimation.h>
 #include <pcl/surface/mls.h> //-- Upsampling
 
 #include <cmath>
 
+#include "CloudView.hpp"
+
 template<typename PointT>
 class ZBufferDepthImageCreator
 {
@@ -52,9 +53,10 @@ class ZBufferDepthImageCreator
             }
 
             //-- Upsampling (if enabled)
-            typename pcl::PointCloud<PointT>::Ptr processed_cloud(new pcl::PointCloud<PointT>);
+            PointCloudConstPtr processed_cloud = point_cloud;
             if (do_upsampling)
             {
+                typename pcl::PointCloud<PointT>::Ptr upsampled_cloud(new pcl::PointCloud<PointT>);
                 pcl::MovingLeastSquares<PointT, PointT> mls_filter;
                 typename pcl::search::KdTree<PointT>::Ptr kd_tree;
                 mls_filter.setInputCloud(point_cloud);
@@ -63,39 +65,28 @@ class ZBufferDepthImageCreator
                 mls_filter.setUpsamplingMethod(pcl::MovingLeastSquares<PointT, PointT>::SAMPLE_LOCAL_PLANE);
                 mls_filter.setUpsamplingRadius(0.03);
                 mls_filter.setUpsamplingStepSize(0.02);
-                mls_filter.process(*processed_cloud);
+                mls_filter.process(*upsampled_cloud);
 
                 std::cout << "Upsampling from " << point_cloud->points.size()
-                          << " points to " << processed_cloud->points.size()
+                          << " points to " << upsampled_cloud->points.size()
                           << " points." << std::endl;
 
                 std::vector<int> mapping;
-                pcl::removeNaNFromPointCloud(*processed_cloud, *processed_cloud, mapping);
+                pcl::removeNaNFromPointCloud(*upsampled_cloud, *upsampled_cloud, mapping);
 
-                std::cout << "After NaN removal: " << processed_cloud->points.size() << " points." << std::endl;
+                std::cout << "After NaN removal: " << upsampled_cloud->points.size() << " points." << std::endl;
 
-                if (processed_cloud->points.size() == 0)
+                if (upsampled_cloud->points.size() == 0)
                 {
                     std::cerr << "Some error happened at upsampling state. Aborting..." << std::endl;
                     return false;
                 }
-            }
-            else
-            {
-                *processed_cloud = *point_cloud;
+                processed_cloud = upsampled_cloud;
             }
 
             //-- Find bounding box of input point_cloud
-            pcl::MomentOfInertiaEstimation<PointT> feature_extractor;
             PointT min_point_AABB, max_point_AABB;
-            PointT min_point_OBB,  max_point_OBB;
-            PointT position_OBB;
-            Eigen::Matrix3f rotational_matrix_OBB;
-
-            feature_extractor.setInputCloud(processed_cloud);
-            feature_extractor.compute();
-            feature_extractor.getAABB(min_point_AABB, max_point_AABB);
-            feature_extractor.getOBB(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB);
+            CloudView<PointT>(processed_cloud).getMinMax3D(min_point_AABB, max_point_AABB);
 
             //-- Calculate aspect ratio and bin size
             /* Note: if not using std::abs, floating abs function seems to be
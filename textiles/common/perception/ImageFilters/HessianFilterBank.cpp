@@ -0,0 +1,166 @@
+#include "HessianFilterBank.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+HessianFilterBank::HessianFilterBank()
+{
+    //-- Set default values (same as skimage's frangi)
+    setScaleRange(1, 10, 2);
+    beta = 0.5;
+    c = 15;
+    black_ridges = true;
+    tile_width = 128;
+}
+
+void HessianFilterBank::setScaleRange(float min_scale, float max_scale, float scale_step)
+{
+    scales.clear();
+    for (float scale = min_scale; scale < max_scale && scale_step > 0; scale += scale_step)
+        scales.push_back(scale);
+}
+
+bool HessianFilterBank::compute()
+{
+    frangi.resize(0, 0);
+    shape_index.clear();
+
+    if (image.size() == 0)
+    {
+        std::cerr << "Error: input image not set" << std::endl;
+        return false;
+    }
+
+    if (scales.empty() || *std::min_element(scales.begin(), scales.end()) <= 0 || tile_width <= 0)
+    {
+        std::cerr << "Error: scales and tile width must be positive" << std::endl;
+        return false;
+    }
+
+    frangi = Eigen::MatrixXf::Zero(image.rows(), image.cols());
+    shape_index.resize(scales.size(), Eigen::MatrixXf(image.rows(), image.cols()));
+
+    int n_tiles = (image.cols() + tile_width - 1) / tile_width;
+    #pragma omp parallel
+    {
+        std::vector<Eigen::MatrixXf> buffers;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int tile = 0; tile < n_tiles; tile++)
+            filterTile(tile * tile_width, std::min<int>((tile + 1) * tile_width, image.cols()), buffers);
+    }
+    return true;
+}
+
+int HessianFilterBank::getKernelRadius(float sigma)
+{
+    return std::max(1, (int)(4 * sigma + 0.5f));
+}
+
+void HessianFilterBank::computeKernels(float sigma, int radius, std::vector<Eigen::VectorXf>& kernels)
+{
+    //-- The sampled Gaussian is normalized to sum 1
+    kernels.assign(3, Eigen::VectorXf(2 * radius + 1));
+    float variance = sigma * sigma;
+    for (int j = 0; j <= 2 * radius; j++)
+    {
+        float x = j - radius;
+        kernels[0][j] = std::exp(-x * x / (2 * variance));
+    }
+    kernels[0] /= kernels[0].sum();
+
+    for (int j = 0; j <= 2 * radius; j++)
+    {
+        float x = j - radius;
+        kernels[1][j] = -x / variance * kernels[0][j];
+        kernels[2][j] = (x * x / variance - 1) / variance * kernels[0][j];
+    }
+}
+
+void HessianFilterBank::filterTile(int first_col, int last_col, std::vector<Eigen::MatrixXf>& buffers)
+{
+    int rows = image.rows(), cols = image.cols();
+    int width = last_col - first_col;
+    int halo = getKernelRadius(*std::max_element(scales.begin(), scales.end()));
+
+    //-- Padded input column, column pass (smoothed, first and second derivative along the rows)
+    //-- of the tile and its halo, and the three Hessian components of an output column
+    buffers.resize(5);
+    Eigen::MatrixXf& padded = buffers[0];
+    Eigen::MatrixXf& hessian = buffers[4];
+    padded.resize(rows + 2 * halo, 1);
+    for (int k = 0; k < 3; k++)
+        buffers[1 + k].resize(rows, width + 2 * halo);
+    hessian.resize(rows, 3);
+
+    std::vector<Eigen::VectorXf> kernels;
+    for (int s = 0; s < scales.size(); s++)
+    {
+        float sigma = scales[s];
+        int radius = getKernelRadius(sigma);
+        computeKernels(sigma, radius, kernels);
+
+        //-- Column pass, only over the part of the halo reached by this scale
+        for (int e = halo - radius; e < halo + width + radius; e++)
+        {
+            int col = std::min(std::max(first_col - halo + e, 0), cols - 1);
+            padded.block(0, 0, radius, 1).setConstant(image(0, col));
+            padded.block(radius, 0, rows, 1) = image.col(col);
+            padded.block(radius + rows, 0, radius, 1).setConstant(image(rows - 1, col));
+
+            for (int k = 0; k < 3; k++)
+            {
+                Eigen::MatrixXf& output = buffers[1 + k];
+                output.col(e).setZero();
+                for (int j = 0; j <= 2 * radius; j++)
+                    output.col(e) += kernels[k][j] * padded.block(2 * radius - j, 0, rows, 1);
+            }
+        }
+
+        //-- Row pass: xx = second derivative of the smoothed columns, yy = smoothed second
+        //-- derivative, xy = first derivative of the first derivative
+        const Eigen::MatrixXf& smoothed = buffers[1];
+        const Eigen::MatrixXf& first_derivative = buffers[2];
+        const Eigen::MatrixXf& second_derivative = buffers[3];
+        for (int i = 0; i < width; i++)
+        {
+            hessian.setZero();
+            for (int j = 0; j <= 2 * radius; j++)
+            {
+                int e = halo + i + radius - j;
+                hessian.col(0) += kernels[2][j] * smoothed.col(e);
+                hessian.col(1) += kernels[1][j] * first_derivative.col(e);
+                hessian.col(2) += kernels[0][j] * second_derivative.col(e);
+            }
+            //-- Scale normalization
+            hessian *= sigma * sigma;
+
+            int col = first_col + i;
+            for (int row = 0; row < rows; row++)
+            {
+                //-- Eigenvalues of [xx xy; xy yy], k1 >= k2
+                float xx = hessian(row, 0), xy = hessian(row, 1), yy = hessian(row, 2);
+                float half_trace = (xx + yy) / 2;
+                float root = std::sqrt((xx - yy) * (xx - yy) / 4 + xy * xy);
+                float k1 = half_trace + root, k2 = half_trace - root;
+
+                //-- 2/pi * atan((k1+k2)/(k1-k2)), 0 on flat pixels
+                shape_index[s](row, col) = 2 / (float)M_PI * std::atan2(half_trace, root);
+
+                //-- Vesselness: l2 is the eigenvalue of largest magnitude, positive across dark ridges
+                float l1 = k1, l2 = k2;
+                if (std::abs(l1) > std::abs(l2))
+                    std::swap(l1, l2);
+                if (l2 == 0 || (black_ridges ? l2 < 0 : l2 > 0))
+                    continue;
+
+                float blobness = l1 / l2;
+                float structureness = l1 * l1 + l2 * l2;
+                float vesselness = std::exp(-blobness * blobness / (2 * beta * beta))
+                        * (1 - std::exp(-structureness / (2 * c * c)));
+                frangi(row, col) = std::max(frangi(row, col), vesselness);
+            }
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/*
+ * Hessian Filter Bank
+ *
+ * Multi-scale Hessian of a raster (depth, WiLD...) and the filters built on its eigenvalues,
+ * replacing skimage's frangi / hessian_matrix + hessian_matrix_eigvals:
+ *  - Frangi vesselness (Frangi et al., 1998), maximum over the scales
+ *  - Shape index (Koenderink & van Doorn, 1992) of each scale, 2/pi * atan((k1+k2)/(k1-k2))
+ *
+ * The second derivative of Gaussian kernels are separable, so each Hessian component is a
+ * column pass and a row pass of 1D kernels instead of a 2D convolution. The kernels are
+ * truncated at 4 sigma and normalized as scipy's gaussian_filter (used by skimage), but the
+ * derivatives are taken analytically instead of by finite differences of the smoothed image.
+ * Both passes add whole columns of the (column-major) images, which Eigen vectorizes. The
+ * Hessians are scale-normalized (times sigma^2) and the eigenvalues of the 2x2 Hessians have
+ * a closed form.
+ *
+ * The image is processed in tiles of columns (with a halo for the kernels) in parallel, and
+ * all the scales of a tile are filtered before moving to the next one, so the Hessians of
+ * each scale are never stored for the whole image. Borders replicate the nearest pixel (mode
+ * 'nearest', as CurvatureScanLi), while skimage's hessian_matrix pads with zeros by default.
+ *
+ */
+
+#ifndef __HessianFilterBank_HPP__
+#define __HessianFilterBank_HPP__
+
+#include <Eigen/Core>
+
+#include <vector>
+
+class HessianFilterBank
+{
+    public:
+        HessianFilterBank();
+
+        void setInputImage(const Eigen::MatrixXf& image) { this->image = image; }
+        //-- Gaussian sigmas, in pixels
+        void setScales(const std::vector<float>& scales) { this->scales = scales; }
+        //-- Scales from min_scale to max_scale (exclusive) every scale_step, as skimage's scale_range
+        void setScaleRange(float min_scale, float max_scale, float scale_step);
+        //-- Sensitivity of the vesselness to blobs (beta) and to the Hessian norm (c)
+        void setFrangiParameters(float beta, float c) { this->beta = beta; this->c = c; }
+        //-- Dark ridges (valleys) or bright ones
+        void setBlackRidges(bool black_ridges) { this->black_ridges = black_ridges; }
+        //-- Width of the column tiles processed by each thread
+        void setTileWidth(int tile_width) { this->tile_width = tile_width; }
+
+        bool compute();
+
+        const Eigen::MatrixXf& getFrangi() const { return frangi; }
+        const Eigen::MatrixXf& getShapeIndex(int scale_index) const { return shape_index[scale_index]; }
+        const std::vector<float>& getScales() const { return scales; }
+
+    private:
+        //-- Half width of the kernels of a scale (4 sigma, rounded as scipy)
+        static int getKernelRadius(float sigma);
+        //-- Gaussian and its first and second derivatives, sampled in [-radius, radius]
+        static void computeKernels(float sigma, int radius, std::vector<Eigen::VectorXf>& kernels);
+        void filterTile(int first_col, int last_col, std::vector<Eigen::MatrixXf>& buffers);
+
+        Eigen::MatrixXf image;
+        std::vector<float> scales;
+        float beta;
+        float c;
+        bool black_ridges;
+        int tile_width;
+
+        Eigen::MatrixXf frangi;
+        std::vector<Eigen::MatrixXf> shape_index;
+};
+
+#endif // __HessianFilterBank_HPP__
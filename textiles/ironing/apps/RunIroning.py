@@ -3,13 +3,16 @@ import subprocess
 import logging
 
 import begin
+import numpy as np
 
 from textiles.ironing.perception.ClusteringPointCloudSegmentation import clustering_point_cloud_segmentation_from_file
 from textiles.ironing.perception.WrinkleDetection import detect_wrinkles_from_file
 
 pcl_segmentation_binary = "garmentSegmentation"
+pcl_clustering_binary = "garmentClustering"
 pcl_cleanup_binary = "garmentCleanup"
 pcl_detection_binary = "wrinkleDetection"
+pcl_perception_binary = "ironingPerception"
 pcl_processing_folder = "~/Repositories/textiles/build/textiles/ironing/perception/"
 
 segmented_file_suffix = "-unsegmented.pcd"
@@ -19,18 +22,68 @@ cleaned_file_suffix = "-output.pcd"
 
 @begin.start(auto_convert=True)
 @begin.logging
-def main(input_file, debug=False):
+def main(input_file, debug=False, plane_cache=True, native_clustering=True, in_process=True,
+         raster_wild=False, max_wrinkles=1):
     input_file_absolute = os.path.abspath(os.path.expanduser(input_file))
     input_folder, input_filename = os.path.split(input_file_absolute)
 
+    if in_process:
+        # Whole perception chain in a single program, only the wrinkle images are saved
+        args = [os.path.expanduser(os.path.join(pcl_processing_folder, pcl_perception_binary)),
+                "--normal-threshold",
+                str(0.03)]
+        if plane_cache:
+            args += ["--plane-cache", os.path.join(input_folder, "plane-cache.txt")]
+        if raster_wild:
+            args.append("--raster-wild")
+        if max_wrinkles != 1:  # Batch of strokes, ranked by wrinkle area
+            args += ["--max-wrinkles", str(max_wrinkles)]
+        if debug:
+            args.append("--save-intermediate")
+        args.append(input_file_absolute)
+
+        p = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        out, err = p.communicate()
+
+        if debug:
+            print(str(out))
+            print(str(err))
+
+        # The ironing path is extracted by the same program
+        garment_file = input_file_absolute + segmented_file_suffix + cluster_file_suffix + cleaned_file_suffix
+        path = np.loadtxt(garment_file + "-wrinkle_path.m", dtype=int, ndmin=2)
+        trajectory = [tuple(point) for point in path] if len(path) else None
+        metric = float(np.loadtxt(garment_file + "-wrinkle_metric.m"))
+
+        if max_wrinkles != 1:
+            # One trajectory (x y z points, garment frame) per ranked wrinkle
+            points = np.loadtxt(garment_file + "-trajectories.m", ndmin=2)
+            trajectories = [points[points[:, 0] == k, 1:] for k in np.unique(points[:, 0]).astype(int)] if len(points) else []
+            print("{} wrinkles ranked".format(len(trajectories)))
+            print(trajectories)
+    else:
+        run_program_chain(input_file_absolute, debug, plane_cache, native_clustering)
+
+        # Extract ironing path with Python
+        trajectory, metric = detect_wrinkles_from_file(input_file_absolute + segmented_file_suffix +
+                                                       cluster_file_suffix + cleaned_file_suffix, debug=True)
+    print(trajectory)
+    print(metric)
+
+
+def run_program_chain(input_file_absolute, debug, plane_cache, native_clustering):
+    input_folder, input_filename = os.path.split(input_file_absolute)
+
     # Call the processing program for segmentation
     args = [os.path.expanduser(os.path.join(pcl_processing_folder, pcl_segmentation_binary)),
             "--hsv-s-threshold",  # This is not really used, since we are using clustering
             str(0.4),
             "--hsv-v-threshold",  # This is not really used, since we are using clustering
             str(0.30),
-            "--enable-debug",
-            input_file_absolute]
+            "--enable-debug"]
+    if plane_cache:  # Reuse the board plane found in previous scans of the same folder
+        args += ["--plane-cache", os.path.join(input_folder, "plane-cache.txt")]
+    args.append(input_file_absolute)
 
     p = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
     out, err = p.communicate()
@@ -39,8 +92,20 @@ def main(input_file, debug=False):
         print(str(out))
         print(str(err))
 
-    # Do clustering with Python
-    clustering_point_cloud_segmentation_from_file(input_file_absolute+segmented_file_suffix)
+    if native_clustering:
+        # Call the processing program for clustering
+        args = [os.path.expanduser(os.path.join(pcl_processing_folder, pcl_clustering_binary)),
+                input_file_absolute+segmented_file_suffix]
+
+        p = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        out, err = p.communicate()
+
+        if debug:
+            print(str(out))
+            print(str(err))
+    else:
+        # Do clustering with Python
+        clustering_point_cloud_segmentation_from_file(input_file_absolute+segmented_file_suffix)
 
     # Call the processing program for cleanup
     args = [os.path.expanduser(os.path.join(pcl_processing_folder, pcl_cleanup_binary)),
@@ -66,9 +131,3 @@ def main(input_file, debug=False):
     if debug:
         print(str(out))
         print(str(err))
-
-    # Extract ironing path with Python
-    trajectory, metric = detect_wrinkles_from_file(input_file_absolute + segmented_file_suffix + cluster_file_suffix +
-                                                   cleaned_file_suffix, debug=True)
-    print(trajectory)
-    print(metric)
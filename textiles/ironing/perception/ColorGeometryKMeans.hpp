@@ -0,0 +1,398 @@
+/*
+ * Color Geometry KMeans
+ *
+ * K-means segmentation of a colored cloud using the position of each point (normalized to
+ * [0, 1] on each axis) and its color in HSV, the same features used by
+ * ClusteringPointCloudSegmentation.py. Used to split the garment from the ironing board.
+ *
+ *  - Features are stored by dimension (structure of arrays), so distances to the centroids
+ *    are computed in contiguous loops the compiler can vectorize.
+ *  - Centroids are initialized with k-means++ using a fixed seed, so results are repeatable.
+ *    The best of several initializations (lowest inertia) is kept.
+ *  - With a batch size, mini-batch k-means is used instead of full Lloyd iterations.
+ *  - Clusters are returned sorted by the X coordinate of their centroid.
+ *
+ */
+
+#ifndef COLOR_GEOMETRY_KMEANS_HPP
+#define COLOR_GEOMETRY_KMEANS_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+template<typename PointT>
+class ColorGeometryKMeans
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+    static const int n_features = 6;  //-- x, y, z, h, s, v
+
+    public:
+        ColorGeometryKMeans() {
+            //-- Set default values
+            n_clusters = 2;
+            n_initializations = 10;
+            max_iterations = 300;
+            tolerance = 1e-4;
+            batch_size = 0;
+            seed = 0;
+        }
+
+        void setInputCloud(const PointCloudConstPtr& input_cloud) { this->input_cloud = input_cloud; }
+        void setNumberOfClusters(int n_clusters) { this->n_clusters = n_clusters; }
+        void setInitializations(int n_initializations) { this->n_initializations = n_initializations; }
+        void setMaxIterations(int max_iterations) { this->max_iterations = max_iterations; }
+        //-- Convergence tolerance (relative to the variance of the features)
+        void setTolerance(float tolerance) { this->tolerance = tolerance; }
+        //-- Points per iteration of mini-batch k-means (0: full k-means)
+        void setBatchSize(int batch_size) { this->batch_size = batch_size; }
+        void setSeed(unsigned int seed) { this->seed = seed; }
+
+        //-- Cluster of each point of the input cloud (-1 for invalid points), after segment()
+        const std::vector<int>& getLabels() const { return labels; }
+        //-- Centroids in feature space (n_clusters x 6), in the same order as the clusters
+        const std::vector<float>& getCentroids() const { return centroids; }
+        float getInertia() const { return inertia; }
+
+        bool segment(std::vector<pcl::PointIndices>& clusters)
+        {
+            clusters.clear();
+            if (!input_cloud)
+            {
+                std::cerr << "Error: input cloud not set" << std::endl;
+                return false;
+            }
+
+            computeFeatures();
+            int n = point_indices.size();
+            if (n < n_clusters || n_clusters < 1)
+            {
+                std::cerr << "Error: not enough points for " << n_clusters << " clusters" << std::endl;
+                return false;
+            }
+
+            //-- Keep the best of several runs
+            std::mt19937 generator(seed);
+            std::vector<float> run_centroids;
+            std::vector<int> run_labels;
+            inertia = std::numeric_limits<float>::max();
+            for (int run = 0; run < std::max(1, n_initializations); run++)
+            {
+                initializeCentroids(generator, run_centroids);
+                if (batch_size > 0)
+                    runMiniBatch(generator, run_centroids);
+                else
+                    runLloyd(run_centroids);
+
+                float run_inertia = assign(run_centroids, run_labels);
+                if (run_inertia < inertia)
+                {
+                    inertia = run_inertia;
+                    centroids = run_centroids;
+                    point_labels.swap(run_labels);
+                }
+            }
+
+            //-- Sort clusters by the X coordinate of the centroid
+            std::vector<int> order(n_clusters);
+            for (int c = 0; c < n_clusters; c++)
+                order[c] = c;
+            std::stable_sort(order.begin(), order.end(), CompareX(centroids));
+
+            std::vector<int> rank(n_clusters);
+            std::vector<float> sorted_centroids(centroids.size());
+            for (int c = 0; c < n_clusters; c++)
+            {
+                rank[order[c]] = c;
+                std::copy(centroids.begin() + order[c] * n_features, centroids.begin() + (order[c]+1) * n_features,
+                          sorted_centroids.begin() + c * n_features);
+            }
+            centroids.swap(sorted_centroids);
+
+            labels.assign(input_cloud->points.size(), -1);
+            clusters.resize(n_clusters);
+            for (int c = 0; c < n_clusters; c++)
+                clusters[c].header = input_cloud->header;
+            for (int i = 0; i < n; i++)
+            {
+                int cluster = rank[point_labels[i]];
+                labels[point_indices[i]] = cluster;
+                clusters[cluster].indices.push_back(point_indices[i]);
+            }
+            return true;
+        }
+
+    private:
+        //-- Features of the valid points, one array per dimension
+        void computeFeatures()
+        {
+            const std::vector<PointT, Eigen::aligned_allocator<PointT> >& points = input_cloud->points;
+            point_indices.clear();
+            for (std::size_t i = 0; i < points.size(); i++)
+                if (std::isfinite(points[i].x) && std::isfinite(points[i].y) && std::isfinite(points[i].z))
+                    point_indices.push_back(i);
+
+            int n = point_indices.size();
+            for (int d = 0; d < n_features; d++)
+                features[d].resize(n);
+
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < n; i++)
+            {
+                const PointT& point = points[point_indices[i]];
+                features[0][i] = point.x;
+                features[1][i] = point.y;
+                features[2][i] = point.z;
+
+                //-- HSV in [0, 1], as skimage.color.rgb2hsv
+                float r = point.r / 255.0f, g = point.g / 255.0f, b = point.b / 255.0f;
+                float max = std::max(r, std::max(g, b));
+                float delta = max - std::min(r, std::min(g, b));
+                float h = 0;
+                if (delta > 0)
+                {
+                    if (b == max) h = 4 + (r - g) / delta;
+                    else if (g == max) h = 2 + (b - r) / delta;
+                    else h = (g - b) / delta;
+                    h /= 6;
+                    h -= std::floor(h);
+                }
+                features[3][i] = h;
+                features[4][i] = max > 0 ? delta / max : 0;
+                features[5][i] = max;
+            }
+
+            //-- Position normalized to [0, 1]
+            for (int d = 0; d < 3 && n > 0; d++)
+            {
+                float min = *std::min_element(features[d].begin(), features[d].end());
+                float max = *std::max_element(features[d].begin(), features[d].end());
+                float scale = max > min ? 1.0f / (max - min) : 0;
+                for (int i = 0; i < n; i++)
+                    features[d][i] = (features[d][i] - min) * scale;
+            }
+
+            //-- Tolerance is relative to the mean variance of the features
+            variance = 0;
+            for (int d = 0; d < n_features && n > 0; d++)
+            {
+                double sum = 0, squared_sum = 0;
+                for (int i = 0; i < n; i++)
+                {
+                    sum += features[d][i];
+                    squared_sum += features[d][i] * features[d][i];
+                }
+                variance += (squared_sum - sum * sum / n) / n;
+            }
+            variance /= n_features;
+        }
+
+        //-- Squared distance of points [begin, end) to a centroid
+        void computeDistances(int begin, int end, const float* centroid, float* distances) const
+        {
+            for (int i = begin; i < end; i++)
+                distances[i - begin] = 0;
+            for (int d = 0; d < n_features; d++)
+            {
+                const float* feature = &features[d][0];
+                float value = centroid[d];
+                #pragma omp simd
+                for (int i = begin; i < end; i++)
+                {
+                    float difference = feature[i] - value;
+                    distances[i - begin] += difference * difference;
+                }
+            }
+        }
+
+        //-- Label of each point and total inertia
+        float assign(const std::vector<float>& current_centroids, std::vector<int>& current_labels) const
+        {
+            int n = point_indices.size();
+            current_labels.resize(n);
+            double total = 0;
+
+            #pragma omp parallel reduction(+:total)
+            {
+                std::vector<float> distances(block_size), best(block_size);
+                #pragma omp for schedule(static)
+                for (int begin = 0; begin < n; begin += block_size)
+                {
+                    int end = std::min(n, begin + block_size);
+                    std::fill(best.begin(), best.end(), std::numeric_limits<float>::max());
+                    for (int c = 0; c < n_clusters; c++)
+                    {
+                        computeDistances(begin, end, &current_centroids[c * n_features], &distances[0]);
+                        for (int i = begin; i < end; i++)
+                            if (distances[i - begin] < best[i - begin])
+                            {
+                                best[i - begin] = distances[i - begin];
+                                current_labels[i] = c;
+                            }
+                    }
+                    for (int i = begin; i < end; i++)
+                        total += best[i - begin];
+                }
+            }
+            return total;
+        }
+
+        //-- k-means++: each new centroid is chosen with probability proportional to the squared
+        //-- distance to the closest centroid already chosen
+        void initializeCentroids(std::mt19937& generator, std::vector<float>& current_centroids) const
+        {
+            int n = point_indices.size();
+            current_centroids.assign(n_clusters * n_features, 0);
+
+            std::uniform_int_distribution<int> uniform_index(0, n-1);
+            setCentroid(uniform_index(generator), &current_centroids[0]);
+
+            std::vector<float> closest(n, std::numeric_limits<float>::max()), distances(n);
+            for (int c = 1; c < n_clusters; c++)
+            {
+                computeDistances(0, n, &current_centroids[(c-1) * n_features], &distances[0]);
+                double total = 0;
+                for (int i = 0; i < n; i++)
+                {
+                    closest[i] = std::min(closest[i], distances[i]);
+                    total += closest[i];
+                }
+
+                std::uniform_real_distribution<double> uniform(0, total);
+                double target = uniform(generator);
+                int chosen = n-1;
+                for (int i = 0; i < n; i++)
+                {
+                    target -= closest[i];
+                    if (target <= 0)
+                    {
+                        chosen = i;
+                        break;
+                    }
+                }
+                setCentroid(chosen, &current_centroids[c * n_features]);
+            }
+        }
+
+        void runLloyd(std::vector<float>& current_centroids) const
+        {
+            int n = point_indices.size();
+            std::vector<int> current_labels;
+            for (int iteration = 0; iteration < max_iterations; iteration++)
+            {
+                assign(current_centroids, current_labels);
+
+                //-- New centroids: mean of their points
+                std::vector<double> sums(n_clusters * n_features, 0);
+                std::vector<int> counts(n_clusters, 0);
+                for (int i = 0; i < n; i++)
+                {
+                    int c = current_labels[i];
+                    counts[c]++;
+                    for (int d = 0; d < n_features; d++)
+                        sums[c * n_features + d] += features[d][i];
+                }
+
+                double shift = 0;
+                for (int c = 0; c < n_clusters; c++)
+                    for (int d = 0; d < n_features && counts[c] > 0; d++)
+                    {
+                        float value = sums[c * n_features + d] / counts[c];
+                        float difference = value - current_centroids[c * n_features + d];
+                        shift += difference * difference;
+                        current_centroids[c * n_features + d] = value;
+                    }
+
+                if (shift <= tolerance * variance)
+                    break;
+            }
+        }
+
+        void runMiniBatch(std::mt19937& generator, std::vector<float>& current_centroids) const
+        {
+            int n = point_indices.size();
+            std::uniform_int_distribution<int> uniform_index(0, n-1);
+            std::vector<int> counts(n_clusters, 0);
+            std::vector<int> batch(std::min(batch_size, n));
+            for (int iteration = 0; iteration < max_iterations; iteration++)
+            {
+                for (std::size_t j = 0; j < batch.size(); j++)
+                    batch[j] = uniform_index(generator);
+
+                //-- Each centroid moves towards its points with a decreasing learning rate
+                std::vector<float> previous = current_centroids;
+                for (std::size_t j = 0; j < batch.size(); j++)
+                {
+                    int i = batch[j];
+                    int closest = 0;
+                    float closest_distance = std::numeric_limits<float>::max();
+                    for (int c = 0; c < n_clusters; c++)
+                    {
+                        float distance = 0;
+                        for (int d = 0; d < n_features; d++)
+                        {
+                            float difference = features[d][i] - previous[c * n_features + d];
+                            distance += difference * difference;
+                        }
+                        if (distance < closest_distance)
+                        {
+                            closest_distance = distance;
+                            closest = c;
+                        }
+                    }
+
+                    counts[closest]++;
+                    float learning_rate = 1.0f / counts[closest];
+                    for (int d = 0; d < n_features; d++)
+                        current_centroids[closest * n_features + d] += learning_rate * (features[d][i] - current_centroids[closest * n_features + d]);
+                }
+
+                double shift = 0;
+                for (std::size_t k = 0; k < current_centroids.size(); k++)
+                    shift += (current_centroids[k] - previous[k]) * (current_centroids[k] - previous[k]);
+                if (shift <= tolerance * variance)
+                    break;
+            }
+        }
+
+        void setCentroid(int point, float* centroid) const
+        {
+            for (int d = 0; d < n_features; d++)
+                centroid[d] = features[d][point];
+        }
+
+        struct CompareX {
+            CompareX(const std::vector<float>& centroids) : centroids(centroids) {}
+            bool operator()(int a, int b) const { return centroids[a * n_features] < centroids[b * n_features]; }
+            const std::vector<float>& centroids;
+        };
+
+        static const int block_size = 1024;
+
+        PointCloudConstPtr input_cloud;
+
+        int n_clusters;
+        int n_initializations;
+        int max_iterations;
+        float tolerance;
+        int batch_size;
+        unsigned int seed;
+
+        std::vector<int> point_indices;
+        std::vector<float> features[n_features];
+        double variance;
+
+        std::vector<int> point_labels;
+        std::vector<int> labels;
+        std::vector<float> centroids;
+        float inertia;
+};
+
+#endif // COLOR_GEOMETRY_KMEANS_HPP
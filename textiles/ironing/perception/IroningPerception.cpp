@@ -0,0 +1,789 @@
+#include "IroningPerception.hpp"
+
+#include <pcl/io/pcd_io.h>
+#include <pcl/common/io.h>
+#include <pcl/common/common.h>
+#include <pcl/common/transforms.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/features/moment_of_inertia_estimation.h>
+#include <yarp/os/Time.h>
+
+#include <cfloat>
+#include <limits>
+#include <fstream>
+#include <sstream>
+
+#include "MultiPlaneSegmentation.hpp"
+#include "VoxelGridDownsampler.hpp"
+#include "LargestClusterExtraction.hpp"
+#include "MortonReordering.hpp"
+#include "ColorGeometryKMeans.hpp"
+#include "NormalEstimator.hpp"
+#include "NeighborhoodCache.hpp"
+#include "WiLDEstimator.hpp"
+#include "WiLDImageCreator.hpp"
+
+IroningPerception::Result::Result()
+{
+    board_transform = Eigen::Affine3f::Identity();
+    garment_cluster = -1;
+    garment_transform = Eigen::Affine3f::Identity();
+    wrinkle_metric = 0;
+}
+
+IroningPerception::IroningPerception()
+{
+    //-- Same values used by RunIroning.py
+    ransac_threshold = 0.02;
+    plane_candidates = 1;
+    plane_cache_rig = "ironing_board";
+
+    n_clusters = 2;
+    n_initializations = 10;
+    batch_size = 0;
+
+    cluster_tolerance = 0.005;
+
+    normal_radius = 0.03;
+    wild_radius = 0.03;
+    image_resolution = 0.005;
+    raster_wild = false;
+    use_frangi = false;
+    max_wrinkles = 1;
+    min_wrinkle_area = 0;
+    wrinkle_ranking = WrinklePathExtractor::RANK_BY_AREA;
+    neighborhood_cache.reset(new NeighborhoodCache<PointT>);
+
+    verbose = false;
+}
+
+bool IroningPerception::setPlaneCacheFile(const std::string &plane_cache_file)
+{
+    this->plane_cache_file = plane_cache_file;
+    if (plane_cache_file.empty())
+        return true;
+
+    //-- A missing file is not an error, it will be created with the first plane found
+    if (!std::ifstream(plane_cache_file.c_str()).good())
+        return true;
+    return plane_cache.load(plane_cache_file);
+}
+
+bool IroningPerception::process(const PointCloud::ConstPtr &source_cloud, Result &result)
+{
+    double t_start = yarp::os::Time::now();
+
+    if (!segmentBoard(source_cloud, result))
+        return false;
+    double t_segmentation = yarp::os::Time::now();
+
+    if (!clusterGarment(result))
+        return false;
+    double t_clustering = yarp::os::Time::now();
+
+    if (!cleanupGarment(result))
+        return false;
+    double t_cleanup = yarp::os::Time::now();
+
+    if (!detectWrinkles(result))
+        return false;
+    double t_wrinkles = yarp::os::Time::now();
+
+    if (!extractWrinklePath(result))
+        return false;
+    double t_end = yarp::os::Time::now();
+
+    if (verbose)
+        std::cout << "Board segmentation time: " << t_segmentation - t_start << " seconds." << std::endl
+                  << "Clustering time: " << t_clustering - t_segmentation << " seconds." << std::endl
+                  << "Cleanup time: " << t_cleanup - t_clustering << " seconds." << std::endl
+                  << "Wrinkle detection time: " << t_wrinkles - t_cleanup << " seconds." << std::endl
+                  << "Wrinkle path time: " << t_end - t_wrinkles << " seconds." << std::endl
+                  << "Total perception time: " << t_end - t_start << " seconds." << std::endl;
+    return true;
+}
+
+bool IroningPerception::segmentBoard(const PointCloud::ConstPtr &source_cloud, Result &result)
+{
+    if (!source_cloud || source_cloud->points.empty())
+    {
+        std::cerr << "Error: empty input cloud" << std::endl;
+        return false;
+    }
+
+    //-- Downsample the dataset prior to plane detection (using a leaf size of 1cm)
+    pcl::PointCloud<PointT>::Ptr cloud_filtered(new pcl::PointCloud<PointT>);
+    VoxelGridDownsampler<PointT> voxel_grid;
+    voxel_grid.setInputCloud(source_cloud);
+    voxel_grid.setLeafSize(0.01f, 0.01f, 0.01f);
+    voxel_grid.filter(*cloud_filtered);
+
+    //-- Try first the plane found in the previous scans of the same rig
+    pcl::ModelCoefficients garment_plane;
+    float min_height = FLT_MAX;
+    Eigen::Vector3f garment_projected_center;
+
+    pcl::PointIndices cached_plane_inliers;
+    bool plane_from_cache = plane_cache.refit<PointT>(plane_cache_rig, cloud_filtered, ransac_threshold,
+                                                      garment_plane, cached_plane_inliers);
+
+    //-- Otherwise, detect all possible planes (organized clouds are segmented in image space)
+    std::vector<pcl::ModelCoefficients> all_planes;
+    std::vector<pcl::PointIndices> all_planes_inliers;
+    if (plane_from_cache)
+        all_planes.push_back(garment_plane);
+    else
+    {
+        MultiPlaneSegmentation<PointT> multi_plane_segmentation;
+        multi_plane_segmentation.setInputCloud(source_cloud->isOrganized() ? source_cloud : cloud_filtered);
+        multi_plane_segmentation.setDistanceThreshold(ransac_threshold);
+        multi_plane_segmentation.setRemainingPointsRatio(0.3);
+        multi_plane_segmentation.setCandidateRegions(plane_candidates);
+        if (!multi_plane_segmentation.segment(all_planes, all_planes_inliers))
+            std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
+    }
+
+    //-- Filter planes to obtain garment plane (the cached one is always accepted)
+    Eigen::Vector3f good_orientation(0, -1, -1);
+    good_orientation.normalize();
+    for (int i = 0; i < all_planes.size(); i++)
+    {
+        Eigen::Vector3f normal_vector(all_planes[i].values[0], all_planes[i].values[1], all_planes[i].values[2]);
+        if (!plane_from_cache && std::abs(normal_vector.normalized().dot(good_orientation)) < 0.9)
+            continue;
+
+        //-- Height is the distance from the sensor to its projection on the plane
+        Eigen::Vector3f projected_center = -all_planes[i].values[3] * normal_vector / normal_vector.squaredNorm();
+        float height = projected_center.norm();
+        if (height < min_height)
+        {
+            min_height = height;
+            garment_plane = all_planes[i];
+            garment_projected_center = projected_center;
+        }
+    }
+
+    if (!(min_height < FLT_MAX))
+    {
+        std::cerr << "Garment plane not found!" << std::endl;
+        return false;
+    }
+
+    //-- Remember the garment plane for the next scans of this rig. The file is only written for
+    //-- new planes: refits are kept in memory, so scans of a known rig do no disk I/O
+    if (!plane_from_cache)
+    {
+        plane_cache.storePlane(plane_cache_rig, garment_plane,
+                               PlaneModelCache::computeInlierRatio(*cloud_filtered, garment_plane, ransac_threshold));
+        if (!plane_cache_file.empty())
+            plane_cache.save(plane_cache_file);
+    }
+    result.board_plane = garment_plane;
+
+    //-- Reorient cloud to origin, orienting the plane normal with Z
+    Eigen::Affine3f translation_transform = Eigen::Affine3f::Identity();
+    translation_transform.translation() = -garment_projected_center;
+
+    Eigen::Vector3f normal_vector(garment_plane.values[0], garment_plane.values[1], garment_plane.values[2]);
+    if (normal_vector.dot(Eigen::Vector3f::UnitZ()) >= 0 && normal_vector.dot(Eigen::Vector3f::UnitY()) >= 0)
+        normal_vector = -normal_vector;
+    Eigen::Quaternionf rotation_quaternion = Eigen::Quaternionf().setFromTwoVectors(normal_vector, Eigen::Vector3f::UnitZ());
+    result.board_transform = Eigen::Affine3f(rotation_quaternion * translation_transform);
+
+    //-- Keep the points over the garment table (transformed only once)
+    std::vector<int> board_points;
+    board_points.reserve(source_cloud->points.size());
+    for (int i = 0; i < source_cloud->points.size(); i++)
+    {
+        float z = (result.board_transform * source_cloud->points[i].getVector3fMap())[2];
+        if (z >= -ransac_threshold/2.0f)
+            board_points.push_back(i);
+    }
+
+    result.board_cloud.reset(new PointCloud);
+    pcl::transformPointCloud(*source_cloud, board_points, *result.board_cloud, result.board_transform);
+    result.source_cloud = source_cloud;
+    result.board_indices.swap(board_points);
+    return true;
+}
+
+bool IroningPerception::clusterGarment(Result &result)
+{
+    ColorGeometryKMeans<PointT> kmeans;
+    kmeans.setInputCloud(result.board_cloud);
+    kmeans.setNumberOfClusters(n_clusters);
+    kmeans.setInitializations(n_initializations);
+    kmeans.setBatchSize(batch_size);
+    if (!kmeans.segment(result.clusters))
+    {
+        std::cerr << "Garment clustering failed" << std::endl;
+        return false;
+    }
+
+    //-- Clusters are sorted by X, the garment is the last one
+    result.garment_cluster = result.clusters.size() - 1;
+    return true;
+}
+
+bool IroningPerception::cleanupGarment(Result &result)
+{
+    //-- Euclidean Clustering of the garment cluster (only the largest cluster is kept)
+    const pcl::PointIndices& garment_cluster = result.clusters[result.garment_cluster];
+    LargestClusterExtraction<PointT> largest_cluster_extraction;
+    largest_cluster_extraction.setClusterTolerance(cluster_tolerance);
+    largest_cluster_extraction.setMinClusterSize(100);
+    largest_cluster_extraction.setInputCloud(result.board_cloud);
+    largest_cluster_extraction.setIndices(pcl::IndicesConstPtr(new std::vector<int>(garment_cluster.indices)));
+    if (!largest_cluster_extraction.extractLargest(result.garment_indices))
+    {
+        std::cerr << "No garment cluster found!" << std::endl;
+        return false;
+    }
+
+    //-- Garment points along a Z-order curve, so the descriptors read neighbors close in memory
+    MortonReordering<PointT> morton_reordering;
+    morton_reordering.setInputCloud(result.board_cloud);
+    morton_reordering.setIndices(pcl::IndicesConstPtr(new std::vector<int>(result.garment_indices.indices)));
+    morton_reordering.compute();
+    morton_reordering.apply(result.garment_indices.indices, result.garment_indices.indices);
+
+    //-- Find bounding box
+    pcl::MomentOfInertiaEstimation<PointT> feature_extractor;
+    PointT min_point_OBB, max_point_OBB, position_OBB;
+    Eigen::Matrix3f rotational_matrix_OBB;
+    feature_extractor.setInputCloud(result.board_cloud);
+    feature_extractor.setIndices(pcl::IndicesConstPtr(new std::vector<int>(result.garment_indices.indices)));
+    feature_extractor.compute();
+    feature_extractor.getOBB(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB);
+
+    //-- Center and orient using the principal axes of the bounding box (both at once)
+    Eigen::Affine3f garment_translation_transform = Eigen::Affine3f::Identity();
+    garment_translation_transform.translation() << -position_OBB.x, -position_OBB.y, -position_OBB.z;
+    Eigen::Affine3f garment_rotation_transform = Eigen::Affine3f::Identity();
+    garment_rotation_transform.rotate(rotational_matrix_OBB.inverse());
+    result.garment_transform = garment_rotation_transform * garment_translation_transform;
+
+    result.garment_cloud.reset(new PointCloud);
+    pcl::transformPointCloud(*result.board_cloud, result.garment_indices.indices, *result.garment_cloud, result.garment_transform);
+    return true;
+}
+
+bool IroningPerception::detectWrinkles(Result &result)
+{
+    const PointCloud& garment_cloud = *result.garment_cloud;
+
+    if (result.source_cloud && result.source_cloud->isOrganized())
+    {
+        if (!computeOrganizedWild(result))
+            return false;
+    }
+    else
+    {
+        //-- Find normals (the neighborhoods searched for them are reused for the WiLD)
+        neighborhood_cache->setMaxRadius(raster_wild ? normal_radius : std::max(normal_radius, wild_radius));
+        NormalEstimator<PointT> normal_estimator;
+        result.garment_normals.reset(new pcl::PointCloud<pcl::Normal>);
+        normal_estimator.setInputCloud(result.garment_cloud);
+        normal_estimator.setSearchMethod(neighborhood_cache);
+        normal_estimator.setRadiusSearch(normal_radius);
+        normal_estimator.setViewPoint(0,0,1000);
+        normal_estimator.compute(*result.garment_normals);
+
+        //-- WiLD: mean dot product of the normal of each point with the normals of its neighbors
+        if (!raster_wild)
+        {
+            WiLDEstimator<PointT> wild_estimator;
+            wild_estimator.setInputCloud(result.garment_cloud);
+            wild_estimator.setInputNormals(result.garment_normals);
+            wild_estimator.setSearchMethod(neighborhood_cache);
+            wild_estimator.setRadius(wild_radius);
+            wild_estimator.setLegacyOffset(true);
+            if (!wild_estimator.compute(result.wild))
+                return false;
+        }
+    }
+
+    //-- Raster WiLD: the images come with the descriptors
+    if (raster_wild)
+        return createRasterWildImages(result);
+
+    //-- 2D images of the garment (the cloud is already centered)
+    Eigen::Vector4f min_point, max_point;
+    pcl::getMinMax3D(garment_cloud, min_point, max_point);
+    result.image_origin = pcl::PointXYZ(min_point[0], max_point[1], 0);
+
+    int width = std::ceil(std::abs(max_point[0] - min_point[0]) / image_resolution);
+    int height = std::ceil(std::abs(max_point[1] - min_point[1]) / image_resolution);
+    result.depth_image = Eigen::MatrixXf::Zero(height, width);
+    result.wild_image = Eigen::MatrixXf::Zero(height, width);
+    result.mask_image = Eigen::MatrixXd::Zero(height, width);
+    fillImages(result, Eigen::MatrixXd());
+
+    if (verbose)
+        std::cout << "Created 2D images with resolution: " << width << "x" << height << "px" << std::endl;
+    return true;
+}
+
+bool IroningPerception::updateRegion(const PointCloud::ConstPtr &scan, const std::vector<Eigen::Vector2f> &stroke,
+                                     float stroke_radius, Result &result)
+{
+    Eigen::MatrixXd changed_mask;
+    if (!createStrokeMask(result, stroke, stroke_radius, changed_mask))
+        return false;
+    return updateRegion(scan, changed_mask, result);
+}
+
+bool IroningPerception::updateRegion(const PointCloud::ConstPtr &scan, const Eigen::MatrixXd &changed_mask, Result &result)
+{
+    double t_start = yarp::os::Time::now();
+
+    if (!scan || !result.garment_cloud || !result.garment_normals
+            || result.wild.size() != result.garment_cloud->points.size())
+    {
+        std::cerr << "Error: no scan or no previous results to update" << std::endl;
+        return false;
+    }
+
+    if (changed_mask.rows() != result.mask_image.rows() || changed_mask.cols() != result.mask_image.cols())
+    {
+        std::cerr << "Error: changed region does not match the images" << std::endl;
+        return false;
+    }
+
+    //-- Normals change up to a normal radius away from the changed points, WiLD up to a WiLD
+    //-- radius further, and those need the neighbors of their neighbors
+    int normal_pixels = std::ceil(normal_radius / image_resolution);
+    int wild_pixels = std::ceil(wild_radius / image_resolution);
+    Eigen::MatrixXd normal_region = dilateMask(changed_mask, normal_pixels);
+    Eigen::MatrixXd wild_region = dilateMask(changed_mask, normal_pixels + wild_pixels);
+    Eigen::MatrixXd support_region = dilateMask(changed_mask, std::max(2*normal_pixels, normal_pixels + 2*wild_pixels));
+
+    //-- Merge the cached points outside the changed region with the scan points inside it (only
+    //-- where the garment was, the garment does not grow while ironing)
+    const PointCloud& cached_cloud = *result.garment_cloud;
+    PointCloud::Ptr garment_cloud(new PointCloud);
+    pcl::PointCloud<pcl::Normal>::Ptr garment_normals(new pcl::PointCloud<pcl::Normal>);
+    std::vector<double> wild;
+    garment_cloud->points.reserve(cached_cloud.points.size());
+    garment_normals->points.reserve(cached_cloud.points.size());
+    wild.reserve(cached_cloud.points.size());
+
+    int row, col;
+    for (int i = 0; i < cached_cloud.points.size(); i++)
+    {
+        if (getPixel(result, cached_cloud.points[i], row, col) && changed_mask(row, col) != 0)
+            continue;
+        garment_cloud->points.push_back(cached_cloud.points[i]);
+        garment_normals->points.push_back(result.garment_normals->points[i]);
+        wild.push_back(result.wild[i]);
+    }
+
+    Eigen::Affine3f scan_transform = result.garment_transform * result.board_transform;
+    pcl::Normal no_normal;
+    no_normal.normal_x = no_normal.normal_y = no_normal.normal_z = std::numeric_limits<float>::quiet_NaN();
+    for (int i = 0; i < scan->points.size(); i++)
+    {
+        PointT point = pcl::transformPoint(scan->points[i], scan_transform);
+        if (!getPixel(result, point, row, col) || changed_mask(row, col) == 0 || result.mask_image(row, col) == 0)
+            continue;
+        garment_cloud->points.push_back(point);
+        garment_normals->points.push_back(no_normal);
+        wild.push_back(0);
+    }
+    garment_cloud->width = garment_normals->width = garment_cloud->points.size();
+    garment_cloud->height = garment_normals->height = 1;
+
+    //-- Points needed to recompute the region
+    std::vector<int> local_indices;
+    for (int i = 0; i < garment_cloud->points.size(); i++)
+        if (getPixel(result, garment_cloud->points[i], row, col) && support_region(row, col) != 0)
+            local_indices.push_back(i);
+
+    PointCloud::Ptr local_cloud(new PointCloud);
+    pcl::copyPointCloud(*garment_cloud, local_indices, *local_cloud);
+
+    //-- Normals inside the normal region (the neighborhoods searched for them are reused for the WiLD)
+    neighborhood_cache->setMaxRadius(raster_wild ? normal_radius : std::max(normal_radius, wild_radius));
+    pcl::PointCloud<pcl::Normal>::Ptr local_normals(new pcl::PointCloud<pcl::Normal>);
+    NormalEstimator<PointT> normal_estimator;
+    normal_estimator.setInputCloud(local_cloud);
+    normal_estimator.setSearchMethod(neighborhood_cache);
+    normal_estimator.setRadiusSearch(normal_radius);
+    normal_estimator.setViewPoint(0,0,1000);
+    normal_estimator.compute(*local_normals);
+
+    for (int k = 0; k < local_indices.size(); k++)
+    {
+        getPixel(result, local_cloud->points[k], row, col);
+        if (normal_region(row, col) != 0)
+            garment_normals->points[local_indices[k]] = local_normals->points[k];
+        else
+            local_normals->points[k] = garment_normals->points[local_indices[k]];
+    }
+
+    result.garment_cloud = garment_cloud;
+    result.garment_normals = garment_normals;
+    result.wild.swap(wild);
+
+    //-- Raster WiLD takes milliseconds on the whole garment
+    if (raster_wild)
+        return createRasterWildImages(result) && extractWrinklePath(result);
+
+    //-- WiLD inside the WiLD region
+    std::vector<double> local_wild;
+    WiLDEstimator<PointT> wild_estimator;
+    wild_estimator.setInputCloud(local_cloud);
+    wild_estimator.setInputNormals(local_normals);
+    wild_estimator.setSearchMethod(neighborhood_cache);
+    wild_estimator.setRadius(wild_radius);
+    wild_estimator.setLegacyOffset(true);
+    if (!wild_estimator.compute(local_wild))
+        return false;
+
+    for (int k = 0; k < local_indices.size(); k++)
+    {
+        getPixel(result, local_cloud->points[k], row, col);
+        if (wild_region(row, col) != 0)
+            result.wild[local_indices[k]] = local_wild[k];
+    }
+
+    //-- Patch the images
+    fillImages(result, wild_region);
+
+    if (verbose)
+        std::cout << "Updated " << local_indices.size() << " of " << garment_cloud->points.size() << " points in "
+                  << yarp::os::Time::now() - t_start << " seconds." << std::endl;
+    return extractWrinklePath(result);
+}
+
+bool IroningPerception::extractWrinklePath(Result &result)
+{
+    WrinklePathExtractor wrinkle_path_extractor;
+    wrinkle_path_extractor.setInputImage(result.wild_image);
+    wrinkle_path_extractor.setMask(result.mask_image);
+    wrinkle_path_extractor.setUseFrangi(use_frangi);
+    wrinkle_path_extractor.setDepthImage(result.depth_image);
+    wrinkle_path_extractor.setMaxWrinkles(max_wrinkles);
+    wrinkle_path_extractor.setMinWrinkleArea(min_wrinkle_area);
+    wrinkle_path_extractor.setRanking(wrinkle_ranking);
+    if (!wrinkle_path_extractor.compute())
+        return false;
+
+    result.wrinkle_path = wrinkle_path_extractor.getPath();
+    result.wrinkle_metric = wrinkle_path_extractor.getMetric();
+    result.wrinkles = wrinkle_path_extractor.getWrinkles();
+
+    //-- Pixel centers to the garment frame
+    result.trajectories.resize(result.wrinkles.size());
+    for (int k = 0; k < result.wrinkles.size(); k++)
+    {
+        const std::vector<Eigen::Vector2i>& wrinkle_path = result.wrinkles[k].path;
+        result.trajectories[k].resize(wrinkle_path.size());
+        for (int i = 0; i < wrinkle_path.size(); i++)
+        {
+            int col = wrinkle_path[i][0], row = wrinkle_path[i][1];
+            result.trajectories[k][i] = Eigen::Vector3f(result.image_origin.x + (col + 0.5f) * image_resolution,
+                                                        result.image_origin.y - (row + 0.5f) * image_resolution,
+                                                        result.depth_image(row, col));
+        }
+    }
+    if (result.trajectories.empty())
+        result.trajectory.clear();
+    else
+        result.trajectory = result.trajectories[0];
+
+    if (verbose && result.wrinkle_path.empty())
+        std::cout << "No wrinkles found." << std::endl;
+    return true;
+}
+
+bool IroningPerception::createStrokeMask(const Result &result, const std::vector<Eigen::Vector2f> &stroke,
+                                         float stroke_radius, Eigen::MatrixXd &mask) const
+{
+    if (stroke.empty())
+    {
+        std::cerr << "Error: empty stroke" << std::endl;
+        return false;
+    }
+
+    int height = result.mask_image.rows(), width = result.mask_image.cols();
+    mask = Eigen::MatrixXd::Zero(height, width);
+
+    //-- Pixels whose center is closer to a segment than the radius plus half a pixel diagonal
+    float max_distance = stroke_radius + image_resolution * std::sqrt(0.5f);
+    Eigen::Vector2f origin(result.image_origin.x, result.image_origin.y);
+    for (int i = 0; i < stroke.size(); i++)
+    {
+        const Eigen::Vector2f& start = stroke[i];
+        const Eigen::Vector2f& end = stroke[std::min<int>(i+1, stroke.size()-1)];
+        Eigen::Vector2f segment = end - start;
+        float squared_length = segment.squaredNorm();
+
+        //-- Only the pixels of the bounding box of the segment
+        int min_col = std::max(0, (int)std::floor((std::min(start[0], end[0]) - max_distance - origin[0]) / image_resolution));
+        int max_col = std::min(width-1, (int)std::floor((std::max(start[0], end[0]) + max_distance - origin[0]) / image_resolution));
+        int min_row = std::max(0, (int)std::floor((origin[1] - std::max(start[1], end[1]) - max_distance) / image_resolution));
+        int max_row = std::min(height-1, (int)std::floor((origin[1] - std::min(start[1], end[1]) + max_distance) / image_resolution));
+
+        for (int row = min_row; row <= max_row; row++)
+            for (int col = min_col; col <= max_col; col++)
+            {
+                Eigen::Vector2f center(origin[0] + (col + 0.5f) * image_resolution, origin[1] - (row + 0.5f) * image_resolution);
+                float t = squared_length > 0 ? std::max(0.0f, std::min(1.0f, (center - start).dot(segment) / squared_length)) : 0;
+                if ((start + t * segment - center).norm() <= max_distance)
+                    mask(row, col) = 1;
+            }
+    }
+    return true;
+}
+
+bool IroningPerception::getPixel(const Result &result, const PointT &point, int &row, int &col) const
+{
+    if (!std::isfinite(point.x) || !std::isfinite(point.y))
+        return false;
+
+    //-- Points on the far edges of the bounding box belong to the last pixel
+    float x = (point.x - result.image_origin.x) / image_resolution;
+    float y = (result.image_origin.y - point.y) / image_resolution;
+    if (x < 0 || y < 0 || x > result.mask_image.cols() || y > result.mask_image.rows())
+        return false;
+
+    col = std::min<int>(x, result.mask_image.cols()-1);
+    row = std::min<int>(y, result.mask_image.rows()-1);
+    return true;
+}
+
+void IroningPerception::fillImages(Result &result, const Eigen::MatrixXd &region)
+{
+    const PointCloud& garment_cloud = *result.garment_cloud;
+    bool whole_image = region.size() == 0;
+    if (!whole_image)
+        for (int row = 0; row < region.rows(); row++)
+            for (int col = 0; col < region.cols(); col++)
+                if (region(row, col) != 0)
+                {
+                    result.depth_image(row, col) = 0;
+                    result.wild_image(row, col) = 0;
+                    result.mask_image(row, col) = 0;
+                }
+
+    Eigen::MatrixXi element_count = Eigen::MatrixXi::Zero(result.mask_image.rows(), result.mask_image.cols());
+    for (int i = 0; i < garment_cloud.points.size(); i++)
+    {
+        const PointT& point = garment_cloud.points[i];
+        int index_y, index_x;
+        if (!getPixel(result, point, index_y, index_x) || (!whole_image && region(index_y, index_x) == 0))
+            continue;
+
+        //-- Highest z for the depth image, mean WiLD for the WiLD image
+        if (point.z > result.depth_image(index_y, index_x))
+            result.depth_image(index_y, index_x) = point.z;
+
+        int n_current_bin = ++element_count(index_y, index_x);
+        result.wild_image(index_y, index_x) += (result.wild[i] - result.wild_image(index_y, index_x)) / (float)n_current_bin;
+        result.mask_image(index_y, index_x) = 1;
+    }
+}
+
+Eigen::MatrixXd IroningPerception::dilateMask(const Eigen::MatrixXd &mask, int radius)
+{
+    //-- Square dilation: a pixel is set if the summed-area table has any pixel set in its window
+    int height = mask.rows(), width = mask.cols();
+    Eigen::MatrixXi table = Eigen::MatrixXi::Zero(height+1, width+1);
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+            table(row+1, col+1) = (mask(row, col) != 0) + table(row, col+1) + table(row+1, col) - table(row, col);
+
+    Eigen::MatrixXd dilated = Eigen::MatrixXd::Zero(height, width);
+    for (int row = 0; row < height; row++)
+    {
+        int top = std::max(0, row - radius), bottom = std::min(height, row + radius + 1);
+        for (int col = 0; col < width; col++)
+        {
+            int left = std::max(0, col - radius), right = std::min(width, col + radius + 1);
+            if (table(bottom, right) - table(top, right) - table(bottom, left) + table(top, left) > 0)
+                dilated(row, col) = 1;
+        }
+    }
+    return dilated;
+}
+
+bool IroningPerception::computeOrganizedWild(Result &result)
+{
+    const PointCloud& garment_cloud = *result.garment_cloud;
+    int n = garment_cloud.points.size();
+
+    //-- Pixel of each garment point
+    pcl::IndicesPtr garment_pixels(new std::vector<int>(n));
+    for (int i = 0; i < n; i++)
+        (*garment_pixels)[i] = result.board_indices[result.garment_indices.indices[i]];
+
+    //-- Normals with integral images (on the whole image, in the sensor frame)
+    pcl::PointCloud<pcl::Normal>::Ptr source_normals(new pcl::PointCloud<pcl::Normal>);
+    NormalEstimator<PointT> normal_estimator;
+    normal_estimator.setInputCloud(result.source_cloud);
+    normal_estimator.compute(*source_normals);
+
+    //-- Normals of the garment, moved to the garment frame and flipped towards the same view
+    //-- point as in the unorganized path. Integral images give NaN normals at depth edges and
+    //-- image borders: they are zeroed, so neither WiLD implementation uses them
+    Eigen::Matrix3f rotation = (result.garment_transform * result.board_transform).linear();
+    Eigen::Vector3f view_point(0, 0, 1000);
+    result.garment_normals.reset(new pcl::PointCloud<pcl::Normal>);
+    result.garment_normals->points.resize(n);
+    result.garment_normals->width = n;
+    result.garment_normals->height = 1;
+    for (int i = 0; i < n; i++)
+    {
+        pcl::Normal& source_normal = source_normals->points[(*garment_pixels)[i]];
+        Eigen::Vector3f normal = rotation * source_normal.getNormalVector3fMap();
+        if (!std::isfinite(normal[0]) || !std::isfinite(normal[1]) || !std::isfinite(normal[2]))
+            normal.setZero();
+        else if (normal.dot(view_point - garment_cloud.points[i].getVector3fMap()) < 0)
+            normal = -normal;
+        source_normal.getNormalVector3fMap() = normal;
+        result.garment_normals->points[i] = source_normal;
+    }
+
+    //-- Raster WiLD only needs the normals
+    if (raster_wild)
+        return true;
+
+    //-- WiLD with the neighbors found in a window of pixels among the garment pixels (distances
+    //-- do not change with the transformations, so they are searched in the sensor frame)
+    WiLDEstimator<PointT> wild_estimator;
+    wild_estimator.setInputCloud(result.source_cloud);
+    wild_estimator.setInputNormals(source_normals);
+    wild_estimator.setIndices(garment_pixels);
+    wild_estimator.setRadius(wild_radius);
+    wild_estimator.setLegacyOffset(true);
+    return wild_estimator.compute(result.wild);
+}
+
+bool IroningPerception::createRasterWildImages(Result &result)
+{
+    WiLDImageCreator<PointT> image_creator;
+    image_creator.setInputPointCloud(result.garment_cloud);
+    image_creator.setInputNormals(result.garment_normals);
+    image_creator.setAvgPointDist(image_resolution);
+    image_creator.setRadius(wild_radius);
+    if (!image_creator.compute())
+        return false;
+
+    result.depth_image = image_creator.getDepthImageAsMatrix();
+    result.wild_image = image_creator.getWiLDImageAsMatrix();
+    result.mask_image = image_creator.getMaskAsMatrix();
+    PointT origin = image_creator.getOrigin();
+    result.image_origin = pcl::PointXYZ(origin.x, origin.y, 0);
+
+    //-- Each point gets the WiLD of its pixel
+    const PointCloud& garment_cloud = *result.garment_cloud;
+    result.wild.assign(garment_cloud.points.size(), 0);
+    for (int i = 0; i < garment_cloud.points.size(); i++)
+    {
+        int row, col;
+        if (image_creator.getPixel(garment_cloud.points[i], row, col))
+            result.wild[i] = result.wild_image(row, col);
+    }
+    return true;
+}
+
+std::string IroningPerception::getGarmentFilename(const Result &result, const std::string &input_filename)
+{
+    std::ostringstream filename;
+    filename << input_filename << "-unsegmented.pcd-cluster" << result.garment_cluster << ".pcd-output.pcd";
+    return filename.str();
+}
+
+bool IroningPerception::saveArtifacts(const Result &result, const std::string &input_filename, bool save_intermediate)
+{
+    std::string garment_filename = getGarmentFilename(result, input_filename);
+    bool ok = true;
+
+    if (save_intermediate)
+    {
+        //-- garmentSegmentation
+        std::string board_filename = input_filename + "-unsegmented.pcd";
+        ok &= saveTransform(input_filename + "-transform1.txt", result.board_transform);
+        ok &= pcl::io::savePCDFileBinary(board_filename, *result.board_cloud) >= 0;
+
+        //-- Clustering
+        for (int i = 0; i < result.clusters.size(); i++)
+        {
+            PointCloud cluster_cloud;
+            pcl::copyPointCloud(*result.board_cloud, result.clusters[i], cluster_cloud);
+            std::ostringstream cluster_filename;
+            cluster_filename << board_filename << "-cluster" << i << ".pcd";
+            ok &= pcl::io::savePCDFileBinaryCompressed(cluster_filename.str(), cluster_cloud) >= 0;
+        }
+
+        //-- garmentCleanup
+        std::string cluster_filename = garment_filename.substr(0, garment_filename.size() - std::string("-output.pcd").size());
+        ok &= saveTransform(cluster_filename + "-transform2.txt", result.garment_transform);
+        ok &= pcl::io::savePCDFileBinary(garment_filename, *result.garment_cloud) >= 0;
+
+        //-- wrinkleDetection
+        std::ofstream wild_file((garment_filename + "-wild_descriptors.m").c_str());
+        for (int i = 0; i < result.garment_cloud->points.size(); i++)
+            wild_file << result.garment_cloud->points[i].x << " "
+                      << result.garment_cloud->points[i].y << " "
+                      << result.garment_cloud->points[i].z << " "
+                      << result.wild[i] << "\n";
+        ok &= wild_file.good();
+    }
+
+    std::ofstream origin_file((garment_filename + "-origin.txt").c_str());
+    origin_file << result.image_origin.x << " " << result.image_origin.y << " " << result.image_origin.z;
+    ok &= origin_file.good();
+
+    ok &= saveMatrix(garment_filename + "-depth_image.m", result.depth_image);
+    ok &= saveMatrix(garment_filename + "-wild_image.m", result.wild_image);
+    ok &= saveMatrix(garment_filename + "-image_mask.m", result.mask_image);
+
+    //-- Ironing path: pixels (col row) and garment frame points (x y z), one per line
+    std::ofstream path_file((garment_filename + "-wrinkle_path.m").c_str());
+    std::ofstream trajectory_file((garment_filename + "-trajectory.m").c_str());
+    for (int i = 0; i < result.wrinkle_path.size(); i++)
+    {
+        path_file << result.wrinkle_path[i][0] << " " << result.wrinkle_path[i][1] << "\n";
+        trajectory_file << result.trajectory[i][0] << " " << result.trajectory[i][1] << " " << result.trajectory[i][2] << "\n";
+    }
+    ok &= path_file.good() && trajectory_file.good();
+
+    std::ofstream metric_file((garment_filename + "-wrinkle_metric.m").c_str());
+    metric_file << result.wrinkle_metric;
+    ok &= metric_file.good();
+
+    //-- Ranked wrinkles (area mean_wild volume score) and their trajectories (wrinkle x y z)
+    std::ofstream wrinkles_file((garment_filename + "-wrinkles.m").c_str());
+    std::ofstream trajectories_file((garment_filename + "-trajectories.m").c_str());
+    for (int k = 0; k < result.wrinkles.size(); k++)
+    {
+        const WrinklePathExtractor::Wrinkle& wrinkle = result.wrinkles[k];
+        wrinkles_file << wrinkle.area << " " << wrinkle.mean_wild << " " << wrinkle.volume << " " << wrinkle.score << "\n";
+        for (int i = 0; i < result.trajectories[k].size(); i++)
+            trajectories_file << k << " " << result.trajectories[k][i][0] << " " << result.trajectories[k][i][1]
+                              << " " << result.trajectories[k][i][2] << "\n";
+    }
+    ok &= wrinkles_file.good() && trajectories_file.good();
+
+    if (!ok)
+        std::cerr << "Error saving the results for " << input_filename << std::endl;
+    return ok;
+}
+
+bool IroningPerception::saveTransform(const std::string &filename, const Eigen::Affine3f &transform)
+{
+    std::ofstream file(filename.c_str());
+    file << "# Transformation Matrix:" << std::endl;
+    file << transform.matrix() << std::endl;
+    return file.good();
+}
+
+template<typename MatrixT>
+bool IroningPerception::saveMatrix(const std::string &filename, const MatrixT &matrix)
+{
+    std::ofstream file(filename.c_str());
+    file << matrix;
+    return file.good();
+}
@@ -0,0 +1,205 @@
+/*
+ * Ironing Perception
+ *
+ * The whole ironing perception chain in a single process, with every intermediate result
+ * kept in memory:
+ *  1. Board segmentation: garment plane (from the plane cache or RANSAC), cloud moved to the
+ *     plane frame and points under the board removed (garmentSegmentation)
+ *  2. Clustering: garment and board split by k-means on position and color, the garment being
+ *     the cluster with the largest X (ClusteringPointCloudSegmentation.py)
+ *  3. Cleanup: largest euclidean cluster of the garment, centered and oriented with its
+ *     bounding box (garmentCleanup)
+ *  4. Wrinkle detection: normals, WiLD descriptors and the depth, WiLD and mask images
+ *     (wrinkleDetection). Neighborhoods are searched once, for the normals and the WiLD.
+ *  5. Wrinkle path: ironing trajectory along the skeleton of the largest wrinkle of the WiLD
+ *     image, and the global wrinkle metric (WrinkleDetection.py, see WrinklePathExtractor).
+ *     With setMaxWrinkles() several wrinkles are ranked and get a trajectory, so a batch of
+ *     strokes can be executed per scan
+ *
+ * Organized input clouds (height > 1) take a faster path: planes are found in image space,
+ * normals are computed with integral images on the input cloud and WiLD neighbors are
+ * searched in a window of pixels, so no kd-tree is built at all.
+ *
+ * With setRasterWild() the WiLD descriptors are computed on the images instead (WiLDImageCreator),
+ * which takes milliseconds instead of seconds.
+ *
+ * After an ironing stroke, updateRegion() takes a new scan and the region it changed (a mask of
+ * the images or the stroke polyline) and only recomputes normals, WiLD and images around it. The
+ * wrinkle paths are then extracted again from the whole updated images.
+ *
+ * Stages work on indices of the board cloud instead of copies until the garment is transformed.
+ * The plane cache is kept between calls, so consecutive scans of the same rig skip RANSAC even
+ * without a cache file. Nothing is written to disk unless saveArtifacts() is called, which writes
+ * the same files as the chain of programs did.
+ *
+ */
+
+#ifndef IRONING_PERCEPTION_HPP
+#define IRONING_PERCEPTION_HPP
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+#include <pcl/ModelCoefficients.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "NeighborhoodCache.hpp"
+#include "PlaneModelCache.hpp"
+#include "WrinklePathExtractor.hpp"
+
+class IroningPerception
+{
+    public:
+        typedef pcl::PointXYZRGB PointT;
+        typedef pcl::PointCloud<PointT> PointCloud;
+
+        struct Result {
+            Result();
+
+            //-- Board segmentation
+            PointCloud::ConstPtr source_cloud;
+            pcl::ModelCoefficients board_plane;
+            Eigen::Affine3f board_transform;            //-- Sensor frame to board frame
+            PointCloud::Ptr board_cloud;                //-- Points over the board, in the board frame
+            std::vector<int> board_indices;             //-- Index in source_cloud of each point of board_cloud
+
+            //-- Clustering (indices of board_cloud, sorted by centroid X)
+            std::vector<pcl::PointIndices> clusters;
+            int garment_cluster;
+
+            //-- Cleanup
+            pcl::PointIndices garment_indices;          //-- Largest cluster of the garment, in board_cloud
+            Eigen::Affine3f garment_transform;          //-- Board frame to garment frame
+            PointCloud::Ptr garment_cloud;              //-- Garment points, in the garment frame
+
+            //-- Wrinkle detection
+            pcl::PointCloud<pcl::Normal>::Ptr garment_normals;
+            std::vector<double> wild;                   //-- WiLD descriptor of each garment point
+            Eigen::MatrixXf depth_image;
+            Eigen::MatrixXf wild_image;
+            Eigen::MatrixXd mask_image;
+            pcl::PointXYZ image_origin;                 //-- Garment frame coordinates of the top left pixel
+
+            //-- Wrinkle path (empty if no wrinkle was found)
+            std::vector<Eigen::Vector2i> wrinkle_path;  //-- Pixels (col, row) of the ironing trajectory, from start to end
+            std::vector<Eigen::Vector3f> trajectory;    //-- Same path in the garment frame (pixel centers at their depth)
+            double wrinkle_metric;
+
+            //-- Ranked wrinkles (the first one is the wrinkle path above) and their trajectories
+            std::vector<WrinklePathExtractor::Wrinkle> wrinkles;
+            std::vector<std::vector<Eigen::Vector3f> > trajectories;
+        };
+
+        IroningPerception();
+
+        //-- Board segmentation
+        void setRansacThreshold(float ransac_threshold) { this->ransac_threshold = ransac_threshold; }
+        void setPlaneCandidates(int plane_candidates) { this->plane_candidates = plane_candidates; }
+        //-- File to store the garment plane between runs ("" to keep it only in memory)
+        bool setPlaneCacheFile(const std::string& plane_cache_file);
+        void setPlaneCacheRig(const std::string& plane_cache_rig) { this->plane_cache_rig = plane_cache_rig; }
+
+        //-- Clustering
+        void setClusters(int n_clusters) { this->n_clusters = n_clusters; }
+        void setClusteringInitializations(int n_initializations) { this->n_initializations = n_initializations; }
+        void setClusteringBatchSize(int batch_size) { this->batch_size = batch_size; }
+
+        //-- Cleanup
+        void setClusterTolerance(float cluster_tolerance) { this->cluster_tolerance = cluster_tolerance; }
+
+        //-- Wrinkle detection
+        void setNormalRadius(float normal_radius) { this->normal_radius = normal_radius; }
+        void setWildRadius(float wild_radius) { this->wild_radius = wild_radius; }
+        void setImageResolution(float image_resolution) { this->image_resolution = image_resolution; }
+        float getImageResolution() const { return image_resolution; }
+        //-- Compute WiLD on the rasterized normals with summed-area tables instead of per point
+        //-- (box neighborhood, each point gets the WiLD of its pixel)
+        void setRasterWild(bool raster_wild) { this->raster_wild = raster_wild; }
+        //-- Wrinkle path from the Frangi vesselness of the WiLD image instead of WiLD thresholds
+        void setUseFrangi(bool use_frangi) { this->use_frangi = use_frangi; }
+        //-- Number of ranked wrinkles with a trajectory (0: all of them), minimum wrinkle area (in
+        //-- pixels) and ranking criterion
+        void setMaxWrinkles(int max_wrinkles) { this->max_wrinkles = max_wrinkles; }
+        void setMinWrinkleArea(int min_wrinkle_area) { this->min_wrinkle_area = min_wrinkle_area; }
+        void setWrinkleRanking(WrinklePathExtractor::Ranking wrinkle_ranking) { this->wrinkle_ranking = wrinkle_ranking; }
+
+        //-- Print the time spent in each stage
+        void setVerbose(bool verbose) { this->verbose = verbose; }
+
+        //-- Whole chain
+        bool process(const PointCloud::ConstPtr& source_cloud, Result& result);
+
+        //-- Single stages (each one needs the results of the previous ones)
+        bool segmentBoard(const PointCloud::ConstPtr& source_cloud, Result& result);
+        bool clusterGarment(Result& result);
+        bool cleanupGarment(Result& result);
+        bool detectWrinkles(Result& result);
+        bool extractWrinklePath(Result& result);
+
+        //-- Incremental update after an ironing stroke: normals, WiLD and images are only recomputed
+        //-- around the changed region, and patched into the results of the previous scan. The scan
+        //-- must be registered to the previous one (same sensor frame). Board and clustering results
+        //-- are kept from the previous scan
+        bool updateRegion(const PointCloud::ConstPtr& scan, const Eigen::MatrixXd& changed_mask, Result& result);
+        //-- Changed region given as a polyline (garment frame) and the radius around it
+        bool updateRegion(const PointCloud::ConstPtr& scan, const std::vector<Eigen::Vector2f>& stroke,
+                          float stroke_radius, Result& result);
+        //-- Mask of the pixels of the images within a radius of a polyline (garment frame)
+        bool createStrokeMask(const Result& result, const std::vector<Eigen::Vector2f>& stroke,
+                              float stroke_radius, Eigen::MatrixXd& mask) const;
+
+        //-- Files written by the former chain of programs, named after the input file. Only the
+        //-- images used by WrinkleDetection.py and the wrinkle path are written unless intermediate
+        //-- results are requested
+        static bool saveArtifacts(const Result& result, const std::string& input_filename, bool save_intermediate = false);
+        //-- Name of the garment cloud file in the former chain (the images are named after it)
+        static std::string getGarmentFilename(const Result& result, const std::string& input_filename);
+
+    private:
+        //-- Normals and WiLD of the garment computed on the organized source cloud
+        bool computeOrganizedWild(Result& result);
+        //-- Depth, WiLD and mask images from the garment normals (raster WiLD)
+        bool createRasterWildImages(Result& result);
+        //-- Pixel of a garment point in the images of the result
+        bool getPixel(const Result& result, const PointT& point, int& row, int& col) const;
+        //-- Depth, WiLD and mask of the pixels selected by the region (the whole images if empty)
+        void fillImages(Result& result, const Eigen::MatrixXd& region);
+        static Eigen::MatrixXd dilateMask(const Eigen::MatrixXd& mask, int radius);
+
+        static bool saveTransform(const std::string& filename, const Eigen::Affine3f& transform);
+        template<typename MatrixT>
+        static bool saveMatrix(const std::string& filename, const MatrixT& matrix);
+
+        //-- Board segmentation
+        float ransac_threshold;
+        int plane_candidates;
+        std::string plane_cache_file;
+        std::string plane_cache_rig;
+        PlaneModelCache plane_cache;
+
+        //-- Clustering
+        int n_clusters;
+        int n_initializations;
+        int batch_size;
+
+        //-- Cleanup
+        float cluster_tolerance;
+
+        //-- Wrinkle detection
+        float normal_radius;
+        float wild_radius;
+        float image_resolution;
+        bool raster_wild;
+        bool use_frangi;
+        int max_wrinkles;
+        int min_wrinkle_area;
+        WrinklePathExtractor::Ranking wrinkle_ranking;
+        NeighborhoodCache<PointT>::Ptr neighborhood_cache;
+
+        bool verbose;
+};
+
+#endif // IRONING_PERCEPTION_HPP
@@ -0,0 +1,336 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+#include "IroningPerceptionServer.hpp"
+
+namespace textiles
+{
+
+/************************************************************************/
+
+bool IroningPerceptionServer::configure(yarp::os::ResourceFinder &rf) {
+
+    std::string name = rf.check("name",yarp::os::Value(DEFAULT_NAME),"prefix of the port names").asString();
+    double ransacThreshold = rf.check("ransacThreshold",yarp::os::Value(DEFAULT_RANSAC_THRESHOLD),"ransac threshold").asDouble();
+    int planeCandidates = rf.check("planeCandidates",yarp::os::Value(DEFAULT_PLANE_CANDIDATES),"regions searched for planes").asInt();
+    std::string planeCache = rf.check("planeCache",yarp::os::Value(DEFAULT_PLANE_CACHE),"plane cache file").asString();
+    std::string planeCacheRig = rf.check("planeCacheRig",yarp::os::Value(DEFAULT_PLANE_CACHE_RIG),"rig of the cached plane").asString();
+    int batchSize = rf.check("batchSize",yarp::os::Value(DEFAULT_BATCH_SIZE),"mini-batch k-means batch size").asInt();
+    double normalThreshold = rf.check("normalThreshold",yarp::os::Value(DEFAULT_NORMAL_THRESHOLD),"normal radius").asDouble();
+    double wildRadius = rf.check("wildRadius",yarp::os::Value(DEFAULT_WILD_RADIUS),"WiLD radius").asDouble();
+    bool rasterWild = rf.check("rasterWild");
+    bool useFrangi = rf.check("useFrangi");
+    int maxWrinkles = rf.check("maxWrinkles",yarp::os::Value(DEFAULT_MAX_WRINKLES),"ranked wrinkles with a trajectory").asInt();
+    int minWrinkleArea = rf.check("minWrinkleArea",yarp::os::Value(DEFAULT_MIN_WRINKLE_AREA),"minimum wrinkle area").asInt();
+    std::string wrinkleRanking = rf.check("wrinkleRanking",yarp::os::Value(DEFAULT_WRINKLE_RANKING),"wrinkle ranking").asString();
+
+    printf("--------------------------------------------------------------\n");
+    if (rf.check("help")) {
+        printf("IroningPerceptionServer options:\n");
+        printf("\t--help (this help)\t--from [file.ini]\t--context [path]\n");
+        printf("\t--name: %s [%s]\n",name.c_str(),DEFAULT_NAME);
+        printf("\t--ransacThreshold: %f [%f]\n",ransacThreshold,DEFAULT_RANSAC_THRESHOLD);
+        printf("\t--planeCandidates: %d [%d]\n",planeCandidates,DEFAULT_PLANE_CANDIDATES);
+        printf("\t--planeCache: %s [%s] (empty: only kept in memory)\n",planeCache.c_str(),DEFAULT_PLANE_CACHE);
+        printf("\t--planeCacheRig: %s [%s]\n",planeCacheRig.c_str(),DEFAULT_PLANE_CACHE_RIG);
+        printf("\t--batchSize: %d [%d] (0: full k-means)\n",batchSize,DEFAULT_BATCH_SIZE);
+        printf("\t--normalThreshold: %f [%f]\n",normalThreshold,DEFAULT_NORMAL_THRESHOLD);
+        printf("\t--wildRadius: %f [%f]\n",wildRadius,DEFAULT_WILD_RADIUS);
+        printf("\t--rasterWild (WiLD on the rasterized normals, much faster)\n");
+        printf("\t--useFrangi (wrinkle from the Frangi filter of the WiLD image)\n");
+        printf("\t--maxWrinkles: %d [%d] (0: all)\n",maxWrinkles,DEFAULT_MAX_WRINKLES);
+        printf("\t--minWrinkleArea: %d [%d] (pixels)\n",minWrinkleArea,DEFAULT_MIN_WRINKLE_AREA);
+        printf("\t--wrinkleRanking: %s [%s] (area, wild or volume)\n",wrinkleRanking.c_str(),DEFAULT_WRINKLE_RANKING);
+        ::exit(0);
+    }
+
+    ironingPerception.setRansacThreshold(ransacThreshold);
+    ironingPerception.setPlaneCandidates(planeCandidates);
+    if (!ironingPerception.setPlaneCacheFile(planeCache))
+        return false;
+    ironingPerception.setPlaneCacheRig(planeCacheRig);
+    ironingPerception.setClusteringBatchSize(batchSize);
+    ironingPerception.setNormalRadius(normalThreshold);
+    ironingPerception.setWildRadius(wildRadius);
+    ironingPerception.setRasterWild(rasterWild);
+    ironingPerception.setUseFrangi(useFrangi);
+    ironingPerception.setMaxWrinkles(maxWrinkles);
+    ironingPerception.setMinWrinkleArea(minWrinkleArea);
+    WrinklePathExtractor::Ranking rankBy;
+    if (!WrinklePathExtractor::parseRanking(wrinkleRanking, rankBy))
+        return false;
+    ironingPerception.setWrinkleRanking(rankBy);
+    ironingPerception.setVerbose(true);
+
+    if (!rpcPort.open(name + "/rpc:s"))
+    {
+        fprintf(stderr,"Could not open port %s/rpc:s\n",name.c_str());
+        return false;
+    }
+    attach(rpcPort);
+
+    printf("IroningPerceptionServer ready at %s/rpc:s\n",name.c_str());
+    return true;
+}
+
+/************************************************************************/
+
+bool IroningPerceptionServer::respond(const yarp::os::Bottle &command, yarp::os::Bottle &reply) {
+
+    reply.clear();
+    std::string request = command.get(0).asString();
+
+    if (request == "process" && command.size() >= 2)
+    {
+        std::string filename = command.get(1).asString();
+        if (!cloudLoader.load(filename))
+        {
+            reply.addString("fail");
+            reply.addString("could not load " + filename);
+            return true;
+        }
+
+        if (!processCloud(cloudLoader.getCloud<IroningPerception::PointT>(), reply))
+            return true;
+
+        if (command.size() >= 3 && command.get(2).asString() == "save")
+            IroningPerception::saveArtifacts(result, filename);
+        return true;
+    }
+    else if (request == "update" && command.size() >= 4 && command.get(3).isList())
+    {
+        //-- Stroke given as x y of each vertex, in the garment frame of the last result
+        std::string filename = command.get(1).asString();
+        if (!cloudLoader.load(filename))
+        {
+            reply.addString("fail");
+            reply.addString("could not load " + filename);
+            return true;
+        }
+
+        yarp::os::Bottle *values = command.get(3).asList();
+        std::vector<Eigen::Vector2f> stroke(values->size() / 2);
+        for (int i = 0; i < stroke.size(); i++)
+            stroke[i] = Eigen::Vector2f(values->get(2*i).asDouble(), values->get(2*i+1).asDouble());
+
+        if (!ironingPerception.updateRegion(cloudLoader.getCloud<IroningPerception::PointT>(), stroke,
+                                            command.get(2).asDouble(), result))
+        {
+            reply.addString("fail");
+            reply.addString("update failed");
+            return true;
+        }
+
+        addResult(reply);
+        return true;
+    }
+    else if (request == "cloud" && command.size() >= 2 && command.get(1).isList())
+    {
+        //-- Points given as x y z r g b
+        yarp::os::Bottle *values = command.get(1).asList();
+        IroningPerception::PointCloud::Ptr cloud(new IroningPerception::PointCloud);
+        cloud->points.resize(values->size() / 6);
+        for (int i = 0; i < cloud->points.size(); i++)
+        {
+            IroningPerception::PointT &point = cloud->points[i];
+            point.x = values->get(6*i).asDouble();
+            point.y = values->get(6*i+1).asDouble();
+            point.z = values->get(6*i+2).asDouble();
+            point.r = values->get(6*i+3).asInt();
+            point.g = values->get(6*i+4).asInt();
+            point.b = values->get(6*i+5).asInt();
+        }
+        cloud->width = cloud->points.size();
+        cloud->height = 1;
+
+        processCloud(cloud, reply);
+        return true;
+    }
+    else if (request == "set" && command.size() >= 3)
+    {
+        if (setParameter(command.get(1).asString(), command.get(2)))
+            reply.addString("ok");
+        else
+        {
+            reply.addString("fail");
+            reply.addString("unknown parameter");
+        }
+        return true;
+    }
+    else if (request == "help")
+    {
+        reply.addString("process <file.[pcd|ply]> [save]");
+        reply.addString("cloud (x y z r g b ...)");
+        reply.addString("update <file.[pcd|ply]> <radius> (x y x y ...)");
+        reply.addString("set <ransacThreshold|planeCandidates|planeCacheRig|batchSize|normalThreshold|wildRadius|rasterWild|useFrangi|maxWrinkles|minWrinkleArea|wrinkleRanking> <value>");
+        return true;
+    }
+
+    //-- Let RFModule handle "quit" and the rest
+    return yarp::os::RFModule::respond(command, reply);
+}
+
+/************************************************************************/
+
+bool IroningPerceptionServer::processCloud(const IroningPerception::PointCloud::ConstPtr &cloud, yarp::os::Bottle &reply) {
+
+    if (!ironingPerception.process(cloud, result))
+    {
+        reply.addString("fail");
+        reply.addString("perception failed");
+        return false;
+    }
+
+    addResult(reply);
+    return true;
+}
+
+/************************************************************************/
+
+void IroningPerceptionServer::addResult(yarp::os::Bottle &reply) {
+
+    reply.addString("ok");
+
+    yarp::os::Bottle &garmentPoints = reply.addList();
+    garmentPoints.addString("garmentPoints");
+    garmentPoints.addInt(result.garment_cloud->points.size());
+
+    addMatrix(reply, "boardTransform", result.board_transform.matrix());
+    addMatrix(reply, "garmentTransform", result.garment_transform.matrix());
+
+    yarp::os::Bottle &imageOrigin = reply.addList();
+    imageOrigin.addString("imageOrigin");
+    imageOrigin.addDouble(result.image_origin.x);
+    imageOrigin.addDouble(result.image_origin.y);
+    imageOrigin.addDouble(result.image_origin.z);
+
+    yarp::os::Bottle &imageResolution = reply.addList();
+    imageResolution.addString("imageResolution");
+    imageResolution.addDouble(ironingPerception.getImageResolution());
+
+    yarp::os::Bottle &imageSize = reply.addList();
+    imageSize.addString("imageSize");
+    imageSize.addInt(result.mask_image.rows());
+    imageSize.addInt(result.mask_image.cols());
+
+    addMatrix(reply, "depth", result.depth_image);
+    addMatrix(reply, "wild", result.wild_image);
+    addMatrix(reply, "mask", result.mask_image);
+
+    yarp::os::Bottle &wrinklePath = reply.addList();
+    wrinklePath.addString("wrinklePath");
+    for (int i = 0; i < result.wrinkle_path.size(); i++)
+    {
+        wrinklePath.addInt(result.wrinkle_path[i][0]);
+        wrinklePath.addInt(result.wrinkle_path[i][1]);
+    }
+
+    yarp::os::Bottle &trajectory = reply.addList();
+    trajectory.addString("trajectory");
+    for (int i = 0; i < result.trajectory.size(); i++)
+    {
+        trajectory.addDouble(result.trajectory[i][0]);
+        trajectory.addDouble(result.trajectory[i][1]);
+        trajectory.addDouble(result.trajectory[i][2]);
+    }
+
+    yarp::os::Bottle &wrinkleMetric = reply.addList();
+    wrinkleMetric.addString("wrinkleMetric");
+    wrinkleMetric.addDouble(result.wrinkle_metric);
+
+    //-- Ranked wrinkles: (area meanWild volume score (x y z ...)) each
+    yarp::os::Bottle &wrinkles = reply.addList();
+    wrinkles.addString("wrinkles");
+    for (int k = 0; k < result.wrinkles.size(); k++)
+    {
+        yarp::os::Bottle &wrinkle = wrinkles.addList();
+        wrinkle.addInt(result.wrinkles[k].area);
+        wrinkle.addDouble(result.wrinkles[k].mean_wild);
+        wrinkle.addDouble(result.wrinkles[k].volume);
+        wrinkle.addDouble(result.wrinkles[k].score);
+
+        yarp::os::Bottle &wrinkleTrajectory = wrinkle.addList();
+        for (int i = 0; i < result.trajectories[k].size(); i++)
+        {
+            wrinkleTrajectory.addDouble(result.trajectories[k][i][0]);
+            wrinkleTrajectory.addDouble(result.trajectories[k][i][1]);
+            wrinkleTrajectory.addDouble(result.trajectories[k][i][2]);
+        }
+    }
+}
+
+/************************************************************************/
+
+bool IroningPerceptionServer::setParameter(const std::string &parameter, const yarp::os::Value &value) {
+
+    if (parameter == "ransacThreshold")
+        ironingPerception.setRansacThreshold(value.asDouble());
+    else if (parameter == "planeCandidates")
+        ironingPerception.setPlaneCandidates(value.asInt());
+    else if (parameter == "planeCacheRig")
+        ironingPerception.setPlaneCacheRig(value.asString());
+    else if (parameter == "batchSize")
+        ironingPerception.setClusteringBatchSize(value.asInt());
+    else if (parameter == "normalThreshold")
+        ironingPerception.setNormalRadius(value.asDouble());
+    else if (parameter == "wildRadius")
+        ironingPerception.setWildRadius(value.asDouble());
+    else if (parameter == "rasterWild")
+        ironingPerception.setRasterWild(value.asInt() != 0);
+    else if (parameter == "useFrangi")
+        ironingPerception.setUseFrangi(value.asInt() != 0);
+    else if (parameter == "maxWrinkles")
+        ironingPerception.setMaxWrinkles(value.asInt());
+    else if (parameter == "minWrinkleArea")
+        ironingPerception.setMinWrinkleArea(value.asInt());
+    else if (parameter == "wrinkleRanking")
+    {
+        WrinklePathExtractor::Ranking rank_by;
+        if (!WrinklePathExtractor::parseRanking(value.asString(), rank_by))
+            return false;
+        ironingPerception.setWrinkleRanking(rank_by);
+    }
+    else
+        return false;
+    return true;
+}
+
+/************************************************************************/
+
+template<typename MatrixT>
+void IroningPerceptionServer::addMatrix(yarp::os::Bottle &reply, const std::string &name, const MatrixT &matrix) {
+
+    yarp::os::Bottle &list = reply.addList();
+    list.addString(name);
+    for (int i = 0; i < matrix.rows(); i++)
+        for (int j = 0; j < matrix.cols(); j++)
+            list.addDouble(matrix(i, j));
+}
+
+/************************************************************************/
+
+double IroningPerceptionServer::getPeriod() {
+    return 2.0;  // Fixed, in seconds, the slow thread that calls updateModule below
+}
+
+/************************************************************************/
+
+bool IroningPerceptionServer::updateModule() {
+    return true;
+}
+
+/************************************************************************/
+
+bool IroningPerceptionServer::interruptModule() {
+    printf("IroningPerceptionServer closing...\n");
+    rpcPort.interrupt();
+    return true;
+}
+
+/************************************************************************/
+
+bool IroningPerceptionServer::close() {
+    rpcPort.close();
+    return true;
+}
+
+}  // namespace textiles
@@ -0,0 +1,99 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+#ifndef __IRONING_PERCEPTION_SERVER_HPP__
+#define __IRONING_PERCEPTION_SERVER_HPP__
+
+#include <yarp/os/all.h>
+#include <string>
+
+#include "CloudLoader.hpp"
+#include "IroningPerception.hpp"
+
+#define DEFAULT_NAME "/ironingPerception"
+#define DEFAULT_RANSAC_THRESHOLD 0.02
+#define DEFAULT_PLANE_CANDIDATES 1
+#define DEFAULT_PLANE_CACHE ""
+#define DEFAULT_PLANE_CACHE_RIG "ironing_board"
+#define DEFAULT_BATCH_SIZE 0
+#define DEFAULT_NORMAL_THRESHOLD 0.03
+#define DEFAULT_WILD_RADIUS 0.03
+#define DEFAULT_MAX_WRINKLES 1
+#define DEFAULT_MIN_WRINKLE_AREA 0
+#define DEFAULT_WRINKLE_RANKING "area"
+
+namespace textiles
+{
+
+/**
+ * @ingroup ironingPerceptionServer
+ *
+ * @brief Ironing perception service. Keeps an IroningPerception instance (plane cache, search
+ * tree, buffers) and the OpenMP threads alive between requests, which are received on an RPC port:
+ *
+ *  - process <file.[pcd|ply]> [save]: runs the perception chain on a cloud file (and saves the
+ *    wrinkle images next to it, as ironingPerception does)
+ *  - cloud (x y z r g b x y z r g b ...): runs the perception chain on the given points
+ *  - update <file.[pcd|ply]> <radius> (x y x y ...): after an ironing stroke, updates the last
+ *    result with a new scan only around the stroke (polyline in the garment frame), and extracts
+ *    the wrinkle paths again from the updated images
+ *  - set <ransacThreshold|planeCandidates|planeCacheRig|batchSize|normalThreshold|wildRadius|rasterWild|
+ *    useFrangi|maxWrinkles|minWrinkleArea|wrinkleRanking> <value>
+ *    (rasterWild, useFrangi: 1 to enable, 0 to disable; wrinkleRanking: area, wild or volume)
+ *  - help
+ *
+ * Successful requests are answered with:
+ *  ok (garmentPoints n) (boardTransform 4x4) (garmentTransform 4x4) (imageOrigin x y z)
+ *     (imageResolution r) (imageSize rows cols) (depth ...) (wild ...) (mask ...)
+ *     (wrinklePath col row col row ...) (trajectory x y z x y z ...) (wrinkleMetric m)
+ *     (wrinkles (area meanWild volume score (x y z ...)) ...)
+ * where transforms and images are given row by row, wrinklePath and trajectory belong to the best
+ * wrinkle (in pixels and in the garment frame) and wrinkles lists the ranked wrinkles, best first,
+ * with their trajectories. Errors are answered with: fail <reason>
+ */
+class IroningPerceptionServer : public yarp::os::RFModule
+{
+    public:
+        bool configure(yarp::os::ResourceFinder &rf);
+
+        /** RFModule respond: called for each request on the RPC port. */
+        bool respond(const yarp::os::Bottle &command, yarp::os::Bottle &reply);
+
+    private:
+        /** Run the perception chain and fill the reply. */
+        bool processCloud(const IroningPerception::PointCloud::ConstPtr &cloud, yarp::os::Bottle &reply);
+
+        /** Fill the reply with the last result. */
+        void addResult(yarp::os::Bottle &reply);
+
+        /** Change a parameter of the perception chain. */
+        bool setParameter(const std::string &parameter, const yarp::os::Value &value);
+
+        /** Add a list with a name and the values of a matrix (row by row) to the reply. */
+        template<typename MatrixT>
+        static void addMatrix(yarp::os::Bottle &reply, const std::string &name, const MatrixT &matrix);
+
+        /** Perception chain, with its state kept between requests. */
+        IroningPerception ironingPerception;
+
+        /** Result of the last request. */
+        IroningPerception::Result result;
+
+        /** Loader for the process requests. */
+        CloudLoader cloudLoader;
+
+        /** RPC port. */
+        yarp::os::RpcServer rpcPort;
+
+        /** RFModule interruptModule. */
+        bool interruptModule();
+        /** RFModule close. */
+        bool close();
+        /** RFModule getPeriod. */
+        double getPeriod();
+        /** RFModule updateModule. */
+        bool updateModule();
+};
+
+}  // namespace textiles
+
+#endif  // __IRONING_PERCEPTION_SERVER_HPP__
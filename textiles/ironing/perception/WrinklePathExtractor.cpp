@@ -0,0 +1,538 @@
+#include "WrinklePathExtractor.hpp"
+
+#include "HessianFilterBank.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace {
+    //-- 8-neighbors, clockwise from the top one (P2 ... P9 in Zhang-Suen)
+    const int neighbor_rows[8] = {-1, -1, 0, 1, 1, 1, 0, -1};
+    const int neighbor_cols[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+    //-- Distance value for pixels without seeds
+    const double infinity = 1e20;
+}
+
+WrinklePathExtractor::WrinklePathExtractor()
+{
+    //-- Same values used by WrinkleDetection.py
+    mask_dilation = 3;
+    border_erosion = 11;
+    min_threshold = 0.4;
+    max_threshold = 0.95;
+    use_frangi = false;
+    max_wrinkles = 1;
+    min_wrinkle_area = 0;
+    rank_by = RANK_BY_AREA;
+    metric = 0;
+}
+
+bool WrinklePathExtractor::parseRanking(const std::string& name, Ranking& rank_by)
+{
+    if (name == "area")
+        rank_by = RANK_BY_AREA;
+    else if (name == "wild")
+        rank_by = RANK_BY_WILD;
+    else if (name == "volume")
+        rank_by = RANK_BY_VOLUME;
+    else
+    {
+        std::cerr << "Error: unknown wrinkle ranking " << name << " (area, wild or volume)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WrinklePathExtractor::compute()
+{
+    path.clear();
+    metric = 0;
+    inner_mask.resize(0, 0);
+    wrinkle_mask.resize(0, 0);
+    skeleton.resize(0, 0);
+    wrinkles.clear();
+
+    if (wild_image.size() == 0 || mask.rows() != wild_image.rows() || mask.cols() != wild_image.cols())
+    {
+        std::cerr << "Error: WiLD image and mask not set or of different size" << std::endl;
+        return false;
+    }
+
+    int height = wild_image.rows(), width = wild_image.cols();
+    BinaryImage garment = (mask.array() != 0).cast<unsigned char>();
+    if ((garment.array() != 0).count() == 0)
+    {
+        std::cerr << "Error: empty garment mask" << std::endl;
+        return false;
+    }
+
+    //-- Inner mask: dilation and erosion of the garment with discs. Pixels outside of the image
+    //-- are not considered background, as in skimage
+    Eigen::MatrixXf squared_distances;
+    computeDistanceTransform(garment, squared_distances);
+    BinaryImage dilated = (squared_distances.array() <= (float)(mask_dilation * mask_dilation)).cast<unsigned char>();
+    computeDistanceTransform((dilated.array() == 0).cast<unsigned char>(), squared_distances);
+    inner_mask = (squared_distances.array() > (float)(border_erosion * border_erosion)).cast<unsigned char>();
+
+    //-- Normalized WiLD over the garment
+    float minimum = std::numeric_limits<float>::max();
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+            if (garment(row, col))
+                minimum = std::min(minimum, wild_image(row, col));
+    float range = wild_image.maxCoeff() - minimum;
+    if (range <= 0)
+        range = 1;
+
+    Eigen::MatrixXf normalized_image = Eigen::MatrixXf::Zero(height, width);
+    BinaryImage wrinkle_pixels = BinaryImage::Zero(height, width);
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+        {
+            if (!garment(row, col))
+                continue;
+
+            float value = (wild_image(row, col) - minimum) / range;
+            normalized_image(row, col) = value;
+            wrinkle_pixels(row, col) = inner_mask(row, col) && value > min_threshold && value < max_threshold;
+        }
+
+    //-- Frangi: vesselness of the garment pixels normalized over the non-zero ones, above 160 in
+    //-- 8 bits as in WrinkleDetection.py
+    if (use_frangi)
+    {
+        HessianFilterBank hessian_filter_bank;
+        hessian_filter_bank.setInputImage(wild_image);
+        if (!hessian_filter_bank.compute())
+            return false;
+
+        Eigen::MatrixXf vesselness = hessian_filter_bank.getFrangi().cwiseProduct(garment.cast<float>());
+        float min_vesselness = std::numeric_limits<float>::max(), max_vesselness = vesselness.maxCoeff();
+        for (int row = 0; row < height; row++)
+            for (int col = 0; col < width; col++)
+                if (vesselness(row, col) != 0)
+                    min_vesselness = std::min(min_vesselness, vesselness(row, col));
+        float vesselness_range = max_vesselness > min_vesselness ? max_vesselness - min_vesselness : 1;
+
+        for (int row = 0; row < height; row++)
+            for (int col = 0; col < width; col++)
+                wrinkle_pixels(row, col) = vesselness(row, col) != 0
+                        && (vesselness(row, col) - min_vesselness) / vesselness_range * 255 > 160;
+    }
+
+    //-- Wrinkle blobs, ranked before extracting their paths
+    Eigen::MatrixXi labels;
+    std::vector<int> sizes;
+    labelComponents(wrinkle_pixels, labels, sizes);
+    int n_labels = sizes.size();
+
+    //-- Bounding box (min row, min col, max row, max col), WiLD and height range of each blob.
+    //-- Heights come from the depth image if given, from 1 - WiLD otherwise
+    bool use_depth = depth_image.rows() == height && depth_image.cols() == width;
+    std::vector<Eigen::Vector4i> boxes(n_labels, Eigen::Vector4i(height, width, -1, -1));
+    std::vector<double> wild_sums(n_labels, 0);
+    std::vector<float> min_heights(n_labels, std::numeric_limits<float>::max());
+    std::vector<float> max_heights(n_labels, -std::numeric_limits<float>::max());
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+        {
+            int label = labels(row, col);
+            if (label < 0)
+                continue;
+
+            boxes[label] = Eigen::Vector4i(std::min(boxes[label][0], row), std::min(boxes[label][1], col),
+                                           std::max(boxes[label][2], row), std::max(boxes[label][3], col));
+            wild_sums[label] += normalized_image(row, col);
+            float pixel_height = use_depth ? depth_image(row, col) : 1 - normalized_image(row, col);
+            min_heights[label] = std::min(min_heights[label], pixel_height);
+            max_heights[label] = std::max(max_heights[label], pixel_height);
+        }
+
+    //-- Normalized volume: sum of the heights normalized to [0, 1] within the blob
+    std::vector<double> volumes(n_labels, 0);
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+        {
+            int label = labels(row, col);
+            if (label < 0 || max_heights[label] <= min_heights[label])
+                continue;
+
+            float pixel_height = use_depth ? depth_image(row, col) : 1 - normalized_image(row, col);
+            volumes[label] += (pixel_height - min_heights[label]) / (max_heights[label] - min_heights[label]);
+        }
+
+    //-- Highest scores first (ties in label order)
+    std::vector<std::pair<double, int> > ranking;
+    for (int label = 0; label < n_labels; label++)
+    {
+        if (sizes[label] < min_wrinkle_area)
+            continue;
+
+        double mean_wild = wild_sums[label] / sizes[label];
+        double score = (rank_by == RANK_BY_AREA) ? sizes[label] : (rank_by == RANK_BY_WILD) ? 1 - mean_wild : volumes[label];
+        ranking.push_back(std::make_pair(-score, label));
+    }
+    std::sort(ranking.begin(), ranking.end());
+    if (max_wrinkles > 0 && ranking.size() > max_wrinkles)
+        ranking.resize(max_wrinkles);
+
+    //-- Global metric: mean of 1 - WiLD over the area of the garment (0 without wrinkles, as
+    //-- WrinkleDetection.py)
+    if (!ranking.empty())
+    {
+        BinaryImage garment_area = selectLargestComponent(garment);
+        fillHoles(garment_area);
+        double wild_sum = 0;
+        for (int row = 0; row < height; row++)
+            for (int col = 0; col < width; col++)
+                if (garment(row, col))
+                    wild_sum += 1 - normalized_image(row, col);
+        metric = wild_sum / (garment_area.array() != 0).count();
+    }
+
+    //-- Path of each ranked blob, filled and thinned within its bounding box (plus a background margin)
+    if (!ranking.empty())
+        computeDistanceTransform(findBorder(inner_mask), squared_distances);
+    wrinkle_mask = BinaryImage::Zero(height, width);
+    skeleton = BinaryImage::Zero(height, width);
+    wrinkles.resize(ranking.size());
+    for (int i = 0; i < ranking.size(); i++)
+    {
+        int label = ranking[i].second;
+        Wrinkle& wrinkle = wrinkles[i];
+        wrinkle.area = sizes[label];
+        wrinkle.mean_wild = wild_sums[label] / sizes[label];
+        wrinkle.volume = volumes[label];
+        wrinkle.score = -ranking[i].first;
+
+        int first_row = std::max(boxes[label][0] - 1, 0), first_col = std::max(boxes[label][1] - 1, 0);
+        int rows = std::min(boxes[label][2] + 1, height - 1) - first_row + 1;
+        int cols = std::min(boxes[label][3] + 1, width - 1) - first_col + 1;
+        BinaryImage blob = (labels.block(first_row, first_col, rows, cols).array() == label).cast<unsigned char>();
+        fillHoles(blob);
+        BinaryImage blob_skeleton = blob;
+        thin(blob_skeleton);
+
+        tracePath(blob_skeleton, squared_distances.block(first_row, first_col, rows, cols), wrinkle.path);
+        for (int k = 0; k < wrinkle.path.size(); k++)
+            wrinkle.path[k] += Eigen::Vector2i(first_col, first_row);
+
+        wrinkle_mask.block(first_row, first_col, rows, cols) = wrinkle_mask.block(first_row, first_col, rows, cols).cwiseMax(blob);
+        skeleton.block(first_row, first_col, rows, cols) = skeleton.block(first_row, first_col, rows, cols).cwiseMax(blob_skeleton);
+    }
+
+    if (!wrinkles.empty())
+        path = wrinkles[0].path;
+    return true;
+}
+
+void WrinklePathExtractor::computeDistanceTransform(const BinaryImage& seeds, Eigen::MatrixXf& squared_distances)
+{
+    int height = seeds.rows(), width = seeds.cols();
+    squared_distances.resize(height, width);
+    std::vector<float> f, z, d;
+    std::vector<int> v;
+
+    //-- Columns, then rows over the result
+    f.resize(height);
+    for (int col = 0; col < width; col++)
+    {
+        for (int row = 0; row < height; row++)
+            f[row] = seeds(row, col) ? 0 : infinity;
+        computeDistanceTransform1D(f, v, z, d);
+        for (int row = 0; row < height; row++)
+            squared_distances(row, col) = d[row];
+    }
+
+    f.resize(width);
+    for (int row = 0; row < height; row++)
+    {
+        for (int col = 0; col < width; col++)
+            f[col] = squared_distances(row, col);
+        computeDistanceTransform1D(f, v, z, d);
+        for (int col = 0; col < width; col++)
+            squared_distances(row, col) = d[col];
+    }
+}
+
+void WrinklePathExtractor::computeDistanceTransform1D(std::vector<float>& f, std::vector<int>& v, std::vector<float>& z, std::vector<float>& d)
+{
+    //-- Lower envelope of the parabolas rooted at each sample
+    int n = f.size();
+    v.resize(n);
+    z.resize(n+1);
+    d.resize(n);
+
+    int k = 0;
+    v[0] = 0;
+    z[0] = -infinity;
+    z[1] = infinity;
+    for (int q = 1; q < n; q++)
+    {
+        double s;
+        while (true)
+        {
+            s = (((double)f[q] + (double)q*q) - ((double)f[v[k]] + (double)v[k]*v[k])) / (2.0*q - 2.0*v[k]);
+            if (s > z[k] || k == 0)
+                break;
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k+1] = infinity;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++)
+    {
+        while (z[k+1] < q)
+            k++;
+        d[q] = (double)(q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+void WrinklePathExtractor::labelComponents(const BinaryImage& image, Eigen::MatrixXi& labels, std::vector<int>& sizes)
+{
+    int height = image.rows(), width = image.cols();
+    labels = Eigen::MatrixXi::Constant(height, width, -1);
+    sizes.clear();
+    std::vector<int> queue;
+
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+        {
+            if (!image(row, col) || labels(row, col) >= 0)
+                continue;
+
+            //-- Flood fill (BFS) of a new component
+            int label = sizes.size();
+            labels(row, col) = label;
+            queue.assign(1, row * width + col);
+            for (std::size_t i = 0; i < queue.size(); i++)
+            {
+                int pixel_row = queue[i] / width, pixel_col = queue[i] % width;
+                for (int k = 0; k < 8; k++)
+                {
+                    int neighbor_row = pixel_row + neighbor_rows[k], neighbor_col = pixel_col + neighbor_cols[k];
+                    if (neighbor_row < 0 || neighbor_row >= height || neighbor_col < 0 || neighbor_col >= width
+                            || !image(neighbor_row, neighbor_col) || labels(neighbor_row, neighbor_col) >= 0)
+                        continue;
+                    labels(neighbor_row, neighbor_col) = label;
+                    queue.push_back(neighbor_row * width + neighbor_col);
+                }
+            }
+            sizes.push_back(queue.size());
+        }
+}
+
+WrinklePathExtractor::BinaryImage WrinklePathExtractor::selectLargestComponent(const BinaryImage& image)
+{
+    Eigen::MatrixXi labels;
+    std::vector<int> sizes;
+    labelComponents(image, labels, sizes);
+    if (sizes.empty())
+        return BinaryImage::Zero(image.rows(), image.cols());
+
+    int largest_label = std::max_element(sizes.begin(), sizes.end()) - sizes.begin();
+    return (labels.array() == largest_label).cast<unsigned char>();
+}
+
+void WrinklePathExtractor::fillHoles(BinaryImage& image)
+{
+    int height = image.rows(), width = image.cols();
+    BinaryImage outside = BinaryImage::Zero(height, width);
+    std::vector<int> queue;
+
+    //-- Background reachable from the border of the image
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+            if ((row == 0 || col == 0 || row == height-1 || col == width-1) && !image(row, col))
+            {
+                outside(row, col) = 1;
+                queue.push_back(row * width + col);
+            }
+
+    for (std::size_t i = 0; i < queue.size(); i++)
+    {
+        int pixel_row = queue[i] / width, pixel_col = queue[i] % width;
+        for (int k = 0; k < 8; k += 2)
+        {
+            int neighbor_row = pixel_row + neighbor_rows[k], neighbor_col = pixel_col + neighbor_cols[k];
+            if (neighbor_row < 0 || neighbor_row >= height || neighbor_col < 0 || neighbor_col >= width
+                    || image(neighbor_row, neighbor_col) || outside(neighbor_row, neighbor_col))
+                continue;
+            outside(neighbor_row, neighbor_col) = 1;
+            queue.push_back(neighbor_row * width + neighbor_col);
+        }
+    }
+
+    image = (outside.array() == 0).cast<unsigned char>();
+}
+
+void WrinklePathExtractor::thin(BinaryImage& image)
+{
+    int height = image.rows(), width = image.cols();
+    std::vector<int> deleted;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int step = 0; step < 2; step++)
+        {
+            deleted.clear();
+            for (int row = 0; row < height; row++)
+                for (int col = 0; col < width; col++)
+                {
+                    if (!image(row, col))
+                        continue;
+
+                    //-- Neighbors P2 ... P9 (pixels outside of the image are background)
+                    int p[8];
+                    int n_neighbors = 0;
+                    for (int k = 0; k < 8; k++)
+                    {
+                        int neighbor_row = row + neighbor_rows[k], neighbor_col = col + neighbor_cols[k];
+                        p[k] = (neighbor_row >= 0 && neighbor_row < height && neighbor_col >= 0 && neighbor_col < width
+                                && image(neighbor_row, neighbor_col)) ? 1 : 0;
+                        n_neighbors += p[k];
+                    }
+                    if (n_neighbors < 2 || n_neighbors > 6)
+                        continue;
+
+                    int transitions = 0;
+                    for (int k = 0; k < 8; k++)
+                        if (!p[k] && p[(k+1) % 8])
+                            transitions++;
+                    if (transitions != 1)
+                        continue;
+
+                    //-- P2 = p[0], P4 = p[2], P6 = p[4], P8 = p[6]
+                    bool removable = (step == 0) ? (!(p[0] && p[2] && p[4]) && !(p[2] && p[4] && p[6]))
+                                                 : (!(p[0] && p[2] && p[6]) && !(p[0] && p[4] && p[6]));
+                    if (removable)
+                        deleted.push_back(row * width + col);
+                }
+
+            for (std::size_t i = 0; i < deleted.size(); i++)
+                image(deleted[i] / width, deleted[i] % width) = 0;
+            changed |= !deleted.empty();
+        }
+    }
+}
+
+WrinklePathExtractor::BinaryImage WrinklePathExtractor::findBorder(const BinaryImage& image)
+{
+    int height = image.rows(), width = image.cols();
+    //-- Only the outer contour (holes are filled), as cv2.RETR_EXTERNAL
+    BinaryImage largest = selectLargestComponent(image);
+    fillHoles(largest);
+    BinaryImage border = BinaryImage::Zero(height, width);
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+        {
+            if (!largest(row, col))
+                continue;
+
+            bool is_border = (row == 0 || col == 0 || row == height-1 || col == width-1);
+            for (int k = 0; k < 8 && !is_border; k += 2)
+                is_border = !largest(row + neighbor_rows[k], col + neighbor_cols[k]);
+            border(row, col) = is_border;
+        }
+    return border;
+}
+
+void WrinklePathExtractor::tracePath(const BinaryImage& skeleton, const Eigen::MatrixXf& border_distances,
+                                     std::vector<Eigen::Vector2i>& path)
+{
+    //-- Endpoints: skeleton pixels with a single neighbor. The path starts at the one farthest
+    //-- from the border of the inner mask and ends at the closest one
+    int height = skeleton.rows(), width = skeleton.cols();
+    int start = -1, end = -1, first_pixel = -1;
+    float max_distance = -1, min_distance = std::numeric_limits<float>::max();
+    for (int row = 0; row < height; row++)
+        for (int col = 0; col < width; col++)
+        {
+            if (!skeleton(row, col))
+                continue;
+            if (first_pixel < 0)
+                first_pixel = row * width + col;
+
+            int n_neighbors = 0;
+            for (int k = 0; k < 8; k++)
+            {
+                int neighbor_row = row + neighbor_rows[k], neighbor_col = col + neighbor_cols[k];
+                if (neighbor_row >= 0 && neighbor_row < height && neighbor_col >= 0 && neighbor_col < width
+                        && skeleton(neighbor_row, neighbor_col))
+                    n_neighbors++;
+            }
+            if (n_neighbors != 1)
+                continue;
+
+            float distance = border_distances(row, col);
+            if (distance > max_distance)
+            {
+                max_distance = distance;
+                start = row * width + col;
+            }
+            if (distance < min_distance)
+            {
+                min_distance = distance;
+                end = row * width + col;
+            }
+        }
+
+    path.clear();
+    if (first_pixel < 0)
+        return;
+
+    //-- Skeletons without two distinct endpoints (loops, single pixels) go between the two
+    //-- farthest pixels reached by BFS
+    if (start < 0 || start == end)
+    {
+        traceShortestPath(skeleton, first_pixel, -1, path);
+        start = path.back()[1] * width + path.back()[0];
+        end = -1;
+    }
+    traceShortestPath(skeleton, start, end, path);
+}
+
+void WrinklePathExtractor::traceShortestPath(const BinaryImage& skeleton, int start, int end, std::vector<Eigen::Vector2i>& path)
+{
+    int height = skeleton.rows(), width = skeleton.cols();
+    std::vector<int> parent(height * width, -1);
+    std::vector<int> queue(1, start);
+    parent[start] = start;
+
+    int target = start;
+    for (std::size_t i = 0; i < queue.size(); i++)
+    {
+        target = queue[i];
+        if (target == end)
+            break;
+
+        int pixel_row = target / width, pixel_col = target % width;
+        for (int k = 0; k < 8; k++)
+        {
+            int neighbor_row = pixel_row + neighbor_rows[k], neighbor_col = pixel_col + neighbor_cols[k];
+            int neighbor = neighbor_row * width + neighbor_col;
+            if (neighbor_row < 0 || neighbor_row >= height || neighbor_col < 0 || neighbor_col >= width
+                    || !skeleton(neighbor_row, neighbor_col) || parent[neighbor] >= 0)
+                continue;
+            parent[neighbor] = target;
+            queue.push_back(neighbor);
+        }
+    }
+
+    //-- Back from the target (the end, or the last pixel reached)
+    path.clear();
+    for (int pixel = target; ; pixel = parent[pixel])
+    {
+        path.push_back(Eigen::Vector2i(pixel % width, pixel / width));
+        if (pixel == start)
+            break;
+    }
+    std::reverse(path.begin(), path.end());
+}
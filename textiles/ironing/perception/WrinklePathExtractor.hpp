@@ -0,0 +1,125 @@
+/*
+ * Wrinkle Path Extractor
+ *
+ * Ironing trajectory from the WiLD image of a garment, as in WrinkleDetection.py:
+ *  1. The garment mask is dilated and eroded to discard the border, and the WiLD image is
+ *     normalized to [0, 1] over the garment
+ *  2. Wrinkle pixels are those of the inner mask with a normalized WiLD within the thresholds
+ *     (or, with use_frangi, those of the garment with a high normalized Frangi vesselness of the
+ *     WiLD image). The 8-connected blobs are the wrinkles
+ *  3. Wrinkles are scored by area, mean WiLD or normalized volume (as in CurvatureScanLi) and
+ *     ranked. The best ones (only the largest by default, as WrinkleDetection.py) get a path, so
+ *     several strokes can be planned from a single scan
+ *  4. Each wrinkle, with its holes filled, is thinned to a skeleton (Zhang-Suen) within its
+ *     bounding box
+ *  5. The skeleton endpoints (pixels with a single 8-neighbor) are found in a single pass, and
+ *     the path goes from the endpoint farthest from the border of the inner mask to the closest
+ *     one, looked up in a distance transform of the border
+ *  6. The path is traced with a BFS over the 8-neighbors of the skeleton pixels
+ *
+ * Every step is linear in the number of pixels (the Python version builds the skeleton graph
+ * comparing all pairs of pixels and measures the distance of each endpoint to every contour
+ * point). Morphology also uses exact Euclidean distance transforms, so the disc radius does not
+ * change the cost.
+ *
+ * The global metric is the mean of 1 - normalized WiLD over the garment, or 0 if no wrinkle
+ * is found (as WrinkleDetection.py).
+ *
+ */
+
+#ifndef WRINKLE_PATH_EXTRACTOR_HPP
+#define WRINKLE_PATH_EXTRACTOR_HPP
+
+#include <Eigen/Core>
+
+#include <string>
+#include <vector>
+
+class WrinklePathExtractor
+{
+    public:
+        typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, Eigen::Dynamic> BinaryImage;
+
+        enum Ranking { RANK_BY_AREA, RANK_BY_WILD, RANK_BY_VOLUME };
+
+        struct Wrinkle
+        {
+            std::vector<Eigen::Vector2i> path;  //-- Pixels (col, row), from start to end
+            int area;                           //-- Pixels of the blob (before filling its holes)
+            double mean_wild;                   //-- Mean normalized WiLD (lower on deeper wrinkles)
+            double volume;                      //-- Sum of the heights normalized within the blob
+            double score;                       //-- Value used for the ranking, higher first
+        };
+
+        WrinklePathExtractor();
+
+        void setInputImage(const Eigen::MatrixXf& wild_image) { this->wild_image = wild_image; }
+        //-- Garment pixels (non-zero)
+        void setMask(const Eigen::MatrixXd& mask) { this->mask = mask; }
+        //-- Radii (in pixels) of the dilation and erosion of the mask that discard the border
+        void setMaskDilation(int mask_dilation) { this->mask_dilation = mask_dilation; }
+        void setBorderErosion(int border_erosion) { this->border_erosion = border_erosion; }
+        //-- Range of normalized WiLD values of the wrinkle pixels (exclusive)
+        void setThresholds(float min_threshold, float max_threshold) { this->min_threshold = min_threshold; this->max_threshold = max_threshold; }
+        //-- Wrinkle pixels from the Frangi vesselness instead of the WiLD thresholds
+        void setUseFrangi(bool use_frangi) { this->use_frangi = use_frangi; }
+        //-- Heights for the normalized volume (optional, 1 - WiLD is used otherwise)
+        void setDepthImage(const Eigen::MatrixXf& depth_image) { this->depth_image = depth_image; }
+        //-- Number of ranked wrinkles with a path (0: all of them) and minimum area, in pixels
+        void setMaxWrinkles(int max_wrinkles) { this->max_wrinkles = max_wrinkles; }
+        void setMinWrinkleArea(int min_wrinkle_area) { this->min_wrinkle_area = min_wrinkle_area; }
+        void setRanking(Ranking rank_by) { this->rank_by = rank_by; }
+        //-- Ranking from its name: area, wild or volume
+        static bool parseRanking(const std::string& name, Ranking& rank_by);
+
+        //-- False only for invalid input: an image without wrinkles gives an empty path
+        bool compute();
+
+        //-- Pixels (col, row) of the ironing path of the best wrinkle, from start to end
+        const std::vector<Eigen::Vector2i>& getPath() const { return path; }
+        //-- Ranked wrinkles, best first
+        const std::vector<Wrinkle>& getWrinkles() const { return wrinkles; }
+        double getMetric() const { return metric; }
+        //-- Intermediate images (for debugging), with all the ranked wrinkles
+        const BinaryImage& getInnerMask() const { return inner_mask; }
+        const BinaryImage& getWrinkleMask() const { return wrinkle_mask; }
+        const BinaryImage& getSkeleton() const { return skeleton; }
+
+    private:
+        //-- Squared Euclidean distance from each pixel to the closest non-zero pixel (Felzenszwalb & Huttenlocher)
+        static void computeDistanceTransform(const BinaryImage& seeds, Eigen::MatrixXf& squared_distances);
+        static void computeDistanceTransform1D(std::vector<float>& f, std::vector<int>& v, std::vector<float>& z, std::vector<float>& d);
+        //-- 8-connected components (-1 for background) and their pixel count
+        static void labelComponents(const BinaryImage& image, Eigen::MatrixXi& labels, std::vector<int>& sizes);
+        static BinaryImage selectLargestComponent(const BinaryImage& image);
+        //-- Background pixels not 4-connected to the image border are set
+        static void fillHoles(BinaryImage& image);
+        static void thin(BinaryImage& image);
+        //-- Pixels of the largest component of the image (holes filled) with a 4-neighbor outside of it
+        static BinaryImage findBorder(const BinaryImage& image);
+        //-- Path between the endpoints of a skeleton closest to and farthest from the border
+        static void tracePath(const BinaryImage& skeleton, const Eigen::MatrixXf& border_distances, std::vector<Eigen::Vector2i>& path);
+        //-- Shortest path between two skeleton pixels over 8-neighbors (to the farthest pixel reached if end < 0)
+        static void traceShortestPath(const BinaryImage& skeleton, int start, int end, std::vector<Eigen::Vector2i>& path);
+
+        Eigen::MatrixXf wild_image;
+        Eigen::MatrixXd mask;
+        int mask_dilation;
+        int border_erosion;
+        float min_threshold;
+        float max_threshold;
+        bool use_frangi;
+        Eigen::MatrixXf depth_image;
+        int max_wrinkles;
+        int min_wrinkle_area;
+        Ranking rank_by;
+
+        BinaryImage inner_mask;
+        BinaryImage wrinkle_mask;
+        BinaryImage skeleton;
+        std::vector<Eigen::Vector2i> path;
+        std::vector<Wrinkle> wrinkles;
+        double metric;
+};
+
+#endif // WRINKLE_PATH_EXTRACTOR_HPP
@@ -13,7 +13,6 @@
 #include <pcl/io/ply_io.h>
 #include <pcl/point_types.h>
 #include <pcl/filters/extract_indices.h>
-#include <pcl/segmentation/extract_clusters.h>
 #include <pcl/common/transforms.h>
 #include <pcl/filters/passthrough.h>
 #include <pcl/search/search.h>
@@ -22,6 +21,9 @@
 #include <pcl/features/moment_of_inertia_estimation.h>
 
 #include "Debug.hpp"
+#include "CloudLoader.hpp"
+#include "CloudView.hpp"
+#include "LargestClusterExtraction.hpp"
 
 void show_usage(char * program_name)
 {
@@ -60,67 +62,22 @@ int main (int argc, char** argv)
         debug_enabled = true;
 
     //-- Get point cloud file from arguments
-    std::vector<int> filenames;
-    bool file_is_pcd = false;
-
-    filenames = pcl::console::parse_file_extension_argument(argc, argv, ".ply");
-
-    if (filenames.size() != 1)
-    {
-        filenames = pcl::console::parse_file_extension_argument(argc, argv, ".pcd");
-
-        if (filenames.size() != 1)
-        {
-            show_usage(argv[0]);
-            return -1;
-        }
-
-        file_is_pcd = true;
-    }
-
-    //-- Load point cloud data
-    pcl::PointCloud<pcl::PointXYZ>::Ptr source_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
-    if (file_is_pcd)
-    {
-        if (pcl::io::loadPCDFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-    }
-    else
+    std::string input_filename = CloudLoader::parseFilenameArgument(argc, argv);
+    if (input_filename.empty())
     {
-        if (pcl::io::loadPLYFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
+        show_usage(argv[0]);
+        return -1;
     }
 
     //-- Load point cloud data (with color)
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr source_cloud_color(new pcl::PointCloud<pcl::PointXYZRGB>);
-
-    if (file_is_pcd)
-    {
-        if (pcl::io::loadPCDFile(argv[filenames[0]], *source_cloud_color) < 0)
-        {
-            std::cout << "Error loading colored point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-    }
-    else
+    CloudLoader cloud_loader;
+    if (!cloud_loader.load(input_filename))
     {
-        if (pcl::io::loadPLYFile(argv[filenames[0]], *source_cloud_color) < 0)
-        {
-            std::cout << "Error loading colored point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
+        std::cout << "Error loading point cloud " << input_filename << std::endl << std::endl;
+        show_usage(argv[0]);
+        return -1;
     }
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr source_cloud_color = cloud_loader.getCloud<pcl::PointXYZRGB>();
 
 
     //--------------------------------------------------------------------------------------------------------
@@ -134,40 +91,28 @@ int main (int argc, char** argv)
     debug.plotPointCloud<pcl::PointXYZRGB>(source_cloud_color, Debug::COLOR_ORIGINAL);
     debug.show("Original with color");
 
-    //-- Euclidean Clustering of the resultant cloud
-    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZRGB>);
-    tree->setInputCloud(source_cloud_color);
-
-    std::vector<pcl::PointIndices> cluster_indices;
-    pcl::EuclideanClusterExtraction<pcl::PointXYZRGB> euclidean_custering;
-    euclidean_custering.setClusterTolerance(0.005);
-    euclidean_custering.setMinClusterSize(100);
-    euclidean_custering.setSearchMethod(tree);
-    euclidean_custering.setInputCloud(source_cloud_color);
-    euclidean_custering.extract(cluster_indices);
-
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr largest_color_cluster(new pcl::PointCloud<pcl::PointXYZRGB>);
-    int largest_cluster_size = 0;
-    for (auto it = cluster_indices.begin (); it != cluster_indices.end (); ++it)
+    //-- Euclidean Clustering of the resultant cloud (only the largest cluster is kept)
+    pcl::PointIndices largest_cluster_indices;
+    LargestClusterExtraction<pcl::PointXYZRGB> largest_cluster_extraction;
+    largest_cluster_extraction.setClusterTolerance(0.005);
+    largest_cluster_extraction.setMinClusterSize(100);
+    largest_cluster_extraction.setInputCloud(source_cloud_color);
+    if (!largest_cluster_extraction.extractLargest(largest_cluster_indices))
     {
-      pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_cluster (new pcl::PointCloud<pcl::PointXYZRGB>);
-      for (auto pit = it->indices.begin (); pit != it->indices.end (); ++pit)
-        cloud_cluster->points.push_back(source_cloud_color->points[*pit]);
-      cloud_cluster->width = cloud_cluster->points.size ();
-      cloud_cluster->height = 1;
-      cloud_cluster->is_dense = true;
-
-      std::cout << "Found cluster of " << cloud_cluster->points.size() << " points." << std::endl;
-      if (cloud_cluster->points.size() > largest_cluster_size)
-      {
-          largest_cluster_size = cloud_cluster->points.size();
-          *largest_color_cluster = *cloud_cluster;
-      }
+        std::cerr << "No garment cluster found!" << std::endl;
+        return -3;
     }
+    std::cout << "Found largest cluster of " << largest_cluster_indices.indices.size() << " points." << std::endl;
+    CloudView<pcl::PointXYZRGB> largest_color_cluster(source_cloud_color, largest_cluster_indices);
 
-    debug.setEnabled(debug_enabled);
-    debug.plotPointCloud<pcl::PointXYZRGB>(largest_color_cluster, Debug::COLOR_GREEN);
-    debug.show("Filtered garment cloud");
+    if (debug_enabled)
+    {
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr largest_color_cluster_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+        largest_color_cluster.copyTo(*largest_color_cluster_cloud);
+        debug.setEnabled(debug_enabled);
+        debug.plotPointCloud<pcl::PointXYZRGB>(largest_color_cluster_cloud, Debug::COLOR_GREEN);
+        debug.show("Filtered garment cloud");
+    }
 
     //-- Centering the point cloud before saving it
     //-----------------------------------------------------------------------------------
@@ -178,16 +123,15 @@ int main (int argc, char** argv)
     pcl::PointXYZRGB position_OBB;
     Eigen::Matrix3f rotational_matrix_OBB;
 
-    feature_extractor.setInputCloud(largest_color_cluster);
+    feature_extractor.setInputCloud(source_cloud_color);
+    feature_extractor.setIndices(largest_color_cluster.getIndices());
     feature_extractor.compute();
     feature_extractor.getAABB(min_point_AABB, max_point_AABB);
     feature_extractor.getOBB(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB);
 
     //-- Translating to center
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr centered_garment_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
     Eigen::Affine3f garment_translation_transform = Eigen::Affine3f::Identity();
     garment_translation_transform.translation() << -position_OBB.x, -position_OBB.y, -position_OBB.z;
-    pcl::transformPointCloud(*largest_color_cluster, *centered_garment_cloud, garment_translation_transform);
 
     //-- Orient using the principal axes of the bounding box
     pcl::PointCloud<pcl::PointXYZRGB>::Ptr oriented_garment_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
@@ -196,10 +140,12 @@ int main (int argc, char** argv)
     Eigen::Transform<float, 3, Eigen::Affine> t2 = Eigen::Transform<float, 3, Eigen::Affine>::Identity();
     t2.rotate(rotational_matrix_OBB.inverse());
     //pcl::transformPointCloud(*centered_garment_cloud, *oriented_garment_cloud, Eigen::Vector3f(0,0,0), garment_rotation_quaternion);
-    pcl::transformPointCloud(*centered_garment_cloud, *oriented_garment_cloud, t2);
+    //-- Both transformations are applied at once, only to the points of the garment cluster
+    pcl::transformPointCloud(*source_cloud_color, *largest_color_cluster.getIndices(), *oriented_garment_cloud,
+                             Eigen::Transform<float, 3, Eigen::Affine>(t2 * garment_translation_transform));
 
     //-- Save to file
-    record_transformation(argv[filenames[0]]+std::string("-transform2.txt"), garment_translation_transform, Eigen::Quaternionf(t2.rotation()));
+    record_transformation(input_filename+std::string("-transform2.txt"), garment_translation_transform, Eigen::Quaternionf(t2.rotation()));
 
 
     debug.setEnabled(debug_enabled);
@@ -208,7 +154,7 @@ int main (int argc, char** argv)
     debug.show("Oriented garment patch");
 
     //-- Save point cloud in file to process it in Python
-    pcl::io::savePCDFileBinary(argv[filenames[0]]+std::string("-output.pcd"), *oriented_garment_cloud);
+    pcl::io::savePCDFileBinary(input_filename+std::string("-output.pcd"), *oriented_garment_cloud);
 
     return 0;
 }
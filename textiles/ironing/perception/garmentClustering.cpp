@@ -0,0 +1,97 @@
+/*
+ * GarmentClustering
+ * --------------------------------------
+ *
+ * Splits the segmented cloud in the garment and the ironing board with k-means on position
+ * and color (same as ClusteringPointCloudSegmentation.py). Each cluster is saved to
+ * {input}-cluster{i}.pcd, sorted by the X coordinate of its centroid.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <pcl/console/parse.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/point_types.h>
+#include <pcl/common/io.h>
+
+#include "CloudLoader.hpp"
+#include "ColorGeometryKMeans.hpp"
+
+void show_usage(char * program_name)
+{
+    std::cout << std::endl;
+    std::cout << "Usage: " << program_name << " cloud_filename.[pcd|ply]" << std::endl;
+    std::cout << "-h:  Show this help." << std::endl;
+    std::cout << "--clusters: number of clusters (default: 2)" << std::endl;
+    std::cout << "--initializations: number of k-means++ initializations (default: 10)" << std::endl;
+    std::cout << "--batch-size: points per iteration, for mini-batch k-means (default: 0, full k-means)" << std::endl;
+    std::cout << "--seed: seed for the initialization (default: 0)" << std::endl;
+}
+
+int main (int argc, char** argv)
+{
+    //-- Command-line arguments
+    int n_clusters = 2;
+    int n_initializations = 10;
+    int batch_size = 0;
+    int seed = 0;
+
+    //-- Show usage
+    if (pcl::console::find_switch(argc, argv, "-h") || pcl::console::find_switch(argc, argv, "--help"))
+    {
+        show_usage(argv[0]);
+        return 0;
+    }
+
+    pcl::console::parse_argument(argc, argv, "--clusters", n_clusters);
+    pcl::console::parse_argument(argc, argv, "--initializations", n_initializations);
+    pcl::console::parse_argument(argc, argv, "--batch-size", batch_size);
+    pcl::console::parse_argument(argc, argv, "--seed", seed);
+
+    //-- Get point cloud file from arguments
+    std::string input_filename = CloudLoader::parseFilenameArgument(argc, argv);
+    if (input_filename.empty())
+    {
+        show_usage(argv[0]);
+        return -1;
+    }
+
+    //-- Load point cloud data (with color)
+    CloudLoader cloud_loader;
+    if (!cloud_loader.load(input_filename))
+    {
+        std::cout << "Error loading point cloud " << input_filename << std::endl << std::endl;
+        show_usage(argv[0]);
+        return -1;
+    }
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr source_cloud = cloud_loader.getCloud<pcl::PointXYZRGB>();
+
+    //-- Clustering
+    std::vector<pcl::PointIndices> clusters;
+    ColorGeometryKMeans<pcl::PointXYZRGB> kmeans;
+    kmeans.setInputCloud(source_cloud);
+    kmeans.setNumberOfClusters(n_clusters);
+    kmeans.setInitializations(n_initializations);
+    kmeans.setBatchSize(batch_size);
+    kmeans.setSeed(seed);
+    if (!kmeans.segment(clusters))
+    {
+        std::cerr << "Clustering failed" << std::endl;
+        return -2;
+    }
+
+    //-- Save each cluster
+    for (int i = 0; i < (int)clusters.size(); i++)
+    {
+        pcl::PointCloud<pcl::PointXYZRGB> cluster_cloud;
+        pcl::copyPointCloud(*source_cloud, clusters[i], cluster_cloud);
+
+        std::stringstream output_filename;
+        output_filename << input_filename << "-cluster" << i << ".pcd";
+        pcl::io::savePCDFileBinaryCompressed(output_filename.str(), cluster_cloud);
+        std::cout << "Cluster " << i << ": " << cluster_cloud.points.size() << " points" << std::endl;
+    }
+
+    return 0;
+}
@@ -22,21 +22,25 @@
 #include <pcl/point_types.h>
 #include <pcl/ModelCoefficients.h>
 #include <pcl/filters/extract_indices.h>
-#include <pcl/filters/voxel_grid.h>
 #include <pcl/sample_consensus/method_types.h>
 #include <pcl/sample_consensus/model_types.h>
 #include <pcl/segmentation/sac_segmentation.h>
 #include <pcl/filters/project_inliers.h>
-#include <pcl/segmentation/extract_clusters.h>
+#include <pcl/common/io.h>
 #include <pcl/common/transforms.h>
 #include <pcl/filters/passthrough.h>
 #include <pcl/search/search.h>
 #include <pcl/search/kdtree.h>
 #include <pcl/segmentation/region_growing_rgb.h>
-#include <pcl/point_types_conversion.h>
 #include <pcl/features/moment_of_inertia_estimation.h>
 
 #include "Debug.hpp"
+#include "CloudLoader.hpp"
+#include "MultiPlaneSegmentation.hpp"
+#include "PlaneModelCache.hpp"
+#include "VoxelGridDownsampler.hpp"
+#include "LargestClusterExtraction.hpp"
+#include "ColorSegmentation.hpp"
 
 #define SEGMENTATION_PYTHON
 
@@ -46,8 +50,12 @@ void show_usage(char * program_name)
     std::cout << "Usage: " << program_name << " cloud_filename.[pcd|ply]" << std::endl;
     std::cout << "-h:  Show this help." << std::endl;
     std::cout << "--ransac-threshold: Set ransac threshold value (default: 0.02)" << std::endl;
-    std::cout << "--hsv-s-threshold: threshold for saturation channel on hsv (default: ??)" << std::endl;
-    std::cout << "--hsv-v-threshold: threshold for value channel on hsv (default: ??)" << std::endl;
+    std::cout << "--plane-candidates: Number of regions where candidate planes are searched concurrently (default: 1)" << std::endl;
+    std::cout << "--plane-cache: File to store the garment plane between scans of the same rig (default: disabled)" << std::endl;
+    std::cout << "--plane-cache-rig: Name of the rig the cached plane belongs to (default: ironing_board)" << std::endl;
+    std::cout << "--hsv-s-threshold: threshold for saturation channel on hsv (default: 0.30)" << std::endl;
+    std::cout << "--hsv-v-threshold: threshold for value channel on hsv (default: 0.35)" << std::endl;
+    std::cout << "--hsv-auto-threshold: compute both hsv thresholds automatically (Otsu) (default: false)" << std::endl;
     std::cout << "--enable-debug: enable debug info display" << std::endl;
 }
 
@@ -60,6 +68,20 @@ void record_transformation(std::string output_file, Eigen::Affine3f translation_
     file.close();
 }
 
+pcl::PointXYZ project_point_on_plane(pcl::PointXYZ point, const pcl::ModelCoefficients& plane)
+{
+    pcl::PointCloud<pcl::PointXYZ>::Ptr to_be_projected_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    to_be_projected_cloud->points.push_back(point);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr projected_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+
+    pcl::ProjectInliers<pcl::PointXYZ> project_inliners;
+    project_inliners.setModelType(pcl::SACMODEL_PLANE);
+    project_inliners.setInputCloud(to_be_projected_cloud);
+    project_inliners.setModelCoefficients(pcl::ModelCoefficients::ConstPtr(new pcl::ModelCoefficients(plane)));
+    project_inliners.filter(*projected_cloud);
+    return projected_cloud->points[0];
+}
+
 int main (int argc, char** argv)
 {
     //---------------------------------------------------------------------------------------------------
@@ -68,8 +90,12 @@ int main (int argc, char** argv)
 
     //-- Command-line arguments
     float ransac_threshold = 0.02;
+    int plane_candidates = 1;
+    std::string plane_cache_file = "";
+    std::string plane_cache_rig = "ironing_board";
     float hsv_s_threshold = 0.30;
     float hsv_v_threshold = 0.35;
+    bool hsv_auto_threshold = false;
     bool debug_enabled = false;
 
     //-- Show usage
@@ -86,6 +112,15 @@ int main (int argc, char** argv)
         std::cerr << "RANSAC theshold not specified, using default value..." << std::endl;
     }
 
+    if (pcl::console::find_switch(argc, argv, "--plane-candidates"))
+        pcl::console::parse_argument(argc, argv, "--plane-candidates", plane_candidates);
+
+    if (pcl::console::find_switch(argc, argv, "--plane-cache"))
+        pcl::console::parse_argument(argc, argv, "--plane-cache", plane_cache_file);
+
+    if (pcl::console::find_switch(argc, argv, "--plane-cache-rig"))
+        pcl::console::parse_argument(argc, argv, "--plane-cache-rig", plane_cache_rig);
+
     if (pcl::console::find_switch(argc, argv, "--hsv-s-threshold"))
         pcl::console::parse_argument(argc, argv, "--hsv-s-threshold", hsv_s_threshold);
     else
@@ -100,71 +135,36 @@ int main (int argc, char** argv)
         std::cerr << "Value theshold not specified, using default value..." << std::endl;
     }
 
+    if (pcl::console::find_switch(argc, argv, "--hsv-auto-threshold"))
+        hsv_auto_threshold = true;
+
     if (pcl::console::find_switch(argc, argv, "--enable-debug"))
         debug_enabled = true;
 
 
     //-- Get point cloud file from arguments
-    std::vector<int> filenames;
-    bool file_is_pcd = false;
-
-    filenames = pcl::console::parse_file_extension_argument(argc, argv, ".ply");
-
-    if (filenames.size() != 1)
-    {
-        filenames = pcl::console::parse_file_extension_argument(argc, argv, ".pcd");
-
-        if (filenames.size() != 1)
-        {
-            show_usage(argv[0]);
-            return -1;
-        }
-
-        file_is_pcd = true;
-    }
-
-    //-- Load point cloud data
-    pcl::PointCloud<pcl::PointXYZ>::Ptr source_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
-    if (file_is_pcd)
+    std::string input_filename = CloudLoader::parseFilenameArgument(argc, argv);
+    if (input_filename.empty())
     {
-        if (pcl::io::loadPCDFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-    }
-    else
-    {
-        if (pcl::io::loadPLYFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
+        show_usage(argv[0]);
+        return -1;
     }
 
-    //-- Load point cloud data (with color)
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr source_cloud_color(new pcl::PointCloud<pcl::PointXYZRGB>);
-
-    if (file_is_pcd)
+    //-- Load point cloud data (parsed only once, used both with and without color)
+    CloudLoader cloud_loader;
+    if (!cloud_loader.load(input_filename))
     {
-        if (pcl::io::loadPCDFile(argv[filenames[0]], *source_cloud_color) < 0)
-        {
-            std::cout << "Error loading colored point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
+        std::cout << "Error loading point cloud " << input_filename << std::endl << std::endl;
+        show_usage(argv[0]);
+        return -1;
     }
-    else
+    pcl::PointCloud<pcl::PointXYZ>::Ptr source_cloud = cloud_loader.getCloud<pcl::PointXYZ>();
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr source_cloud_color = cloud_loader.getCloud<pcl::PointXYZRGB>();
+    if (!source_cloud || !source_cloud_color)
     {
-        if (pcl::io::loadPLYFile(argv[filenames[0]], *source_cloud_color) < 0)
-        {
-            std::cout << "Error loading colored point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
+        std::cout << "Error reading point cloud " << input_filename << std::endl << std::endl;
+        show_usage(argv[0]);
+        return -1;
     }
 
     //-- Print arguments to user
@@ -189,74 +189,72 @@ int main (int argc, char** argv)
 
     //-- Downsample the dataset prior to plane detection (using a leaf size of 1cm)
     //-----------------------------------------------------------------------------------
-    pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
+    VoxelGridDownsampler<pcl::PointXYZ> voxel_grid;
     voxel_grid.setInputCloud(source_cloud);
     voxel_grid.setLeafSize(0.01f, 0.01f, 0.01f);
     voxel_grid.filter(*cloud_filtered);
     std::cout << "Initially PointCloud has: " << source_cloud->points.size ()  << " data points." << std::endl;
     std::cout << "PointCloud after filtering has: " << cloud_filtered->points.size ()  << " data points." << std::endl;
 
-    //-- Detect all possible planes
+    //-- Try first the plane found in the previous scans of the same rig
     //-----------------------------------------------------------------------------------
-    std::vector<pcl::ModelCoefficientsPtr> all_planes;
-
-    pcl::SACSegmentation<pcl::PointXYZ> ransac_segmentation;
-    ransac_segmentation.setOptimizeCoefficients(true);
-    ransac_segmentation.setModelType(pcl::SACMODEL_PLANE);
-    ransac_segmentation.setMethodType(pcl::SAC_RANSAC);
-    ransac_segmentation.setDistanceThreshold(ransac_threshold);
-
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    pcl::ModelCoefficients::Ptr current_plane(new pcl::ModelCoefficients);
+    pcl::ModelCoefficients::Ptr garment_plane(new pcl::ModelCoefficients);
+    float min_height = FLT_MAX;
+    pcl::PointXYZ garment_projected_center;
 
-    int i=0, nr_points = (int) cloud_filtered->points.size();
-    while (cloud_filtered->points.size() > 0.3 * nr_points)
+    PlaneModelCache plane_cache;
+    bool plane_from_cache = false;
+    if (!plane_cache_file.empty() && plane_cache.load(plane_cache_file))
     {
-        // Segment the largest planar component from the remaining cloud
-        ransac_segmentation.setInputCloud(cloud_filtered);
-        ransac_segmentation.segment(*inliers, *current_plane);
-        if (inliers->indices.size() == 0)
+        pcl::PointIndices cached_plane_inliers;
+        if (plane_cache.refit<pcl::PointXYZ>(plane_cache_rig, cloud_filtered, ransac_threshold,
+                                             *garment_plane, cached_plane_inliers))
         {
-            std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
-            break;
+            plane_from_cache = true;
+            garment_projected_center = project_point_on_plane(pcl::PointXYZ(0,0,0), *garment_plane);
+            min_height = garment_projected_center.getVector3fMap().norm();
         }
+    }
 
-        // Extract the planar inliers from the input cloud
-        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_f(new pcl::PointCloud<pcl::PointXYZ>);
-        pcl::ExtractIndices<pcl::PointXYZ> extract;
-        extract.setInputCloud(cloud_filtered);
-        extract.setIndices(inliers);
-        extract.setNegative(false);
+    //-- Detect all possible planes (only if there is no valid cached plane)
+    //-----------------------------------------------------------------------------------
+    std::vector<pcl::ModelCoefficients> all_planes;
+    std::vector<pcl::PointIndices> all_planes_inliers;
 
-        // Remove the planar inliers, extract the rest
-        extract.setNegative(true);
-        extract.filter(*cloud_f);
-        *cloud_filtered = *cloud_f;
+    if (!plane_from_cache)
+    {
+        MultiPlaneSegmentation<pcl::PointXYZ> multi_plane_segmentation;
+        multi_plane_segmentation.setInputCloud(cloud_filtered);
+        multi_plane_segmentation.setDistanceThreshold(ransac_threshold);
+        multi_plane_segmentation.setRemainingPointsRatio(0.3);
+        multi_plane_segmentation.setCandidateRegions(plane_candidates);
+        if (!multi_plane_segmentation.segment(all_planes, all_planes_inliers))
+            std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
+    }
 
-        //-- Save plane
-        pcl::ModelCoefficients::Ptr copy_current_plane(new pcl::ModelCoefficients);
-        *copy_current_plane = *current_plane;
-        all_planes.push_back(copy_current_plane);
+    for (int i = 0; i < all_planes.size(); i++)
+    {
+        std::cout << "Found plane with " << all_planes_inliers[i].indices.size() << " inliers." << std::endl;
 
         //-- Debug stuff
-        debug.setEnabled(debug_enabled);
-        debug.plotPlane(*current_plane, Debug::COLOR_BLUE);
-        debug.plotPointCloud<pcl::PointXYZ>(cloud_filtered, Debug::COLOR_RED);
-        debug.show("Plane segmentation");
+        if (debug_enabled)
+        {
+            pcl::PointCloud<pcl::PointXYZ>::Ptr plane_cloud(new pcl::PointCloud<pcl::PointXYZ>(*cloud_filtered, all_planes_inliers[i].indices));
+            debug.setEnabled(debug_enabled);
+            debug.plotPlane(all_planes[i], Debug::COLOR_BLUE);
+            debug.plotPointCloud<pcl::PointXYZ>(plane_cloud, Debug::COLOR_RED);
+            debug.show("Plane segmentation");
+        }
     }
 
     //-- Filter planes to obtain garment plane
     //-----------------------------------------------------------------------------------
-    pcl::ModelCoefficients::Ptr garment_plane(new pcl::ModelCoefficients);
-    float min_height = FLT_MAX;
-    pcl::PointXYZ garment_projected_center;
-
     for(int i = 0; i < all_planes.size(); i++)
     {
         //-- Check orientation
-        Eigen::Vector3f normal_vector(all_planes[i]->values[0],
-                                      all_planes[i]->values[1],
-                                      all_planes[i]->values[2]);
+        Eigen::Vector3f normal_vector(all_planes[i].values[0],
+                                      all_planes[i].values[1],
+                                      all_planes[i].values[2]);
         normal_vector.normalize();
         Eigen::Vector3f good_orientation(0, -1, -1);
         good_orientation.normalize();
@@ -267,30 +265,28 @@ int main (int argc, char** argv)
             //-- Check "height" (height is defined in the local frame of reference in the yz direction)
             //-- With this frame, it is approximately equal to the norm of the vector OO' (being O the
             //-- center of the old frame and O' the projection of that center onto the plane).
-
-            //-- Project center point onto given plane:
-            pcl::PointCloud<pcl::PointXYZ>::Ptr center_to_be_projected_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-            center_to_be_projected_cloud->points.push_back(pcl::PointXYZ(0,0,0));
-            pcl::PointCloud<pcl::PointXYZ>::Ptr center_projected_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
-            pcl::ProjectInliers<pcl::PointXYZ> project_inliners;
-            project_inliners.setModelType(pcl::SACMODEL_PLANE);
-            project_inliners.setInputCloud(center_to_be_projected_cloud);
-            project_inliners.setModelCoefficients(all_planes[i]);
-            project_inliners.filter(*center_projected_cloud);
-            pcl::PointXYZ projected_center = center_projected_cloud->points[0];
+            pcl::PointXYZ projected_center = project_point_on_plane(pcl::PointXYZ(0,0,0), all_planes[i]);
             Eigen::Vector3f projected_center_vector(projected_center.x, projected_center.y, projected_center.z);
 
             float height = projected_center_vector.norm();
             if (height < min_height)
             {
                 min_height = height;
-                *garment_plane = *all_planes[i];
+                *garment_plane = all_planes[i];
                 garment_projected_center = projected_center;
             }
         }
     }
 
+    //-- Remember the garment plane for the next scans of this rig
+    if (!plane_cache_file.empty() && min_height < FLT_MAX)
+    {
+        if (!plane_from_cache)
+            plane_cache.storePlane(plane_cache_rig, *garment_plane,
+                                   PlaneModelCache::computeInlierRatio(*cloud_filtered, *garment_plane, ransac_threshold));
+        plane_cache.save(plane_cache_file);
+    }
+
     if (!(min_height < FLT_MAX))
     {
         std::cerr << "Garment plane not found!" << std::endl;
@@ -327,7 +323,7 @@ int main (int argc, char** argv)
     pcl::transformPointCloud(*source_cloud_color, *oriented_cloud, t);
 
     //-- Save to file
-    record_transformation(argv[filenames[0]]+std::string("-transform1.txt"), translation_transform, rotation_quaternion);
+    record_transformation(input_filename+std::string("-transform1.txt"), translation_transform, rotation_quaternion);
 
     debug.setEnabled(debug_enabled);
     debug.plotPointCloud<pcl::PointXYZRGB>(oriented_cloud, Debug::COLOR_GREEN);
@@ -349,57 +345,48 @@ int main (int argc, char** argv)
 
 #ifdef SEGMENTATION_PYTHON
     //-- Save point cloud in file to process it in Python
-    pcl::io::savePCDFileBinary(argv[filenames[0]]+std::string("-unsegmented.pcd"), *garment_table_cloud);
+    pcl::io::savePCDFileBinary(input_filename+std::string("-unsegmented.pcd"), *garment_table_cloud);
     return 0;
 #else
     //-- Color segmentation of the garment
     //-----------------------------------------------------------------------------------
-    //-- HSV thresholding
-    pcl::PointCloud<pcl::PointXYZHSV>::Ptr hsv_cloud(new pcl::PointCloud<pcl::PointXYZHSV>);
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr filtered_garment_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-    pcl::PointCloudXYZRGBtoXYZHSV(*garment_table_cloud, *hsv_cloud);
-    for (int i = 0; i < hsv_cloud->points.size(); i++)
+    //-- HSV thresholding (S and V are computed on the fly, no HSV cloud is needed)
+    pcl::PointIndices::Ptr garment_indices(new pcl::PointIndices);
+    ColorSegmentation<pcl::PointXYZRGB> color_segmentation;
+    color_segmentation.setInputCloud(garment_table_cloud);
+    color_segmentation.setSaturationThreshold(hsv_s_threshold);
+    color_segmentation.setValueThreshold(hsv_v_threshold);
+    color_segmentation.setAutomaticThresholds(hsv_auto_threshold);
+    color_segmentation.segment(*garment_indices);
+    if (hsv_auto_threshold)
+        std::cout << "Automatic HSV thresholds: S > " << color_segmentation.getSaturationThreshold()
+                  << ", V > " << color_segmentation.getValueThreshold() << std::endl;
+
+    if (debug_enabled)
     {
-        if (isnan(hsv_cloud->points[i].x) || isnan(hsv_cloud->points[i].y || isnan(hsv_cloud->points[i].z)))
-            continue;
-        if (hsv_cloud->points[i].s > hsv_s_threshold &&  hsv_cloud->points[i].v > hsv_v_threshold)
-            filtered_garment_cloud->push_back(garment_table_cloud->points[i]);
+        pcl::PointCloud<pcl::PointXYZRGB>::Ptr filtered_garment_cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+        pcl::copyPointCloud(*garment_table_cloud, *garment_indices, *filtered_garment_cloud);
+        debug.setEnabled(debug_enabled);
+        debug.plotPointCloud<pcl::PointXYZRGB>(filtered_garment_cloud, Debug::COLOR_GREEN);
+        debug.show("Garment cloud");
     }
 
-    debug.setEnabled(debug_enabled);
-    debug.plotPointCloud<pcl::PointXYZRGB>(filtered_garment_cloud, Debug::COLOR_GREEN);
-    debug.show("Garment cloud");
-
-    //-- Euclidean Clustering of the resultant cloud
-    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZRGB>);
-    tree->setInputCloud(filtered_garment_cloud);
-
-    std::vector<pcl::PointIndices> cluster_indices;
-    pcl::EuclideanClusterExtraction<pcl::PointXYZRGB> euclidean_custering;
-    euclidean_custering.setClusterTolerance(0.005);
-    euclidean_custering.setMinClusterSize(100);
-    euclidean_custering.setSearchMethod(tree);
-    euclidean_custering.setInputCloud(filtered_garment_cloud);
-    euclidean_custering.extract(cluster_indices);
-
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr largest_color_cluster(new pcl::PointCloud<pcl::PointXYZRGB>);
-    int largest_cluster_size = 0;
-    for (auto it = cluster_indices.begin (); it != cluster_indices.end (); ++it)
+    //-- Euclidean Clustering of the resultant cloud (only the largest cluster is kept)
+    pcl::PointIndices largest_cluster_indices;
+    LargestClusterExtraction<pcl::PointXYZRGB> largest_cluster_extraction;
+    largest_cluster_extraction.setClusterTolerance(0.005);
+    largest_cluster_extraction.setMinClusterSize(100);
+    largest_cluster_extraction.setInputCloud(garment_table_cloud);
+    largest_cluster_extraction.setIndices(pcl::IndicesConstPtr(garment_indices, &garment_indices->indices));
+    if (!largest_cluster_extraction.extractLargest(largest_cluster_indices))
     {
-      pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud_cluster (new pcl::PointCloud<pcl::PointXYZRGB>);
-      for (auto pit = it->indices.begin (); pit != it->indices.end (); ++pit)
-        cloud_cluster->points.push_back(filtered_garment_cloud->points[*pit]);
-      cloud_cluster->width = cloud_cluster->points.size ();
-      cloud_cluster->height = 1;
-      cloud_cluster->is_dense = true;
-
-      std::cout << "Found cluster of " << cloud_cluster->points.size() << " points." << std::endl;
-      if (cloud_cluster->points.size() > largest_cluster_size)
-      {
-          largest_cluster_size = cloud_cluster->points.size();
-          *largest_color_cluster = *cloud_cluster;
-      }
+        std::cerr << "No garment cluster found!" << std::endl;
+        return -3;
     }
+    std::cout << "Found largest cluster of " << largest_cluster_indices.indices.size() << " points." << std::endl;
+
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr largest_color_cluster(new pcl::PointCloud<pcl::PointXYZRGB>);
+    pcl::copyPointCloud(*garment_table_cloud, largest_cluster_indices, *largest_color_cluster);
 
     debug.setEnabled(debug_enabled);
     debug.plotPointCloud<pcl::PointXYZRGB>(largest_color_cluster, Debug::COLOR_GREEN);
@@ -435,7 +422,7 @@ int main (int argc, char** argv)
     pcl::transformPointCloud(*centered_garment_cloud, *oriented_garment_cloud, t2);
 
     //-- Save to file
-    record_transformation(argv[filenames[0]]+std::string("-transform2.txt"), garment_translation_transform, Eigen::Quaternionf(t2.rotation()));
+    record_transformation(input_filename+std::string("-transform2.txt"), garment_translation_transform, Eigen::Quaternionf(t2.rotation()));
 
 
     debug.setEnabled(debug_enabled);
@@ -444,7 +431,7 @@ int main (int argc, char** argv)
     debug.show("Oriented garment patch");
 
     //-- Save point cloud in file to process it in Python
-    pcl::io::savePCDFileBinary(argv[filenames[0]]+std::string("-output.pcd"), *oriented_garment_cloud);
+    pcl::io::savePCDFileBinary(input_filename+std::string("-output.pcd"), *oriented_garment_cloud);
 
     return 0;
 #endif
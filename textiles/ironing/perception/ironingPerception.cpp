@@ -0,0 +1,149 @@
+/*
+ * IroningPerception
+ * --------------------------------------
+ *
+ * Runs the whole ironing perception chain (segmentation, clustering, cleanup, wrinkle
+ * detection and wrinkle path) in a single process. By default only the images needed by
+ * WrinkleDetection.py and the wrinkle path are written, named as the former chain of
+ * programs did.
+ *
+ */
+
+#include <iostream>
+#include <pcl/console/parse.h>
+#include <pcl/point_types.h>
+#include <yarp/os/Time.h>
+
+#include "CloudLoader.hpp"
+#include "IroningPerception.hpp"
+
+void show_usage(char * program_name)
+{
+    std::cout << std::endl;
+    std::cout << "Usage: " << program_name << " cloud_filename.[pcd|ply]" << std::endl;
+    std::cout << "-h:  Show this help." << std::endl;
+    std::cout << "--ransac-threshold: Set ransac threshold value (default: 0.02)" << std::endl;
+    std::cout << "--plane-candidates: Number of regions where candidate planes are searched concurrently (default: 1)" << std::endl;
+    std::cout << "--plane-cache: File to store the garment plane between scans of the same rig (default: disabled)" << std::endl;
+    std::cout << "--plane-cache-rig: Name of the rig the cached plane belongs to (default: ironing_board)" << std::endl;
+    std::cout << "--batch-size: points per iteration, for mini-batch k-means (default: 0, full k-means)" << std::endl;
+    std::cout << "--normal-threshold: Set normal threshold value (default: 0.03)" << std::endl;
+    std::cout << "--wild-radius: Radius of the WiLD neighborhood (default: 0.03)" << std::endl;
+    std::cout << "--raster-wild: compute WiLD on the rasterized normals (box neighborhood, much faster)" << std::endl;
+    std::cout << "--use-frangi: find the wrinkle with the Frangi filter of the WiLD image" << std::endl;
+    std::cout << "--max-wrinkles: Number of ranked wrinkles with a trajectory, 0 for all (default: 1)" << std::endl;
+    std::cout << "--min-wrinkle-area: Minimum area of a wrinkle, in pixels (default: 0)" << std::endl;
+    std::cout << "--wrinkle-ranking: Rank wrinkles by area, wild or volume (default: area)" << std::endl;
+    std::cout << "--save-intermediate: also save the intermediate clouds, transforms and descriptors" << std::endl;
+    std::cout << "--no-output: do not save any file" << std::endl;
+}
+
+int main (int argc, char** argv)
+{
+    //-- Command-line arguments
+    float ransac_threshold = 0.02;
+    int plane_candidates = 1;
+    std::string plane_cache_file = "";
+    std::string plane_cache_rig = "ironing_board";
+    int batch_size = 0;
+    float normal_threshold = 0.03;
+    float wild_radius = 0.03;
+    bool raster_wild = false;
+    bool use_frangi = false;
+    int max_wrinkles = 1;
+    int min_wrinkle_area = 0;
+    std::string wrinkle_ranking = "area";
+    bool save_intermediate = false;
+    bool save_output = true;
+
+    //-- Show usage
+    if (pcl::console::find_switch(argc, argv, "-h") || pcl::console::find_switch(argc, argv, "--help"))
+    {
+        show_usage(argv[0]);
+        return 0;
+    }
+
+    pcl::console::parse_argument(argc, argv, "--ransac-threshold", ransac_threshold);
+    pcl::console::parse_argument(argc, argv, "--plane-candidates", plane_candidates);
+    pcl::console::parse_argument(argc, argv, "--plane-cache", plane_cache_file);
+    pcl::console::parse_argument(argc, argv, "--plane-cache-rig", plane_cache_rig);
+    pcl::console::parse_argument(argc, argv, "--batch-size", batch_size);
+    pcl::console::parse_argument(argc, argv, "--normal-threshold", normal_threshold);
+    pcl::console::parse_argument(argc, argv, "--wild-radius", wild_radius);
+    pcl::console::parse_argument(argc, argv, "--max-wrinkles", max_wrinkles);
+    pcl::console::parse_argument(argc, argv, "--min-wrinkle-area", min_wrinkle_area);
+    pcl::console::parse_argument(argc, argv, "--wrinkle-ranking", wrinkle_ranking);
+
+    WrinklePathExtractor::Ranking rank_by;
+    if (!WrinklePathExtractor::parseRanking(wrinkle_ranking, rank_by))
+    {
+        show_usage(argv[0]);
+        return -1;
+    }
+
+    if (pcl::console::find_switch(argc, argv, "--raster-wild"))
+        raster_wild = true;
+
+    if (pcl::console::find_switch(argc, argv, "--use-frangi"))
+        use_frangi = true;
+
+    if (pcl::console::find_switch(argc, argv, "--save-intermediate"))
+        save_intermediate = true;
+
+    if (pcl::console::find_switch(argc, argv, "--no-output"))
+        save_output = false;
+
+    //-- Get point cloud file from arguments
+    std::string input_filename = CloudLoader::parseFilenameArgument(argc, argv);
+    if (input_filename.empty())
+    {
+        show_usage(argv[0]);
+        return -1;
+    }
+
+    //-- Load point cloud data (with color)
+    double t_start = yarp::os::Time::now();
+    CloudLoader cloud_loader;
+    if (!cloud_loader.load(input_filename))
+    {
+        std::cout << "Error loading point cloud " << input_filename << std::endl << std::endl;
+        show_usage(argv[0]);
+        return -1;
+    }
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr source_cloud = cloud_loader.getCloud<pcl::PointXYZRGB>();
+    std::cout << "Loading time: " << yarp::os::Time::now() - t_start << " seconds." << std::endl;
+
+    //-- Perception chain
+    IroningPerception ironing_perception;
+    ironing_perception.setRansacThreshold(ransac_threshold);
+    ironing_perception.setPlaneCandidates(plane_candidates);
+    ironing_perception.setPlaneCacheFile(plane_cache_file);
+    ironing_perception.setPlaneCacheRig(plane_cache_rig);
+    ironing_perception.setClusteringBatchSize(batch_size);
+    ironing_perception.setNormalRadius(normal_threshold);
+    ironing_perception.setWildRadius(wild_radius);
+    ironing_perception.setRasterWild(raster_wild);
+    ironing_perception.setUseFrangi(use_frangi);
+    ironing_perception.setMaxWrinkles(max_wrinkles);
+    ironing_perception.setMinWrinkleArea(min_wrinkle_area);
+    ironing_perception.setWrinkleRanking(rank_by);
+    ironing_perception.setVerbose(true);
+
+    IroningPerception::Result result;
+    if (!ironing_perception.process(source_cloud, result))
+        return -3;
+    std::cout << "Garment has " << result.garment_cloud->points.size() << " points." << std::endl;
+    std::cout << "Wrinkle path has " << result.wrinkle_path.size() << " pixels, wrinkle metric: " << result.wrinkle_metric << std::endl;
+    for (int k = 1; k < result.wrinkles.size(); k++)
+        std::cout << "Wrinkle " << k+1 << ": " << result.wrinkles[k].path.size() << " pixels, score: " << result.wrinkles[k].score << std::endl;
+
+    //-- Save results only if requested
+    if (save_output)
+    {
+        if (!IroningPerception::saveArtifacts(result, input_filename, save_intermediate))
+            return -4;
+        std::cout << "Results saved as " << IroningPerception::getGarmentFilename(result, input_filename) << std::endl;
+    }
+
+    return 0;
+}
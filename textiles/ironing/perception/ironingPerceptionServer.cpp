@@ -0,0 +1,41 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/**
+ *
+ * @ingroup textiles_programs
+ * \defgroup ironingPerceptionServer ironingPerceptionServer
+ *
+ * @brief Creates an instance of textiles::IroningPerceptionServer.
+ *
+ * Only needs a YARP name server. Requests can be sent with: yarp rpc /ironingPerception/rpc:s
+ *
+ */
+
+#include <yarp/os/all.h>
+
+#include "IroningPerceptionServer.hpp"
+
+int main(int argc, char **argv) {
+
+    yarp::os::ResourceFinder rf;
+    rf.setVerbose(true);
+    rf.setDefaultContext("ironingPerceptionServer");
+    rf.setDefaultConfigFile("ironingPerceptionServer.ini");
+    rf.configure(argc, argv);
+
+    textiles::IroningPerceptionServer mod;
+    if(rf.check("help")) {
+        return mod.runModule(rf);
+    }
+
+    printf("Run \"%s --help\" for options.\n",argv[0]);
+    printf("%s checking for yarp network... ",argv[0]);
+    fflush(stdout);
+    yarp::os::Network yarp;
+    if (!yarp.checkNetwork()) {
+        fprintf(stderr,"[fail]\n%s found no yarp network (try running \"yarpserver &\"), bye!\n",argv[0]);
+        return 1;
+    } else printf("[ok]\n");
+
+    return mod.runModule(rf);
+}
@@ -13,6 +13,7 @@
 #include <pcl/features/moment_of_inertia_estimation.h>
 
 #include "Debug.hpp"
+#include "NormalEstimator.hpp"
 
 int main (int argc, char** argv)
 {
@@ -58,7 +59,8 @@ int main (int argc, char** argv)
 
   pcl::search::Search<pcl::PointXYZRGB>::Ptr tree = boost::shared_ptr<pcl::search::Search<pcl::PointXYZRGB> > (new pcl::search::KdTree<pcl::PointXYZRGB>);
   pcl::PointCloud <pcl::Normal>::Ptr normals (new pcl::PointCloud <pcl::Normal>);
-  pcl::NormalEstimation<pcl::PointXYZRGB, pcl::Normal> normal_estimator;
+  //-- Integral image normals if the cloud is organized, 50 nearest neighbors otherwise
+  NormalEstimator<pcl::PointXYZRGB> normal_estimator;
   normal_estimator.setSearchMethod (tree);
   normal_estimator.setInputCloud (source_cloud);
   normal_estimator.setKSearch (50);
@@ -17,11 +17,14 @@
 #include <pcl/features/normal_3d.h>
 #include <pcl/features/normal_3d_omp.h>
 #include <pcl/filters/filter.h>
-#include <pcl/features/rsd.h>
 #include <pcl/features/moment_of_inertia_estimation.h>
 #include <yarp/os/Time.h>
 
 #include "Debug.hpp"
+#include "MortonReordering.hpp"
+#include "NeighborhoodCache.hpp"
+#include "RSDEstimator.hpp"
+#include "WiLDEstimator.hpp"
 
 void show_usage(char * program_name)
 {
@@ -29,7 +32,9 @@ void show_usage(char * program_name)
     std::cout << "Usage: " << program_name << " cloud_filename.[pcd|ply]" << std::endl;
     std::cout << "-h:  Show this help." << std::endl;
     std::cout << "--normal-threshold: Set normal threshold value (default: ??)" << std::endl;
-    std::cout << "--rsd: Enable RSD descriptors calculation" << std::endl;
+    std::cout << "--wild-radius: Radius of the WiLD neighborhood (default: 0.03)" << std::endl;
+    std::cout << "--rsd: Enable RSD descriptors calculation (also saved as r_min / r_max images)" << std::endl;
+    std::cout << "--rsd-max-neighbors: Approximate RSD with at most this many neighbors per point (default: 0, all)" << std::endl;
 }
 
 template<typename PointT>
@@ -50,10 +55,14 @@ int main (int argc, char** argv)
     std::string output_wild = "-wild_image.m";
     std::string output_mask = "-image_mask.m";
     std::string output_rsd = "-rsd.m";
+    std::string output_rsd_min_image = "-rsd_min_image.m";
+    std::string output_rsd_max_image = "-rsd_max_image.m";
 
     //-- Command-line arguments
     float normal_threshold = 0.02;
+    float wild_radius = 0.03;
     bool rsd = false;
+    int rsd_max_neighbors = 0;
 
     //-- Show usage
     if (pcl::console::find_switch(argc, argv, "-h") || pcl::console::find_switch(argc, argv, "--help"))
@@ -69,11 +78,17 @@ int main (int argc, char** argv)
         std::cerr << "Normal theshold not specified, using default value..." << std::endl;
     }
 
+    if (pcl::console::find_switch(argc, argv, "--wild-radius"))
+        pcl::console::parse_argument(argc, argv, "--wild-radius", wild_radius);
+
     if (pcl::console::find_switch(argc, argv, "--rsd"))
     {
         rsd = true;
     }
 
+    if (pcl::console::find_switch(argc, argv, "--rsd-max-neighbors"))
+        pcl::console::parse_argument(argc, argv, "--rsd-max-neighbors", rsd_max_neighbors);
+
     //-- Get point cloud file from arguments
     std::vector<int> filenames;
     bool file_is_pcd = false;
@@ -115,9 +130,19 @@ int main (int argc, char** argv)
         }
     }
 
+    //-- Sort unorganized clouds along a Z-order curve, so that the neighborhoods of consecutive
+    //-- points are close in memory for the normals, RSD and WiLD
+    if (!source_cloud->isOrganized())
+    {
+        MortonReordering<pcl::PointXYZRGB> morton_reordering;
+        morton_reordering.setInputCloud(source_cloud);
+        morton_reordering.filter(*source_cloud);
+    }
+
     //-- Print arguments to user
     std::cout << "Selected arguments: " << std::endl
-              << "\tNormal threshold: " << normal_threshold << std::endl;
+              << "\tNormal threshold: " << normal_threshold << std::endl
+              << "\tWiLD radius: " << wild_radius << std::endl;
     if (rsd)
         std::cout << "\tRSD computation enabled" << std::endl;
 
@@ -135,7 +160,10 @@ int main (int argc, char** argv)
     //-- Find normals
     double t_normals_start = yarp::os::Time::now();
     pcl::NormalEstimationOMP<pcl::PointXYZRGB, pcl::Normal> normalEstimator;
-    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZRGB>);
+    //-- Neighborhoods are searched once at the largest radius and shared by normals, RSD and WiLD
+    const float rsd_radius = 0.03;
+    NeighborhoodCache<pcl::PointXYZRGB>::Ptr tree(new NeighborhoodCache<pcl::PointXYZRGB>);
+    tree->setMaxRadius(std::max(std::max(normal_threshold, wild_radius), rsd ? rsd_radius : 0.0f));
     pcl::PointCloud<pcl::Normal>::Ptr cloud_normals(new pcl::PointCloud<pcl::Normal>);
 
     normalEstimator.setInputCloud(source_cloud);
@@ -156,40 +184,47 @@ int main (int argc, char** argv)
     debug.show("Normals");
     double t_normals =  yarp::os::Time::now() - t_normals_start;
     std::cout << "Normal computation time: " << t_normals << " seconds." << std::endl;
+
+    float average_point_distance=0.005; //-- Parameter to determine output image resolution
+
     // RSD estimation object
     if (rsd)
     {
         double t_rsd_start = yarp::os::Time::now();
-        pcl::PointCloud<pcl::PrincipalRadiiRSD>::Ptr descriptors(new pcl::PointCloud<pcl::PrincipalRadiiRSD>());
-        pcl::RSDEstimation<pcl::PointXYZRGB, pcl::Normal, pcl::PrincipalRadiiRSD> rsd;
+        std::vector<float> r_min, r_max;
+        RSDEstimator<pcl::PointXYZRGB> rsd;
         rsd.setInputCloud(source_cloud);
-        rsd.setInputNormals(filtered_normals);
+        rsd.setInputNormals(cloud_normals);
         rsd.setSearchMethod(tree);
         // Search radius, to look for neighbors. Note: the value given here has to be
         // larger than the radius used to estimate the normals.
-        rsd.setRadiusSearch(0.03);
+        rsd.setRadiusSearch(rsd_radius);
         // Plane radius. Any radius larger than this is considered infinite (a plane).
         rsd.setPlaneRadius(0.1);
-        // Do we want to save the full distance-angle histograms?
-        rsd.setSaveHistograms(false);
+        // Approximate mode: subsample the neighbors of each point (0 uses all of them).
+        rsd.setMaxNeighbors(rsd_max_neighbors);
 
-        rsd.compute(*descriptors);
+        rsd.compute(r_min, r_max);
 
         double t_rsd = yarp::os::Time::now() - t_rsd_start;
         std::cout << "RSD computation time: " << t_rsd << " seconds." << std::endl;
         std::cout << "RSD total computation time: " << t_rsd + t_normals << " seconds." << std::endl;
 
-        //-- Save to mat file
-        std::ofstream rsd_file((argv[filenames[0]]+output_rsd).c_str());
-        for (int i = 0; i < source_cloud->points.size(); i++)
+        //-- Save to mat file (binary if its name ends in .bin)
+        RSDEstimator<pcl::PointXYZRGB>::save(argv[filenames[0]]+output_rsd, *source_cloud, r_min, r_max);
+
+        //-- Curvature maps, on the same grid as the depth and WiLD images
+        Eigen::MatrixXf r_min_image, r_max_image;
+        if (rsd.computeImages(average_point_distance, r_min, r_max, r_min_image, r_max_image))
         {
-            rsd_file << source_cloud->points[i].x << " "
-                     << source_cloud->points[i].y << " "
-                     << source_cloud->points[i].z << " "
-                     << descriptors->points[i].r_min << " "
-                     << descriptors->points[i].r_max << "\n";
+            std::ofstream r_min_file((argv[filenames[0]]+output_rsd_min_image).c_str());
+            r_min_file << r_min_image;
+            r_min_file.close();
+
+            std::ofstream r_max_file((argv[filenames[0]]+output_rsd_max_image).c_str());
+            r_max_file << r_max_image;
+            r_max_file.close();
         }
-        rsd_file.close();
     }
 
     //-- WILD
@@ -197,39 +232,14 @@ int main (int argc, char** argv)
     //-- Compute wild descriptor
     double t_wild_start = yarp::os::Time::now();
 
-    const double threshold = 0.03;
-    std::vector<double> wild(source_cloud->points.size());
-
-    #pragma omp parallel for
-    for (int i = 0; i < source_cloud->points.size(); i++)
-    {
-        //-- Create vector from normal of current point
-        Eigen::Vector3f current_normal(cloud_normals->points[i].normal_x,
-                                       cloud_normals->points[i].normal_y,
-                                       cloud_normals->points[i].normal_z);
-
-        //-- Find neighbors within radius
-        std::vector<int> pointIdxRadiusSearch;
-        std::vector<float> pointRadiusSquaredDistance;
-        double current_wild = -Eigen::Infinity; //-- Will this work?
-
-        if (tree->radiusSearch(source_cloud->points[i], threshold, pointIdxRadiusSearch, pointRadiusSquaredDistance) > 0)
-        {
-            for (auto& j: pointIdxRadiusSearch)
-            {
-                //-- Compute descriptor
-                Eigen::Vector3f neighbor_normal(cloud_normals->points[j].normal_x,
-                                                cloud_normals->points[j].normal_y,
-                                                cloud_normals->points[j].normal_z);
-
-                current_wild += current_normal.dot(neighbor_normal);
-            }
-
-            current_wild /= (double)pointIdxRadiusSearch.size();
-        }
-
-        wild[i] =current_wild;
-    }
+    std::vector<double> wild;
+    WiLDEstimator<pcl::PointXYZRGB> wild_estimator;
+    wild_estimator.setInputCloud(source_cloud);
+    wild_estimator.setInputNormals(cloud_normals);
+    wild_estimator.setSearchMethod(tree); //-- Already filled for the normals
+    wild_estimator.setRadius(wild_radius);
+    wild_estimator.setLegacyOffset(true);
+    wild_estimator.compute(wild);
 
     double t_wild = yarp::os::Time::now() - t_wild_start;
     std::cout << "WiLD computation time: " << t_wild << " seconds." << std::endl;
@@ -250,8 +260,6 @@ int main (int argc, char** argv)
 
     //-- Create 2D output image
     //-------------------------------------------------------------------------------------------
-    float average_point_distance=0.005; //-- Parameter to determine output image resolution
-
     //-- Find bounding box of input point_cloud (already centered)
     pcl::MomentOfInertiaEstimation<pcl::PointXYZRGB> feature_extractor;
     pcl::PointXYZRGB min_point_AABB, max_point_AABB;
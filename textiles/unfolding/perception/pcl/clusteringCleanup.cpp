@@ -12,15 +12,9 @@
 #include <pcl/io/pcd_io.h>
 #include <pcl/io/ply_io.h>
 #include <pcl/point_types.h>
-#include <pcl/ModelCoefficients.h>
-#include <pcl/filters/extract_indices.h>
-#include <pcl/filters/voxel_grid.h>
-#include <pcl/features/normal_3d.h>
-#include <pcl/kdtree/kdtree.h>
-#include <pcl/sample_consensus/method_types.h>
-#include <pcl/sample_consensus/model_types.h>
-#include <pcl/segmentation/sac_segmentation.h>
-#include <pcl/segmentation/extract_clusters.h>
+
+#include "Pipeline.hpp"
+#include "CloudStages.hpp"
 
 void show_usage(char * program_name)
 {
@@ -30,7 +24,9 @@ void show_usage(char * program_name)
     std::cout << "-o: Output folder for cluster data (default: "")" << std::endl;
     std::cout << "--ransac: Enable plane segmentation (default: false)" << std::endl;
     std::cout << "--ransac-threshold: Set ransac threshold value (default: 0.02)" << std::endl;
+    std::cout << "--plane-candidates: Number of regions where candidate planes are searched concurrently (default: 1)" << std::endl;
     std::cout << "--cluster-params: Set clustering parameters (default: 0.02 100 250000)" << std::endl;
+    std::cout << "--cache-dir: Folder to keep intermediate results between runs (default: disabled)" << std::endl;
 }
 
 int main (int argc, char** argv)
@@ -39,9 +35,11 @@ int main (int argc, char** argv)
     std::string output_folder = "";
     bool ransac_enabled = false;
     float ransac_threshold = 0.02;
+    int plane_candidates = 1;
     float cluster_tolerance = 0.02;
     float cluster_min_size = 100;
     float cluster_max_size = 2500000;
+    std::string cache_directory = "";
 
     //-- Show usage
     if (pcl::console::find_switch(argc, argv, "-h") || pcl::console::find_switch(argc, argv, "--help"))
@@ -65,15 +63,19 @@ int main (int argc, char** argv)
         ransac_enabled = true;
         if (pcl::console::find_switch(argc, argv, "--ransac-threshold"))
             pcl::console::parse_argument(argc, argv, "--ransac-threshold", ransac_threshold);
+        if (pcl::console::find_switch(argc, argv, "--plane-candidates"))
+            pcl::console::parse_argument(argc, argv, "--plane-candidates", plane_candidates);
     }
 
     if (pcl::console::find_switch(argc, argv, "--cluster-params"))
         pcl::console::parse_3x_arguments(argc, argv, "--cluster-params", cluster_tolerance,
                                          cluster_min_size, cluster_max_size);
 
+    if (pcl::console::find_switch(argc, argv, "--cache-dir"))
+        pcl::console::parse_argument(argc, argv, "--cache-dir", cache_directory);
+
     //-- Get point cloud file from arguments
     std::vector<int> filenames;
-    bool file_is_pcd = false;
 
     filenames = pcl::console::parse_file_extension_argument(argc, argv, ".ply");
 
@@ -86,30 +88,6 @@ int main (int argc, char** argv)
             show_usage(argv[0]);
             return -1;
         }
-
-        file_is_pcd = true;
-    }
-
-    //-- Load point cloud data
-    pcl::PointCloud<pcl::PointXYZ>::Ptr source_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
-    if (file_is_pcd)
-    {
-        if (pcl::io::loadPCDFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-    }
-    else
-    {
-        if (pcl::io::loadPLYFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
     }
 
     //-- Print arguments to user
@@ -125,89 +103,54 @@ int main (int argc, char** argv)
         std::cout << "\tRANSAC enabled with threshold: " << ransac_threshold << std::endl;
 
 
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_filtered(new pcl::PointCloud<pcl::PointXYZ>);
+    //-- Assemble the processing stages. Only the stages whose parameters (or inputs) changed
+    //-- since the last run with the same cache folder are actually run
+    Pipeline pipeline;
+    pipeline.setCacheDirectory(cache_directory);
+    pipeline.addStage("load", PipelineStage::Ptr(new LoadCloudStage<pcl::PointXYZ>(argv[filenames[0]])));
+
+    std::string cloud_stage = "load";
     if (ransac_enabled)
     {
-        // Create the filtering object: downsample the dataset using a leaf size of 1cm
-        pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
-        voxel_grid.setInputCloud(source_cloud);
-        voxel_grid.setLeafSize(0.01f, 0.01f, 0.01f);
-        voxel_grid.filter(*cloud_filtered);
-        std::cout << "PointCloud after filtering has: " << cloud_filtered->points.size ()  << " data points." << std::endl; //*
-
-        // Create the segmentation object for the planar model and set all the parameters
-        pcl::SACSegmentation<pcl::PointXYZ> seg;
-        pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-        pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_plane(new pcl::PointCloud<pcl::PointXYZ> ());
-        seg.setOptimizeCoefficients(true);
-        seg.setModelType(pcl::SACMODEL_PLANE);
-        seg.setMethodType(pcl::SAC_RANSAC);
-        seg.setDistanceThreshold(ransac_threshold);
-
-        int i=0, nr_points = (int) cloud_filtered->points.size();
-        while (cloud_filtered->points.size() > 0.3 * nr_points)
-        {
-            // Segment the largest planar component from the remaining cloud
-            seg.setInputCloud(cloud_filtered);
-            seg.segment(*inliers, *coefficients);
-            if (inliers->indices.size() == 0)
-            {
-                std::cout << "Could not estimate a planar model for the given dataset." << std::endl;
-                break;
-            }
-
-            // Extract the planar inliers from the input cloud
-            pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_f(new pcl::PointCloud<pcl::PointXYZ>);
-            pcl::ExtractIndices<pcl::PointXYZ> extract;
-            extract.setInputCloud(cloud_filtered);
-            extract.setIndices(inliers);
-            extract.setNegative(false);
-
-            // Get the points associated with the planar surface
-            extract.filter(*cloud_plane);
-            std::cout << "PointCloud representing the planar component: " << cloud_plane->points.size () << " data points." << std::endl;
-
-            // Remove the planar inliers, extract the rest
-            extract.setNegative(true);
-            extract.filter(*cloud_f);
-            *cloud_filtered = *cloud_f;
-        }
+        //-- Downsample the dataset using a leaf size of 1cm
+        pipeline.addStage("voxel", PipelineStage::Ptr(new VoxelGridStage<pcl::PointXYZ>(0.01f)),
+                          std::vector<std::string>(1, "load"));
+        cloud_stage = "voxel";
     }
-    else
+
+    //-- Sort the points along a Z-order curve, so the neighborhood searches read nearby memory
+    pipeline.addStage("morton", PipelineStage::Ptr(new MortonReorderingStage<pcl::PointXYZ>()),
+                      std::vector<std::string>(1, cloud_stage));
+    cloud_stage = "morton";
+
+    std::vector<std::string> cluster_inputs(1, cloud_stage);
+    if (ransac_enabled)
     {
-        *cloud_filtered = *source_cloud;
+        //-- Peel all the planar components: only the points not belonging to any plane are clustered
+        pipeline.addStage("planes", PipelineStage::Ptr(new PlaneRemovalStage<pcl::PointXYZ>(ransac_threshold, 0.3, plane_candidates)),
+                          std::vector<std::string>(1, cloud_stage));
+        cluster_inputs.push_back("planes");
     }
 
-    // Creating the KdTree object for the search method of the extraction
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
-    tree->setInputCloud(cloud_filtered);
+    pipeline.addStage("clusters", PipelineStage::Ptr(new EuclideanClusteringStage<pcl::PointXYZ>(cluster_tolerance, cluster_min_size, cluster_max_size)),
+                      cluster_inputs);
 
     std::vector<pcl::PointIndices> cluster_indices;
-    pcl::EuclideanClusterExtraction<pcl::PointXYZ> ec;
-    ec.setClusterTolerance(cluster_tolerance);
-    ec.setMinClusterSize(cluster_min_size);
-    ec.setMaxClusterSize(cluster_max_size);
-    ec.setSearchMethod(tree);
-    ec.setInputCloud(cloud_filtered);
-    ec.extract(cluster_indices);
-
-    int j = 0;
-    for (std::vector<pcl::PointIndices>::const_iterator it = cluster_indices.begin(); it != cluster_indices.end (); ++it)
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr cloud_filtered;
+    if (!pipeline.run("clusters", cluster_indices) || !pipeline.run(cloud_stage, cloud_filtered))
+    {
+        show_usage(argv[0]);
+        return -1;
+    }
+
+    //-- Clusters are written straight from their indices, without copying them into new clouds
+    pcl::PCDWriter writer;
+    for (int j = 0; j < (int)cluster_indices.size(); j++)
     {
-        pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_cluster(new pcl::PointCloud<pcl::PointXYZ>);
-        for (std::vector<int>::const_iterator pit = it->indices.begin(); pit != it->indices.end (); ++pit)
-            cloud_cluster->points.push_back(cloud_filtered->points[*pit]);
-        cloud_cluster->width = cloud_cluster->points.size();
-        cloud_cluster->height = 1;
-        cloud_cluster->is_dense = true;
-
-        std::cout << "PointCloud representing the Cluster: " << cloud_cluster->points.size() << " data points." << std::endl;
+        std::cout << "PointCloud representing the Cluster: " << cluster_indices[j].indices.size() << " data points." << std::endl;
         std::stringstream ss;
         ss << output_folder << "/" << "cloud_cluster_" << j << ".pcd";
-                pcl::PCDWriter writer;
-        writer.write<pcl::PointXYZ> (ss.str(), *cloud_cluster, false);
-        j++;
+        writer.write<pcl::PointXYZ>(ss.str(), *cloud_filtered, cluster_indices[j].indices, false);
     }
 
     return 0;
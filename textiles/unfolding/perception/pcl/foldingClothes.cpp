@@ -24,11 +24,12 @@
 //-- RSD estimation
 #include <pcl/features/normal_3d.h>
 #include <pcl/features/normal_3d_omp.h>
-#include <pcl/features/rsd.h>
 
 //-- My classes
 #include "PointCloudPreprocessor.hpp"
 #include "ZBufferDepthImageCreator.hpp"
+#include "NeighborhoodCache.hpp"
+#include "RSDEstimator.hpp"
 
 #include <fstream>
 
@@ -44,6 +45,7 @@ void show_usage(char * program_name)
   std::cout << "-d, --depth: Output file for depth image" << std::endl;
   std::cout << "-r, --rsd: Output file for RSD data" << std::endl;
   std::cout << "--rsd-params: Parameters for RSD (kdtree radius for normals, for curvature and plane threshold" << std::endl;
+  std::cout << "--rsd-max-neighbors: Approximate RSD with at most this many neighbors per point (default: 0, all)" << std::endl;
 }
 
 int main(int argc, char* argv[])
@@ -60,6 +62,7 @@ int main(int argc, char* argv[])
     double rsd_normal_radius = 0.05;
     double rsd_curvature_radius = 0.07;
     double rsd_plane_threshold = 0.2;
+    int rsd_max_neighbors = 0;
 
     //-- Show usage
     if (pcl::console::find_switch(argc, argv, "-h") || pcl::console::find_switch(argc, argv, "--help"))
@@ -102,6 +105,7 @@ int main(int argc, char* argv[])
     if (pcl::console::find_switch(argc, argv, "--rsd-params"))
         pcl::console::parse_3x_arguments(argc, argv, "--rsd-params", rsd_normal_radius, rsd_curvature_radius,
                                          rsd_plane_threshold);
+    pcl::console::parse_argument(argc, argv, "--rsd-max-neighbors", rsd_max_neighbors);
 
     //-- Get point cloud file from arguments
     std::vector<int> filenames;
@@ -184,8 +188,8 @@ int main(int argc, char* argv[])
     //-----------------------------------------------------------------------------------
     // Object for storing the normals.
     pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
-    // Object for storing the RSD descriptors for each point.
-    pcl::PointCloud<pcl::PrincipalRadiiRSD>::Ptr descriptors(new pcl::PointCloud<pcl::PrincipalRadiiRSD>());
+    // Minimum and maximum radius of each point.
+    std::vector<float> r_min, r_max;
 
 
     // Note: you would usually perform downsampling now. It has been omitted here
@@ -195,13 +199,15 @@ int main(int argc, char* argv[])
     pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> normalEstimation;
     normalEstimation.setInputCloud(garment_points);
     normalEstimation.setRadiusSearch(rsd_normal_radius);
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr kdtree(new pcl::search::KdTree<pcl::PointXYZ>);
+    // Neighborhoods are searched once, at the largest radius, for both normals and RSD.
+    NeighborhoodCache<pcl::PointXYZ>::Ptr kdtree(new NeighborhoodCache<pcl::PointXYZ>);
+    kdtree->setMaxRadius(std::max(rsd_normal_radius, rsd_curvature_radius));
     normalEstimation.setSearchMethod(kdtree);
     normalEstimation.setViewPoint(0, 0 , 2);
     normalEstimation.compute(*normals);
 
     // RSD estimation object.
-    pcl::RSDEstimation<pcl::PointXYZ, pcl::Normal, pcl::PrincipalRadiiRSD> rsd;
+    RSDEstimator<pcl::PointXYZ> rsd;
     rsd.setInputCloud(garment_points);
     rsd.setInputNormals(normals);
     rsd.setSearchMethod(kdtree);
@@ -210,22 +216,13 @@ int main(int argc, char* argv[])
     rsd.setRadiusSearch(rsd_curvature_radius);
     // Plane radius. Any radius larger than this is considered infinite (a plane).
     rsd.setPlaneRadius(rsd_plane_threshold);
-    // Do we want to save the full distance-angle histograms?
-    rsd.setSaveHistograms(false);
+    // Approximate mode: subsample the neighbors of each point (0 uses all of them).
+    rsd.setMaxNeighbors(rsd_max_neighbors);
 
-    rsd.compute(*descriptors);
+    rsd.compute(r_min, r_max);
 
-    //-- Save to mat file
-    std::ofstream rsd_file(output_rsd_data.c_str());
-    for (int i = 0; i < garment_points->points.size(); i++)
-    {
-        rsd_file << garment_points->points[i].x << " "
-                 << garment_points->points[i].y << " "
-                 << garment_points->points[i].z << " "
-                 << descriptors->points[i].r_min << " "
-                 << descriptors->points[i].r_max << "\n";
-    }
-    rsd_file.close();
+    //-- Save to mat file (binary if its name ends in .bin)
+    RSDEstimator<pcl::PointXYZ>::save(output_rsd_data, *garment_points, r_min, r_max);
 
     //-- Obtain range image
     //-----------------------------------------------------------------------------------
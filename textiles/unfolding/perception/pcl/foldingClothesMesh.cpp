@@ -17,18 +17,19 @@
 //-- Projection
 #include <pcl/ModelCoefficients.h>
 #include <pcl/filters/project_inliers.h>
-//-- Bounding box
-#include <pcl/features/moment_of_inertia_estimation.h>
 #include <vector>
 #include <pcl/visualization/cloud_viewer.h>
 //-- RSD estimation
 #include <pcl/features/normal_3d.h>
 #include <pcl/features/normal_3d_omp.h>
-#include <pcl/features/rsd.h>
 
 //-- My classes
-#include "MeshPreprocessor.hpp"
-#include "HistogramImageCreator.hpp"
+#include "Pipeline.hpp"
+#include "CloudStages.hpp"
+#include "MeshPreprocessorStage.hpp"
+#include "CloudLoader.hpp"
+#include "SpatialHashSearch.hpp"
+#include "RSDEstimator.hpp"
 
 #include <fstream>
 
@@ -42,12 +43,14 @@ void show_usage(char * program_name)
   std::cout << "Usage: " << program_name << " cloud_filename.[pcd|ply]" << std::endl;
   std::cout << "-h:  Show this help." << std::endl;
   std::cout << "-t, --threshold:  Distance threshold for RANSAC (default: 0.03)" << std::endl;
+  std::cout << "--cache-dir: Folder to keep intermediate results between runs (default: disabled)" << std::endl;
 #ifdef HISTOGRAM
   std::cout << "--histogram: Output file for histogram image" << std::endl;
 #endif
 #ifdef CURVATURE
   std::cout << "-r, --rsd: Output file for RSD data" << std::endl;
   std::cout << "--rsd-params: Parameters for RSD (kdtree radius for normals, for curvature and plane threshold" << std::endl;
+  std::cout << "--rsd-max-neighbors: Approximate RSD with at most this many neighbors per point (default: 0, all)" << std::endl;
 #endif
 }
 
@@ -60,6 +63,8 @@ int main(int argc, char* argv[])
     double rsd_normal_radius = 0.05;
     double rsd_curvature_radius = 0.07;
     double rsd_plane_threshold = 0.2;
+    int rsd_max_neighbors = 0;
+    std::string cache_directory = "";
 
     //-- Show usage
     if (pcl::console::find_switch(argc, argv, "-h") || pcl::console::find_switch(argc, argv, "--help"))
@@ -74,6 +79,9 @@ int main(int argc, char* argv[])
     else if (pcl::console::find_switch(argc, argv, "--threshold"))
         pcl::console::parse_argument(argc, argv, "--threshold", threshold);
 
+    if (pcl::console::find_switch(argc, argv, "--cache-dir"))
+        pcl::console::parse_argument(argc, argv, "--cache-dir", cache_directory);
+
     if (pcl::console::find_switch(argc, argv, "--histogram"))
         pcl::console::parse_argument(argc, argv, "--histogram", output_histogram_image);
 
@@ -85,25 +93,15 @@ int main(int argc, char* argv[])
     if (pcl::console::find_switch(argc, argv, "--rsd-params"))
         pcl::console::parse_3x_arguments(argc, argv, "--rsd-params", rsd_normal_radius, rsd_curvature_radius,
                                          rsd_plane_threshold);
+    pcl::console::parse_argument(argc, argv, "--rsd-max-neighbors", rsd_max_neighbors);
 
     //-- Get point cloud file from arguments
-    std::vector<int> filenames;
-    bool file_is_pcd = false;
-
-    filenames = pcl::console::parse_file_extension_argument(argc, argv, ".ply");
-
-    if (filenames.size() != 1)
+    std::string input_filename = CloudLoader::parseFilenameArgument(argc, argv);
+    if (input_filename.empty())
     {
-        filenames = pcl::console::parse_file_extension_argument(argc, argv, ".pcd");
-
-        if (filenames.size() != 1)
-        {
-            std::cerr << "No input file specified!" << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-
-        file_is_pcd = true;
+        std::cerr << "No input file specified!" << std::endl;
+        show_usage(argv[0]);
+        return -1;
     }
 
     //-- Print arguments to user
@@ -119,55 +117,45 @@ int main(int argc, char* argv[])
               << "\t\tCurvature search radius: " << rsd_curvature_radius << std::endl
               << "\t\tPlane threshold: " << rsd_plane_threshold << std::endl
 #endif
-              << "\tInput file: " << argv[filenames[0]] << std::endl;
+              << "\tInput file: " << input_filename << std::endl;
 
 
 
-    //-- Load point cloud data
-    pcl::PointCloud<pcl::PointXYZ>::Ptr source_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    //-- Assemble the processing stages. Only the stages whose parameters (or inputs) changed
+    //-- since the last run with the same cache folder are actually run
+    Pipeline pipeline;
+    pipeline.setCacheDirectory(cache_directory);
+    pipeline.addStage("load", PipelineStage::Ptr(new LoadCloudStage<pcl::PointXYZ>(input_filename)));
 
-    if (file_is_pcd)
-    {
-        if (pcl::io::loadPCDFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-    }
-    else
-    {
-        if (pcl::io::loadPLYFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-    }
+    //-- Initial pre-processing of the mesh
+    pipeline.addStage("preprocess", PipelineStage::Ptr(new MeshPreprocessorStage<pcl::PointXYZ>(threshold)),
+                      std::vector<std::string>(1, "load"));
+
+    //-- Find bounding box (not really required)
+    pipeline.addStage("bounding_box", PipelineStage::Ptr(new OrientedBoundingBoxStage<pcl::PointXYZ>()),
+                      std::vector<std::string>(1, "preprocess"));
+
+#ifdef HISTOGRAM
+    //-- Histogram image of the garment
+    pipeline.addStage("histogram", PipelineStage::Ptr(new HistogramImageStage<pcl::PointXYZ>(1024, true)),
+                      std::vector<std::string>(1, "preprocess"));
+#endif
 
     /********************************************************************************************
     * Stuff goes on here
     *********************************************************************************************/
-    //-- Initial pre-processing of the mesh
-    //------------------------------------------------------------------------------------
     std::cout << "[+] Pre-processing the mesh..." << std::endl;
-    pcl::PointCloud<pcl::PointXYZ>::Ptr garment_points(new pcl::PointCloud<pcl::PointXYZ>);
-    MeshPreprocessor<pcl::PointXYZ> preprocessor;
-    preprocessor.setRANSACThresholdDistance(threshold);
-    preprocessor.setInputCloud(source_cloud);
-    preprocessor.process(*garment_points);
-
-    //-- Find bounding box (not really required)
-    pcl::MomentOfInertiaEstimation<pcl::PointXYZ> feature_extractor;
-    pcl::PointXYZ min_point_AABB, max_point_AABB;
-    pcl::PointXYZ min_point_OBB,  max_point_OBB;
-    pcl::PointXYZ position_OBB;
-    Eigen::Matrix3f rotational_matrix_OBB;
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr garment_points;
+    if (!pipeline.run("preprocess", garment_points))
+    {
+        std::cout << "Error processing point cloud " << input_filename << std::endl << std::endl;
+        show_usage(argv[0]);
+        return -1;
+    }
 
-    feature_extractor.setInputCloud(garment_points);
-    feature_extractor.compute();
-    feature_extractor.getAABB(min_point_AABB, max_point_AABB);
-    feature_extractor.getOBB(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB);
+    OrientedBoundingBox bounding_box;
+    if (pipeline.run("bounding_box", bounding_box))
+        std::cout << "Garment bounding box size: " << (bounding_box.max_point - bounding_box.min_point).transpose() << std::endl;
 
 #ifdef CURVATURE
     //-- Curvature stuff
@@ -175,8 +163,8 @@ int main(int argc, char* argv[])
     std::cout << "[+] Calculating curvature descriptors..." << std::endl;
     // Object for storing the normals.
     pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
-    // Object for storing the RSD descriptors for each point.
-    pcl::PointCloud<pcl::PrincipalRadiiRSD>::Ptr descriptors(new pcl::PointCloud<pcl::PrincipalRadiiRSD>());
+    // Minimum and maximum radius of each point.
+    std::vector<float> r_min, r_max;
 
 
     // Note: you would usually perform downsampling now. It has been omitted here
@@ -186,13 +174,14 @@ int main(int argc, char* argv[])
     pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> normalEstimation;
     normalEstimation.setInputCloud(garment_points);
     normalEstimation.setRadiusSearch(rsd_normal_radius);
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr kdtree(new pcl::search::KdTree<pcl::PointXYZ>);
+    // Hash grid with cells of the largest radius, shared by normals and RSD.
+    SpatialHashSearch<pcl::PointXYZ>::Ptr kdtree(new SpatialHashSearch<pcl::PointXYZ>(std::max(rsd_normal_radius, rsd_curvature_radius)));
     normalEstimation.setSearchMethod(kdtree);
     normalEstimation.setViewPoint(0, 0 , 2);
     normalEstimation.compute(*normals);
 
     // RSD estimation object.
-    pcl::RSDEstimation<pcl::PointXYZ, pcl::Normal, pcl::PrincipalRadiiRSD> rsd;
+    RSDEstimator<pcl::PointXYZ> rsd;
     rsd.setInputCloud(garment_points);
     rsd.setInputNormals(normals);
     rsd.setSearchMethod(kdtree);
@@ -201,22 +190,13 @@ int main(int argc, char* argv[])
     rsd.setRadiusSearch(rsd_curvature_radius);
     // Plane radius. Any radius larger than this is considered infinite (a plane).
     rsd.setPlaneRadius(rsd_plane_threshold);
-    // Do we want to save the full distance-angle histograms?
-    rsd.setSaveHistograms(false);
+    // Approximate mode: subsample the neighbors of each point (0 uses all of them).
+    rsd.setMaxNeighbors(rsd_max_neighbors);
 
-    rsd.compute(*descriptors);
+    rsd.compute(r_min, r_max);
 
-    //-- Save to mat file
-    std::ofstream rsd_file(output_rsd_data.c_str());
-    for (int i = 0; i < garment_points->points.size(); i++)
-    {
-        rsd_file << garment_points->points[i].x << " "
-                 << garment_points->points[i].y << " "
-                 << garment_points->points[i].z << " "
-                 << descriptors->points[i].r_min << " "
-                 << descriptors->points[i].r_max << "\n";
-    }
-    rsd_file.close();
+    //-- Save to mat file (binary if its name ends in .bin)
+    RSDEstimator<pcl::PointXYZ>::save(output_rsd_data, *garment_points, r_min, r_max);
 
 #endif
 
@@ -224,12 +204,9 @@ int main(int argc, char* argv[])
     //-- Obtain histogram image
     //-----------------------------------------------------------------------------------
     std::cout << "[+] Calculating histogram image..." << std::endl;
-    HistogramImageCreator<pcl::PointXYZ> histogram_image_creator;
-    histogram_image_creator.setInputPointCloud(garment_points);
-    histogram_image_creator.setResolution(1024);
-    histogram_image_creator.setUpsampling(true);
-    histogram_image_creator.compute();
-    Eigen::MatrixXi image = histogram_image_creator.getDepthImageAsMatrix();
+    Eigen::MatrixXi image;
+    if (!pipeline.run("histogram", image))
+        return -2;
 
     //-- Temporal fix to get image (through file)
     std::ofstream file(output_histogram_image.c_str());
@@ -22,12 +22,13 @@
 //-- Passthrough filter
 #include <pcl/filters/passthrough.h>
 //-- Voxels
-#include <pcl/filters/voxel_grid.h>
 //-- Projection
 #include <pcl/ModelCoefficients.h>
 #include <pcl/filters/project_inliers.h>
 //-- Debug
 #include "Debug.hpp"
+#include "VoxelGridDownsampler.hpp"
+#include "CloudView.hpp"
 
 
 template<typename PointT>
@@ -42,6 +43,7 @@ class MeshPreprocessor
         MeshPreprocessor() {
             //-- Set default values
             RANSAC_threshold_distance = 0.03;
+            debug_enabled = false;
         }
 
         void setRANSACThresholdDistance(float threshold_distance) {
@@ -52,18 +54,20 @@ class MeshPreprocessor
             this->input_cloud = input_cloud;
         }
 
+        void setDebugEnabled(bool debug_enabled) {
+            this->debug_enabled = debug_enabled;
+        }
+
         bool process(pcl::PointCloud<PointT>& output_cloud) {
-            //-- Create debug object
+            //-- Create debug object (clouds are only copied for plotting when it is enabled)
             Debug debug;
-            debug.setEnabled(false);
-            PointCloudPtr print_cloud(new PointCloud);
-            *print_cloud = *input_cloud;
-            debug.plotPointCloud<PointT>(print_cloud, Debug::COLOR_CYAN);
+            debug.setEnabled(debug_enabled);
+            debug.plotPointCloud<PointT>(input_cloud, Debug::COLOR_CYAN);
             debug.show("Original");
 
             //-- Downsampling the mesh prior to RANSAC
             PointCloudPtr downsampled_point_cloud(new PointCloud);
-            typename pcl::VoxelGrid<PointT> voxel_grid_filter;
+            VoxelGridDownsampler<PointT> voxel_grid_filter;
             voxel_grid_filter.setInputCloud(input_cloud);
             voxel_grid_filter.setLeafSize(0.01f, 0.01f, 0.01f); //-- 1cm^3
             voxel_grid_filter.filter(*downsampled_point_cloud);
@@ -100,15 +104,21 @@ class MeshPreprocessor
             //-- Find points that do not belong to the plane
             //----------------------------------------------------------------------------------
             //-- Filter table points
-            PointCloudPtr not_table_points (new PointCloud);
+            pcl::IndicesPtr not_table_indices(new std::vector<int>);
             typename pcl::ExtractIndices<PointT> extract_indices;
             extract_indices.setInputCloud(downsampled_point_cloud);
             extract_indices.setIndices(table_plane_points);
             extract_indices.setNegative(true);
-            extract_indices.filter(*not_table_points);
+            extract_indices.filter(*not_table_indices);
+            CloudView<PointT> not_table_points(downsampled_point_cloud, not_table_indices);
 
-            debug.plotPointCloud<PointT>(not_table_points, Debug::COLOR_MAGENTA);
-            debug.show("Not table points");
+            if (debug_enabled)
+            {
+                PointCloudPtr not_table_cloud(new PointCloud);
+                not_table_points.copyTo(*not_table_cloud);
+                debug.plotPointCloud<PointT>(not_table_cloud, Debug::COLOR_MAGENTA);
+                debug.show("Not table points");
+            }
 //            *not_table_points = *input_cloud;     //-- Add this to disable RANSAC filtering
 
             //-- Find bounding box:
@@ -119,7 +129,8 @@ class MeshPreprocessor
             PointT position_OBB;
             Eigen::Matrix3f rotational_matrix_OBB;
 
-            feature_extractor.setInputCloud(not_table_points);
+            feature_extractor.setInputCloud(downsampled_point_cloud);
+            feature_extractor.setIndices(not_table_points.getIndices());
             feature_extractor.compute();
             feature_extractor.getAABB(min_point_AABB, max_point_AABB);
             feature_extractor.getOBB(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB);
@@ -138,16 +149,14 @@ class MeshPreprocessor
             //-- Transform point cloud
             //-----------------------------------------------------------------------------------
             //-- Translating to center
-            PointCloudPtr centered_cloud(new PointCloud);
             Eigen::Affine3f translation_transform = Eigen::Affine3f::Identity();
             translation_transform.translation() << -projected_OBB.x, -projected_OBB.y, -projected_OBB.z;
-            pcl::transformPointCloud(*input_cloud, *centered_cloud, translation_transform);
 
-            //-- Orient using the plane normal
+            //-- Orient using the plane normal (both transformations are applied in a single pass)
             PointCloudPtr oriented_cloud(new PointCloud);
             Eigen::Vector3f normal_vector(table_plane_coefficients->values[0], table_plane_coefficients->values[1], table_plane_coefficients->values[2]);
             Eigen::Quaternionf rotation_quaternion = Eigen::Quaternionf().setFromTwoVectors(normal_vector, Eigen::Vector3f::UnitZ());
-            pcl::transformPointCloud(*centered_cloud, *oriented_cloud, Eigen::Vector3f(0,0,0), rotation_quaternion);
+            pcl::transformPointCloud(*input_cloud, *oriented_cloud, Eigen::Affine3f(rotation_quaternion * translation_transform));
 
             debug.plotPointCloud<PointT>(oriented_cloud, Debug::COLOR_BLUE);
             debug.show("Oriented");
@@ -161,16 +170,19 @@ class MeshPreprocessor
             passthrough_filter.filter(output_cloud);
 
             //output_cloud = *oriented_cloud; //-- Add to test if negative outliers shouldn't be removed
-            PointCloudPtr print_out_cloud(new PointCloud);
-            *print_out_cloud = output_cloud;
-            debug.plotPointCloud<PointT>(print_out_cloud, Debug::COLOR_GREEN);
-            debug.show("Filtered stuff");
+            if (debug_enabled)
+            {
+                PointCloudPtr print_out_cloud(new PointCloud(output_cloud));
+                debug.plotPointCloud<PointT>(print_out_cloud, Debug::COLOR_GREEN);
+                debug.show("Filtered stuff");
+            }
             return true;
         }
 
 
      private:
         float RANSAC_threshold_distance;
+        bool debug_enabled;
 
         PointCloudConstPtr input_cloud;
 };
@@ -0,0 +1,51 @@
+/*
+ * Mesh Preprocessor Stage
+ *
+ * Pipeline stage that runs the MeshPreprocessor: removes the table from the cloud and takes
+ * the garment to the frame of the table (input: cloud)
+ *
+ */
+
+#ifndef MESH_PREPROCESSOR_STAGE_HPP
+#define MESH_PREPROCESSOR_STAGE_HPP
+
+#include <iomanip>
+#include <sstream>
+
+#include "CloudStages.hpp"
+#include "MeshPreprocessor.hpp"
+
+template<typename PointT>
+class MeshPreprocessorStage : public CloudStage<PointT>
+{
+    typedef typename pcl::PointCloud<PointT>::ConstPtr PointCloudConstPtr;
+
+    public:
+        MeshPreprocessorStage(float ransac_threshold) : ransac_threshold(ransac_threshold) {}
+
+        virtual std::string getType() const { return "MeshPreprocessor"; }
+        virtual std::string getParameters() const
+        {
+            std::ostringstream parameters;
+            parameters << std::setprecision(9) << ransac_threshold;
+            return parameters.str();
+        }
+
+        virtual bool process(const std::vector<boost::any>& inputs, boost::any& output)
+        {
+            typename pcl::PointCloud<PointT>::Ptr garment_points(new pcl::PointCloud<PointT>);
+            MeshPreprocessor<PointT> preprocessor;
+            preprocessor.setRANSACThresholdDistance(ransac_threshold);
+            preprocessor.setInputCloud(boost::any_cast<PointCloudConstPtr>(inputs[0]));
+            if (!preprocessor.process(*garment_points))
+                return false;
+
+            output = PointCloudConstPtr(garment_points);
+            return true;
+        }
+
+    private:
+        float ransac_threshold;
+};
+
+#endif // MESH_PREPROCESSOR_STAGE_HPP
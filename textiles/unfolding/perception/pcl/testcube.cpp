@@ -7,10 +7,12 @@
 //-- RSD estimation
 #include <pcl/features/normal_3d.h>
 #include <pcl/features/normal_3d_omp.h>
-#include <pcl/features/rsd.h>
 
 #include <fstream>
 
+#include "SpatialHashSearch.hpp"
+#include "RSDEstimator.hpp"
+
 void show_usage(char * program_name)
 {
   std::cout << std::endl;
@@ -113,8 +115,8 @@ int main (int argc, char** argv)
     //-----------------------------------------------------------------------------------
     // Object for storing the normals.
     pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
-    // Object for storing the RSD descriptors for each point.
-    pcl::PointCloud<pcl::PrincipalRadiiRSD>::Ptr descriptors(new pcl::PointCloud<pcl::PrincipalRadiiRSD>());
+    // Minimum and maximum radius of each point.
+    std::vector<float> r_min, r_max;
 
 
     // Note: you would usually perform downsampling now. It has been omitted here
@@ -125,14 +127,14 @@ int main (int argc, char** argv)
     pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> normalEstimation;
     normalEstimation.setInputCloud(cloud);
     normalEstimation.setRadiusSearch(0.005);
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr kdtree(new pcl::search::KdTree<pcl::PointXYZ>);
+    SpatialHashSearch<pcl::PointXYZ>::Ptr kdtree(new SpatialHashSearch<pcl::PointXYZ>(0.007));
     normalEstimation.setSearchMethod(kdtree);
     normalEstimation.compute(*normals);
     std::cout << "Found " << normals->points.size() << " normals." << std::endl;
 
     // RSD estimation object.
     std::cout << "Computing RSD descriptors..." << std::endl;
-    pcl::RSDEstimation<pcl::PointXYZ, pcl::Normal, pcl::PrincipalRadiiRSD> rsd;
+    RSDEstimator<pcl::PointXYZ> rsd;
     rsd.setInputCloud(cloud);
     rsd.setInputNormals(normals);
     rsd.setSearchMethod(kdtree);
@@ -141,24 +143,13 @@ int main (int argc, char** argv)
     rsd.setRadiusSearch(0.007);
     // Plane radius. Any radius larger than this is considered infinite (a plane).
     rsd.setPlaneRadius(0.005);
-    // Do we want to save the full distance-angle histograms?
-    rsd.setSaveHistograms(false);
 
-    rsd.compute(*descriptors);
-    std::cout << "Found " << descriptors->points.size() << " descriptors." << std::endl;
+    rsd.compute(r_min, r_max);
+    std::cout << "Found " << r_min.size() << " descriptors." << std::endl;
 
     //-- Save to mat file
     std::cout << "Saving to file " << filename <<  " ..." << std::endl;
-    std::ofstream rsd_file(filename.c_str());
-    for (int i = 0; i < cloud->points.size(); i++)
-    {
-        rsd_file << cloud->points[i].x << " "
-                 << cloud->points[i].y << " "
-                 << cloud->points[i].z << " "
-                 << descriptors->points[i].r_min << " "
-                 << descriptors->points[i].r_max << "\n";
-    }
-    rsd_file.close();
+    RSDEstimator<pcl::PointXYZ>::save(filename, *cloud, r_min, r_max);
 
     //-- Save point cloud
     pcl::io::savePCDFileASCII((filename+".pcd").c_str(), *cloud);
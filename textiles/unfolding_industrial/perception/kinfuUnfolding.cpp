@@ -15,7 +15,6 @@
 #include <pcl/io/ply_io.h>
 #include <pcl/point_types.h>
 //-- Downsampling
-#include <pcl/filters/voxel_grid.h>
 //-- Plane fitting
 #include <pcl/ModelCoefficients.h>
 #include <pcl/sample_consensus/method_types.h>
@@ -24,8 +23,7 @@
 //-- Filter by indices
 #include <pcl/filters/extract_indices.h>
 //-- Euclidean clustering
-#include <pcl/search/kdtree.h>
-#include <pcl/segmentation/extract_clusters.h>
+#include "LargestClusterExtraction.hpp"
 //-- Bounding box
 #include <pcl/features/moment_of_inertia_estimation.h>
 //-- Point projection
@@ -38,9 +36,13 @@
 
 //-- Textiles headers
 #include "Debug.hpp"
+#include "CloudLoader.hpp"
 #include "MaskImageCreator.hpp"
 #include "DepthImageCreator.hpp"
 #include "ImageUtils.hpp"
+#include "CloudView.hpp"
+#include "PlaneModelCache.hpp"
+#include "VoxelGridDownsampler.hpp"
 
 void show_usage(char * program_name)
 {
@@ -49,6 +51,8 @@ void show_usage(char * program_name)
     std::cout << "-h:  Show this help." << std::endl;
     std::cout << "--debug: Debug mode, shows visual feedback of each step" << std::endl;
     std::cout << "--ransac-threshold: Set ransac threshold value (default: 0.02)" << std::endl;
+    std::cout << "--plane-cache: File to store the table plane between scans of the same rig (default: disabled)" << std::endl;
+    std::cout << "--plane-cache-rig: Name of the rig the cached plane belongs to (default: kinfu_table)" << std::endl;
 }
 
 void record_transformation(std::string output_file, Eigen::Transform<float, 3, Eigen::Affine> t)
@@ -77,6 +81,8 @@ int main (int argc, char** argv)
 
     //-- Command-line arguments
     float ransac_threshold = 0.02;
+    std::string plane_cache_file = "";
+    std::string plane_cache_rig = "kinfu_table";
     bool debug_enabled = false;
 
     //-- Show usage
@@ -97,47 +103,30 @@ int main (int argc, char** argv)
         std::cerr << "RANSAC theshold not specified, using default value..." << std::endl;
     }
 
+    if (pcl::console::find_switch(argc, argv, "--plane-cache"))
+        pcl::console::parse_argument(argc, argv, "--plane-cache", plane_cache_file);
 
-    //-- Get point cloud file from arguments
-    std::vector<int> filenames;
-    bool file_is_pcd = false;
+    if (pcl::console::find_switch(argc, argv, "--plane-cache-rig"))
+        pcl::console::parse_argument(argc, argv, "--plane-cache-rig", plane_cache_rig);
 
-    filenames = pcl::console::parse_file_extension_argument(argc, argv, ".ply");
 
-    if (filenames.size() != 1)
+    //-- Get point cloud file from arguments
+    std::string input_filename = CloudLoader::parseFilenameArgument(argc, argv);
+    if (input_filename.empty())
     {
-        filenames = pcl::console::parse_file_extension_argument(argc, argv, ".pcd");
-
-        if (filenames.size() != 1)
-        {
-            show_usage(argv[0]);
-            return -1;
-        }
-
-        file_is_pcd = true;
+        show_usage(argv[0]);
+        return -1;
     }
 
     //-- Load point cloud data
-    pcl::PointCloud<pcl::PointXYZ>::Ptr source_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-
-    if (file_is_pcd)
+    CloudLoader cloud_loader;
+    if (!cloud_loader.load(input_filename))
     {
-        if (pcl::io::loadPCDFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading colored point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
-    }
-    else
-    {
-        if (pcl::io::loadPLYFile(argv[filenames[0]], *source_cloud) < 0)
-        {
-            std::cout << "Error loading colored point cloud " << argv[filenames[0]] << std::endl << std::endl;
-            show_usage(argv[0]);
-            return -1;
-        }
+        std::cout << "Error loading point cloud " << input_filename << std::endl << std::endl;
+        show_usage(argv[0]);
+        return -1;
     }
+    pcl::PointCloud<pcl::PointXYZ>::Ptr source_cloud = cloud_loader.getCloud<pcl::PointXYZ>();
 
     //-- Print arguments to user
     std::cout << "Selected arguments: " << std::endl;
@@ -159,7 +148,7 @@ int main (int argc, char** argv)
     //-- Downsample the dataset prior to plane detection (using a leaf size of 1cm)
     //-----------------------------------------------------------------------------------
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::VoxelGrid<pcl::PointXYZ> voxel_grid;
+    VoxelGridDownsampler<pcl::PointXYZ> voxel_grid;
     voxel_grid.setInputCloud(source_cloud);
     voxel_grid.setLeafSize(0.01f, 0.01f, 0.01f);
     voxel_grid.filter(*cloud_downsampled);
@@ -170,13 +159,32 @@ int main (int argc, char** argv)
     //------------------------------------------------------------------------------------
     pcl::ModelCoefficients::Ptr table_plane_coefficients(new pcl::ModelCoefficients);
     pcl::PointIndices::Ptr table_plane_points(new pcl::PointIndices);
-    pcl::SACSegmentation<pcl::PointXYZ> ransac_segmentation;
-    ransac_segmentation.setOptimizeCoefficients(true);
-    ransac_segmentation.setModelType(pcl::SACMODEL_PLANE);
-    ransac_segmentation.setMethodType(pcl::SAC_RANSAC);
-    ransac_segmentation.setDistanceThreshold(ransac_threshold);
-    ransac_segmentation.setInputCloud(cloud_downsampled);
-    ransac_segmentation.segment(*table_plane_points, *table_plane_coefficients);
+
+    //-- Refit the plane of the previous scan of this rig, if any, to avoid RANSAC
+    PlaneModelCache plane_cache;
+    bool plane_from_cache = false;
+    if (!plane_cache_file.empty() && plane_cache.load(plane_cache_file))
+        plane_from_cache = plane_cache.refit<pcl::PointXYZ>(plane_cache_rig, cloud_downsampled, ransac_threshold,
+                                                            *table_plane_coefficients, *table_plane_points);
+
+    if (!plane_from_cache)
+    {
+        pcl::SACSegmentation<pcl::PointXYZ> ransac_segmentation;
+        ransac_segmentation.setOptimizeCoefficients(true);
+        ransac_segmentation.setModelType(pcl::SACMODEL_PLANE);
+        ransac_segmentation.setMethodType(pcl::SAC_RANSAC);
+        ransac_segmentation.setDistanceThreshold(ransac_threshold);
+        ransac_segmentation.setInputCloud(cloud_downsampled);
+        ransac_segmentation.segment(*table_plane_points, *table_plane_coefficients);
+
+        if (!plane_cache_file.empty() && table_plane_points->indices.size() > 0)
+            plane_cache.storePlane(plane_cache_rig, *table_plane_coefficients,
+                                   PlaneModelCache::computeInlierRatio(*cloud_downsampled, *table_plane_coefficients,
+                                                                       ransac_threshold));
+    }
+
+    if (!plane_cache_file.empty() && table_plane_points->indices.size() > 0)
+        plane_cache.save(plane_cache_file);
 
     if (table_plane_points->indices.size() == 0)
     {
@@ -199,51 +207,46 @@ int main (int argc, char** argv)
 
     //-- Find points that do not belong to the plane
     //----------------------------------------------------------------------------------
-    pcl::PointCloud<pcl::PointXYZ>::Ptr not_table_points (new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::IndicesPtr not_table_indices(new std::vector<int>);
     pcl::ExtractIndices<pcl::PointXYZ> extract_indices;
     extract_indices.setInputCloud(cloud_downsampled);
     extract_indices.setIndices(table_plane_points);
     extract_indices.setNegative(true);
-    extract_indices.filter(*not_table_points);
+    extract_indices.filter(*not_table_indices);
+    CloudView<pcl::PointXYZ> not_table_points(cloud_downsampled, not_table_indices);
 
-    debug.setEnabled(debug_enabled);
-    debug.plotPointCloud<pcl::PointXYZ>(not_table_points, Debug::COLOR_CYAN);
-    debug.show("Not table points");
+    if (debug_enabled)
+    {
+        pcl::PointCloud<pcl::PointXYZ>::Ptr not_table_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+        not_table_points.copyTo(*not_table_cloud);
+        debug.setEnabled(debug_enabled);
+        debug.plotPointCloud<pcl::PointXYZ>(not_table_cloud, Debug::COLOR_CYAN);
+        debug.show("Not table points");
+    }
 
     //-- Compute largest cluster (the garment)
     //-----------------------------------------------------------------------------------
-    pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
-    tree->setInputCloud(not_table_points);
-
-    std::vector<pcl::PointIndices> cluster_indices;
-    pcl::EuclideanClusterExtraction<pcl::PointXYZ> euclidean_custering;
-    euclidean_custering.setClusterTolerance(0.015);
-    euclidean_custering.setMinClusterSize(100);
-    euclidean_custering.setSearchMethod(tree);
-    euclidean_custering.setInputCloud(not_table_points);
-    euclidean_custering.extract(cluster_indices);
-
-    pcl::PointCloud<pcl::PointXYZ>::Ptr largest_cluster(new pcl::PointCloud<pcl::PointXYZ>);
-    int largest_cluster_size = 0;
-    for (auto it = cluster_indices.begin (); it != cluster_indices.end (); ++it)
+    pcl::PointIndices largest_cluster_indices;
+    LargestClusterExtraction<pcl::PointXYZ> largest_cluster_extraction;
+    largest_cluster_extraction.setClusterTolerance(0.015);
+    largest_cluster_extraction.setMinClusterSize(100);
+    largest_cluster_extraction.setInputCloud(cloud_downsampled);
+    largest_cluster_extraction.setIndices(not_table_points.getIndices());
+    if (!largest_cluster_extraction.extractLargest(largest_cluster_indices))
     {
-      pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_cluster (new pcl::PointCloud<pcl::PointXYZ>);
-      for (auto pit = it->indices.begin (); pit != it->indices.end (); ++pit)
-        cloud_cluster->points.push_back(not_table_points->points[*pit]);
-      cloud_cluster->width = cloud_cluster->points.size ();
-      cloud_cluster->height = 1;
-      cloud_cluster->is_dense = true;
-
-      std::cout << "Found cluster of " << cloud_cluster->points.size() << " points." << std::endl;
-      if (cloud_cluster->points.size() > largest_cluster_size)
-      {
-          largest_cluster_size = cloud_cluster->points.size();
-          *largest_cluster = *cloud_cluster;
-      }
+        std::cerr << "Could not find the garment cluster." << std::endl;
+        return -2;
     }
+    std::cout << "Found largest cluster of " << largest_cluster_indices.indices.size() << " points." << std::endl;
+    CloudView<pcl::PointXYZ> largest_cluster(cloud_downsampled, largest_cluster_indices);
+
+    //-- Only needed for debugging
+    pcl::PointCloud<pcl::PointXYZ>::Ptr largest_cluster_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    if (debug_enabled)
+        largest_cluster.copyTo(*largest_cluster_cloud);
 
     debug.setEnabled(debug_enabled);
-    debug.plotPointCloud<pcl::PointXYZ>(largest_cluster, Debug::COLOR_CYAN);
+    debug.plotPointCloud<pcl::PointXYZ>(largest_cluster_cloud, Debug::COLOR_CYAN);
     debug.show("Filtered garment cloud");
 
     //-- Find bounding box:
@@ -253,16 +256,17 @@ int main (int argc, char** argv)
     pcl::PointXYZ position_OBB;
     Eigen::Matrix3f rotational_matrix_OBB;
 
-    feature_extractor.setInputCloud(largest_cluster);
+    feature_extractor.setInputCloud(cloud_downsampled);
+    feature_extractor.setIndices(largest_cluster.getIndices());
     feature_extractor.compute();
     feature_extractor.getOBB(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB);
 
 
     //-- Save 2D image origin point
-    record_point(argv[filenames[0]]+std::string("-origin.txt"), pcl::PointXYZ(min_point_OBB.x, max_point_OBB.y, 0));
+    record_point(input_filename+std::string("-origin.txt"), pcl::PointXYZ(min_point_OBB.x, max_point_OBB.y, 0));
 
     debug.setEnabled(debug_enabled);
-    debug.plotPointCloud<pcl::PointXYZ>(largest_cluster, Debug::COLOR_CYAN);
+    debug.plotPointCloud<pcl::PointXYZ>(largest_cluster_cloud, Debug::COLOR_CYAN);
     debug.plotBoundingBox(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB, Debug::COLOR_GREEN);
     debug.show("Oriented bounding cloud");
 
@@ -295,14 +299,14 @@ int main (int argc, char** argv)
     //-- Transform cloud
     Eigen::Transform<float, 3, Eigen::Affine> T(rotation_quaternion*rotational_matrix_OBB.inverse()*translation_transform);
     pcl::transformPointCloud(*source_cloud, *oriented_cloud, T);
-    pcl::transformPointCloud(*largest_cluster, *oriented_garment, T);
+    pcl::transformPointCloud(*cloud_downsampled, *largest_cluster.getIndices(), *oriented_garment, T);
 
     //-- Save to file
-    record_transformation(argv[filenames[0]]+std::string("-transform.txt"), T);
+    record_transformation(input_filename+std::string("-transform.txt"), T);
 
     debug.setEnabled(debug_enabled);
     debug.plotPointCloud<pcl::PointXYZ>(oriented_garment, Debug::COLOR_CYAN);
-    debug.plotPointCloud<pcl::PointXYZ>(largest_cluster, Debug::COLOR_CYAN);
+    debug.plotPointCloud<pcl::PointXYZ>(largest_cluster_cloud, Debug::COLOR_CYAN);
     debug.plotBoundingBox(min_point_OBB, max_point_OBB, position_OBB, rotational_matrix_OBB, Debug::COLOR_YELLOW);
     debug.plotBoundingBox(min_point_OBB, max_point_OBB, pcl::PointXYZ(0,0,0), Eigen::Matrix3f::Identity(), Debug::COLOR_BLUE);
     debug.getRawViewer()->addLine (pcl::PointXYZ(0,0,0), projected_center, 1.0, 0.0, 0.0, "line");
@@ -323,7 +327,7 @@ int main (int argc, char** argv)
     Eigen::MatrixXf depth = depthImageCreator.getDepthImageAsMatrix();
 
     //-- Temporal fix to get depth image (through file)
-    std::ofstream file((argv[filenames[0]]+std::string("-depth.txt")).c_str());
+    std::ofstream file((input_filename+std::string("-depth.txt")).c_str());
     file << depth;
     file.close();
 
@@ -335,7 +339,7 @@ int main (int argc, char** argv)
     maskImageCreator.setAvgPointDist(average_point_distance);
     maskImageCreator.compute();
     Eigen::MatrixXd mask = maskImageCreator.getMaskAsMatrix();
-    eigen2file(mask, argv[filenames[0]]+std::string("-mask.png"));
+    eigen2file(mask, input_filename+std::string("-mask.png"));
 
     return 0;
 }